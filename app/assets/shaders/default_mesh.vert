@@ -6,14 +6,21 @@ layout (location = 2) in vec3 vColor;
 
 layout (location = 0) out vec3 outColor;
 
-layout ( push_constant ) uniform PushConstants
+// the depth prepass and the color pass run this shader in two pipelines and compare with EQUAL,
+// so both must compute bit-identical positions
+invariant gl_Position;
+
+// per-frame data, the draws reading it are recorded once and replayed
+layout (set = 0, binding = 0) uniform FrameData
 {
 	vec4 colors[3];
-} pushConstants;
+} frameData;
 
 void main()
 {
 	gl_Position = vec4(vPosition, 1.0f);
 
-	outColor = pushConstants.colors[gl_VertexIndex].rgb;
+	// gl_VertexIndex counts from the start of the buffer, not of the LOD range being drawn;
+	// the vertex colors are one-hot per triangle corner and pick that corner's UI color
+	outColor = frameData.colors[0].rgb * vColor.r + frameData.colors[1].rgb * vColor.g + frameData.colors[2].rgb * vColor.b;
 }
\ No newline at end of file
@@ -0,0 +1,13 @@
+#version 450
+
+layout (location = 0) in vec3 inColor;
+layout (location = 1) in vec2 inCorner;
+
+layout (location = 0) out vec4 outFragColor;
+
+void main()
+{
+	// round falloff, blended additively
+	float falloff = max(1.0 - dot(inCorner, inCorner), 0.0);
+	outFragColor = vec4(inColor * falloff, falloff);
+}
@@ -0,0 +1,36 @@
+#version 450
+
+struct Particle
+{
+	vec4 position_life;
+	vec4 velocity_seed;
+};
+
+layout (std430, set = 0, binding = 0) readonly buffer Particles { Particle particles[]; };
+
+layout (push_constant) uniform PushConstants
+{
+	// half size of a particle quad in clip space
+	vec2 half_size;
+} pc;
+
+layout (location = 0) out vec3 outColor;
+layout (location = 1) out vec2 outCorner;
+
+const vec2 corners[6] = vec2[](
+	vec2(-1.0, -1.0), vec2( 1.0, -1.0), vec2( 1.0,  1.0),
+	vec2(-1.0, -1.0), vec2( 1.0,  1.0), vec2(-1.0,  1.0)
+);
+
+void main()
+{
+	Particle p = particles[gl_InstanceIndex];
+	vec2 corner = corners[gl_VertexIndex];
+
+	gl_Position = vec4(p.position_life.xy + corner * pc.half_size, p.position_life.z, 1.0);
+
+	// hot when spawned, fading to dark red
+	float heat = clamp(p.position_life.w / 3.0, 0.0, 1.0);
+	outColor = mix(vec3(0.4, 0.05, 0.02), vec3(1.0, 0.8, 0.4), heat) * heat;
+	outCorner = corner;
+}
@@ -1,2 +1,7 @@
 C:/VulkanSDK/1.3.296.0/Bin/glslc.exe assets/shaders/default_mesh.vert -o assets/shaders/spirv/default_mesh_vert.spv
-C:/VulkanSDK/1.3.296.0/Bin/glslc.exe assets/shaders/default_mesh.frag -o assets/shaders/spirv/default_mesh_frag.spv
\ No newline at end of file
+C:/VulkanSDK/1.3.296.0/Bin/glslc.exe assets/shaders/default_mesh.frag -o assets/shaders/spirv/default_mesh_frag.spv
+C:/VulkanSDK/1.3.296.0/Bin/glslc.exe assets/shaders/particles.comp -o assets/shaders/spirv/particles_comp.spv
+C:/VulkanSDK/1.3.296.0/Bin/glslc.exe assets/shaders/particles.vert -o assets/shaders/spirv/particles_vert.spv
+C:/VulkanSDK/1.3.296.0/Bin/glslc.exe assets/shaders/particles.frag -o assets/shaders/spirv/particles_frag.spv
+C:/VulkanSDK/1.3.296.0/Bin/glslc.exe assets/shaders/hiz_build.comp -o assets/shaders/spirv/hiz_build_comp.spv
+C:/VulkanSDK/1.3.296.0/Bin/glslc.exe assets/shaders/hiz_cull.comp -o assets/shaders/spirv/hiz_cull_comp.spv
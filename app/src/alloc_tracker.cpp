@@ -0,0 +1,481 @@
+#include "pre-compiled-header.h"
+#include "alloc_tracker.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+	#include <dbghelp.h>
+	#pragma comment(lib, "dbghelp.lib")
+#else
+	#include <cxxabi.h>
+	#include <dlfcn.h>
+	#include <execinfo.h>
+#endif
+
+namespace
+{
+	enum class Source : uint8_t
+	{
+		NEW,
+		IMGUI,
+		VULKAN_HOST,
+		DEVICE_MEMORY
+	};
+
+	const char* source_name(Source source)
+	{
+		switch(source)
+		{
+		case Source::NEW: 			return "operator new";
+		case Source::IMGUI: 		return "ImGui";
+		case Source::VULKAN_HOST: 	return "Vulkan host";
+		case Source::DEVICE_MEMORY: return "device memory";
+		default: 					return "unknown";
+		}
+	}
+
+	constexpr uint32_t MAX_SITES = 256;
+
+	// deep enough to get out of the standard library's allocator layers in a debug build
+	constexpr uint32_t STACK_DEPTH = 12;
+
+	// capture_stack() and record()
+	constexpr uint32_t SKIPPED_FRAMES = 2;
+
+	struct Site
+	{
+		// 0 while the site is free
+		std::atomic<uint64_t> key {0};
+
+		const char* scope = nullptr;
+
+		Source source = Source::NEW;
+
+		void* stack[STACK_DEPTH] = {};
+
+		uint32_t depth = 0;
+
+		std::atomic<uint64_t> count {0};
+
+		std::atomic<uint64_t> bytes {0};
+	};
+
+	// constant-initialized, operator new may run before any constructor does
+	Site g_sites[MAX_SITES];
+
+	std::atomic<bool> g_armed {false};
+
+	std::atomic<uint64_t> g_count {0};
+
+	// allocations at sites that did not fit in the table
+	std::atomic<uint64_t> g_unlisted {0};
+
+	thread_local const char* t_scope = "unscoped";
+
+	// the stack walk may allocate, which must not be recorded again
+	thread_local bool t_recording = false;
+
+	uint32_t capture_stack(void** frames)
+	{
+#ifdef _WIN32
+		return CaptureStackBackTrace(SKIPPED_FRAMES, STACK_DEPTH, frames, nullptr);
+#else
+		void* all[STACK_DEPTH + SKIPPED_FRAMES];
+		int captured = backtrace(all, STACK_DEPTH + SKIPPED_FRAMES);
+		uint32_t kept = captured > static_cast<int>(SKIPPED_FRAMES) ? captured - SKIPPED_FRAMES : 0;
+		memcpy(frames, all + SKIPPED_FRAMES, kept * sizeof(void*));
+		return kept;
+#endif
+	}
+
+	// lock-free and allocation-free, any thread
+	void record(Source source, size_t size)
+	{
+		if(!g_armed.load(std::memory_order_relaxed) || t_recording)
+			return;
+		t_recording = true;
+
+		g_count.fetch_add(1, std::memory_order_relaxed);
+
+		void* stack[STACK_DEPTH];
+		uint32_t depth = capture_stack(stack);
+
+		uint64_t key = 0xcbf29ce484222325ull;
+		for(uint32_t i = 0; i < depth; i++)
+			key = (key ^ reinterpret_cast<uint64_t>(stack[i])) * 0x100000001b3ull;
+		key = (key ^ reinterpret_cast<uint64_t>(t_scope)) * 0x100000001b3ull;
+		key = ((key ^ static_cast<uint64_t>(source)) * 0x100000001b3ull) | 1;
+
+		bool listed = false;
+		for(uint32_t probe = 0; probe < MAX_SITES && !listed; probe++)
+		{
+			Site& site = g_sites[(key + probe) % MAX_SITES];
+
+			uint64_t expected = 0;
+			if(site.key.compare_exchange_strong(expected, key, std::memory_order_acq_rel))
+			{
+				site.scope = t_scope;
+				site.source = source;
+				site.depth = depth;
+				memcpy(site.stack, stack, depth * sizeof(void*));
+				expected = key;
+			}
+
+			if(expected == key)
+			{
+				site.count.fetch_add(1, std::memory_order_relaxed);
+				site.bytes.fetch_add(size, std::memory_order_relaxed);
+				listed = true;
+			}
+		}
+
+		if(!listed)
+			g_unlisted.fetch_add(1, std::memory_order_relaxed);
+
+		t_recording = false;
+	}
+
+	std::string describe(void* address)
+	{
+#ifdef _WIN32
+		HANDLE process = GetCurrentProcess();
+
+		alignas(SYMBOL_INFO) char buffer[sizeof(SYMBOL_INFO) + MAX_SYM_NAME];
+		SYMBOL_INFO* symbol = reinterpret_cast<SYMBOL_INFO*>(buffer);
+		symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+		symbol->MaxNameLen = MAX_SYM_NAME;
+
+		DWORD64 displacement = 0;
+		if(SymFromAddr(process, reinterpret_cast<DWORD64>(address), &displacement, symbol))
+			return fmt::format("{}+0x{:x}", symbol->Name, displacement);
+#else
+		// symbols of the executable itself need -rdynamic, otherwise the module offset is printed for addr2line
+		Dl_info info;
+		if(dladdr(address, &info))
+		{
+			uintptr_t target = reinterpret_cast<uintptr_t>(address);
+			if(info.dli_sname != nullptr)
+			{
+				int status = 0;
+				char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+				std::string name = status == 0 ? demangled : info.dli_sname;
+				std::free(demangled);
+				return fmt::format("{}+0x{:x}", name, target - reinterpret_cast<uintptr_t>(info.dli_saddr));
+			}
+			if(info.dli_fname != nullptr)
+				return fmt::format("{}+0x{:x}", info.dli_fname, target - reinterpret_cast<uintptr_t>(info.dli_fbase));
+		}
+#endif
+		return fmt::format("{}", fmt::ptr(address));
+	}
+
+	// --- aligned blocks ---
+
+	void* aligned_malloc(size_t size, size_t alignment)
+	{
+#ifdef _WIN32
+		return _aligned_malloc(size, alignment);
+#else
+		// aligned_alloc wants a multiple of the alignment
+		return std::aligned_alloc(alignment, (std::max<size_t>(size, 1) + alignment - 1) / alignment * alignment);
+#endif
+	}
+
+	void aligned_free(void* pointer)
+	{
+#ifdef _WIN32
+		_aligned_free(pointer);
+#else
+		std::free(pointer);
+#endif
+	}
+
+	// VkAllocationCallbacks must reallocate aligned blocks, so each one keeps its size and malloc block in front of it
+	struct VulkanBlock
+	{
+		void* base;
+
+		size_t size;
+	};
+
+	void* allocate_vulkan_block(size_t size, size_t alignment)
+	{
+		alignment = std::max(alignment, alignof(VulkanBlock));
+
+		uint8_t* base = static_cast<uint8_t*>(std::malloc(size + alignment + sizeof(VulkanBlock)));
+		if(base == nullptr)
+			return nullptr;
+
+		uintptr_t start = (reinterpret_cast<uintptr_t>(base) + sizeof(VulkanBlock) + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+		VulkanBlock* block = reinterpret_cast<VulkanBlock*>(start) - 1;
+		block->base = base;
+		block->size = size;
+
+		return reinterpret_cast<void*>(start);
+	}
+
+	void VKAPI_PTR vulkan_free(void*, void* memory)
+	{
+		if(memory != nullptr)
+			std::free((static_cast<VulkanBlock*>(memory) - 1)->base);
+	}
+
+	void* VKAPI_PTR vulkan_allocate(void*, size_t size, size_t alignment, VkSystemAllocationScope)
+	{
+		record(Source::VULKAN_HOST, size);
+		return allocate_vulkan_block(size, alignment);
+	}
+
+	void* VKAPI_PTR vulkan_reallocate(void* user_data, void* original, size_t size, size_t alignment, VkSystemAllocationScope scope)
+	{
+		if(original == nullptr)
+			return vulkan_allocate(user_data, size, alignment, scope);
+
+		if(size == 0)
+		{
+			vulkan_free(user_data, original);
+			return nullptr;
+		}
+
+		record(Source::VULKAN_HOST, size);
+		void* memory = allocate_vulkan_block(size, alignment);
+		if(memory == nullptr)
+			return nullptr;
+
+		memcpy(memory, original, std::min(size, (static_cast<VulkanBlock*>(original) - 1)->size));
+		vulkan_free(user_data, original);
+		return memory;
+	}
+
+	void VKAPI_PTR device_memory_allocated(VmaAllocator, uint32_t, VkDeviceMemory, VkDeviceSize size, void*)
+	{
+		record(Source::DEVICE_MEMORY, static_cast<size_t>(size));
+	}
+
+	void VKAPI_PTR device_memory_freed(VmaAllocator, uint32_t, VkDeviceMemory, VkDeviceSize, void*)
+	{
+	}
+
+	const VkAllocationCallbacks VULKAN_CALLBACKS = {
+		.pUserData 			   = nullptr,
+		.pfnAllocation 		   = vulkan_allocate,
+		.pfnReallocation 	   = vulkan_reallocate,
+		.pfnFree 			   = vulkan_free,
+		.pfnInternalAllocation = nullptr,
+		.pfnInternalFree 	   = nullptr
+	};
+
+	const VmaDeviceMemoryCallbacks DEVICE_MEMORY_CALLBACKS = {
+		.pfnAllocate = device_memory_allocated,
+		.pfnFree 	 = device_memory_freed,
+		.pUserData 	 = nullptr
+	};
+}
+
+bool alloctrack::is_available()
+{
+#ifdef DEBUG
+	return true;
+#else
+	return false;
+#endif
+}
+
+void alloctrack::arm()
+{
+#ifndef _WIN32
+	// the first backtrace() loads the unwinder, which allocates
+	void* frame;
+	backtrace(&frame, 1);
+#endif
+
+	for(Site& site : g_sites)
+	{
+		site.key.store(0, std::memory_order_relaxed);
+		site.count.store(0, std::memory_order_relaxed);
+		site.bytes.store(0, std::memory_order_relaxed);
+	}
+	g_count.store(0, std::memory_order_relaxed);
+	g_unlisted.store(0, std::memory_order_relaxed);
+
+	g_armed.store(true, std::memory_order_release);
+}
+
+void alloctrack::disarm()
+{
+	g_armed.store(false, std::memory_order_release);
+}
+
+uint64_t alloctrack::get_count()
+{
+	return g_count.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Print the sites that allocated while armed, most allocations first
+ *
+ * Must run disarmed, it allocates itself.
+ * @param phase What was tracked, e.g. "after warm-up"
+ */
+uint64_t alloctrack::report(const char* phase)
+{
+	std::vector<const Site*> sites;
+	for(const Site& site : g_sites)
+		if(site.key.load(std::memory_order_acquire) != 0 && site.count.load(std::memory_order_relaxed) > 0)
+			sites.push_back(&site);
+
+	std::sort(sites.begin(), sites.end(), [](const Site* a, const Site* b)
+	{
+		return a->count.load(std::memory_order_relaxed) > b->count.load(std::memory_order_relaxed);
+	});
+
+	uint64_t count = get_count();
+	fmt::print("allocations {}: {} at {} call sites\n", phase, count, sites.size());
+
+#ifdef _WIN32
+	HANDLE process = GetCurrentProcess();
+	SymSetOptions(SYMOPT_UNDNAME | SYMOPT_DEFERRED_LOADS);
+	SymInitialize(process, nullptr, TRUE);
+#endif
+
+	for(const Site* site : sites)
+	{
+		fmt::print("  {:6}x {:10} bytes, {} in {}\n", site->count.load(std::memory_order_relaxed), site->bytes.load(std::memory_order_relaxed),
+			source_name(site->source), site->scope);
+		for(uint32_t i = 0; i < site->depth; i++)
+			fmt::print("      {}\n", describe(site->stack[i]));
+	}
+
+#ifdef _WIN32
+	SymCleanup(process);
+#endif
+
+	uint64_t unlisted = g_unlisted.load(std::memory_order_relaxed);
+	if(unlisted > 0)
+		fmt::print("  {} allocations at sites beyond the first {}\n", unlisted, MAX_SITES);
+
+	return count;
+}
+
+void* alloctrack::imgui_alloc(size_t size, void*)
+{
+	record(Source::IMGUI, size);
+	return std::malloc(size);
+}
+
+void alloctrack::imgui_free(void* pointer, void*)
+{
+	std::free(pointer);
+}
+
+const VkAllocationCallbacks* alloctrack::get_vulkan_callbacks()
+{
+	return &VULKAN_CALLBACKS;
+}
+
+const VmaDeviceMemoryCallbacks* alloctrack::get_device_memory_callbacks()
+{
+	return &DEVICE_MEMORY_CALLBACKS;
+}
+
+AllocationScope::AllocationScope(const char* name)
+	: m_previous(t_scope)
+{
+	t_scope = name;
+}
+
+AllocationScope::~AllocationScope()
+{
+	t_scope = m_previous;
+}
+
+// --- global operator new, counted while armed ---
+
+#ifdef DEBUG
+
+void* operator new(size_t size)
+{
+	record(Source::NEW, size);
+	if(void* pointer = std::malloc(size > 0 ? size : 1))
+		return pointer;
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size)
+{
+	record(Source::NEW, size);
+	if(void* pointer = std::malloc(size > 0 ? size : 1))
+		return pointer;
+	throw std::bad_alloc();
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	record(Source::NEW, size);
+	return std::malloc(size > 0 ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	record(Source::NEW, size);
+	return std::malloc(size > 0 ? size : 1);
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	record(Source::NEW, size);
+	if(void* pointer = aligned_malloc(size, static_cast<size_t>(alignment)))
+		return pointer;
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t size, std::align_val_t alignment)
+{
+	record(Source::NEW, size);
+	if(void* pointer = aligned_malloc(size, static_cast<size_t>(alignment)))
+		return pointer;
+	throw std::bad_alloc();
+}
+
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	record(Source::NEW, size);
+	return aligned_malloc(size, static_cast<size_t>(alignment));
+}
+
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept
+{
+	record(Source::NEW, size);
+	return aligned_malloc(size, static_cast<size_t>(alignment));
+}
+
+void operator delete(void* pointer) noexcept { std::free(pointer); }
+
+void operator delete[](void* pointer) noexcept { std::free(pointer); }
+
+void operator delete(void* pointer, size_t) noexcept { std::free(pointer); }
+
+void operator delete[](void* pointer, size_t) noexcept { std::free(pointer); }
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { std::free(pointer); }
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { std::free(pointer); }
+
+void operator delete(void* pointer, std::align_val_t) noexcept { aligned_free(pointer); }
+
+void operator delete[](void* pointer, std::align_val_t) noexcept { aligned_free(pointer); }
+
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept { aligned_free(pointer); }
+
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept { aligned_free(pointer); }
+
+void operator delete(void* pointer, std::align_val_t, const std::nothrow_t&) noexcept { aligned_free(pointer); }
+
+void operator delete[](void* pointer, std::align_val_t, const std::nothrow_t&) noexcept { aligned_free(pointer); }
+
+#endif
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "vk_defines.h"
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Debug harness that counts the heap allocations made while it is armed,
+ * by call site. It sees global operator new, ImGui's allocator and, when
+ * they are handed to vmaCreateAllocator, VMA's host allocations and its
+ * device memory blocks. Plain malloc calls from other libraries are not
+ * seen. Call sites are told apart by a short stack trace and by the
+ * AllocationScope of the thread. Only built with DEBUG, which replaces
+ * operator new; is_available() is false otherwise.
+ */
+namespace alloctrack
+{
+
+	bool is_available();
+
+	// counts from now on, sites seen before are forgotten
+	void arm();
+
+	void disarm();
+
+	uint64_t get_count();
+
+	// prints every site that allocated while armed, returns the allocation count
+	uint64_t report(const char* phase);
+
+	// for ImGui::SetAllocatorFunctions()
+	void* imgui_alloc(size_t size, void* user_data);
+
+	void imgui_free(void* pointer, void* user_data);
+
+	// for VmaAllocatorCreateInfo
+	const VkAllocationCallbacks* get_vulkan_callbacks();
+
+	const VmaDeviceMemoryCallbacks* get_device_memory_callbacks();
+
+};
+
+// Names the allocations of the calling thread in the report until it goes out of scope
+class AllocationScope
+{
+public:
+
+	explicit AllocationScope(const char* name);
+
+	~AllocationScope();
+
+	AllocationScope(const AllocationScope&) = delete;
+
+	AllocationScope& operator=(const AllocationScope&) = delete;
+
+private:
+
+	const char* m_previous;
+};
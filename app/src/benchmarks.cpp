@@ -0,0 +1,93 @@
+#include "pre-compiled-header.h"
+#include "benchmarks.h"
+
+#include "jobs.h"
+#include "alloc_tracker.h"
+
+#include <fmt/core.h>
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	double elapsed_ns(Clock::time_point start)
+	{
+		return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+	}
+
+	void empty_job(void*, uint32_t, uint32_t)
+	{
+	}
+}
+
+/**
+ * @brief Measure the per-task overhead of the job system
+ *
+ * Reports the cost of submitting and completing empty jobs (single worker
+ * and all workers), and of a parallel_for over trivially small ranges.
+ * Throws when either costs more than MAX_TASK_OVERHEAD_NS per task. In a
+ * debug build it also checks that neither allocates once the workers are
+ * running.
+ */
+void run_job_benchmark()
+{
+	constexpr uint32_t JOB_COUNT = 1 << 20;
+	constexpr uint32_t BATCH_SIZE = 1024;
+
+	// the job system is meant for tasks of a few microseconds, its own cost per task must stay below one
+	constexpr double MAX_TASK_OVERHEAD_NS = 1000.0;
+
+	// a job that does not fit in the deque runs inline and would not be measured as a job
+	static_assert(BATCH_SIZE <= WorkStealingDeque::CAPACITY, "a batch must fit in one deque");
+
+	for(uint32_t worker_count : { 1u, std::max(1u, std::thread::hardware_concurrency()) })
+	{
+		JobSystem jobs;
+		jobs.init(worker_count);
+
+		std::vector<uint32_t> values(JOB_COUNT);
+
+		if(alloctrack::is_available())
+			alloctrack::arm();
+
+		// empty jobs, submitted in batches that fit in one deque
+		Clock::time_point start = Clock::now();
+		for(uint32_t submitted = 0; submitted < JOB_COUNT; submitted += BATCH_SIZE)
+		{
+			JobCounter counter;
+			for(uint32_t i = 0; i < BATCH_SIZE; i++)
+				jobs.run(counter, empty_job, nullptr);
+			jobs.wait(counter);
+		}
+		double empty_ns = elapsed_ns(start) / JOB_COUNT;
+
+		// parallel_for with one item per job, over batches that fit in one deque as well
+		start = Clock::now();
+		for(uint32_t first = 0; first < JOB_COUNT; first += BATCH_SIZE)
+		{
+			jobs.parallel_for(BATCH_SIZE, 1, [&values, first](uint32_t begin, uint32_t end)
+			{
+				for(uint32_t i = first + begin; i < first + end; i++)
+					values[i] = i * 2654435761u;
+			});
+		}
+		double parallel_for_ns = elapsed_ns(start) / JOB_COUNT;
+
+		if(alloctrack::is_available())
+		{
+			alloctrack::disarm();
+			alloctrack::report("job benchmark");
+		}
+
+		if(jobs.get_overflow_count() > 0)
+			throw std::runtime_error(fmt::format("job benchmark: {} jobs overflowed their deque and ran inline", jobs.get_overflow_count()));
+
+		fmt::print("jobs: {:2} workers | empty job {:7.1f} ns | parallel_for item (grain 1) {:7.1f} ns\n",
+			worker_count, empty_ns, parallel_for_ns);
+
+		if(empty_ns > MAX_TASK_OVERHEAD_NS || parallel_for_ns > MAX_TASK_OVERHEAD_NS)
+			throw std::runtime_error(fmt::format("job benchmark: per-task overhead over {:.0f} ns with {} workers", MAX_TASK_OVERHEAD_NS, worker_count));
+
+		jobs.shutdown();
+	}
+}
@@ -0,0 +1,4 @@
+#pragma once
+
+// Micro-benchmarks run from the command line (--bench-jobs), outside the engine
+void run_job_benchmark();
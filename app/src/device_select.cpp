@@ -0,0 +1,240 @@
+#include "pre-compiled-header.h"
+#include "device_select.h"
+
+#include <cctype>
+
+namespace
+{
+	// the device type decides first, the other terms only order GPUs of the same type
+	constexpr int64_t SCORE_DISCRETE 	= 100000;
+	constexpr int64_t SCORE_INTEGRATED 	= 50000;
+	constexpr int64_t SCORE_VIRTUAL 	= 25000;
+
+	// per 64 MiB of device-local memory
+	constexpr int64_t SCORE_MEMORY_UNIT = 1;
+	constexpr VkDeviceSize MEMORY_UNIT 	= 64ull * 1024 * 1024;
+
+	constexpr int64_t SCORE_ASYNC_COMPUTE = 500;
+
+	// per optional feature the engine enables when present
+	constexpr int64_t SCORE_FEATURE = 250;
+
+	// above any single GPU, so --device-group picks a linked GPU whenever there is one
+	constexpr int64_t SCORE_DEVICE_GROUP = 1000000;
+
+	const char* get_type_name(VkPhysicalDeviceType type)
+	{
+		switch(type)
+		{
+		case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: 	 return "discrete";
+		case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return "integrated";
+		case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: 	 return "virtual";
+		case VK_PHYSICAL_DEVICE_TYPE_CPU: 			 return "cpu";
+		default: 									 return "other";
+		}
+	}
+
+	int64_t get_type_score(VkPhysicalDeviceType type)
+	{
+		switch(type)
+		{
+		case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: 	 return SCORE_DISCRETE;
+		case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return SCORE_INTEGRATED;
+		case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: 	 return SCORE_VIRTUAL;
+		default: 									 return 0;
+		}
+	}
+
+	std::vector<VkPhysicalDeviceGroupProperties> get_device_groups(VkInstance instance)
+	{
+		uint32_t group_count = 0;
+		VK_CHECK(vkEnumeratePhysicalDeviceGroups(instance, &group_count, nullptr));
+		std::vector<VkPhysicalDeviceGroupProperties> groups(group_count, { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GROUP_PROPERTIES });
+		VK_CHECK(vkEnumeratePhysicalDeviceGroups(instance, &group_count, groups.data()));
+		return groups;
+	}
+
+	std::string to_lower(std::string text)
+	{
+		std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+		return text;
+	}
+}
+
+/**
+ * @brief List the GPUs the engine can run on, best first
+ * @param instance The vulkan instance
+ * @param surface The surface the engine presents to
+ * @param prefer_device_groups Rank GPUs linked to others above single ones
+ */
+std::vector<DeviceCandidate> vkdevice::rank_devices(VkInstance instance, VkSurfaceKHR surface, bool prefer_device_groups)
+{
+	uint32_t gpu_count;
+	VK_CHECK(vkEnumeratePhysicalDevices(instance, &gpu_count, nullptr));
+	if(gpu_count < 1)
+		throw std::runtime_error("No physical device found.");
+	std::vector<VkPhysicalDevice> gpus(gpu_count);
+	VK_CHECK(vkEnumeratePhysicalDevices(instance, &gpu_count, gpus.data()));
+
+	std::vector<VkPhysicalDeviceGroupProperties> groups = get_device_groups(instance);
+
+	std::vector<DeviceCandidate> candidates;
+	for(uint32_t index = 0; index < gpu_count; index++)
+	{
+		DeviceCandidate candidate = {
+			.gpu   = gpus[index],
+			.index = index
+		};
+		vkGetPhysicalDeviceProperties(candidate.gpu, &candidate.properties);
+
+		auto skip = [&](const char* reason)
+		{
+			std::cout << "gpu [" << index << "] " << candidate.properties.deviceName << ": skipped, " << reason << '\n';
+		};
+
+		if(candidate.properties.apiVersion < VK_API_VERSION_1_3)
+		{
+			skip("no Vulkan 1.3");
+			continue;
+		}
+
+		candidate.families = vkutil::find_queue_families(candidate.gpu, surface);
+		if(candidate.families.graphics == UINT32_MAX)
+		{
+			skip("no graphics queue that presents to the window");
+			continue;
+		}
+
+		uint32_t extension_count;
+		VK_CHECK(vkEnumerateDeviceExtensionProperties(candidate.gpu, nullptr, &extension_count, nullptr));
+		std::vector<VkExtensionProperties> extensions(extension_count);
+		VK_CHECK(vkEnumerateDeviceExtensionProperties(candidate.gpu, nullptr, &extension_count, extensions.data()));
+
+		auto has_extension = [&extensions](const char* name)
+		{
+			for(const auto& extension : extensions)
+				if(strcmp(extension.extensionName, name) == 0)
+					return true;
+			return false;
+		};
+
+		if(!has_extension(VK_KHR_SWAPCHAIN_EXTENSION_NAME))
+		{
+			skip("no swapchain support");
+			continue;
+		}
+
+		VkPhysicalDeviceFeatures2 features2{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+		VkPhysicalDeviceVulkan12Features vulkan12_features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+		VkPhysicalDeviceVulkan13Features vulkan13_features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES};
+		VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extended_dynamic_state_features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT};
+		features2.pNext = &vulkan12_features;
+		vulkan12_features.pNext = &vulkan13_features;
+		vulkan13_features.pNext = &extended_dynamic_state_features;
+		vkGetPhysicalDeviceFeatures2(candidate.gpu, &features2);
+
+		if(!vulkan13_features.dynamicRendering || !vulkan13_features.synchronization2
+			|| !vulkan12_features.timelineSemaphore || !extended_dynamic_state_features.extendedDynamicState)
+		{
+			skip("a required feature is missing");
+			continue;
+		}
+
+		VkPhysicalDeviceMemoryProperties memory_properties;
+		vkGetPhysicalDeviceMemoryProperties(candidate.gpu, &memory_properties);
+		for(uint32_t heap = 0; heap < memory_properties.memoryHeapCount; heap++)
+			if(memory_properties.memoryHeaps[heap].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+				candidate.local_memory += memory_properties.memoryHeaps[heap].size;
+
+		for(const VkPhysicalDeviceGroupProperties& group : groups)
+			for(uint32_t i = 0; i < group.physicalDeviceCount; i++)
+				if(group.physicalDevices[i] == candidate.gpu)
+					candidate.group_size = group.physicalDeviceCount;
+
+		// the optional features init_vulkan() enables
+		uint32_t optional_features = 0;
+		if(has_extension(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME))
+			optional_features++;
+		if(has_extension(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME))
+			optional_features++;
+		if(has_extension(VK_KHR_PRESENT_WAIT_EXTENSION_NAME))
+			optional_features++;
+		if(vulkan12_features.drawIndirectCount)
+			optional_features++;
+
+		candidate.score = get_type_score(candidate.properties.deviceType)
+						+ static_cast<int64_t>(candidate.local_memory / MEMORY_UNIT) * SCORE_MEMORY_UNIT
+						+ (candidate.families.has_async_compute() ? SCORE_ASYNC_COMPUTE : 0)
+						+ optional_features * SCORE_FEATURE
+						+ (prefer_device_groups && candidate.group_size > 1 ? SCORE_DEVICE_GROUP : 0);
+
+		std::cout << "gpu [" << index << "] " << candidate.properties.deviceName << ": " << get_type_name(candidate.properties.deviceType)
+				  << ", " << candidate.local_memory / (1024 * 1024) << " MiB, " << candidate.group_size << " in group, score " << candidate.score << '\n';
+
+		candidates.push_back(candidate);
+	}
+
+	// stable, so equal scores keep the driver's order
+	std::stable_sort(candidates.begin(), candidates.end(), [](const DeviceCandidate& a, const DeviceCandidate& b)
+	{
+		return a.score > b.score;
+	});
+
+	return candidates;
+}
+
+/**
+ * @brief Pick the GPU to run on
+ * @param candidates Suitable GPUs, best first, from rank_devices()
+ * @param preference Empty for the best one, an index from the device list, or part of a device name
+ */
+const DeviceCandidate& vkdevice::choose_device(const std::vector<DeviceCandidate>& candidates, const std::string& preference)
+{
+	if(candidates.empty())
+		throw std::runtime_error("Failed to find a suitable GPU with Vulkan 1.3 support.");
+
+	if(preference.empty())
+		return candidates.front();
+
+	bool is_index = std::all_of(preference.begin(), preference.end(), [](unsigned char c) { return std::isdigit(c); });
+	std::string name = to_lower(preference);
+
+	for(const DeviceCandidate& candidate : candidates)
+	{
+		if(is_index ? candidate.index == std::stoul(preference)
+					: to_lower(candidate.properties.deviceName).find(name) != std::string::npos)
+			return candidate;
+	}
+
+	throw std::runtime_error("No suitable GPU matches --gpu " + preference);
+}
+
+/**
+ * @brief Find the linked GPUs a logical device can span
+ *
+ * gpu is moved to the front: the order of the group is the order of the
+ * device indices, so the GPU that was checked for presenting is device 0.
+ * @param instance The vulkan instance
+ * @param gpu The selected physical device
+ */
+VkPhysicalDeviceGroupProperties vkdevice::find_device_group(VkInstance instance, VkPhysicalDevice gpu)
+{
+	for(VkPhysicalDeviceGroupProperties group : get_device_groups(instance))
+	{
+		for(uint32_t i = 0; i < group.physicalDeviceCount; i++)
+		{
+			if(group.physicalDevices[i] == gpu)
+			{
+				std::swap(group.physicalDevices[0], group.physicalDevices[i]);
+				return group;
+			}
+		}
+	}
+
+	VkPhysicalDeviceGroupProperties single = {
+		.sType 				 = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GROUP_PROPERTIES,
+		.physicalDeviceCount = 1
+	};
+	single.physicalDevices[0] = gpu;
+	return single;
+}
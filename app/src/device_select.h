@@ -0,0 +1,50 @@
+#pragma once
+
+#include "vk_defines.h"
+#include "vk_utils.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A GPU the engine can run on, and how well it suits it
+struct DeviceCandidate
+{
+	VkPhysicalDevice gpu = VK_NULL_HANDLE;
+
+	// position in vkEnumeratePhysicalDevices, what --gpu selects by number
+	uint32_t index = 0;
+
+	VkPhysicalDeviceProperties properties {};
+
+	QueueFamilies families;
+
+	// sum of the device-local heaps, in bytes
+	VkDeviceSize local_memory = 0;
+
+	// physical devices of its device group, 1 when it is not linked to another GPU
+	uint32_t group_size = 1;
+
+	int64_t score = 0;
+};
+
+namespace vkdevice
+{
+
+	/**
+	 * Every GPU that meets the engine's requirements (Vulkan 1.3, a graphics
+	 * queue that presents to surface, the required features), best score
+	 * first. Discrete beats integrated beats virtual, then device-local
+	 * memory, a dedicated compute family and the optional features the
+	 * engine uses break ties. With prefer_device_groups, GPUs linked to
+	 * others come first. The GPUs that were skipped are printed with why.
+	 */
+	std::vector<DeviceCandidate> rank_devices(VkInstance instance, VkSurfaceKHR surface, bool prefer_device_groups);
+
+	// the first candidate, or the one preference names by index or by part of its name (case-insensitive); throws when none matches
+	const DeviceCandidate& choose_device(const std::vector<DeviceCandidate>& candidates, const std::string& preference);
+
+	// the device group gpu belongs to with gpu first, a group of one when it is not linked to another GPU
+	VkPhysicalDeviceGroupProperties find_device_group(VkInstance instance, VkPhysicalDevice gpu);
+
+};
@@ -0,0 +1,397 @@
+// Reference consumer of the frame export: connects to a running pseudo3d
+// (--export <path>), waits for each frame on the imported "ready" semaphore,
+// reads it in place and releases it. Only needs frame_export_protocol.h.
+//
+//   export-consumer <path> [--frames N] [--dump frame.ppm]
+
+#include "frame_export_protocol.h"
+
+#include <vulkan/vulkan.h>
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <linux/dma-buf.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#define CHECK(x)                                                           \
+do                                                                         \
+{                                                                          \
+	VkResult err = x;                                                      \
+	if (err) {                                                             \
+		std::cerr << #x << " failed: " << err << '\n';                     \
+		abort();                                                           \
+	}                                                                      \
+} while (0)
+
+namespace
+{
+	struct Connection
+	{
+		int socket = -1;
+
+		frame_export::Handshake handshake;
+
+		// ready, released, then the memory
+		std::vector<int> fds;
+	};
+
+	Connection connect_to_engine(const std::string& path)
+	{
+		Connection connection;
+
+		sockaddr_un address = {};
+		address.sun_family = AF_UNIX;
+		if(path.size() >= sizeof(address.sun_path))
+			throw std::runtime_error("Socket path is too long: " + path);
+		std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+		connection.socket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if(connection.socket < 0 || connect(connection.socket, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+			throw std::runtime_error("Failed to connect to " + path);
+
+		iovec payload = {
+			.iov_base = &connection.handshake,
+			.iov_len  = sizeof(connection.handshake)
+		};
+
+		union
+		{
+			char buffer[CMSG_SPACE(sizeof(int) * (2 + frame_export::MAX_SLOTS))];
+			cmsghdr align;
+		} control = {};
+
+		msghdr message = {};
+		message.msg_iov 	   = &payload;
+		message.msg_iovlen 	   = 1;
+		message.msg_control    = control.buffer;
+		message.msg_controllen = sizeof(control.buffer);
+
+		ssize_t received = recvmsg(connection.socket, &message, MSG_WAITALL | MSG_CMSG_CLOEXEC);
+		if(received != static_cast<ssize_t>(sizeof(connection.handshake)) || connection.handshake.magic != frame_export::MAGIC)
+			throw std::runtime_error("Invalid handshake from " + path);
+
+		for(cmsghdr* header = CMSG_FIRSTHDR(&message); header != nullptr; header = CMSG_NXTHDR(&message, header))
+		{
+			if(header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS)
+				continue;
+
+			size_t count = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+			connection.fds.resize(count);
+			std::memcpy(connection.fds.data(), CMSG_DATA(header), sizeof(int) * count);
+		}
+
+		const frame_export::Handshake& handshake = connection.handshake;
+		size_t expected = 2 + (handshake.memory_kind == frame_export::MEMORY_DMA_BUF ? handshake.slot_count : 1);
+		if(handshake.slot_count < 2 || handshake.slot_count > frame_export::MAX_SLOTS || connection.fds.size() != expected)
+			throw std::runtime_error("Handshake carries " + std::to_string(connection.fds.size()) + " file descriptors, expected " + std::to_string(expected));
+
+		return connection;
+	}
+
+	struct Device
+	{
+		VkInstance instance = VK_NULL_HANDLE;
+
+		VkDevice device = VK_NULL_HANDLE;
+
+		VkSemaphore ready = VK_NULL_HANDLE;
+
+		VkSemaphore released = VK_NULL_HANDLE;
+	};
+
+	// the semaphores can only be imported on the GPU and driver that exported them
+	Device open_device(const frame_export::Handshake& handshake)
+	{
+		Device device;
+
+		VkApplicationInfo app_info = {
+			.sType 			  = VK_STRUCTURE_TYPE_APPLICATION_INFO,
+			.pApplicationName = "export-consumer",
+			.apiVersion 	  = VK_API_VERSION_1_2
+		};
+
+		VkInstanceCreateInfo instance_info = {
+			.sType 			  = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+			.pApplicationInfo = &app_info
+		};
+
+		CHECK(vkCreateInstance(&instance_info, nullptr, &device.instance));
+
+		uint32_t gpu_count = 0;
+		CHECK(vkEnumeratePhysicalDevices(device.instance, &gpu_count, nullptr));
+		std::vector<VkPhysicalDevice> gpus(gpu_count);
+		CHECK(vkEnumeratePhysicalDevices(device.instance, &gpu_count, gpus.data()));
+
+		VkPhysicalDevice gpu = VK_NULL_HANDLE;
+		for(VkPhysicalDevice candidate : gpus)
+		{
+			VkPhysicalDeviceIDProperties id_properties = {
+				.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES
+			};
+
+			VkPhysicalDeviceProperties2 properties = {
+				.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+				.pNext = &id_properties
+			};
+
+			vkGetPhysicalDeviceProperties2(candidate, &properties);
+			if(std::memcmp(id_properties.deviceUUID, handshake.device_uuid, VK_UUID_SIZE) == 0
+				&& std::memcmp(id_properties.driverUUID, handshake.driver_uuid, VK_UUID_SIZE) == 0)
+			{
+				std::cout << "gpu: " << properties.properties.deviceName << '\n';
+				gpu = candidate;
+				break;
+			}
+		}
+
+		if(gpu == VK_NULL_HANDLE)
+			throw std::runtime_error("The exporting GPU and driver are not available here");
+
+		// the semaphores need a device, not a queue; any family will do
+		float priority = 1.0f;
+		VkDeviceQueueCreateInfo queue_info = {
+			.sType 			  = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+			.queueFamilyIndex = 0,
+			.queueCount 	  = 1,
+			.pQueuePriorities = &priority
+		};
+
+		VkPhysicalDeviceVulkan12Features vulkan12_features = {
+			.sType 			   = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+			.timelineSemaphore = VK_TRUE
+		};
+
+		const char* extensions[] = { VK_KHR_EXTERNAL_SEMAPHORE_FD_EXTENSION_NAME };
+
+		VkDeviceCreateInfo device_info = {
+			.sType 					 = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+			.pNext 					 = &vulkan12_features,
+			.queueCreateInfoCount 	 = 1,
+			.pQueueCreateInfos 		 = &queue_info,
+			.enabledExtensionCount 	 = 1,
+			.ppEnabledExtensionNames = extensions
+		};
+
+		CHECK(vkCreateDevice(gpu, &device_info, nullptr, &device.device));
+		return device;
+	}
+
+	// takes ownership of fd
+	VkSemaphore import_timeline(VkDevice device, int fd)
+	{
+		VkSemaphoreTypeCreateInfo type_info = {
+			.sType 		   = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+			.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE
+		};
+
+		VkSemaphoreCreateInfo semaphore_info = {
+			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+			.pNext = &type_info
+		};
+
+		VkSemaphore semaphore;
+		CHECK(vkCreateSemaphore(device, &semaphore_info, nullptr, &semaphore));
+
+		auto import_fd = reinterpret_cast<PFN_vkImportSemaphoreFdKHR>(vkGetDeviceProcAddr(device, "vkImportSemaphoreFdKHR"));
+
+		VkImportSemaphoreFdInfoKHR import_info = {
+			.sType 		= VK_STRUCTURE_TYPE_IMPORT_SEMAPHORE_FD_INFO_KHR,
+			.semaphore 	= semaphore,
+			.handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_FD_BIT,
+			.fd 		= fd
+		};
+
+		CHECK(import_fd(device, &import_info));
+		return semaphore;
+	}
+
+	// readable means the engine closed the connection, it never writes after the handshake
+	bool is_hung_up(int socket)
+	{
+		pollfd poll_fd = { .fd = socket, .events = POLLIN };
+		return poll(&poll_fd, 1, 0) > 0;
+	}
+
+	uint64_t checksum(const uint8_t* pixels, const frame_export::Handshake& handshake)
+	{
+		// FNV-1a over the visible bytes, the row padding is not part of the frame
+		uint64_t hash = 14695981039346656037ull;
+		for(uint32_t y = 0; y < handshake.height; y++)
+		{
+			const uint8_t* row = pixels + y * handshake.row_pitch;
+			for(uint32_t x = 0; x < handshake.width * 4; x++)
+				hash = (hash ^ row[x]) * 1099511628211ull;
+		}
+		return hash;
+	}
+
+	void write_ppm(const std::string& path, const uint8_t* pixels, const frame_export::Handshake& handshake)
+	{
+		// B8G8R8A8_UNORM and B8G8R8A8_SRGB, everything else is read as RGBA
+		bool bgra = handshake.format == VK_FORMAT_B8G8R8A8_UNORM || handshake.format == VK_FORMAT_B8G8R8A8_SRGB;
+
+		std::ofstream file(path, std::ios::binary);
+		file << "P6\n" << handshake.width << ' ' << handshake.height << "\n255\n";
+
+		std::vector<uint8_t> row_rgb(handshake.width * 3);
+		for(uint32_t y = 0; y < handshake.height; y++)
+		{
+			const uint8_t* row = pixels + y * handshake.row_pitch;
+			for(uint32_t x = 0; x < handshake.width; x++)
+			{
+				row_rgb[x * 3 + 0] = row[x * 4 + (bgra ? 2 : 0)];
+				row_rgb[x * 3 + 1] = row[x * 4 + 1];
+				row_rgb[x * 3 + 2] = row[x * 4 + (bgra ? 0 : 2)];
+			}
+			file.write(reinterpret_cast<const char*>(row_rgb.data()), row_rgb.size());
+		}
+
+		std::cout << "wrote " << path << '\n';
+	}
+}
+
+int main(int argc, char** argv)
+{
+	try
+	{
+		if(argc < 2)
+			throw std::runtime_error("usage: export-consumer <socket> [--frames N] [--dump frame.ppm]");
+
+		std::string socket_path = argv[1];
+		uint64_t frame_limit = 0;
+		std::string dump_path;
+
+		for(int i = 2; i < argc; i++)
+		{
+			std::string arg = argv[i];
+			if(arg == "--frames" && i + 1 < argc)
+				frame_limit = std::stoull(argv[++i]);
+			else if(arg == "--dump" && i + 1 < argc)
+				dump_path = argv[++i];
+			else
+				throw std::runtime_error("Unknown option " + arg);
+		}
+
+		Connection connection = connect_to_engine(socket_path);
+		const frame_export::Handshake& handshake = connection.handshake;
+		const bool dma_buf = handshake.memory_kind == frame_export::MEMORY_DMA_BUF;
+
+		std::cout << "connected: " << handshake.width << "x" << handshake.height << ", format " << handshake.format << ", " << handshake.slot_count
+				  << " slots in " << (dma_buf ? "dma-buf images" : "shared host memory") << ", first frame " << handshake.first_frame << '\n';
+
+		Device device = open_device(handshake);
+		device.ready = import_timeline(device.device, connection.fds[0]);
+		device.released = import_timeline(device.device, connection.fds[1]);
+
+		// every slot mapped once, frames are read where the engine left them
+		std::vector<const uint8_t*> slots(handshake.slot_count);
+		std::vector<void*> mappings;
+		for(size_t i = 2; i < connection.fds.size(); i++)
+		{
+			void* mapping = mmap(nullptr, handshake.memory_size, PROT_READ, MAP_SHARED, connection.fds[i], 0);
+			if(mapping == MAP_FAILED)
+				throw std::runtime_error("Failed to map the exported memory");
+			mappings.push_back(mapping);
+		}
+
+		for(uint32_t slot = 0; slot < handshake.slot_count; slot++)
+		{
+			const uint8_t* base = static_cast<const uint8_t*>(mappings[dma_buf ? slot : 0]);
+			slots[slot] = base + handshake.slot_offsets[slot];
+		}
+
+		auto sync_dma_buf = [&](uint32_t slot, uint64_t flags)
+		{
+			if(!dma_buf)
+				return;
+			dma_buf_sync sync = { .flags = flags | DMA_BUF_SYNC_READ };
+			ioctl(connection.fds[2 + slot], DMA_BUF_IOCTL_SYNC, &sync);
+		};
+
+		uint64_t frame = handshake.first_frame;
+		uint64_t received = 0;
+		uint64_t last_checksum = 0;
+		auto report_time = std::chrono::steady_clock::now();
+		uint64_t report_frames = 0;
+
+		while(frame_limit == 0 || received < frame_limit)
+		{
+			VkSemaphoreWaitInfo wait_info = {
+				.sType 			= VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+				.semaphoreCount = 1,
+				.pSemaphores 	= &device.ready,
+				.pValues 		= &frame
+			};
+
+			// a second without frames: the engine may be idle, or gone
+			VkResult result = vkWaitSemaphores(device.device, &wait_info, 1000000000ull);
+			if(result == VK_TIMEOUT)
+			{
+				if(is_hung_up(connection.socket))
+					break;
+				continue;
+			}
+			CHECK(result);
+
+			uint32_t slot = static_cast<uint32_t>((frame - 1) % handshake.slot_count);
+
+			sync_dma_buf(slot, DMA_BUF_SYNC_START);
+			last_checksum = checksum(slots[slot], handshake);
+			if(received == 0 && !dump_path.empty())
+				write_ppm(dump_path, slots[slot], handshake);
+			sync_dma_buf(slot, DMA_BUF_SYNC_END);
+
+			// the engine may write the slot again
+			VkSemaphoreSignalInfo signal_info = {
+				.sType 	   = VK_STRUCTURE_TYPE_SEMAPHORE_SIGNAL_INFO,
+				.semaphore = device.released,
+				.value 	   = frame
+			};
+			CHECK(vkSignalSemaphore(device.device, &signal_info));
+
+			frame++;
+			received++;
+			report_frames++;
+
+			auto now = std::chrono::steady_clock::now();
+			double elapsed = std::chrono::duration<double>(now - report_time).count();
+			if(elapsed >= 1.0)
+			{
+				std::cout << "frame " << frame - 1 << ": " << report_frames / elapsed << " fps, checksum " << std::hex << last_checksum << std::dec << '\n';
+				report_time = now;
+				report_frames = 0;
+			}
+		}
+
+		std::cout << received << " frames received" << '\n';
+
+		for(void* mapping : mappings)
+			munmap(mapping, handshake.memory_size);
+		for(size_t i = 2; i < connection.fds.size(); i++)
+			close(connection.fds[i]);
+		close(connection.socket);
+
+		vkDestroySemaphore(device.device, device.released, nullptr);
+		vkDestroySemaphore(device.device, device.ready, nullptr);
+		vkDestroyDevice(device.device, nullptr);
+		vkDestroyInstance(device.instance, nullptr);
+	}
+	catch (std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
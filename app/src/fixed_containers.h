@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+/**
+ * Vector with its storage inline, for per-frame lists with a known bound.
+ * Never allocates; pushing past the capacity is a bug and asserts.
+ */
+template<typename T, uint32_t Capacity>
+class FixedVector
+{
+	static_assert(std::is_trivially_destructible_v<T>, "FixedVector holds plain structs, elements are never destroyed");
+
+public:
+
+	inline void push_back(const T& value)
+	{
+		assert(m_size < Capacity);
+		m_items[m_size++] = value;
+	}
+
+	inline void clear() { m_size = 0; }
+
+	inline uint32_t size() const { return m_size; }
+
+	inline bool empty() const { return m_size == 0; }
+
+	inline bool full() const { return m_size == Capacity; }
+
+	inline T* data() { return m_items; }
+
+	inline const T* data() const { return m_items; }
+
+	inline T& operator[](uint32_t index) { return m_items[index]; }
+
+	inline const T& operator[](uint32_t index) const { return m_items[index]; }
+
+	inline T* begin() { return m_items; }
+
+	inline T* end() { return m_items + m_size; }
+
+	inline const T* begin() const { return m_items; }
+
+	inline const T* end() const { return m_items + m_size; }
+
+private:
+
+	T m_items[Capacity] {};
+
+	uint32_t m_size = 0;
+};
+
+/**
+ * FIFO in a fixed ring, the allocation-free stand-in for a std::deque used
+ * as a queue. Capacity must be a power of two.
+ */
+template<typename T, uint32_t Capacity>
+class RingQueue
+{
+	static_assert((Capacity & (Capacity - 1)) == 0, "RingQueue capacity must be a power of two");
+
+public:
+
+	inline void push_back(const T& value)
+	{
+		assert(m_size < Capacity);
+		m_items[(m_head + m_size++) & MASK] = value;
+	}
+
+	inline void pop_front()
+	{
+		assert(m_size > 0);
+		m_head = (m_head + 1) & MASK;
+		m_size--;
+	}
+
+	inline T& front() { return m_items[m_head]; }
+
+	inline const T& front() const { return m_items[m_head]; }
+
+	inline uint32_t size() const { return m_size; }
+
+	inline bool empty() const { return m_size == 0; }
+
+	inline bool full() const { return m_size == Capacity; }
+
+private:
+
+	static constexpr uint32_t MASK = Capacity - 1;
+
+	T m_items[Capacity] {};
+
+	uint32_t m_head = 0;
+
+	uint32_t m_size = 0;
+};
+
+/**
+ * Non-owning reference to a callable, for callbacks invoked before the call
+ * that takes them returns. Unlike std::function it never copies the callable
+ * to the heap, so passing a lambda with captures costs nothing per call.
+ */
+template<typename Signature>
+class FunctionRef;
+
+template<typename Result, typename... Args>
+class FunctionRef<Result(Args...)>
+{
+public:
+
+	template<typename Function, typename = std::enable_if_t<!std::is_same_v<std::decay_t<Function>, FunctionRef>>>
+	FunctionRef(Function&& function)
+		: m_object(const_cast<void*>(static_cast<const void*>(&function)))
+		, m_call([](void* object, Args... args) -> Result
+		{
+			return (*static_cast<std::remove_reference_t<Function>*>(object))(std::forward<Args>(args)...);
+		})
+	{
+	}
+
+	inline Result operator()(Args... args) const { return m_call(m_object, std::forward<Args>(args)...); }
+
+private:
+
+	void* m_object;
+
+	Result (*m_call)(void* object, Args... args);
+};
@@ -0,0 +1,733 @@
+#include "pre-compiled-header.h"
+#include "frame_export.h"
+
+#include "vk_utils.h"
+
+#ifdef __linux__
+	#include <poll.h>
+	#include <sys/mman.h>
+	#include <sys/socket.h>
+	#include <sys/un.h>
+	#include <unistd.h>
+#endif
+
+namespace
+{
+	// the frame is rendered (or upscaled) into the image, then copied to the swapchain image for the window
+	constexpr VkImageUsageFlags EXPORT_IMAGE_USAGE = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+
+	VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	// linear, so any dma-buf importer can read it with the row pitch alone
+	bool can_export_dma_buf(VkPhysicalDevice gpu, VkFormat format)
+	{
+		VkFormatProperties format_properties;
+		vkGetPhysicalDeviceFormatProperties(gpu, format, &format_properties);
+
+		const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_TRANSFER_SRC_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+		if((format_properties.linearTilingFeatures & required) != required)
+			return false;
+
+		VkPhysicalDeviceExternalImageFormatInfo external_info = {
+			.sType 		= VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_IMAGE_FORMAT_INFO,
+			.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT
+		};
+
+		VkPhysicalDeviceImageFormatInfo2 image_info = {
+			.sType 	= VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_FORMAT_INFO_2,
+			.pNext 	= &external_info,
+			.format = format,
+			.type 	= VK_IMAGE_TYPE_2D,
+			.tiling = VK_IMAGE_TILING_LINEAR,
+			.usage 	= EXPORT_IMAGE_USAGE
+		};
+
+		VkExternalImageFormatProperties external_properties = {
+			.sType = VK_STRUCTURE_TYPE_EXTERNAL_IMAGE_FORMAT_PROPERTIES
+		};
+
+		VkImageFormatProperties2 properties = {
+			.sType = VK_STRUCTURE_TYPE_IMAGE_FORMAT_PROPERTIES_2,
+			.pNext = &external_properties
+		};
+
+		if(vkGetPhysicalDeviceImageFormatProperties2(gpu, &image_info, &properties) != VK_SUCCESS)
+			return false;
+
+		return external_properties.externalMemoryProperties.externalMemoryFeatures & VK_EXTERNAL_MEMORY_FEATURE_EXPORTABLE_BIT;
+	}
+}
+
+/**
+ * @brief Create the slot ring and the semaphores, and listen for a consumer
+ * @param description Device, frame size and format, slot count, socket path and the available memory kinds
+ */
+void FrameExporter::init(const FrameExporterDescription& description)
+{
+#ifndef __linux__
+	(void)description;
+	throw std::runtime_error("Frame export needs Linux (Unix sockets, dma-buf and memfd)");
+#else
+	m_description = description;
+
+	m_get_memory_fd = reinterpret_cast<PFN_vkGetMemoryFdKHR>(vkGetDeviceProcAddr(description.device, "vkGetMemoryFdKHR"));
+	m_get_semaphore_fd = reinterpret_cast<PFN_vkGetSemaphoreFdKHR>(vkGetDeviceProcAddr(description.device, "vkGetSemaphoreFdKHR"));
+	if(m_get_memory_fd == nullptr || m_get_semaphore_fd == nullptr)
+		throw std::runtime_error("Frame export requires VK_KHR_external_memory_fd and VK_KHR_external_semaphore_fd");
+
+	VkSemaphoreTypeCreateInfo timeline_type = {
+		.sType 		   = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+		.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE
+	};
+
+	VkPhysicalDeviceExternalSemaphoreInfo semaphore_info = {
+		.sType 		= VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_SEMAPHORE_INFO,
+		.pNext 		= &timeline_type,
+		.handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_FD_BIT
+	};
+
+	VkExternalSemaphoreProperties semaphore_properties = {
+		.sType = VK_STRUCTURE_TYPE_EXTERNAL_SEMAPHORE_PROPERTIES
+	};
+
+	vkGetPhysicalDeviceExternalSemaphoreProperties(description.gpu, &semaphore_info, &semaphore_properties);
+	if(!(semaphore_properties.externalSemaphoreFeatures & VK_EXTERNAL_SEMAPHORE_FEATURE_EXPORTABLE_BIT))
+		throw std::runtime_error("Frame export requires exportable timeline semaphores");
+
+	// zero-copy when the frame can be rendered into a dma-buf, a GPU copy into shared memory otherwise
+	if(description.dma_buf && can_export_dma_buf(description.gpu, description.format))
+		init_dma_buf_slots();
+	else if(description.host_memory)
+		init_host_slots();
+	else
+		throw std::runtime_error("Frame export requires linear dma-buf images or VK_EXT_external_memory_host");
+
+	m_ready = create_exported_timeline();
+	m_released = create_exported_timeline();
+
+	// --- socket ---
+
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	if(description.socket_path.size() >= sizeof(address.sun_path))
+		throw std::runtime_error("Frame export socket path is too long: " + description.socket_path);
+	std::strncpy(address.sun_path, description.socket_path.c_str(), sizeof(address.sun_path) - 1);
+
+	m_listener = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if(m_listener < 0)
+		throw std::runtime_error("Failed to create the frame export socket");
+
+	// a previous run may have left its socket behind
+	unlink(description.socket_path.c_str());
+
+	if(bind(m_listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || listen(m_listener, 1) != 0)
+		throw std::runtime_error("Failed to listen on " + description.socket_path);
+
+	m_slot_count = description.slot_count;
+
+	std::cout << "frame export: " << m_slot_count << " slots in " << (m_memory_kind == frame_export::MEMORY_DMA_BUF ? "dma-buf images" : "shared host memory")
+			  << ", listening on " << description.socket_path << '\n';
+#endif
+}
+
+void FrameExporter::init_dma_buf_slots()
+{
+	VkExternalMemoryImageCreateInfo external_info = {
+		.sType 		 = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO,
+		.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT
+	};
+
+	VkImageCreateInfo image_info = {
+		.sType 		   = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+		.pNext 		   = &external_info,
+		.imageType 	   = VK_IMAGE_TYPE_2D,
+		.format 	   = m_description.format,
+		.extent 	   = { m_description.extent.width, m_description.extent.height, 1 },
+		.mipLevels 	   = 1,
+		.arrayLayers   = 1,
+		.samples 	   = VK_SAMPLE_COUNT_1_BIT,
+		.tiling 	   = VK_IMAGE_TILING_LINEAR,
+		.usage 		   = EXPORT_IMAGE_USAGE,
+		.sharingMode   = VK_SHARING_MODE_EXCLUSIVE,
+		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+	};
+
+	for(uint32_t i = 0; i < m_description.slot_count; i++)
+	{
+		Slot& slot = m_slots[i];
+		VK_CHECK(vkCreateImage(m_description.device, &image_info, nullptr, &slot.image));
+
+		VkMemoryRequirements requirements;
+		vkGetImageMemoryRequirements(m_description.device, slot.image, &requirements);
+
+		// one dma-buf per image
+		VkMemoryDedicatedAllocateInfo dedicated_info = {
+			.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO,
+			.image = slot.image
+		};
+
+		VkExportMemoryAllocateInfo export_info = {
+			.sType 		 = VK_STRUCTURE_TYPE_EXPORT_MEMORY_ALLOCATE_INFO,
+			.pNext 		 = &dedicated_info,
+			.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT
+		};
+
+		VkMemoryAllocateInfo allocate_info = {
+			.sType 			 = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+			.pNext 			 = &export_info,
+			.allocationSize  = requirements.size,
+			.memoryTypeIndex = find_memory_type(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+		};
+
+		VK_CHECK(vkAllocateMemory(m_description.device, &allocate_info, nullptr, &slot.memory));
+		VK_CHECK(vkBindImageMemory(m_description.device, slot.image, slot.memory, 0));
+
+		VkImageSubresource subresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0 };
+		VkSubresourceLayout layout;
+		vkGetImageSubresourceLayout(m_description.device, slot.image, &subresource, &layout);
+
+		slot.offset = layout.offset;
+		m_row_pitch = layout.rowPitch;
+		m_memory_size = requirements.size;
+
+		VkImageViewCreateInfo view_info = {
+			.sType    		  = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+			.image    		  = slot.image,
+			.viewType 		  = VK_IMAGE_VIEW_TYPE_2D,
+			.format   		  = m_description.format,
+			.subresourceRange = {
+				.aspectMask 	= VK_IMAGE_ASPECT_COLOR_BIT,
+				.baseMipLevel 	= 0,
+				.levelCount 	= 1,
+				.baseArrayLayer = 0,
+				.layerCount 	= 1
+			}
+		};
+
+		VK_CHECK(vkCreateImageView(m_description.device, &view_info, nullptr, &slot.view));
+	}
+
+	m_memory_kind = frame_export::MEMORY_DMA_BUF;
+}
+
+void FrameExporter::init_host_slots()
+{
+#ifdef __linux__
+	VkPhysicalDeviceExternalMemoryHostPropertiesEXT host_properties = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_MEMORY_HOST_PROPERTIES_EXT
+	};
+
+	VkPhysicalDeviceProperties2 properties = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+		.pNext = &host_properties
+	};
+
+	vkGetPhysicalDeviceProperties2(m_description.gpu, &properties);
+
+	// tightly packed rows, every slot starts at an address the device can import
+	m_row_pitch = static_cast<VkDeviceSize>(m_description.extent.width) * 4;
+	VkDeviceSize slot_size = align_up(m_row_pitch * m_description.extent.height, host_properties.minImportedHostPointerAlignment);
+	m_memory_size = slot_size * m_description.slot_count;
+
+	m_shared_fd = memfd_create("pseudo3d-frames", MFD_CLOEXEC);
+	if(m_shared_fd < 0 || ftruncate(m_shared_fd, static_cast<off_t>(m_memory_size)) != 0)
+		throw std::runtime_error("Failed to create the frame export shared memory");
+
+	m_shared = mmap(nullptr, m_memory_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_shared_fd, 0);
+	if(m_shared == MAP_FAILED || reinterpret_cast<uintptr_t>(m_shared) % host_properties.minImportedHostPointerAlignment != 0)
+		throw std::runtime_error("Failed to map the frame export shared memory");
+
+	auto get_host_pointer_properties = reinterpret_cast<PFN_vkGetMemoryHostPointerPropertiesEXT>(
+		vkGetDeviceProcAddr(m_description.device, "vkGetMemoryHostPointerPropertiesEXT"));
+
+	VkMemoryHostPointerPropertiesEXT pointer_properties = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_HOST_POINTER_PROPERTIES_EXT
+	};
+	VK_CHECK(get_host_pointer_properties(m_description.device, VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT, m_shared, &pointer_properties));
+
+	VkExternalMemoryBufferCreateInfo external_info = {
+		.sType 		 = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO,
+		.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT
+	};
+
+	VkBufferCreateInfo buffer_info = {
+		.sType 		 = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.pNext 		 = &external_info,
+		.size 		 = m_memory_size,
+		.usage 		 = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		.sharingMode = VK_SHARING_MODE_EXCLUSIVE
+	};
+
+	VK_CHECK(vkCreateBuffer(m_description.device, &buffer_info, nullptr, &m_shared_buffer));
+
+	VkMemoryRequirements requirements;
+	vkGetBufferMemoryRequirements(m_description.device, m_shared_buffer, &requirements);
+
+	VkImportMemoryHostPointerInfoEXT import_info = {
+		.sType 		  = VK_STRUCTURE_TYPE_IMPORT_MEMORY_HOST_POINTER_INFO_EXT,
+		.handleType   = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT,
+		.pHostPointer = m_shared
+	};
+
+	// coherent, so the consumer reads the copy without the engine flushing
+	VkMemoryAllocateInfo allocate_info = {
+		.sType 			 = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+		.pNext 			 = &import_info,
+		.allocationSize  = m_memory_size,
+		.memoryTypeIndex = find_memory_type(requirements.memoryTypeBits & pointer_properties.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+	};
+
+	VK_CHECK(vkAllocateMemory(m_description.device, &allocate_info, nullptr, &m_shared_memory));
+	VK_CHECK(vkBindBufferMemory(m_description.device, m_shared_buffer, m_shared_memory, 0));
+
+	for(uint32_t i = 0; i < m_description.slot_count; i++)
+		m_slots[i].offset = slot_size * i;
+
+	m_memory_kind = frame_export::MEMORY_HOST;
+#endif
+}
+
+VkSemaphore FrameExporter::create_exported_timeline()
+{
+	VkExportSemaphoreCreateInfo export_info = {
+		.sType 		 = VK_STRUCTURE_TYPE_EXPORT_SEMAPHORE_CREATE_INFO,
+		.handleTypes = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_FD_BIT
+	};
+
+	VkSemaphoreTypeCreateInfo type_info = {
+		.sType 		   = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+		.pNext 		   = &export_info,
+		.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+		.initialValue  = 0
+	};
+
+	VkSemaphoreCreateInfo semaphore_info = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+		.pNext = &type_info
+	};
+
+	VkSemaphore semaphore;
+	VK_CHECK(vkCreateSemaphore(m_description.device, &semaphore_info, nullptr, &semaphore));
+	return semaphore;
+}
+
+// a type in type_bits with the preferred properties, or any type in type_bits
+uint32_t FrameExporter::find_memory_type(uint32_t type_bits, VkMemoryPropertyFlags preferred) const
+{
+	VkPhysicalDeviceMemoryProperties memory_properties;
+	vkGetPhysicalDeviceMemoryProperties(m_description.gpu, &memory_properties);
+
+	for(uint32_t i = 0; i < memory_properties.memoryTypeCount; i++)
+		if((type_bits & (1u << i)) && (memory_properties.memoryTypes[i].propertyFlags & preferred) == preferred)
+			return i;
+
+	for(uint32_t i = 0; i < memory_properties.memoryTypeCount; i++)
+		if(type_bits & (1u << i))
+			return i;
+
+	throw std::runtime_error("No memory type can hold exported frames");
+}
+
+/**
+ * @brief Start a frame: accept a waiting consumer, notice a gone one, and claim the next slot
+ *
+ * A frame is exported only while a consumer is connected and the slot it
+ * would overwrite was released; otherwise it is counted as dropped and only
+ * shown in the window, the engine never waits for the consumer.
+ */
+bool FrameExporter::begin_frame()
+{
+	m_exporting = false;
+	if(!is_enabled())
+		return false;
+
+#ifdef __linux__
+	if(m_consumer < 0)
+	{
+		accept_consumer();
+	}
+	else
+	{
+		// the consumer never writes, readable means it closed the connection
+		pollfd poll_fd = { .fd = m_consumer, .events = POLLIN };
+		if(poll(&poll_fd, 1, 0) > 0)
+			drop_consumer();
+	}
+
+	if(m_consumer < 0)
+		return false;
+
+	// the slot of the next frame last held the frame slot_count before it
+	uint64_t released;
+	VK_CHECK(vkGetSemaphoreCounterValue(m_description.device, m_released, &released));
+	if(m_frame + 1 > m_slot_count && released < m_frame + 1 - m_slot_count)
+	{
+		m_dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	m_frame++;
+	m_exporting = true;
+	m_exported.fetch_add(1, std::memory_order_relaxed);
+	return true;
+#else
+	return false;
+#endif
+}
+
+VkImage FrameExporter::get_image() const
+{
+	if(!m_exporting || m_memory_kind != frame_export::MEMORY_DMA_BUF)
+		return VK_NULL_HANDLE;
+	return m_slots[(m_frame - 1) % m_slot_count].image;
+}
+
+VkImageView FrameExporter::get_view() const
+{
+	if(!m_exporting || m_memory_kind != frame_export::MEMORY_DMA_BUF)
+		return VK_NULL_HANDLE;
+	return m_slots[(m_frame - 1) % m_slot_count].view;
+}
+
+/**
+ * @brief Record the copy between the slot and the swapchain image, and hand the slot over
+ * @param cmd The frame's command buffer, outside a render pass
+ * @param swapchain_image The image presented this frame
+ */
+void FrameExporter::record_export(VkCommandBuffer cmd, VkImage swapchain_image)
+{
+	const Slot& slot = m_slots[(m_frame - 1) % m_slot_count];
+
+	VkImageSubresourceLayers subresource = {
+		.aspectMask 	= VK_IMAGE_ASPECT_COLOR_BIT,
+		.mipLevel 		= 0,
+		.baseArrayLayer = 0,
+		.layerCount 	= 1
+	};
+
+	if(m_memory_kind == frame_export::MEMORY_DMA_BUF)
+	{
+		vkutil::transition_image_layout(
+			cmd,
+			slot.image,
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+			VK_ACCESS_2_TRANSFER_READ_BIT,
+			VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+			VK_PIPELINE_STAGE_2_COPY_BIT
+		);
+
+		// chained to the acquire semaphore, which is waited for at the color attachment stage
+		vkutil::transition_image_layout(
+			cmd,
+			swapchain_image,
+			VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			0,
+			VK_ACCESS_2_TRANSFER_WRITE_BIT,
+			VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+			VK_PIPELINE_STAGE_2_COPY_BIT
+		);
+
+		// the window shows a copy, the consumer gets the rendered image itself
+		VkImageCopy region = {
+			.srcSubresource = subresource,
+			.srcOffset 		= { 0, 0, 0 },
+			.dstSubresource = subresource,
+			.dstOffset 		= { 0, 0, 0 },
+			.extent 		= { m_description.extent.width, m_description.extent.height, 1 }
+		};
+
+		vkCmdCopyImage(cmd, slot.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, swapchain_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+		vkutil::transition_image_layout(
+			cmd,
+			swapchain_image,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			VK_ACCESS_2_TRANSFER_WRITE_BIT,
+			VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+			VK_PIPELINE_STAGE_2_COPY_BIT,
+			VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT
+		);
+
+		// release to the consumer, which finds the image in the GENERAL layout once "ready" signals
+		VkImageMemoryBarrier2 release = {
+			.sType 				 = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+			.srcStageMask 		 = VK_PIPELINE_STAGE_2_COPY_BIT,
+			.srcAccessMask 		 = 0,
+			.dstStageMask 		 = VK_PIPELINE_STAGE_2_NONE,
+			.dstAccessMask 		 = 0,
+			.oldLayout 			 = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			.newLayout 			 = VK_IMAGE_LAYOUT_GENERAL,
+			.srcQueueFamilyIndex = m_description.queue_family,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_EXTERNAL,
+			.image 				 = slot.image,
+			.subresourceRange 	 = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
+		};
+
+		VkDependencyInfo dependency_info = {
+			.sType 					 = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+			.imageMemoryBarrierCount = 1,
+			.pImageMemoryBarriers 	 = &release
+		};
+
+		vkCmdPipelineBarrier2(cmd, &dependency_info);
+	}
+	else
+	{
+		vkutil::transition_image_layout(
+			cmd,
+			swapchain_image,
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+			VK_ACCESS_2_TRANSFER_READ_BIT,
+			VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+			VK_PIPELINE_STAGE_2_COPY_BIT
+		);
+
+		VkBufferImageCopy region = {
+			.bufferOffset 	   = slot.offset,
+			.bufferRowLength   = 0,
+			.bufferImageHeight = 0,
+			.imageSubresource  = subresource,
+			.imageOffset 	   = { 0, 0, 0 },
+			.imageExtent 	   = { m_description.extent.width, m_description.extent.height, 1 }
+		};
+
+		vkCmdCopyImageToBuffer(cmd, swapchain_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_shared_buffer, 1, &region);
+
+		// the consumer reads on the host once "ready" signals
+		VkMemoryBarrier2 host_barrier = {
+			.sType 		   = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+			.srcStageMask  = VK_PIPELINE_STAGE_2_COPY_BIT,
+			.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+			.dstStageMask  = VK_PIPELINE_STAGE_2_HOST_BIT,
+			.dstAccessMask = VK_ACCESS_2_HOST_READ_BIT
+		};
+
+		VkDependencyInfo dependency_info = {
+			.sType 				= VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+			.memoryBarrierCount = 1,
+			.pMemoryBarriers 	= &host_barrier
+		};
+
+		vkCmdPipelineBarrier2(cmd, &dependency_info);
+
+		vkutil::transition_image_layout(
+			cmd,
+			swapchain_image,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			0,
+			VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+			VK_PIPELINE_STAGE_2_COPY_BIT,
+			VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT
+		);
+	}
+}
+
+VkSemaphoreSubmitInfo FrameExporter::get_ready_signal() const
+{
+	return {
+		.sType 	   = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+		.semaphore = m_ready,
+		.value 	   = m_frame,
+		.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT
+	};
+}
+
+FrameExportStats FrameExporter::get_stats() const
+{
+	return {
+		.connected 	 = m_connected.load(std::memory_order_relaxed),
+		.memory_kind = m_memory_kind,
+		.exported 	 = m_exported.load(std::memory_order_relaxed),
+		.dropped 	 = m_dropped.load(std::memory_order_relaxed)
+	};
+}
+
+void FrameExporter::accept_consumer()
+{
+#ifdef __linux__
+	// non-blocking: fails right away while nobody is waiting
+	int consumer = accept4(m_listener, nullptr, nullptr, SOCK_CLOEXEC);
+	if(consumer < 0)
+		return;
+
+	try
+	{
+		send_handshake(consumer);
+	}
+	catch(const std::exception& e)
+	{
+		std::cout << "frame export: " << e.what() << '\n';
+		close(consumer);
+		return;
+	}
+
+	m_consumer = consumer;
+	m_connected.store(true, std::memory_order_relaxed);
+	std::cout << "frame export: consumer connected, first frame " << m_frame + 1 << '\n';
+#endif
+}
+
+void FrameExporter::send_handshake(int consumer)
+{
+#ifdef __linux__
+	// a consumer that connects late starts at the next frame, the frames before count as released
+	uint64_t released;
+	VK_CHECK(vkGetSemaphoreCounterValue(m_description.device, m_released, &released));
+	if(released < m_frame)
+	{
+		VkSemaphoreSignalInfo signal_info = {
+			.sType 	   = VK_STRUCTURE_TYPE_SEMAPHORE_SIGNAL_INFO,
+			.semaphore = m_released,
+			.value 	   = m_frame
+		};
+		VK_CHECK(vkSignalSemaphore(m_description.device, &signal_info));
+	}
+
+	frame_export::Handshake handshake = {
+		.memory_kind = m_memory_kind,
+		.slot_count  = m_description.slot_count,
+		.width 		 = m_description.extent.width,
+		.height 	 = m_description.extent.height,
+		.format 	 = static_cast<uint32_t>(m_description.format),
+		.row_pitch 	 = m_row_pitch,
+		.memory_size = m_memory_size,
+		.first_frame = m_frame + 1
+	};
+
+	for(uint32_t i = 0; i < m_description.slot_count; i++)
+		handshake.slot_offsets[i] = m_slots[i].offset;
+
+	VkPhysicalDeviceIDProperties id_properties = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES
+	};
+
+	VkPhysicalDeviceProperties2 properties = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+		.pNext = &id_properties
+	};
+
+	vkGetPhysicalDeviceProperties2(m_description.gpu, &properties);
+	std::memcpy(handshake.device_uuid, id_properties.deviceUUID, VK_UUID_SIZE);
+	std::memcpy(handshake.driver_uuid, id_properties.driverUUID, VK_UUID_SIZE);
+
+	// every fd is a new reference, the consumer receives its own and these are closed once sent
+	std::vector<int> fds;
+	for(VkSemaphore semaphore : { m_ready, m_released })
+	{
+		VkSemaphoreGetFdInfoKHR fd_info = {
+			.sType 		= VK_STRUCTURE_TYPE_SEMAPHORE_GET_FD_INFO_KHR,
+			.semaphore 	= semaphore,
+			.handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_FD_BIT
+		};
+
+		int fd;
+		VK_CHECK(m_get_semaphore_fd(m_description.device, &fd_info, &fd));
+		fds.push_back(fd);
+	}
+
+	if(m_memory_kind == frame_export::MEMORY_DMA_BUF)
+	{
+		for(uint32_t i = 0; i < m_description.slot_count; i++)
+		{
+			VkMemoryGetFdInfoKHR fd_info = {
+				.sType 		= VK_STRUCTURE_TYPE_MEMORY_GET_FD_INFO_KHR,
+				.memory 	= m_slots[i].memory,
+				.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_DMA_BUF_BIT_EXT
+			};
+
+			int fd;
+			VK_CHECK(m_get_memory_fd(m_description.device, &fd_info, &fd));
+			fds.push_back(fd);
+		}
+	}
+	else
+	{
+		fds.push_back(dup(m_shared_fd));
+	}
+
+	iovec payload = {
+		.iov_base = &handshake,
+		.iov_len  = sizeof(handshake)
+	};
+
+	union
+	{
+		char buffer[CMSG_SPACE(sizeof(int) * (2 + frame_export::MAX_SLOTS))];
+		cmsghdr align;
+	} control = {};
+
+	msghdr message = {};
+	message.msg_iov 	   = &payload;
+	message.msg_iovlen 	   = 1;
+	message.msg_control    = control.buffer;
+	message.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+
+	cmsghdr* header = CMSG_FIRSTHDR(&message);
+	header->cmsg_level = SOL_SOCKET;
+	header->cmsg_type  = SCM_RIGHTS;
+	header->cmsg_len   = CMSG_LEN(sizeof(int) * fds.size());
+	std::memcpy(CMSG_DATA(header), fds.data(), sizeof(int) * fds.size());
+
+	ssize_t sent = sendmsg(consumer, &message, MSG_NOSIGNAL);
+	for(int fd : fds)
+		close(fd);
+
+	if(sent != static_cast<ssize_t>(sizeof(handshake)))
+		throw std::runtime_error("failed to send the handshake");
+#else
+	(void)consumer;
+#endif
+}
+
+void FrameExporter::drop_consumer()
+{
+#ifdef __linux__
+	close(m_consumer);
+	m_consumer = -1;
+	m_connected.store(false, std::memory_order_relaxed);
+	std::cout << "frame export: consumer disconnected" << '\n';
+#endif
+}
+
+void FrameExporter::destroy()
+{
+#ifdef __linux__
+	if(m_consumer >= 0)
+		close(m_consumer);
+	if(m_listener >= 0)
+	{
+		close(m_listener);
+		unlink(m_description.socket_path.c_str());
+	}
+#endif
+
+	vkDestroySemaphore(m_description.device, m_released, nullptr);
+	vkDestroySemaphore(m_description.device, m_ready, nullptr);
+
+	for(uint32_t i = 0; i < m_slot_count; i++)
+	{
+		vkDestroyImageView(m_description.device, m_slots[i].view, nullptr);
+		vkDestroyImage(m_description.device, m_slots[i].image, nullptr);
+		vkFreeMemory(m_description.device, m_slots[i].memory, nullptr);
+	}
+
+	vkDestroyBuffer(m_description.device, m_shared_buffer, nullptr);
+	vkFreeMemory(m_description.device, m_shared_memory, nullptr);
+
+#ifdef __linux__
+	if(m_shared != nullptr && m_shared != MAP_FAILED)
+		munmap(m_shared, m_memory_size);
+	if(m_shared_fd >= 0)
+		close(m_shared_fd);
+#endif
+}
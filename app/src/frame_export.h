@@ -0,0 +1,176 @@
+#pragma once
+
+#include "vk_defines.h"
+#include "frame_export_protocol.h"
+
+#include <array>
+#include <atomic>
+#include <string>
+
+struct FrameExporterDescription
+{
+	VkPhysicalDevice gpu = VK_NULL_HANDLE;
+
+	VkDevice device = VK_NULL_HANDLE;
+
+	// the family that renders and releases the images to the consumer
+	uint32_t queue_family = 0;
+
+	// size and format of the swapchain images, exported frames match the window
+	VkExtent2D extent {};
+
+	VkFormat format = VK_FORMAT_UNDEFINED;
+
+	uint32_t slot_count = 3;
+
+	// Unix domain socket consumers connect to
+	std::string socket_path;
+
+	// VK_EXT_external_memory_dma_buf is enabled
+	bool dma_buf = false;
+
+	// VK_EXT_external_memory_host is enabled
+	bool host_memory = false;
+};
+
+// Exported and dropped frames, readable from any thread
+struct FrameExportStats
+{
+	bool connected = false;
+
+	frame_export::MemoryKind memory_kind = frame_export::MEMORY_DMA_BUF;
+
+	uint64_t exported = 0;
+
+	// frames rendered while every slot was still held by the consumer
+	uint64_t dropped = 0;
+};
+
+/**
+ * Hands rendered frames to another process without copying them on the
+ * CPU. A ring of slots lives in exportable memory: linear dma-buf images
+ * the frame is rendered into, or, when the device cannot export those,
+ * shared host memory the GPU copies the frame into. Two exported timeline
+ * semaphores order the ring: the engine signals "ready" with the frame
+ * number, the consumer signals "released" when it is done with a frame,
+ * and a slot is only written again once its previous frame was released.
+ * A frame that finds no free slot is not exported, the window still shows
+ * it. Only runs on Linux (Unix sockets, dma-buf and memfd).
+ */
+class FrameExporter
+{
+public:
+
+	void init(const FrameExporterDescription& description);
+
+	inline bool is_enabled() const { return m_slot_count > 0; }
+
+	// --- render thread ---
+
+	// accepts or drops the consumer, true when this frame takes a slot
+	bool begin_frame();
+
+	// the image to render the frame into instead of the swapchain image, VK_NULL_HANDLE with host memory
+	VkImage get_image() const;
+
+	VkImageView get_view() const;
+
+	/**
+	 * After the UI pass, with the rendered image in COLOR_ATTACHMENT_OPTIMAL.
+	 * dma-buf: copies the slot's image into the swapchain image (UNDEFINED
+	 * before) for the window, then releases the slot to the consumer. Host
+	 * memory: copies the swapchain image into the slot. The swapchain image
+	 * is left in COLOR_ATTACHMENT_OPTIMAL either way.
+	 */
+	void record_export(VkCommandBuffer cmd, VkImage swapchain_image);
+
+	// signal operation for the frame's submit, marks the slot ready
+	VkSemaphoreSubmitInfo get_ready_signal() const;
+
+	// --- any thread ---
+
+	FrameExportStats get_stats() const;
+
+	void destroy();
+
+private:
+
+	struct Slot
+	{
+		// dma-buf
+		VkImage image = VK_NULL_HANDLE;
+
+		VkImageView view = VK_NULL_HANDLE;
+
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+
+		// where the pixels start, in the dma-buf or the shared memory file
+		VkDeviceSize offset = 0;
+	};
+
+	void init_dma_buf_slots();
+
+	void init_host_slots();
+
+	VkSemaphore create_exported_timeline();
+
+	uint32_t find_memory_type(uint32_t type_bits, VkMemoryPropertyFlags preferred) const;
+
+	void accept_consumer();
+
+	void send_handshake(int consumer);
+
+	void drop_consumer();
+
+	FrameExporterDescription m_description;
+
+	uint32_t m_slot_count = 0;
+
+	frame_export::MemoryKind m_memory_kind = frame_export::MEMORY_DMA_BUF;
+
+	std::array<Slot, frame_export::MAX_SLOTS> m_slots {};
+
+	VkDeviceSize m_row_pitch = 0;
+
+	// bytes of one dma-buf, or of the shared memory file
+	VkDeviceSize m_memory_size = 0;
+
+	// --- host memory ---
+
+	int m_shared_fd = -1;
+
+	void* m_shared = nullptr;
+
+	VkBuffer m_shared_buffer = VK_NULL_HANDLE;
+
+	VkDeviceMemory m_shared_memory = VK_NULL_HANDLE;
+
+	// --- sync ---
+
+	VkSemaphore m_ready = VK_NULL_HANDLE;
+
+	VkSemaphore m_released = VK_NULL_HANDLE;
+
+	PFN_vkGetMemoryFdKHR m_get_memory_fd = nullptr;
+
+	PFN_vkGetSemaphoreFdKHR m_get_semaphore_fd = nullptr;
+
+	// --- render thread ---
+
+	int m_listener = -1;
+
+	int m_consumer = -1;
+
+	// number of the last exported frame, 0 before the first
+	uint64_t m_frame = 0;
+
+	bool m_exporting = false;
+
+	// --- shared ---
+
+	std::atomic<bool> m_connected {false};
+
+	std::atomic<uint64_t> m_exported {0};
+
+	std::atomic<uint64_t> m_dropped {0};
+};
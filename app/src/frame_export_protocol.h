@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Handshake between the engine and a frame export consumer. The engine
+ * listens on a Unix domain socket; a consumer connects and receives one
+ * Handshake with file descriptors attached (SCM_RIGHTS), in this order:
+ *
+ *   - the ready timeline semaphore (opaque fd): the engine signals frame n
+ *     once slot (n - 1) % slot_count holds it
+ *   - the released timeline semaphore (opaque fd): the consumer signals
+ *     frame n once it is done reading it; the engine does not write a slot
+ *     until the frame it held is released
+ *   - MEMORY_DMA_BUF: one dma-buf per slot, the linear image itself
+ *   - MEMORY_HOST: one shared memory file holding every slot
+ *
+ * Frames are numbered from 1 and are consecutive; first_frame is the first
+ * one the consumer will receive. Only this header is shared, the consumer
+ * needs no engine code.
+ */
+namespace frame_export
+{
+
+	// "PFX1"
+	constexpr uint32_t MAGIC = 0x31584650;
+
+	constexpr uint32_t MAX_SLOTS = 8;
+
+	enum MemoryKind : uint32_t
+	{
+		// the engine renders into exported images, nothing is copied
+		MEMORY_DMA_BUF = 0,
+
+		// the GPU copies each frame into shared host memory
+		MEMORY_HOST = 1
+	};
+
+	struct Handshake
+	{
+		uint32_t magic = MAGIC;
+
+		MemoryKind memory_kind = MEMORY_DMA_BUF;
+
+		uint32_t slot_count = 0;
+
+		uint32_t width = 0;
+
+		uint32_t height = 0;
+
+		// VkFormat of the pixels, 4 bytes each
+		uint32_t format = 0;
+
+		// bytes between the starts of two rows
+		uint64_t row_pitch = 0;
+
+		// bytes of one dma-buf, or of the shared memory file
+		uint64_t memory_size = 0;
+
+		// where the first row of each slot starts in its dma-buf, or in the shared memory file
+		uint64_t slot_offsets[MAX_SLOTS] = {};
+
+		uint64_t first_frame = 1;
+
+		// the semaphores only import on the same device and driver (VkPhysicalDeviceIDProperties)
+		uint8_t device_uuid[16] = {};
+
+		uint8_t driver_uuid[16] = {};
+	};
+
+};
@@ -0,0 +1,90 @@
+#include "pre-compiled-header.h"
+#include "frame_packet.h"
+
+namespace
+{
+	constexpr uint64_t FNV_OFFSET = 0xcbf29ce484222325ull;
+	constexpr uint64_t FNV_PRIME = 0x100000001b3ull;
+
+	// FNV-1a over 64-bit words, good enough to detect a changed frame
+	uint64_t hash_bytes(uint64_t hash, const void* data, size_t size)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+		size_t i = 0;
+		for(; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+		{
+			uint64_t word;
+			memcpy(&word, bytes + i, sizeof(uint64_t));
+			hash = (hash ^ word) * FNV_PRIME;
+		}
+		for(; i < size; i++)
+			hash = (hash ^ bytes[i]) * FNV_PRIME;
+
+		return hash;
+	}
+
+	uint64_t hash_draw_data(const ImDrawData* draw_data)
+	{
+		uint64_t hash = FNV_OFFSET;
+		hash = hash_bytes(hash, &draw_data->DisplayPos, sizeof(ImVec2));
+		hash = hash_bytes(hash, &draw_data->DisplaySize, sizeof(ImVec2));
+		hash = hash_bytes(hash, &draw_data->FramebufferScale, sizeof(ImVec2));
+		hash = hash_bytes(hash, &draw_data->CmdListsCount, sizeof(int));
+
+		for(int i = 0; i < draw_data->CmdListsCount; i++)
+		{
+			const ImDrawList* list = draw_data->CmdLists[i];
+			hash = hash_bytes(hash, list->CmdBuffer.Data, list->CmdBuffer.size_in_bytes());
+			hash = hash_bytes(hash, list->IdxBuffer.Data, list->IdxBuffer.size_in_bytes());
+			hash = hash_bytes(hash, list->VtxBuffer.Data, list->VtxBuffer.size_in_bytes());
+		}
+
+		return hash;
+	}
+}
+
+/**
+ * @brief Copy the draw data ImGui::Render() produced, must run on the UI thread
+ *
+ * The copy is skipped when the content hash matches what this snapshot
+ * already holds, which is the common case for a static UI.
+ * @param draw_data The result of ImGui::GetDrawData()
+ */
+void UiSnapshot::capture(const ImDrawData* draw_data)
+{
+	uint64_t hash = hash_draw_data(draw_data);
+	if(hash == m_hash && m_draw_data.Valid == draw_data->Valid)
+		return;
+	m_hash = hash;
+
+	m_draw_data.Valid 			 = draw_data->Valid;
+	m_draw_data.CmdListsCount 	 = draw_data->CmdListsCount;
+	m_draw_data.TotalIdxCount 	 = draw_data->TotalIdxCount;
+	m_draw_data.TotalVtxCount 	 = draw_data->TotalVtxCount;
+	m_draw_data.DisplayPos 		 = draw_data->DisplayPos;
+	m_draw_data.DisplaySize 	 = draw_data->DisplaySize;
+	m_draw_data.FramebufferScale = draw_data->FramebufferScale;
+	m_draw_data.OwnerViewport 	 = draw_data->OwnerViewport;
+
+	while(m_draw_lists.size() < static_cast<size_t>(draw_data->CmdListsCount))
+		m_draw_lists.push_back(std::make_unique<ImDrawList>(ImGui::GetDrawListSharedData()));
+
+	// resize() keeps the capacity of the vectors, unlike ImVector's assignment
+	m_draw_data.CmdLists.resize(draw_data->CmdListsCount);
+	for(int i = 0; i < draw_data->CmdListsCount; i++)
+	{
+		const ImDrawList* source = draw_data->CmdLists[i];
+		ImDrawList* copy = m_draw_lists[i].get();
+
+		copy->CmdBuffer.resize(source->CmdBuffer.Size);
+		copy->IdxBuffer.resize(source->IdxBuffer.Size);
+		copy->VtxBuffer.resize(source->VtxBuffer.Size);
+		memcpy(copy->CmdBuffer.Data, source->CmdBuffer.Data, source->CmdBuffer.size_in_bytes());
+		memcpy(copy->IdxBuffer.Data, source->IdxBuffer.Data, source->IdxBuffer.size_in_bytes());
+		memcpy(copy->VtxBuffer.Data, source->VtxBuffer.Data, source->VtxBuffer.size_in_bytes());
+		copy->Flags = source->Flags;
+
+		m_draw_data.CmdLists[i] = copy;
+	}
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "vk_draw.h"
+#include "vk_mesh.h"
+#include "occlusion.h"
+
+#include <imgui.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Deep copy of ImGui draw data; the draw lists are reused between frames
+// so a snapshot stops allocating once the UI reached its largest size.
+// The content hash lets consumers skip work when the UI did not change.
+class UiSnapshot
+{
+public:
+
+	void capture(const ImDrawData* draw_data);
+
+	inline ImDrawData* get() { return &m_draw_data; }
+
+	inline uint64_t get_hash() const { return m_hash; }
+
+private:
+
+	ImDrawData m_draw_data;
+
+	uint64_t m_hash = 0;
+
+	std::vector<std::unique_ptr<ImDrawList>> m_draw_lists;
+};
+
+// Everything the render thread needs for one frame, immutable once published
+struct FramePacket
+{
+	uint64_t frame = 0;
+
+	// when the main thread polled the input this frame shows, latency is measured from here
+	std::chrono::steady_clock::time_point input_time;
+
+	// when the packet was handed to the render thread, for frame pacing
+	std::chrono::steady_clock::time_point publish_time;
+
+	std::vector<DrawCommand> draws;
+
+	// with occlusion culling, the visible objects are drawn from these instead of draws
+	std::vector<GPUOcclusionObject> occlusion_objects;
+
+	glm::mat4 view_projection {1.0f};
+
+	// snapshot of the UI-driven values, written to the frame's uniform buffer so recorded draws stay valid
+	GPUMeshConstant constants {};
+
+	UiSnapshot ui;
+};
+
+/**
+ * Lock-free triple buffer: the producer always has a slot to write, the
+ * consumer always reads the latest published slot, neither waits for the other.
+ */
+template<typename T>
+class TripleBuffer
+{
+public:
+
+	// producer side
+	inline T& get_write() { return m_slots[m_back]; }
+
+	void publish()
+	{
+		m_back = m_middle.exchange(m_back | DIRTY, std::memory_order_acq_rel) & INDEX;
+		m_published.fetch_add(1, std::memory_order_release);
+		m_published.notify_one();
+	}
+
+	// true while the last published slot was not picked up by the consumer
+	inline bool is_pending() const { return m_middle.load(std::memory_order_acquire) & DIRTY; }
+
+	// consumer side, true when a newer slot was swapped in
+	bool acquire()
+	{
+		if(!is_pending())
+			return false;
+
+		m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & INDEX;
+		return true;
+	}
+
+	inline T& get_read() { return m_slots[m_front]; }
+
+	static constexpr uint32_t SLOT_COUNT = 3;
+
+	// any slot, only while neither side runs (setup)
+	inline T& get_slot(uint32_t index) { return m_slots[index]; }
+
+	inline uint32_t get_published() const { return m_published.load(std::memory_order_acquire); }
+
+	// block the consumer until something is published after `seen`, or wake() is called
+	inline void wait(uint32_t seen) const { m_published.wait(seen, std::memory_order_acquire); }
+
+	inline void wake()
+	{
+		m_published.fetch_add(1, std::memory_order_release);
+		m_published.notify_all();
+	}
+
+private:
+
+	static constexpr uint8_t INDEX = 0x3;
+
+	static constexpr uint8_t DIRTY = 0x4;
+
+	T m_slots[SLOT_COUNT];
+
+	uint8_t m_back = 0;
+
+	uint8_t m_front = 1;
+
+	std::atomic<uint8_t> m_middle {2};
+
+	std::atomic<uint32_t> m_published {0};
+};
@@ -0,0 +1,187 @@
+#include "pre-compiled-header.h"
+#include "governor.h"
+
+namespace
+{
+	// optional work at each shed level, in the order it is given up
+	struct ShedLevel
+	{
+		float lod_bias;
+
+		float particle_fraction;
+	};
+
+	constexpr ShedLevel SHED_LEVELS[] = {
+		{ 1.0f, 1.0f },
+		{ 2.0f, 0.5f },
+		{ 4.0f, 0.25f },
+		{ 8.0f, 0.125f }
+	};
+
+	constexpr uint32_t SHED_LEVEL_COUNT = sizeof(SHED_LEVELS) / sizeof(SHED_LEVELS[0]);
+}
+
+/**
+ * @brief Create the timestamp queries, the governor starts at the largest scale
+ * @param description Device, timestamp properties and the budget
+ */
+void FrameGovernor::init(const FrameGovernorDescription& description)
+{
+	m_description = description;
+
+	if(description.timestamp_valid_bits == 0)
+		throw std::runtime_error("The frame budget needs timestamps on the graphics queue");
+
+	VkQueryPoolCreateInfo query_pool_info = {
+		.sType 		= VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+		.queryType 	= VK_QUERY_TYPE_TIMESTAMP,
+		.queryCount = description.slot_count * 2
+	};
+	VK_CHECK(vkCreateQueryPool(description.device, &query_pool_info, nullptr, &m_query_pool));
+
+	m_written.assign(description.slot_count, false);
+
+	m_scale = description.max_scale;
+	m_published_scale.store(m_scale, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Read the GPU time of the frame that last used a slot and adjust
+ * @param slot The frame slot, its fence was waited for
+ */
+void FrameGovernor::begin_frame(uint32_t slot)
+{
+	if(!m_written[slot])
+		return;
+
+	uint64_t ticks[2];
+	if(vkGetQueryPoolResults(m_description.device, m_query_pool, slot * 2, 2, sizeof(ticks), ticks, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+		return;
+
+	// the counter wraps after its valid bits
+	uint64_t mask = m_description.timestamp_valid_bits >= 64 ? ~0ull : (1ull << m_description.timestamp_valid_bits) - 1;
+	float gpu_ms = static_cast<float>(((ticks[1] - ticks[0]) & mask) * static_cast<double>(m_description.timestamp_period) * 1e-6);
+
+	m_average_ms = m_measured++ == 0 ? gpu_ms : m_average_ms + (gpu_ms - m_average_ms) * AVERAGE_WEIGHT;
+	m_last_ms.store(gpu_ms, std::memory_order_relaxed);
+	m_published_average_ms.store(m_average_ms, std::memory_order_relaxed);
+
+	adjust();
+}
+
+void FrameGovernor::adjust()
+{
+	const float target = m_description.target_ms;
+	const float min_scale = m_description.min_scale;
+	const float max_scale = m_description.max_scale;
+
+	m_frames_since_adjust++;
+
+	if(m_average_ms > target)
+	{
+		m_headroom_frames = 0;
+
+		// shed only once the scale cannot drop any further, and the overload lasts
+		if(m_scale <= min_scale)
+		{
+			if(++m_over_budget_frames >= SHED_FRAMES && m_shed_level + 1 < SHED_LEVEL_COUNT)
+			{
+				set_shed_level(m_shed_level + 1);
+				m_over_budget_frames = 0;
+			}
+			return;
+		}
+
+		if(m_frames_since_adjust < ADJUST_INTERVAL)
+			return;
+
+		// the cost of the scene pass follows the pixel count, the square of the scale
+		float scale = m_scale * std::sqrt(target / m_average_ms);
+		scale = std::floor(scale / SCALE_STEP) * SCALE_STEP;
+		m_scale = std::clamp(std::min(scale, m_scale - SCALE_STEP), min_scale, max_scale);
+		m_frames_since_adjust = 0;
+	}
+	else if(m_average_ms < target * HEADROOM)
+	{
+		m_over_budget_frames = 0;
+
+		// shed work comes back before resolution does
+		if(m_shed_level > 0)
+		{
+			if(++m_headroom_frames >= RESTORE_FRAMES)
+			{
+				set_shed_level(m_shed_level - 1);
+				m_headroom_frames = 0;
+			}
+			return;
+		}
+
+		if(m_scale >= max_scale || m_frames_since_adjust < ADJUST_INTERVAL)
+			return;
+
+		m_scale = std::min(m_scale + SCALE_STEP, max_scale);
+		m_frames_since_adjust = 0;
+	}
+	else
+	{
+		// within the band: hold
+		m_over_budget_frames = 0;
+		m_headroom_frames = 0;
+	}
+
+	m_published_scale.store(m_scale, std::memory_order_relaxed);
+}
+
+void FrameGovernor::set_shed_level(uint32_t level)
+{
+	m_shed_level = level;
+	m_published_shed_level.store(level, std::memory_order_relaxed);
+	m_lod_bias.store(SHED_LEVELS[level].lod_bias, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Reset the slot's queries and write its first timestamp
+ *
+ * Written where the scene passes wait for the acquired image, so a frame
+ * held back by the display does not count as GPU time.
+ * @param cmd The frame's command buffer
+ * @param slot The frame slot
+ */
+void FrameGovernor::record_begin(VkCommandBuffer cmd, uint32_t slot)
+{
+	vkCmdResetQueryPool(cmd, m_query_pool, slot * 2, 2);
+	vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, m_query_pool, slot * 2);
+}
+
+/**
+ * @brief Write the last timestamp of the slot
+ * @param cmd The frame's command buffer
+ * @param slot The frame slot
+ */
+void FrameGovernor::record_end(VkCommandBuffer cmd, uint32_t slot)
+{
+	vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, m_query_pool, slot * 2 + 1);
+	m_written[slot] = true;
+}
+
+float FrameGovernor::get_particle_fraction() const
+{
+	return SHED_LEVELS[m_shed_level].particle_fraction;
+}
+
+FrameGovernorStats FrameGovernor::get_stats() const
+{
+	return {
+		.gpu_ms 	= m_last_ms.load(std::memory_order_relaxed),
+		.average_ms = m_published_average_ms.load(std::memory_order_relaxed),
+		.scale 		= m_published_scale.load(std::memory_order_relaxed),
+		.shed_level = m_published_shed_level.load(std::memory_order_relaxed)
+	};
+}
+
+void FrameGovernor::destroy()
+{
+	if(m_query_pool != VK_NULL_HANDLE)
+		vkDestroyQueryPool(m_description.device, m_query_pool, nullptr);
+	m_query_pool = VK_NULL_HANDLE;
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "vk_defines.h"
+
+#include <atomic>
+#include <vector>
+
+struct FrameGovernorDescription
+{
+	VkDevice device = VK_NULL_HANDLE;
+
+	// nanoseconds per timestamp tick
+	float timestamp_period = 0.0f;
+
+	// timestampValidBits of the graphics queue family
+	uint32_t timestamp_valid_bits = 0;
+
+	// frames in flight, two timestamp queries each
+	uint32_t slot_count = 0;
+
+	// GPU time per frame to hold, in milliseconds
+	float target_ms = 0.0f;
+
+	// bounds of the render scale, relative to the window
+	float min_scale = 0.5f;
+
+	float max_scale = 1.0f;
+};
+
+// What the governor measured and decided, readable from any thread
+struct FrameGovernorStats
+{
+	float gpu_ms = 0.0f;
+
+	// exponential moving average the decisions are made on
+	float average_ms = 0.0f;
+
+	float scale = 1.0f;
+
+	// 0 while nothing is shed
+	uint32_t shed_level = 0;
+};
+
+/**
+ * Holds the GPU time of a frame near a budget. Two timestamps per frame
+ * slot bracket the frame's rendering; once the slot's fence is waited for,
+ * their distance feeds a moving average. Over budget, the render scale
+ * drops (the scene pass renders into part of its attachments and is
+ * upscaled into the window); under budget with headroom, it climbs back in
+ * small steps. Sustained overload at the smallest scale sheds optional
+ * work level by level, coarser levels of detail and fewer particles, which
+ * comes back first once there is headroom again.
+ */
+class FrameGovernor
+{
+public:
+
+	void init(const FrameGovernorDescription& description);
+
+	inline bool is_enabled() const { return m_query_pool != VK_NULL_HANDLE; }
+
+	// --- render thread ---
+
+	// the fence of slot was waited for: measures the frame that used it and adjusts the scale and the shed level
+	void begin_frame(uint32_t slot);
+
+	// outside a render pass, after the swapchain image was acquired
+	void record_begin(VkCommandBuffer cmd, uint32_t slot);
+
+	// last commands of the frame, outside a render pass
+	void record_end(VkCommandBuffer cmd, uint32_t slot);
+
+	// render scale of the frame being recorded
+	inline float get_scale() const { return m_scale; }
+
+	// fraction of the particle capacity emitted
+	float get_particle_fraction() const;
+
+	// --- any thread ---
+
+	// multiplies the screen space error threshold of the LOD selection
+	inline float get_lod_bias() const { return m_lod_bias.load(std::memory_order_relaxed); }
+
+	// render scale the LOD selection should assume
+	inline float get_published_scale() const { return m_published_scale.load(std::memory_order_relaxed); }
+
+	FrameGovernorStats get_stats() const;
+
+	void destroy();
+
+private:
+
+	// scales are multiples of this, every change re-records the scene passes
+	static constexpr float SCALE_STEP = 1.0f / 32.0f;
+
+	// frames between two scale changes, the effect of a change is measured FRAME_OVERLAP frames late
+	static constexpr uint32_t ADJUST_INTERVAL = 8;
+
+	// frames over budget at the smallest scale before the next level is shed
+	static constexpr uint32_t SHED_FRAMES = 60;
+
+	// frames with headroom before a shed level is restored
+	static constexpr uint32_t RESTORE_FRAMES = 120;
+
+	// the average must stay below this fraction of the budget to scale up or restore
+	static constexpr float HEADROOM = 0.85f;
+
+	static constexpr float AVERAGE_WEIGHT = 0.1f;
+
+	void adjust();
+
+	void set_shed_level(uint32_t level);
+
+	FrameGovernorDescription m_description;
+
+	VkQueryPool m_query_pool = VK_NULL_HANDLE;
+
+	// --- render thread ---
+
+	// the queries of a slot are only read once a frame wrote them
+	std::vector<bool> m_written;
+
+	float m_scale = 1.0f;
+
+	float m_average_ms = 0.0f;
+
+	uint32_t m_measured = 0;
+
+	uint32_t m_frames_since_adjust = 0;
+
+	uint32_t m_over_budget_frames = 0;
+
+	uint32_t m_headroom_frames = 0;
+
+	uint32_t m_shed_level = 0;
+
+	// --- shared ---
+
+	std::atomic<float> m_last_ms {0.0f};
+
+	std::atomic<float> m_published_average_ms {0.0f};
+
+	std::atomic<float> m_published_scale {1.0f};
+
+	std::atomic<uint32_t> m_published_shed_level {0};
+
+	std::atomic<float> m_lod_bias {1.0f};
+};
@@ -0,0 +1,234 @@
+#include "pre-compiled-header.h"
+#include "jobs.h"
+#include "alloc_tracker.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__i386__)
+	#include <immintrin.h>
+	#define CPU_RELAX() _mm_pause()
+#else
+	#define CPU_RELAX() std::this_thread::yield()
+#endif
+
+namespace
+{
+	// index of the worker running on this thread, -1 for foreign threads
+	thread_local int t_worker = -1;
+
+	// steal attempts before an idle worker goes to sleep
+	constexpr int IDLE_SPIN_COUNT = 256;
+
+	void execute(const Job& job)
+	{
+		job.function(job.data, job.begin, job.end);
+		job.counter->pending.fetch_sub(1, std::memory_order_release);
+	}
+}
+
+bool WorkStealingDeque::push(const Job& job)
+{
+	int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+	int64_t top = m_top.load(std::memory_order_acquire);
+	if(bottom - top >= CAPACITY)
+		return false;
+
+	m_jobs[bottom & MASK] = job;
+	std::atomic_thread_fence(std::memory_order_release);
+	m_bottom.store(bottom + 1, std::memory_order_relaxed);
+	return true;
+}
+
+bool WorkStealingDeque::pop(Job& job)
+{
+	int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+	m_bottom.store(bottom, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t top = m_top.load(std::memory_order_relaxed);
+
+	if(top > bottom)
+	{
+		// empty
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		return false;
+	}
+
+	job = m_jobs[bottom & MASK];
+	if(top == bottom)
+	{
+		// last job, race the thieves for it
+		bool won = m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+		m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		return won;
+	}
+
+	return true;
+}
+
+bool WorkStealingDeque::steal(Job& job)
+{
+	int64_t top = m_top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t bottom = m_bottom.load(std::memory_order_acquire);
+
+	if(top >= bottom)
+		return false;
+
+	job = m_jobs[top & MASK];
+	return m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+}
+
+JobSystem::~JobSystem()
+{
+	if(!m_threads.empty())
+		shutdown();
+}
+
+/**
+ * @brief Start the worker threads, the calling thread becomes worker 0
+ * @param worker_count Number of workers including the caller, 0 for one per hardware thread
+ * @param submitter_count Threads besides the workers that will attach() to submit jobs
+ */
+void JobSystem::init(uint32_t worker_count, uint32_t submitter_count)
+{
+	if(worker_count == 0)
+		worker_count = std::max(1u, std::thread::hardware_concurrency());
+	m_worker_count = worker_count;
+
+	// the workers steal from every deque, it may not grow once they run
+	m_deques.clear();
+	for(uint32_t i = 0; i < worker_count + submitter_count; i++)
+		m_deques.push_back(std::make_unique<WorkStealingDeque>());
+
+	t_worker = 0;
+	m_running = true;
+
+	for(uint32_t i = 1; i < worker_count; i++)
+		m_threads.emplace_back(&JobSystem::worker_loop, this, i);
+}
+
+/**
+ * @brief Let the calling thread submit jobs
+ * @param index Submitter deque, below the submitter_count given to init()
+ */
+void JobSystem::attach(uint32_t index)
+{
+	if(m_worker_count + index >= m_deques.size())
+		throw std::runtime_error("No job submitter deque " + std::to_string(index));
+
+	t_worker = static_cast<int>(m_worker_count + index);
+}
+
+void JobSystem::shutdown()
+{
+	m_running = false;
+	m_epoch.fetch_add(1);
+	m_epoch.notify_all();
+
+	for(auto& thread : m_threads)
+		thread.join();
+	m_threads.clear();
+}
+
+/**
+ * @brief Submit a job to the deque of the calling worker
+ * @param counter Incremented now, decremented when the job finished
+ * @param function The job body
+ * @param data Passed to the function, must stay alive until the counter is done
+ * @param begin Passed to the function
+ * @param end Passed to the function
+ */
+void JobSystem::run(JobCounter& counter, void (*function)(void* data, uint32_t begin, uint32_t end), void* data, uint32_t begin, uint32_t end)
+{
+	if(t_worker < 0)
+		throw std::runtime_error("Jobs can only be submitted from job system workers");
+
+	counter.pending.fetch_add(1, std::memory_order_relaxed);
+
+	Job job = {
+		.function = function,
+		.data 	  = data,
+		.begin 	  = begin,
+		.end 	  = end,
+		.counter  = &counter
+	};
+
+	// a full deque means plenty of parallel work already, just run it here
+	if(!m_deques[t_worker]->push(job))
+	{
+		m_overflow_count.fetch_add(1, std::memory_order_relaxed);
+		execute(job);
+		return;
+	}
+
+	// seq_cst pairs with the sleeping worker's increment, so a wake-up is never lost
+	m_epoch.fetch_add(1);
+	if(m_sleeping.load() > 0)
+		m_epoch.notify_one();
+}
+
+/**
+ * @brief Wait until every job of the counter finished, running jobs meanwhile
+ * @param counter The job group
+ */
+void JobSystem::wait(JobCounter& counter)
+{
+	const uint32_t worker = t_worker < 0 ? 0 : static_cast<uint32_t>(t_worker);
+
+	while(!counter.is_done())
+	{
+		if(t_worker < 0 || !try_run_one(worker))
+			CPU_RELAX();
+	}
+}
+
+bool JobSystem::try_run_one(uint32_t worker)
+{
+	Job job;
+	if(m_deques[worker]->pop(job))
+	{
+		execute(job);
+		return true;
+	}
+
+	const uint32_t deque_count = static_cast<uint32_t>(m_deques.size());
+	for(uint32_t i = 1; i < deque_count; i++)
+	{
+		uint32_t victim = (worker + i) % deque_count;
+		if(m_deques[victim]->steal(job))
+		{
+			execute(job);
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void JobSystem::worker_loop(uint32_t worker)
+{
+	t_worker = static_cast<int>(worker);
+	AllocationScope scope("job worker");
+
+	int idle = 0;
+	while(m_running.load(std::memory_order_relaxed))
+	{
+		uint32_t epoch = m_epoch.load(std::memory_order_acquire);
+
+		if(try_run_one(worker))
+		{
+			idle = 0;
+			continue;
+		}
+
+		if(++idle < IDLE_SPIN_COUNT)
+		{
+			CPU_RELAX();
+			continue;
+		}
+
+		// nothing was submitted since the epoch was read: sleep until something is
+		m_sleeping.fetch_add(1);
+		m_epoch.wait(epoch);
+		m_sleeping.fetch_sub(1);
+		idle = 0;
+	}
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Counts the unfinished jobs of a group; waiting on it runs other jobs meanwhile
+struct JobCounter
+{
+	std::atomic<uint32_t> pending {0};
+
+	inline bool is_done() const { return pending.load(std::memory_order_acquire) == 0; }
+};
+
+struct Job
+{
+	void (*function)(void* data, uint32_t begin, uint32_t end) = nullptr;
+
+	void* data = nullptr;
+
+	uint32_t begin = 0;
+
+	uint32_t end = 0;
+
+	JobCounter* counter = nullptr;
+};
+
+/**
+ * Fixed-capacity Chase-Lev deque: the owning worker pushes and pops at the
+ * bottom, other workers steal from the top.
+ */
+class WorkStealingDeque
+{
+public:
+
+	static constexpr int64_t CAPACITY = 4096;
+
+	bool push(const Job& job);
+
+	bool pop(Job& job);
+
+	bool steal(Job& job);
+
+private:
+
+	static constexpr int64_t MASK = CAPACITY - 1;
+
+	alignas(64) std::atomic<int64_t> m_top {0};
+
+	alignas(64) std::atomic<int64_t> m_bottom {0};
+
+	Job m_jobs[CAPACITY];
+};
+
+/**
+ * Work-stealing scheduler with one deque per worker. The thread calling
+ * init() becomes worker 0; only workers may submit jobs. Other long-lived
+ * threads that submit (the render thread) attach to a deque of their own,
+ * which the workers steal from; they run jobs only while they wait.
+ */
+class JobSystem
+{
+public:
+
+	~JobSystem();
+
+	// worker_count includes the calling thread, 0 uses every hardware thread; submitter_count deques are kept for attach()
+	void init(uint32_t worker_count = 0, uint32_t submitter_count = 0);
+
+	// lets the calling thread submit jobs through submitter deque index, one thread per index
+	void attach(uint32_t index);
+
+	void shutdown();
+
+	void run(JobCounter& counter, void (*function)(void* data, uint32_t begin, uint32_t end), void* data, uint32_t begin = 0, uint32_t end = 0);
+
+	void wait(JobCounter& counter);
+
+	// function(begin, end) over [0, count) in ranges of at most grain items
+	template<typename Function>
+	void parallel_for(uint32_t count, uint32_t grain, Function&& function)
+	{
+		JobCounter counter;
+
+		auto trampoline = [](void* data, uint32_t begin, uint32_t end)
+		{
+			(*static_cast<std::remove_reference_t<Function>*>(data))(begin, end);
+		};
+
+		for(uint32_t begin = 0; begin < count; begin += grain)
+			run(counter, trampoline, &function, begin, std::min(begin + grain, count));
+
+		wait(counter);
+	}
+
+	inline uint32_t get_worker_count() const { return m_worker_count; }
+
+	// jobs their submitter ran itself because its deque was full
+	inline uint64_t get_overflow_count() const { return m_overflow_count.load(std::memory_order_relaxed); }
+
+private:
+
+	bool try_run_one(uint32_t worker);
+
+	void worker_loop(uint32_t worker);
+
+	// the workers', then the submitters'
+	std::vector<std::unique_ptr<WorkStealingDeque>> m_deques;
+
+	uint32_t m_worker_count = 0;
+
+	std::vector<std::thread> m_threads;
+
+	std::atomic<bool> m_running {false};
+
+	// bumped on every submission, idle workers sleep on it
+	std::atomic<uint32_t> m_epoch {0};
+
+	std::atomic<uint32_t> m_sleeping {0};
+
+	std::atomic<uint64_t> m_overflow_count {0};
+};
@@ -0,0 +1,165 @@
+#include "pre-compiled-header.h"
+#include "ktx2.h"
+
+#include <bit>
+
+namespace
+{
+	const uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+	// identifier, nine uint32 header fields, four uint32 and two uint64 index fields
+	constexpr size_t HEADER_SIZE = 12 + 9 * 4 + 4 * 4 + 2 * 8;
+
+	constexpr size_t LEVEL_SIZE = 3 * 8;
+
+	template<typename T>
+	T read(const uint8_t* data, size_t offset)
+	{
+		// KTX2 is little-endian, like every platform the engine runs on
+		T value;
+		std::memcpy(&value, data + offset, sizeof(T));
+		return value;
+	}
+}
+
+/**
+ * @brief Read the header and level index of a KTX2 file
+ *
+ * Only 2D textures are accepted: no depth, no array layers, no cube faces.
+ * @param data The file contents
+ * @param size Size of data in bytes
+ */
+Ktx2Header ktx2::parse(const uint8_t* data, size_t size)
+{
+	if(size < HEADER_SIZE || std::memcmp(data, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0)
+		throw std::runtime_error("Not a KTX2 file");
+
+	Ktx2Header header;
+	header.format 			= static_cast<VkFormat>(read<uint32_t>(data, 12));
+	header.width 			= read<uint32_t>(data, 20);
+	header.height 			= read<uint32_t>(data, 24);
+	uint32_t depth 			= read<uint32_t>(data, 28);
+	uint32_t layer_count 	= read<uint32_t>(data, 32);
+	uint32_t face_count 	= read<uint32_t>(data, 36);
+	header.level_count 		= read<uint32_t>(data, 40);
+	header.supercompression = read<uint32_t>(data, 44);
+
+	if(header.width == 0 || header.height == 0 || depth > 0 || layer_count > 0 || face_count != 1)
+		throw std::runtime_error("Only 2D KTX2 textures are supported");
+
+	header.generate_mips = header.level_count == 0;
+	header.level_count = std::max(header.level_count, 1u);
+
+	uint32_t full_chain = static_cast<uint32_t>(std::bit_width(std::max(header.width, header.height)));
+	if(header.level_count > full_chain)
+		throw std::runtime_error("KTX2 level count exceeds the mip chain of the base level");
+
+	if(size < HEADER_SIZE + header.level_count * LEVEL_SIZE)
+		throw std::runtime_error("KTX2 level index is truncated");
+
+	header.levels.resize(header.level_count);
+	for(uint32_t level = 0; level < header.level_count; level++)
+	{
+		size_t offset = HEADER_SIZE + level * LEVEL_SIZE;
+
+		Ktx2Level& entry 		  = header.levels[level];
+		entry.offset 			  = read<uint64_t>(data, offset);
+		entry.length 			  = read<uint64_t>(data, offset + 8);
+		entry.uncompressed_length = read<uint64_t>(data, offset + 16);
+
+		if(entry.offset > size || entry.length > size - entry.offset)
+			throw std::runtime_error("KTX2 level " + std::to_string(level) + " is out of bounds");
+	}
+
+	return header;
+}
+
+/**
+ * @brief Block layout of an uploadable format
+ * @param format The vulkan format
+ * @param block_width Set to the texel width of a block, 1 for uncompressed formats
+ * @param block_height Set to the texel height of a block, 1 for uncompressed formats
+ */
+uint32_t ktx2::get_block_size(VkFormat format, uint32_t& block_width, uint32_t& block_height)
+{
+	block_width = 1;
+	block_height = 1;
+
+	switch(format)
+	{
+	case VK_FORMAT_R8_UNORM:
+		return 1;
+
+	case VK_FORMAT_R8G8_UNORM:
+	case VK_FORMAT_R16_SFLOAT:
+		return 2;
+
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+	case VK_FORMAT_B8G8R8A8_UNORM:
+	case VK_FORMAT_B8G8R8A8_SRGB:
+	case VK_FORMAT_R16G16_SFLOAT:
+	case VK_FORMAT_R32_SFLOAT:
+		return 4;
+
+	case VK_FORMAT_R16G16B16A16_SFLOAT:
+		return 8;
+
+	case VK_FORMAT_R32G32B32A32_SFLOAT:
+		return 16;
+
+	default:
+		break;
+	}
+
+	block_width = 4;
+	block_height = 4;
+
+	switch(format)
+	{
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+	case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+	case VK_FORMAT_BC4_UNORM_BLOCK:
+	case VK_FORMAT_BC4_SNORM_BLOCK:
+	case VK_FORMAT_ETC2_R8G8B8_UNORM_BLOCK:
+	case VK_FORMAT_ETC2_R8G8B8_SRGB_BLOCK:
+	case VK_FORMAT_ETC2_R8G8B8A1_UNORM_BLOCK:
+	case VK_FORMAT_ETC2_R8G8B8A1_SRGB_BLOCK:
+	case VK_FORMAT_EAC_R11_UNORM_BLOCK:
+		return 8;
+
+	case VK_FORMAT_BC2_UNORM_BLOCK:
+	case VK_FORMAT_BC2_SRGB_BLOCK:
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC3_SRGB_BLOCK:
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+	case VK_FORMAT_BC5_SNORM_BLOCK:
+	case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+	case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+	case VK_FORMAT_BC7_SRGB_BLOCK:
+	case VK_FORMAT_ETC2_R8G8B8A8_UNORM_BLOCK:
+	case VK_FORMAT_ETC2_R8G8B8A8_SRGB_BLOCK:
+	case VK_FORMAT_EAC_R11G11_UNORM_BLOCK:
+	case VK_FORMAT_ASTC_4x4_UNORM_BLOCK:
+	case VK_FORMAT_ASTC_4x4_SRGB_BLOCK:
+		return 16;
+
+	case VK_FORMAT_ASTC_6x6_UNORM_BLOCK:
+	case VK_FORMAT_ASTC_6x6_SRGB_BLOCK:
+		block_width = 6;
+		block_height = 6;
+		return 16;
+
+	case VK_FORMAT_ASTC_8x8_UNORM_BLOCK:
+	case VK_FORMAT_ASTC_8x8_SRGB_BLOCK:
+		block_width = 8;
+		block_height = 8;
+		return 16;
+
+	default:
+		return 0;
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "vk_defines.h"
+
+#include <cstdint>
+#include <vector>
+
+// Byte range of one mip level inside a KTX2 file
+struct Ktx2Level
+{
+	uint64_t offset = 0;
+
+	uint64_t length = 0;
+
+	uint64_t uncompressed_length = 0;
+};
+
+// The parts of a KTX2 header a 2D texture needs, levels[0] is the largest mip
+struct Ktx2Header
+{
+	VkFormat format = VK_FORMAT_UNDEFINED;
+
+	uint32_t width = 0;
+
+	uint32_t height = 0;
+
+	// levels stored in the file; 0 in the file means "generate the mips", which is stored as 1 here
+	uint32_t level_count = 0;
+
+	// the file asks the loader to generate the levels it does not store
+	bool generate_mips = false;
+
+	uint32_t supercompression = 0;
+
+	std::vector<Ktx2Level> levels;
+};
+
+namespace ktx2
+{
+	enum Supercompression : uint32_t
+	{
+		SUPERCOMPRESSION_NONE 	  = 0,
+		SUPERCOMPRESSION_BASIS_LZ = 1,
+		SUPERCOMPRESSION_ZSTD 	  = 2,
+		SUPERCOMPRESSION_ZLIB 	  = 3
+	};
+
+	// throws std::runtime_error when the data is not a KTX2 file or its level index is out of bounds
+	Ktx2Header parse(const uint8_t* data, size_t size);
+
+	// bytes per block and block extent of the formats the streamer can upload, 0 bytes when unknown
+	uint32_t get_block_size(VkFormat format, uint32_t& block_width, uint32_t& block_height);
+
+	inline bool is_block_compressed(VkFormat format)
+	{
+		uint32_t block_width, block_height;
+		return get_block_size(format, block_width, block_height) > 0 && block_width > 1;
+	}
+}
@@ -0,0 +1,336 @@
+#include "pre-compiled-header.h"
+#include "latency.h"
+
+#include <fmt/core.h>
+
+#include <thread>
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+#endif
+
+namespace
+{
+	// a present that takes longer is given up on (minimized window), pacing must not hang the render thread
+	constexpr uint64_t PRESENT_WAIT_TIMEOUT = 100'000'000;
+
+	// the main thread aims for its packet to wait this long before the render thread takes it
+	constexpr float PACING_MARGIN_MS = 1.0f;
+
+	// fraction of the error corrected per frame
+	constexpr float PACING_GAIN = 0.5f;
+
+	constexpr float MAX_PACING_DELAY_MS = 50.0f;
+
+	// weight of a new frame in the moving average
+	constexpr float AVERAGE_WEIGHT = 0.05f;
+
+	float to_ms(LatencyMonitor::Clock::duration duration)
+	{
+		return std::chrono::duration<float, std::milli>(duration).count();
+	}
+
+	const char* source_name(LatencySource source)
+	{
+		switch(source)
+		{
+		case LatencySource::PRESENT:
+			return "present wait";
+		case LatencySource::GPU_TIMESTAMP:
+			return "gpu timestamp";
+		default:
+			return "fence";
+		}
+	}
+}
+
+VkTimeDomainEXT LatencyMonitor::get_host_time_domain()
+{
+#ifdef _WIN32
+	return VK_TIME_DOMAIN_QUERY_PERFORMANCE_COUNTER_EXT;
+#elif defined(__linux__)
+	return VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT;
+#else
+	return VK_TIME_DOMAIN_DEVICE_EXT;
+#endif
+}
+
+/**
+ * @brief Pick the best latency source the device offers
+ * @param description Device, swapchain and the optional extensions that were enabled
+ */
+void LatencyMonitor::init(const LatencyMonitorDescription& description)
+{
+	m_description = description;
+
+	if(description.present_wait)
+	{
+		m_wait_for_present = reinterpret_cast<PFN_vkWaitForPresentKHR>(vkGetDeviceProcAddr(description.device, "vkWaitForPresentKHR"));
+		if(!m_wait_for_present)
+			throw std::runtime_error("Failed to load vkWaitForPresentKHR");
+
+		m_source = LatencySource::PRESENT;
+	}
+	else if(description.calibrated_timestamps)
+	{
+		m_get_calibrated_timestamps = reinterpret_cast<PFN_vkGetCalibratedTimestampsEXT>(vkGetDeviceProcAddr(description.device, "vkGetCalibratedTimestampsEXT"));
+		if(!m_get_calibrated_timestamps)
+			throw std::runtime_error("Failed to load vkGetCalibratedTimestampsEXT");
+
+		VkQueryPoolCreateInfo query_pool_info = {
+			.sType 		= VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+			.queryType 	= VK_QUERY_TYPE_TIMESTAMP,
+			.queryCount = description.slot_count
+		};
+
+		VK_CHECK(vkCreateQueryPool(description.device, &query_pool_info, nullptr, &m_query_pool));
+
+		m_source = LatencySource::GPU_TIMESTAMP;
+	}
+
+	m_samples.reserve(MAX_SAMPLES);
+
+	std::cout << "latency: measured at " << source_name(m_source) << ", pacing " << (description.pacing ? "on" : "off") << '\n';
+}
+
+/**
+ * @brief Sleep before the main thread starts a frame, so its packet is published just in time
+ *
+ * An integral controller: the render thread reports how long each packet
+ * waited in the triple buffer, the delay moves towards the value that
+ * leaves it waiting PACING_MARGIN_MS only.
+ */
+bool LatencyMonitor::wait_for_frame_start()
+{
+	if(!m_description.pacing)
+		return false;
+
+	uint32_t packet_waits = m_packet_waits.load(std::memory_order_acquire);
+	if(packet_waits != m_seen_packet_waits)
+	{
+		m_seen_packet_waits = packet_waits;
+
+		float error = m_packet_wait_ms.load(std::memory_order_relaxed) - PACING_MARGIN_MS;
+		m_delay_ms = std::clamp(m_delay_ms + PACING_GAIN * error, 0.0f, MAX_PACING_DELAY_MS);
+		m_published_delay_ms.store(m_delay_ms, std::memory_order_relaxed);
+	}
+
+	if(m_delay_ms <= 0.0f)
+		return false;
+
+	std::this_thread::sleep_for(std::chrono::duration<float, std::milli>(m_delay_ms));
+	return true;
+}
+
+LatencyStats LatencyMonitor::get_stats() const
+{
+	return {
+		.source 		 = m_source,
+		.frames 		 = m_frames.load(std::memory_order_relaxed),
+		.last_ms 		 = m_last_ms.load(std::memory_order_relaxed),
+		.average_ms 	 = m_average_ms.load(std::memory_order_relaxed),
+		.max_ms 		 = m_max_ms.load(std::memory_order_relaxed),
+		.pacing_delay_ms = m_published_delay_ms.load(std::memory_order_relaxed)
+	};
+}
+
+/**
+ * @brief Resolve the frames that ended and, when pacing, wait until at most one frame is queued for the display
+ *
+ * A present seen complete by polling is timed when it is seen, so without
+ * pacing PRESENT times are late by up to a frame; the pacing wait blocks on
+ * the present itself and times it exactly.
+ * @param slot The frame slot whose fence was just waited for
+ * @param publish_time When the main thread published the packet of this frame
+ */
+void LatencyMonitor::begin_frame(uint32_t slot, Clock::time_point publish_time)
+{
+	Clock::time_point now = Clock::now();
+
+	m_packet_wait_ms.store(to_ms(now - publish_time), std::memory_order_relaxed);
+	m_packet_waits.fetch_add(1, std::memory_order_release);
+
+	if(m_source == LatencySource::PRESENT)
+	{
+		while(!m_pending.empty())
+		{
+			VkResult result = m_wait_for_present(m_description.device, m_description.swapchain, m_pending.front().present_id, 0);
+			if(result == VK_TIMEOUT)
+				break;
+
+			// out of date and lost surfaces never present the frame, it is dropped unmeasured
+			if(result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR)
+				record(m_pending.front(), now);
+			m_pending.pop_front();
+		}
+
+		while(m_description.pacing && m_pending.size() > 1)
+		{
+			VkResult result = m_wait_for_present(m_description.device, m_description.swapchain, m_pending.front().present_id, PRESENT_WAIT_TIMEOUT);
+			if(result == VK_TIMEOUT)
+				break;
+
+			if(result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR)
+				record(m_pending.front(), Clock::now());
+			m_pending.pop_front();
+		}
+
+		return;
+	}
+
+	// the fence of the slot was waited for, so the frame that last used it has ended
+	if(m_pending.empty() || m_pending.front().slot != slot)
+		return;
+
+	PendingFrame frame = m_pending.front();
+	m_pending.pop_front();
+
+	Clock::time_point end_time = now;
+	uint64_t ticks;
+	if(m_source == LatencySource::GPU_TIMESTAMP
+		&& vkGetQueryPoolResults(m_description.device, m_query_pool, slot, 1, sizeof(ticks), &ticks, sizeof(ticks), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)
+	{
+		if(++m_frames_since_calibration >= CALIBRATION_INTERVAL)
+			calibrate();
+
+		// signed tick distance to the calibration point, modulo the valid bits of the counter
+		uint64_t mask = m_description.timestamp_valid_bits >= 64 ? ~0ull : (1ull << m_description.timestamp_valid_bits) - 1;
+		uint64_t distance = (ticks - m_calibration_gpu) & mask;
+		int64_t signed_distance = distance > mask / 2 ? -static_cast<int64_t>((mask - distance) + 1) : static_cast<int64_t>(distance);
+
+		auto offset = std::chrono::nanoseconds(static_cast<int64_t>(signed_distance * static_cast<double>(m_description.timestamp_period)));
+		end_time = m_calibration_cpu + std::chrono::duration_cast<Clock::duration>(offset);
+	}
+
+	record(frame, end_time);
+}
+
+/**
+ * @brief Write the end-of-frame timestamp of a slot
+ * @param cmd The frame's command buffer
+ * @param slot The frame slot
+ */
+void LatencyMonitor::record_end_of_frame(VkCommandBuffer cmd, uint32_t slot)
+{
+	if(m_query_pool == VK_NULL_HANDLE)
+		return;
+
+	vkCmdResetQueryPool(cmd, m_query_pool, slot, 1);
+	vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, m_query_pool, slot);
+}
+
+void LatencyMonitor::prepare_present(VkPresentInfoKHR& present_info, VkPresentIdKHR& present_id)
+{
+	m_present_id++;
+	if(m_source != LatencySource::PRESENT)
+		return;
+
+	// the first swapchain is measured, an id of 0 leaves the others without one
+	assert(present_info.swapchainCount <= MAX_PRESENT_SWAPCHAINS);
+	m_present_ids[0] = m_present_id;
+
+	present_id = {
+		.sType 			= VK_STRUCTURE_TYPE_PRESENT_ID_KHR,
+		.pNext 			= present_info.pNext,
+		.swapchainCount = present_info.swapchainCount,
+		.pPresentIds 	= m_present_ids.data()
+	};
+	present_info.pNext = &present_id;
+}
+
+/**
+ * @brief Start timing a presented frame
+ * @param slot The frame slot it was recorded in
+ * @param input_time When the main thread polled the input of its packet
+ */
+void LatencyMonitor::end_frame(uint32_t slot, Clock::time_point input_time)
+{
+	// presents that never complete would fill the queue, the oldest is dropped unmeasured
+	if(m_pending.full())
+		m_pending.pop_front();
+
+	m_pending.push_back({
+		.present_id = m_present_id,
+		.slot 		= slot,
+		.input_time = input_time
+	});
+}
+
+void LatencyMonitor::print_summary() const
+{
+	if(m_samples.empty())
+		return;
+
+	std::vector<float> sorted = m_samples;
+	std::sort(sorted.begin(), sorted.end());
+
+	auto percentile = [&sorted](float fraction)
+	{
+		return sorted[static_cast<size_t>(fraction * (sorted.size() - 1) + 0.5f)];
+	};
+
+	double sum = 0.0;
+	for(float sample : sorted)
+		sum += sample;
+
+	fmt::print("latency ({}): {} frames | mean {:6.2f} ms | p50 {:6.2f} ms | p99 {:6.2f} ms | max {:6.2f} ms\n",
+		source_name(m_source), sorted.size(), sum / sorted.size(), percentile(0.5f), percentile(0.99f), sorted.back());
+}
+
+void LatencyMonitor::destroy()
+{
+	if(m_query_pool != VK_NULL_HANDLE)
+		vkDestroyQueryPool(m_description.device, m_query_pool, nullptr);
+}
+
+void LatencyMonitor::record(const PendingFrame& frame, Clock::time_point end_time)
+{
+	float latency = std::max(0.0f, to_ms(end_time - frame.input_time));
+	if(m_samples.size() < MAX_SAMPLES)
+		m_samples.push_back(latency);
+	else
+		m_samples[m_sample_count % MAX_SAMPLES] = latency;
+	m_sample_count++;
+
+	uint32_t frames = m_frames.load(std::memory_order_relaxed);
+	m_window[frames % STATS_WINDOW] = latency;
+
+	float window_max = 0.0f;
+	for(uint32_t i = 0; i < std::min(frames + 1, STATS_WINDOW); i++)
+		window_max = std::max(window_max, m_window[i]);
+
+	float average = frames == 0 ? latency : m_average_ms.load(std::memory_order_relaxed) * (1.0f - AVERAGE_WEIGHT) + latency * AVERAGE_WEIGHT;
+
+	m_last_ms.store(latency, std::memory_order_relaxed);
+	m_average_ms.store(average, std::memory_order_relaxed);
+	m_max_ms.store(window_max, std::memory_order_relaxed);
+	m_frames.store(frames + 1, std::memory_order_relaxed);
+}
+
+// a device tick and a host time of the same instant; steady_clock counts in the host domain
+void LatencyMonitor::calibrate()
+{
+	VkCalibratedTimestampInfoEXT infos[2] = {
+		{ .sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT, .timeDomain = VK_TIME_DOMAIN_DEVICE_EXT },
+		{ .sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT, .timeDomain = get_host_time_domain() }
+	};
+
+	uint64_t timestamps[2];
+	uint64_t max_deviation;
+	VK_CHECK(m_get_calibrated_timestamps(m_description.device, 2, infos, timestamps, &max_deviation));
+
+	m_calibration_gpu = timestamps[0];
+
+#ifdef _WIN32
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	auto host = std::chrono::nanoseconds(static_cast<int64_t>(timestamps[1] * (1e9 / frequency.QuadPart)));
+#else
+	auto host = std::chrono::nanoseconds(timestamps[1]);
+#endif
+
+	m_calibration_cpu = Clock::time_point(std::chrono::duration_cast<Clock::duration>(host));
+	m_frames_since_calibration = 0;
+}
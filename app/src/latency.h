@@ -0,0 +1,203 @@
+#pragma once
+
+#include "vk_defines.h"
+#include "fixed_containers.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+// What the end of a frame's latency is measured at, best available first
+enum class LatencySource : uint32_t
+{
+	// the frame reached the display (VK_KHR_present_wait)
+	PRESENT,
+
+	// the GPU finished the frame, its end-of-frame timestamp mapped to the CPU clock (VK_EXT_calibrated_timestamps)
+	GPU_TIMESTAMP,
+
+	// the render thread saw the frame's fence signaled
+	FENCE
+};
+
+struct LatencyMonitorDescription
+{
+	VkPhysicalDevice gpu = VK_NULL_HANDLE;
+
+	VkDevice device = VK_NULL_HANDLE;
+
+	VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+
+	// VK_KHR_present_id and VK_KHR_present_wait are enabled
+	bool present_wait = false;
+
+	// VK_EXT_calibrated_timestamps is enabled and the graphics queue writes timestamps
+	bool calibrated_timestamps = false;
+
+	// nanoseconds per timestamp tick
+	float timestamp_period = 0.0f;
+
+	// timestampValidBits of the graphics queue family
+	uint32_t timestamp_valid_bits = 0;
+
+	// frames in flight, one timestamp query each
+	uint32_t slot_count = 0;
+
+	// delay frame starts and presents so that no more than one frame waits ahead of the display
+	bool pacing = false;
+};
+
+// Input-to-present latency, readable from any thread
+struct LatencyStats
+{
+	LatencySource source = LatencySource::FENCE;
+
+	uint32_t frames = 0;
+
+	float last_ms = 0.0f;
+
+	// exponential moving average
+	float average_ms = 0.0f;
+
+	// largest latency of the last STATS_WINDOW frames
+	float max_ms = 0.0f;
+
+	// how long the main thread holds back the start of a frame
+	float pacing_delay_ms = 0.0f;
+};
+
+/**
+ * Measures input-to-present latency per frame and paces frames to keep it
+ * low. Each frame packet carries the time its input was polled; the frame
+ * ends when VK_KHR_present_wait reports it presented, or, without it, at the
+ * GPU timestamp written last in its command buffer, or when its fence is
+ * seen signaled. With pacing, the render thread waits for the present of
+ * the frame before the previous one before recording, so at most one frame
+ * queues for the display, and the main thread delays the start of the next
+ * frame until just before the render thread will pick its packet up, so the
+ * input it samples is as fresh as possible.
+ */
+class LatencyMonitor
+{
+public:
+
+	using Clock = std::chrono::steady_clock;
+
+	// the calibrated time domain steady_clock counts in, VK_TIME_DOMAIN_DEVICE_EXT on platforms without one
+	static VkTimeDomainEXT get_host_time_domain();
+
+	void init(const LatencyMonitorDescription& description);
+
+	// --- main thread ---
+
+	// sleeps for the pacing delay, true when it did (input should be polled again)
+	bool wait_for_frame_start();
+
+	LatencyStats get_stats() const;
+
+	// --- render thread ---
+
+	// the fence of slot was waited for: resolves finished frames, then waits for the display when pacing
+	void begin_frame(uint32_t slot, Clock::time_point publish_time);
+
+	// last commands of the frame, outside a render pass
+	void record_end_of_frame(VkCommandBuffer cmd, uint32_t slot);
+
+	// chains the frame's present id into present_info; present_id must live until vkQueuePresentKHR returns
+	void prepare_present(VkPresentInfoKHR& present_info, VkPresentIdKHR& present_id);
+
+	// after vkQueuePresentKHR
+	void end_frame(uint32_t slot, Clock::time_point input_time);
+
+	// --- after the render thread stopped ---
+
+	// percentiles of the measured frames (the last hour at 60 fps), for benchmark runs
+	void print_summary() const;
+
+	void destroy();
+
+private:
+
+	static constexpr uint32_t STATS_WINDOW = 120;
+
+	// frames between two calibrations of the GPU clock against the CPU clock
+	static constexpr uint32_t CALIBRATION_INTERVAL = 256;
+
+	// presented frames not measured yet, a few swapchain images at most
+	static constexpr uint32_t MAX_PENDING = 16;
+
+	// an hour at 60 fps, older samples are overwritten so the frame loop never grows the buffer
+	static constexpr uint32_t MAX_SAMPLES = 60 * 60 * 60;
+
+	// windows presented together, see MAX_VIEWS
+	static constexpr uint32_t MAX_PRESENT_SWAPCHAINS = 8;
+
+	struct PendingFrame
+	{
+		uint64_t present_id;
+
+		uint32_t slot;
+
+		Clock::time_point input_time;
+	};
+
+	void record(const PendingFrame& frame, Clock::time_point end_time);
+
+	void calibrate();
+
+	LatencyMonitorDescription m_description;
+
+	LatencySource m_source = LatencySource::FENCE;
+
+	PFN_vkWaitForPresentKHR m_wait_for_present = nullptr;
+
+	PFN_vkGetCalibratedTimestampsEXT m_get_calibrated_timestamps = nullptr;
+
+	VkQueryPool m_query_pool = VK_NULL_HANDLE;
+
+	// --- render thread ---
+
+	uint64_t m_present_id = 0;
+
+	// per swapchain of the present, only the first is set
+	std::array<uint64_t, MAX_PRESENT_SWAPCHAINS> m_present_ids {};
+
+	RingQueue<PendingFrame, MAX_PENDING> m_pending;
+
+	// a GPU tick and a CPU time taken at the same moment
+	uint64_t m_calibration_gpu = 0;
+
+	Clock::time_point m_calibration_cpu;
+
+	uint32_t m_frames_since_calibration = CALIBRATION_INTERVAL;
+
+	std::vector<float> m_samples;
+
+	uint64_t m_sample_count = 0;
+
+	std::array<float, STATS_WINDOW> m_window {};
+
+	// --- shared ---
+
+	std::atomic<uint32_t> m_frames {0};
+
+	std::atomic<float> m_last_ms {0.0f};
+
+	std::atomic<float> m_average_ms {0.0f};
+
+	std::atomic<float> m_max_ms {0.0f};
+
+	// time the last packet waited in the triple buffer before the render thread took it
+	std::atomic<float> m_packet_wait_ms {0.0f};
+
+	std::atomic<uint32_t> m_packet_waits {0};
+
+	// --- main thread ---
+
+	uint32_t m_seen_packet_waits = 0;
+
+	float m_delay_ms = 0.0f;
+
+	std::atomic<float> m_published_delay_ms {0.0f};
+};
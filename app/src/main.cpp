@@ -1,21 +1,32 @@
 #include "pre-compiled-header.h"
 
 #include "vk_engine.h"
+#include "options.h"
+#include "benchmarks.h"
 
-int main() {
+int main(int argc, char** argv) {
 
 	Engine engine;
 	
 	try
 	{
-		engine.init();
+		EngineOptions options = parse_options(argc, argv);
+
+		if(options.bench_jobs)
+		{
+			run_job_benchmark();
+			return 0;
+		}
+
+		engine.init(options);
 
 		engine.run();
 	}
 	catch (std::exception& e)
 	{
 		std::cerr << e.what() << std::endl;
+		return 1;
 	}
 
-	return 0;
+	return engine.has_capture_failed() || engine.has_steady_state_allocations() ? 1 : 0;
 }
\ No newline at end of file
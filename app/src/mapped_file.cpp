@@ -0,0 +1,99 @@
+#include "pre-compiled-header.h"
+#include "mapped_file.h"
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+/**
+ * @brief Map a file for reading
+ * @param path The file to map
+ */
+void MappedFile::open(const std::string& path)
+{
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if(file == INVALID_HANDLE_VALUE)
+		throw std::runtime_error("Failed to open " + path);
+	m_file = file;
+
+	LARGE_INTEGER size;
+	if(!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+	{
+		close();
+		throw std::runtime_error("Failed to get the size of " + path);
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if(mapping == nullptr)
+	{
+		close();
+		throw std::runtime_error("Failed to map " + path);
+	}
+	m_mapping = mapping;
+
+	m_data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if(m_data == nullptr)
+	{
+		close();
+		throw std::runtime_error("Failed to map " + path);
+	}
+	m_size = static_cast<size_t>(size.QuadPart);
+#else
+	m_fd = ::open(path.c_str(), O_RDONLY);
+	if(m_fd < 0)
+		throw std::runtime_error("Failed to open " + path);
+
+	struct stat info;
+	if(fstat(m_fd, &info) != 0 || info.st_size == 0)
+	{
+		close();
+		throw std::runtime_error("Failed to get the size of " + path);
+	}
+
+	void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, m_fd, 0);
+	if(data == MAP_FAILED)
+	{
+		close();
+		throw std::runtime_error("Failed to map " + path);
+	}
+	m_data = static_cast<const uint8_t*>(data);
+	m_size = static_cast<size_t>(info.st_size);
+#endif
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+	if(m_data)
+		UnmapViewOfFile(m_data);
+	if(m_mapping)
+		CloseHandle(m_mapping);
+	if(m_file)
+		CloseHandle(m_file);
+	m_mapping = nullptr;
+	m_file = nullptr;
+#else
+	if(m_data)
+		munmap(const_cast<uint8_t*>(m_data), m_size);
+	if(m_fd >= 0)
+		::close(m_fd);
+	m_fd = -1;
+#endif
+	m_data = nullptr;
+	m_size = 0;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * Read-only memory mapping of a whole file. Pages are loaded by the OS on
+ * first touch, so opening a large file costs nothing until its bytes are read.
+ */
+class MappedFile
+{
+public:
+
+	MappedFile() = default;
+
+	MappedFile(const MappedFile&) = delete;
+
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	~MappedFile();
+
+	// throws std::runtime_error when the file cannot be opened or mapped
+	void open(const std::string& path);
+
+	void close();
+
+	inline const uint8_t* get_data() const { return m_data; }
+
+	inline size_t get_size() const { return m_size; }
+
+private:
+
+	const uint8_t* m_data = nullptr;
+
+	size_t m_size = 0;
+
+#ifdef _WIN32
+	void* m_file = nullptr;
+
+	void* m_mapping = nullptr;
+#else
+	int m_fd = -1;
+#endif
+};
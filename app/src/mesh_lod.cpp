@@ -0,0 +1,394 @@
+#include "pre-compiled-header.h"
+#include "mesh_lod.h"
+
+#include <queue>
+
+namespace
+{
+	// Sum of squared distances to a set of planes, weighted by triangle area
+	struct Quadric
+	{
+		double a2 = 0, ab = 0, ac = 0, ad = 0;
+		double b2 = 0, bc = 0, bd = 0;
+		double c2 = 0, cd = 0;
+		double d2 = 0;
+
+		double weight = 0;
+
+		void add_plane(const glm::dvec3& n, double d, double w)
+		{
+			a2 += w * n.x * n.x; ab += w * n.x * n.y; ac += w * n.x * n.z; ad += w * n.x * d;
+			b2 += w * n.y * n.y; bc += w * n.y * n.z; bd += w * n.y * d;
+			c2 += w * n.z * n.z; cd += w * n.z * d;
+			d2 += w * d * d;
+			weight += w;
+		}
+
+		Quadric operator+(const Quadric& q) const
+		{
+			return {
+				a2 + q.a2, ab + q.ab, ac + q.ac, ad + q.ad,
+				b2 + q.b2, bc + q.bc, bd + q.bd,
+				c2 + q.c2, cd + q.cd,
+				d2 + q.d2,
+				weight + q.weight
+			};
+		}
+
+		// root mean squared distance of p to the planes
+		double get_error(const glm::vec3& p) const
+		{
+			const double x = p.x, y = p.y, z = p.z;
+			double sum = a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+					   + b2 * y * y + 2 * bc * y * z + 2 * bd * y
+					   + c2 * z * z + 2 * cd * z
+					   + d2;
+
+			return weight > 0 ? std::sqrt(std::max(sum, 0.0) / weight) : 0.0;
+		}
+	};
+
+	// Collapse of vertex `from` onto vertex `to`, stale once either vertex changed
+	struct Collapse
+	{
+		double cost;
+
+		uint32_t from, to;
+
+		uint32_t from_version, to_version;
+
+		inline bool operator>(const Collapse& other) const { return cost > other.cost; }
+	};
+
+	class Simplifier
+	{
+	public:
+
+		Simplifier(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices);
+
+		// collapse until at most target triangles remain, or nothing can collapse anymore
+		void simplify_to(uint32_t target);
+
+		std::vector<uint32_t> get_indices() const;
+
+		inline uint32_t get_triangle_count() const { return m_live_triangles; }
+
+		inline float get_error() const { return static_cast<float>(m_error); }
+
+	private:
+
+		void push_collapses(uint32_t vertex);
+
+		bool is_valid(uint32_t from, uint32_t to) const;
+
+		void collapse(uint32_t from, uint32_t to);
+
+		inline bool is_dead(uint32_t triangle) const { return m_triangles[triangle][0] == UINT32_MAX; }
+
+		const std::vector<glm::vec3>& m_positions;
+
+		std::vector<std::array<uint32_t, 3>> m_triangles;
+
+		std::vector<std::vector<uint32_t>> m_vertex_triangles;
+
+		std::vector<Quadric> m_quadrics;
+
+		std::vector<uint32_t> m_versions;
+
+		std::vector<bool> m_locked;
+
+		std::vector<bool> m_removed;
+
+		std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> m_queue;
+
+		uint32_t m_live_triangles = 0;
+
+		double m_error = 0;
+	};
+
+	inline uint64_t edge_key(uint32_t a, uint32_t b)
+	{
+		return a < b ? (static_cast<uint64_t>(a) << 32 | b) : (static_cast<uint64_t>(b) << 32 | a);
+	}
+
+	Simplifier::Simplifier(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices)
+		: m_positions(positions)
+	{
+		const size_t vertex_count = positions.size();
+		m_vertex_triangles.resize(vertex_count);
+		m_quadrics.resize(vertex_count);
+		m_versions.resize(vertex_count);
+		m_locked.resize(vertex_count);
+		m_removed.resize(vertex_count);
+
+		std::unordered_map<uint64_t, uint32_t> edge_uses;
+
+		for(size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			std::array<uint32_t, 3> triangle = { indices[i], indices[i + 1], indices[i + 2] };
+			if(triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[0] == triangle[2])
+				continue;
+
+			const glm::dvec3 p0 = positions[triangle[0]], p1 = positions[triangle[1]], p2 = positions[triangle[2]];
+			const glm::dvec3 cross = glm::cross(p1 - p0, p2 - p0);
+			const double length = glm::length(cross);
+
+			// zero-area triangles still take part in the topology, only their plane is unknown
+			if(length > 0)
+			{
+				const glm::dvec3 normal = cross / length;
+				for(uint32_t vertex : triangle)
+					m_quadrics[vertex].add_plane(normal, -glm::dot(normal, p0), length * 0.5);
+			}
+
+			uint32_t index = static_cast<uint32_t>(m_triangles.size());
+			m_triangles.push_back(triangle);
+			for(int corner = 0; corner < 3; corner++)
+			{
+				m_vertex_triangles[triangle[corner]].push_back(index);
+				edge_uses[edge_key(triangle[corner], triangle[(corner + 1) % 3])]++;
+			}
+		}
+		m_live_triangles = static_cast<uint32_t>(m_triangles.size());
+
+		// border (one use) and non-manifold (more than two) edges keep their vertices
+		for(const auto& [key, uses] : edge_uses)
+		{
+			if(uses != 2)
+			{
+				m_locked[key >> 32] = true;
+				m_locked[key & 0xFFFFFFFF] = true;
+			}
+		}
+
+		for(uint32_t vertex = 0; vertex < vertex_count; vertex++)
+			push_collapses(vertex);
+	}
+
+	void Simplifier::push_collapses(uint32_t vertex)
+	{
+		if(m_locked[vertex])
+			return;
+
+		for(uint32_t triangle : m_vertex_triangles[vertex])
+		{
+			if(is_dead(triangle))
+				continue;
+
+			for(uint32_t other : m_triangles[triangle])
+			{
+				// each edge is visited from both ends, evaluating only the collapse onto `other` here
+				if(other == vertex)
+					continue;
+
+				const Quadric quadric = m_quadrics[vertex] + m_quadrics[other];
+				m_queue.push({ quadric.get_error(m_positions[other]), vertex, other, m_versions[vertex], m_versions[other] });
+			}
+		}
+	}
+
+	// a collapse is rejected when it flips (or degenerates) a triangle that survives it
+	bool Simplifier::is_valid(uint32_t from, uint32_t to) const
+	{
+		for(uint32_t triangle : m_vertex_triangles[from])
+		{
+			if(is_dead(triangle))
+				continue;
+
+			const std::array<uint32_t, 3>& corners = m_triangles[triangle];
+			if(corners[0] == to || corners[1] == to || corners[2] == to)
+				continue;
+
+			glm::vec3 before[3], after[3];
+			for(int corner = 0; corner < 3; corner++)
+			{
+				before[corner] = m_positions[corners[corner]];
+				after[corner] = corners[corner] == from ? m_positions[to] : before[corner];
+			}
+
+			const glm::vec3 normal_before = glm::cross(before[1] - before[0], before[2] - before[0]);
+			const glm::vec3 normal_after = glm::cross(after[1] - after[0], after[2] - after[0]);
+			if(glm::dot(normal_before, normal_after) <= 0.0f)
+				return false;
+		}
+
+		return true;
+	}
+
+	void Simplifier::collapse(uint32_t from, uint32_t to)
+	{
+		std::vector<uint32_t>& to_triangles = m_vertex_triangles[to];
+
+		for(uint32_t triangle : m_vertex_triangles[from])
+		{
+			if(is_dead(triangle))
+				continue;
+
+			std::array<uint32_t, 3>& corners = m_triangles[triangle];
+			if(corners[0] == to || corners[1] == to || corners[2] == to)
+			{
+				// the triangles on the collapsed edge vanish
+				corners = { UINT32_MAX, UINT32_MAX, UINT32_MAX };
+				m_live_triangles--;
+				continue;
+			}
+
+			for(uint32_t& corner : corners)
+				if(corner == from)
+					corner = to;
+			to_triangles.push_back(triangle);
+		}
+
+		std::erase_if(to_triangles, [this](uint32_t triangle) { return is_dead(triangle); });
+		m_vertex_triangles[from].clear();
+
+		m_quadrics[to] = m_quadrics[to] + m_quadrics[from];
+		m_removed[from] = true;
+
+		// queued collapses around `to` saw its old quadric and neighborhood
+		std::vector<uint32_t> neighbors;
+		for(uint32_t triangle : to_triangles)
+			for(uint32_t corner : m_triangles[triangle])
+				if(corner != to)
+					neighbors.push_back(corner);
+		std::sort(neighbors.begin(), neighbors.end());
+		neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+
+		m_versions[to]++;
+		for(uint32_t neighbor : neighbors)
+			m_versions[neighbor]++;
+
+		push_collapses(to);
+		for(uint32_t neighbor : neighbors)
+			push_collapses(neighbor);
+	}
+
+	void Simplifier::simplify_to(uint32_t target)
+	{
+		while(m_live_triangles > target && !m_queue.empty())
+		{
+			Collapse next = m_queue.top();
+			m_queue.pop();
+
+			if(m_removed[next.from] || m_removed[next.to] || m_versions[next.from] != next.from_version || m_versions[next.to] != next.to_version)
+				continue;
+
+			// re-queued when a neighbor changes
+			if(!is_valid(next.from, next.to))
+				continue;
+
+			m_error = std::max(m_error, next.cost);
+			collapse(next.from, next.to);
+		}
+	}
+
+	std::vector<uint32_t> Simplifier::get_indices() const
+	{
+		std::vector<uint32_t> indices;
+		indices.reserve(m_live_triangles * 3);
+
+		for(uint32_t triangle = 0; triangle < m_triangles.size(); triangle++)
+			if(!is_dead(triangle))
+				indices.insert(indices.end(), m_triangles[triangle].begin(), m_triangles[triangle].end());
+
+		return indices;
+	}
+
+	// bit-exact position, vertices that only differ in normal or color are welded for simplification
+	struct PositionKey
+	{
+		uint32_t bits[3];
+
+		inline bool operator==(const PositionKey& other) const { return std::memcmp(bits, other.bits, sizeof(bits)) == 0; }
+	};
+
+	struct PositionKeyHash
+	{
+		inline size_t operator()(const PositionKey& key) const
+		{
+			return (static_cast<size_t>(key.bits[0]) * 73856093) ^ (static_cast<size_t>(key.bits[1]) * 19349663) ^ (static_cast<size_t>(key.bits[2]) * 83492791);
+		}
+	};
+}
+
+/**
+ * @brief Simplify a triangle list
+ * @param positions Vertex positions referenced by indices
+ * @param indices Triangle list
+ * @param target_triangles Triangle count to stop at
+ * @param error Set to the largest distance a collapse moved the surface
+ */
+std::vector<uint32_t> meshlod::simplify(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, uint32_t target_triangles, float& error)
+{
+	Simplifier simplifier(positions, indices);
+	simplifier.simplify_to(target_triangles);
+
+	error = simplifier.get_error();
+	return simplifier.get_indices();
+}
+
+/**
+ * @brief Build the LOD chain of a non-indexed mesh
+ *
+ * Vertices with equal positions are welded so collapses see the topology;
+ * each level is taken from the same collapse sequence, which keeps the
+ * errors of the chain increasing. Levels are stored de-indexed after the
+ * original vertices, so every level is a plain vertex range.
+ * @param mesh The mesh, vertices is a triangle list
+ * @param settings Level count and reduction per level
+ */
+void meshlod::build_lod_chain(Mesh& mesh, const LodChainSettings& settings)
+{
+	const uint32_t vertex_count = static_cast<uint32_t>(mesh.vertices.size());
+
+	mesh.lods.clear();
+	mesh.lods.push_back({ 0, vertex_count, 0.0f });
+
+	std::unordered_map<PositionKey, uint32_t, PositionKeyHash> welded_index;
+	std::vector<glm::vec3> positions;
+	std::vector<Vertex> welded;
+	std::vector<uint32_t> indices;
+	indices.reserve(vertex_count);
+
+	for(const Vertex& vertex : mesh.vertices)
+	{
+		PositionKey key;
+		std::memcpy(key.bits, &vertex.position, sizeof(key.bits));
+
+		auto [it, inserted] = welded_index.try_emplace(key, static_cast<uint32_t>(welded.size()));
+		if(inserted)
+		{
+			welded.push_back(vertex);
+			positions.push_back(vertex.position);
+		}
+		indices.push_back(it->second);
+	}
+
+	Simplifier simplifier(positions, indices);
+	uint32_t triangles = simplifier.get_triangle_count();
+
+	while(mesh.lods.size() < settings.max_lods)
+	{
+		uint32_t target = static_cast<uint32_t>(triangles * settings.reduction);
+		if(target == 0)
+			break;
+
+		simplifier.simplify_to(target);
+
+		uint32_t reached = simplifier.get_triangle_count();
+		if(reached == 0 || reached > triangles * (1.0f - settings.min_reduction))
+			break;
+
+		MeshLod lod = {
+			.first_vertex = static_cast<uint32_t>(mesh.vertices.size()),
+			.vertex_count = reached * 3,
+			.error 		  = simplifier.get_error()
+		};
+
+		for(uint32_t index : simplifier.get_indices())
+			mesh.vertices.push_back(welded[index]);
+
+		mesh.lods.push_back(lod);
+		triangles = reached;
+	}
+}
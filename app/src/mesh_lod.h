@@ -0,0 +1,35 @@
+#pragma once
+
+#include "vk_mesh.h"
+
+#include <cstdint>
+#include <vector>
+
+struct LodChainSettings
+{
+	// levels including the full-detail one
+	uint32_t max_lods = 6;
+
+	// triangle count of a level relative to the previous one
+	float reduction = 0.5f;
+
+	// a level that removes less than this fraction of the previous one's triangles ends the chain
+	float min_reduction = 0.1f;
+};
+
+namespace meshlod
+{
+
+	/**
+	 * Simplify a triangle list with quadric error metrics (Garland-Heckbert
+	 * half-edge collapses) until at most target_triangles remain or no
+	 * collapse is possible. Border and non-manifold vertices are locked, so
+	 * open meshes keep their silhouette. error is set to the largest
+	 * distance (in position units) any collapse moved the surface.
+	 */
+	std::vector<uint32_t> simplify(const std::vector<glm::vec3>& positions, const std::vector<uint32_t>& indices, uint32_t target_triangles, float& error);
+
+	// import time: appends the simplified levels to mesh.vertices and fills mesh.lods
+	void build_lod_chain(Mesh& mesh, const LodChainSettings& settings = {});
+
+};
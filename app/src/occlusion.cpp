@@ -0,0 +1,507 @@
+#include "pre-compiled-header.h"
+#include "occlusion.h"
+
+#include "vk_utils.h"
+#include "vk_pipeline.h"
+
+#include <bit>
+
+namespace
+{
+	// matches the push constants of hiz_build.comp
+	struct BuildConstants
+	{
+		glm::ivec2 depth_size;
+		glm::ivec2 pyramid_size;
+		uint32_t level_count;
+		uint32_t group_count;
+	};
+
+	// matches the push constants of hiz_cull.comp
+	struct CullConstants
+	{
+		glm::mat4 view_projection;
+		glm::ivec2 pyramid_size;
+		uint32_t object_count;
+		uint32_t level_count;
+		uint32_t capacity;
+	};
+
+	constexpr uint32_t CULL_GROUP_SIZE = 64;
+
+	// level 0 texels a pyramid workgroup reduces, per side
+	constexpr uint32_t BUILD_TILE_SIZE = 64;
+
+	void memory_barrier(VkCommandBuffer cmd, VkPipelineStageFlags2 src_stage, VkAccessFlags2 src_access, VkPipelineStageFlags2 dst_stage, VkAccessFlags2 dst_access)
+	{
+		VkMemoryBarrier2 barrier = {
+			.sType 		   = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+			.srcStageMask  = src_stage,
+			.srcAccessMask = src_access,
+			.dstStageMask  = dst_stage,
+			.dstAccessMask = dst_access
+		};
+
+		VkDependencyInfo dependency_info = {
+			.sType 				= VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+			.memoryBarrierCount = 1,
+			.pMemoryBarriers 	= &barrier
+		};
+
+		vkCmdPipelineBarrier2(cmd, &dependency_info);
+	}
+}
+
+/**
+ * @brief Allocate the culling buffers and the depth pyramid, create the build and cull pipelines
+ * @param device The vulkan device, created with drawIndirectCount and shaderStorageImageArrayDynamicIndexing
+ * @param allocator The vma allocator
+ * @param description Capacity and the depth attachment of the scene pass
+ */
+void OcclusionCuller::init(VkDevice device, VmaAllocator allocator, const OcclusionCullerDescription& description)
+{
+	m_device = device;
+	m_allocator = allocator;
+	m_capacity = description.capacity;
+	m_depth = description.depth;
+
+	// --- buffers ---
+
+	for(Slot& slot : m_slots)
+	{
+		slot.objects = vkrsc::create_buffer(allocator, sizeof(GPUOcclusionObject) * m_capacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+											VMA_MEMORY_USAGE_AUTO_PREFER_HOST, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+
+		void* mapped;
+		VK_CHECK(vmaMapMemory(allocator, slot.objects.allocation, &mapped));
+		slot.mapped = static_cast<GPUOcclusionObject*>(mapped);
+
+		slot.draws = vkrsc::create_buffer(allocator, COUNTS_SIZE + 2 * sizeof(VkDrawIndirectCommand) * m_capacity,
+										  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+										  VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, 0);
+
+		slot.readback = vkrsc::create_buffer(allocator, 2 * sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_AUTO_PREFER_HOST, VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT);
+
+		VK_CHECK(vmaMapMemory(allocator, slot.readback.allocation, &mapped));
+		slot.readback_mapped = static_cast<uint32_t*>(mapped);
+		slot.readback_mapped[0] = 0;
+		slot.readback_mapped[1] = 0;
+	}
+
+	m_visibility = vkrsc::create_buffer(allocator, sizeof(uint32_t) * m_capacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, 0);
+
+	m_build_counter = vkrsc::create_buffer(allocator, sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, 0);
+
+	// --- depth pyramid: the depth size rounded down to powers of two, so every level halves exactly ---
+
+	m_pyramid_extent = { std::bit_floor(m_depth.extent.width), std::bit_floor(m_depth.extent.height) };
+	m_level_count = std::min(static_cast<uint32_t>(std::bit_width(std::max(m_pyramid_extent.width, m_pyramid_extent.height))), MAX_LEVELS);
+
+	m_pyramid = vkrsc::create_image(device, allocator, { m_pyramid_extent.width, m_pyramid_extent.height, 1 }, VK_FORMAT_R32_SFLOAT,
+									VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_COLOR_BIT, m_level_count);
+
+	for(uint32_t level = 0; level < m_level_count; level++)
+	{
+		VkImageViewCreateInfo view_info = {
+			.sType    		  = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+			.image    		  = m_pyramid.image,
+			.viewType 		  = VK_IMAGE_VIEW_TYPE_2D,
+			.format   		  = VK_FORMAT_R32_SFLOAT,
+			.subresourceRange = {
+				.aspectMask 	= VK_IMAGE_ASPECT_COLOR_BIT,
+				.baseMipLevel 	= level,
+				.levelCount 	= 1,
+				.baseArrayLayer = 0,
+				.layerCount 	= 1
+			}
+		};
+
+		VK_CHECK(vkCreateImageView(device, &view_info, nullptr, &m_level_views[level]));
+	}
+
+	// both shaders use texelFetch, the sampler only has to exist
+	VkSamplerCreateInfo sampler_info = {
+		.sType 		  = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+		.magFilter 	  = VK_FILTER_NEAREST,
+		.minFilter 	  = VK_FILTER_NEAREST,
+		.mipmapMode   = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+		.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+		.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+		.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+		.maxLod 	  = VK_LOD_CLAMP_NONE
+	};
+
+	VK_CHECK(vkCreateSampler(device, &sampler_info, nullptr, &m_sampler));
+
+	// --- descriptors ---
+
+	ShaderReflection build_reflection;
+	ShaderReflection cull_reflection;
+
+	VkShaderModule build_shader = vkutil::load_shader_module(device, "assets/shaders/spirv/hiz_build_comp.spv", &build_reflection);
+	VkShaderModule cull_shader = vkutil::load_shader_module(device, "assets/shaders/spirv/hiz_cull_comp.spv", &cull_reflection);
+
+	spirv::validate_push_constants(build_reflection, sizeof(BuildConstants), "hiz_build.comp");
+	spirv::validate_push_constants(cull_reflection, sizeof(CullConstants), "hiz_cull.comp");
+
+	// depth, pyramid levels, workgroup counter
+	m_build_layout = description.layouts->get({ &build_reflection });
+	m_build_set_layout = description.layouts->get_set_layout(m_build_layout, 0);
+
+	// objects, visibility, draws, pyramid
+	m_cull_layout = description.layouts->get({ &cull_reflection });
+	m_cull_set_layout = description.layouts->get_set_layout(m_cull_layout, 0);
+
+	VkDescriptorPoolSize pool_sizes[3] = {
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 + SLOT_COUNT },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, MAX_LEVELS },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 + 3 * SLOT_COUNT }
+	};
+
+	VkDescriptorPoolCreateInfo pool_info = {
+		.sType 		   = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.maxSets 	   = 1 + SLOT_COUNT,
+		.poolSizeCount = 3,
+		.pPoolSizes    = pool_sizes
+	};
+
+	VK_CHECK(vkCreateDescriptorPool(device, &pool_info, nullptr, &m_descriptor_pool));
+
+	VkDescriptorSetAllocateInfo build_set_info = {
+		.sType 				= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.descriptorPool 	= m_descriptor_pool,
+		.descriptorSetCount = 1,
+		.pSetLayouts 		= &m_build_set_layout
+	};
+
+	VK_CHECK(vkAllocateDescriptorSets(device, &build_set_info, &m_build_set));
+
+	VkDescriptorImageInfo depth_info = { m_sampler, m_depth.view, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL };
+	VkDescriptorImageInfo pyramid_info = { m_sampler, m_pyramid.view, VK_IMAGE_LAYOUT_GENERAL };
+	VkDescriptorBufferInfo counter_info = { m_build_counter.buffer, 0, VK_WHOLE_SIZE };
+
+	// levels past the end of the chain are never written, they repeat the last one to keep the array valid
+	std::array<VkDescriptorImageInfo, MAX_LEVELS> level_infos;
+	for(uint32_t level = 0; level < MAX_LEVELS; level++)
+		level_infos[level] = { VK_NULL_HANDLE, m_level_views[std::min(level, m_level_count - 1)], VK_IMAGE_LAYOUT_GENERAL };
+
+	VkWriteDescriptorSet build_writes[3] = {
+		{
+			.sType 			 = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet 		 = m_build_set,
+			.dstBinding 	 = 0,
+			.descriptorCount = 1,
+			.descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.pImageInfo 	 = &depth_info
+		},
+		{
+			.sType 			 = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet 		 = m_build_set,
+			.dstBinding 	 = 1,
+			.descriptorCount = MAX_LEVELS,
+			.descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+			.pImageInfo 	 = level_infos.data()
+		},
+		{
+			.sType 			 = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet 		 = m_build_set,
+			.dstBinding 	 = 2,
+			.descriptorCount = 1,
+			.descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pBufferInfo 	 = &counter_info
+		}
+	};
+
+	vkUpdateDescriptorSets(device, 3, build_writes, 0, nullptr);
+
+	for(Slot& slot : m_slots)
+	{
+		VkDescriptorSetAllocateInfo cull_set_info = {
+			.sType 				= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+			.descriptorPool 	= m_descriptor_pool,
+			.descriptorSetCount = 1,
+			.pSetLayouts 		= &m_cull_set_layout
+		};
+
+		VK_CHECK(vkAllocateDescriptorSets(device, &cull_set_info, &slot.cull_set));
+
+		VkDescriptorBufferInfo buffer_infos[3] = {
+			{ slot.objects.buffer, 0, VK_WHOLE_SIZE },
+			{ m_visibility.buffer, 0, VK_WHOLE_SIZE },
+			{ slot.draws.buffer, 0, VK_WHOLE_SIZE }
+		};
+
+		VkWriteDescriptorSet writes[4];
+		for(uint32_t binding = 0; binding < 3; binding++)
+		{
+			writes[binding] = {
+				.sType 			 = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				.dstSet 		 = slot.cull_set,
+				.dstBinding 	 = binding,
+				.descriptorCount = 1,
+				.descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				.pBufferInfo 	 = &buffer_infos[binding]
+			};
+		}
+
+		writes[3] = {
+			.sType 			 = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet 		 = slot.cull_set,
+			.dstBinding 	 = 3,
+			.descriptorCount = 1,
+			.descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			.pImageInfo 	 = &pyramid_info
+		};
+
+		vkUpdateDescriptorSets(device, 4, writes, 0, nullptr);
+	}
+
+	// --- pipelines ---
+
+	m_build_pipeline = vkpipe::create_compute_pipeline(device, build_shader, m_build_layout);
+	vkDestroyShaderModule(device, build_shader, nullptr);
+
+	for(uint32_t phase = 0; phase < m_cull_pipelines.size(); phase++)
+	{
+		VkSpecializationMapEntry phase_entry = {
+			.constantID = 0,
+			.offset 	= 0,
+			.size 		= sizeof(uint32_t)
+		};
+
+		VkSpecializationInfo specialization = {
+			.mapEntryCount = 1,
+			.pMapEntries   = &phase_entry,
+			.dataSize 	   = sizeof(uint32_t),
+			.pData 		   = &phase
+		};
+
+		m_cull_pipelines[phase] = vkpipe::create_compute_pipeline(device, cull_shader, m_cull_layout, &specialization);
+	}
+
+	vkDestroyShaderModule(device, cull_shader, nullptr);
+
+	std::cout << "occlusion culling: capacity " << m_capacity << ", pyramid " << m_pyramid_extent.width << "x" << m_pyramid_extent.height << " (" << m_level_count << " levels)" << '\n';
+}
+
+/**
+ * @brief Upload the objects of a frame and emit the draws of those visible last frame
+ *
+ * The frame that last used this slot has completed, so its draw counts are
+ * read back here for the stats. The visibility history was written by the
+ * late phase of the previous frame on the same queue, the barrier at the
+ * start makes it visible.
+ * @param cmd The frame's command buffer, outside a render pass
+ * @param slot The frame slot
+ * @param objects Objects that passed frustum culling, at most the capacity
+ * @param view_projection The camera the late phase projects bounds with
+ */
+void OcclusionCuller::record_early_cull(VkCommandBuffer cmd, uint32_t slot, const std::vector<GPUOcclusionObject>& objects, const glm::mat4& view_projection)
+{
+	Slot& frame = m_slots[slot];
+
+	VK_CHECK(vmaInvalidateAllocation(m_allocator, frame.readback.allocation, 0, VK_WHOLE_SIZE));
+	m_stats_objects.store(frame.object_count, std::memory_order_relaxed);
+	m_stats_early.store(frame.readback_mapped[OCCLUSION_PHASE_EARLY], std::memory_order_relaxed);
+	m_stats_late.store(frame.readback_mapped[OCCLUSION_PHASE_LATE], std::memory_order_relaxed);
+
+	frame.object_count = static_cast<uint32_t>(std::min<size_t>(objects.size(), m_capacity));
+	std::memcpy(frame.mapped, objects.data(), sizeof(GPUOcclusionObject) * frame.object_count);
+	VK_CHECK(vmaFlushAllocation(m_allocator, frame.objects.allocation, 0, VK_WHOLE_SIZE));
+
+	m_view_projection = view_projection;
+
+	// nothing was visible before the first frame: everything goes through the late phase
+	if(!m_cleared)
+	{
+		vkCmdFillBuffer(cmd, m_visibility.buffer, 0, VK_WHOLE_SIZE, 0);
+		vkCmdFillBuffer(cmd, m_build_counter.buffer, 0, VK_WHOLE_SIZE, 0);
+		m_cleared = true;
+	}
+
+	// the previous late phase wrote the history, the frame before it drew from and copied this slot's draws
+	memory_barrier(cmd,
+		VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_CLEAR_BIT,
+		VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT,
+		VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_CLEAR_BIT,
+		VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT);
+
+	vkCmdFillBuffer(cmd, frame.draws.buffer, 0, COUNTS_SIZE, 0);
+
+	memory_barrier(cmd,
+		VK_PIPELINE_STAGE_2_CLEAR_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+		VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT);
+
+	CullConstants constants = {
+		.view_projection = m_view_projection,
+		.pyramid_size 	 = { m_pyramid_extent.width, m_pyramid_extent.height },
+		.object_count 	 = frame.object_count,
+		.level_count 	 = m_level_count,
+		.capacity 		 = m_capacity
+	};
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_cull_pipelines[OCCLUSION_PHASE_EARLY]);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_cull_layout, 0, 1, &frame.cull_set, 0, nullptr);
+	vkCmdPushConstants(cmd, m_cull_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullConstants), &constants);
+
+	if(frame.object_count > 0)
+		vkCmdDispatch(cmd, (frame.object_count + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+	memory_barrier(cmd,
+		VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT,
+		VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT);
+}
+
+/**
+ * @brief Build the depth pyramid from the early phase, test every object against it and emit the newly visible ones
+ * @param cmd The frame's command buffer, between the two passes
+ * @param slot The frame slot
+ */
+void OcclusionCuller::record_late_cull(VkCommandBuffer cmd, uint32_t slot)
+{
+	Slot& frame = m_slots[slot];
+
+	record_depth_pyramid(cmd);
+
+	CullConstants constants = {
+		.view_projection = m_view_projection,
+		.pyramid_size 	 = { m_pyramid_extent.width, m_pyramid_extent.height },
+		.object_count 	 = frame.object_count,
+		.level_count 	 = m_level_count,
+		.capacity 		 = m_capacity
+	};
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_cull_pipelines[OCCLUSION_PHASE_LATE]);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_cull_layout, 0, 1, &frame.cull_set, 0, nullptr);
+	vkCmdPushConstants(cmd, m_cull_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullConstants), &constants);
+
+	if(frame.object_count > 0)
+		vkCmdDispatch(cmd, (frame.object_count + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+
+	memory_barrier(cmd,
+		VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT,
+		VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_TRANSFER_READ_BIT);
+
+	// both draw counts, read on the CPU the next time this slot is used
+	VkBufferCopy counts = { .srcOffset = 0, .dstOffset = 0, .size = 2 * sizeof(uint32_t) };
+	vkCmdCopyBuffer(cmd, frame.draws.buffer, frame.readback.buffer, 1, &counts);
+
+	memory_barrier(cmd,
+		VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+		VK_PIPELINE_STAGE_2_HOST_BIT, VK_ACCESS_2_HOST_READ_BIT);
+}
+
+/**
+ * @brief Draw the commands a phase emitted
+ * @param recorder The recorder of the scene pass
+ * @param slot The frame slot
+ * @param phase Early or late
+ */
+void OcclusionCuller::record_draws(CommandRecorder& recorder, uint32_t slot, OcclusionPhase phase)
+{
+	const Slot& frame = m_slots[slot];
+
+	VkDeviceSize commands_offset = COUNTS_SIZE + phase * sizeof(VkDrawIndirectCommand) * m_capacity;
+	recorder.draw_indirect_count(frame.draws.buffer, commands_offset, frame.draws.buffer, phase * sizeof(uint32_t), m_capacity, sizeof(VkDrawIndirectCommand));
+}
+
+OcclusionStats OcclusionCuller::get_stats() const
+{
+	return {
+		.objects = m_stats_objects.load(std::memory_order_relaxed),
+		.early 	 = m_stats_early.load(std::memory_order_relaxed),
+		.late 	 = m_stats_late.load(std::memory_order_relaxed)
+	};
+}
+
+void OcclusionCuller::record_depth_pyramid(VkCommandBuffer cmd)
+{
+	// the early pass stored its depth, read it in the compute shader
+	vkutil::transition_image_layout(
+		cmd,
+		m_depth.image,
+		VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+		VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+		VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+		VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+		VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+		VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+		VK_IMAGE_ASPECT_DEPTH_BIT
+	);
+
+	// the late phase of the previous frame may still sample the pyramid
+	vkutil::transition_image_layout(
+		cmd,
+		m_pyramid.image,
+		VK_IMAGE_LAYOUT_UNDEFINED,
+		VK_IMAGE_LAYOUT_GENERAL,
+		0,
+		VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+		VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+		VK_IMAGE_ASPECT_COLOR_BIT,
+		0,
+		m_level_count
+	);
+
+	VkExtent2D groups = {
+		(m_pyramid_extent.width + BUILD_TILE_SIZE - 1) / BUILD_TILE_SIZE,
+		(m_pyramid_extent.height + BUILD_TILE_SIZE - 1) / BUILD_TILE_SIZE
+	};
+
+	BuildConstants constants = {
+		.depth_size   = { m_depth.extent.width, m_depth.extent.height },
+		.pyramid_size = { m_pyramid_extent.width, m_pyramid_extent.height },
+		.level_count  = m_level_count,
+		.group_count  = groups.width * groups.height
+	};
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_build_pipeline);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_build_layout, 0, 1, &m_build_set, 0, nullptr);
+	vkCmdPushConstants(cmd, m_build_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(BuildConstants), &constants);
+	vkCmdDispatch(cmd, groups.width, groups.height, 1);
+
+	memory_barrier(cmd,
+		VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+		VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT);
+
+	// the late pass tests and writes depth again
+	vkutil::transition_image_layout(
+		cmd,
+		m_depth.image,
+		VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+		VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+		0,
+		VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+		VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+		VK_IMAGE_ASPECT_DEPTH_BIT
+	);
+}
+
+void OcclusionCuller::destroy()
+{
+	vkDestroyPipeline(m_device, m_build_pipeline, nullptr);
+	for(VkPipeline pipeline : m_cull_pipelines)
+		vkDestroyPipeline(m_device, pipeline, nullptr);
+
+	// the layouts belong to the layout cache
+	vkDestroyDescriptorPool(m_device, m_descriptor_pool, nullptr);
+
+	vkDestroySampler(m_device, m_sampler, nullptr);
+	for(uint32_t level = 0; level < m_level_count; level++)
+		vkDestroyImageView(m_device, m_level_views[level], nullptr);
+	vkrsc::destroy_image(m_device, m_allocator, m_pyramid);
+
+	vmaDestroyBuffer(m_allocator, m_build_counter.buffer, m_build_counter.allocation);
+	vmaDestroyBuffer(m_allocator, m_visibility.buffer, m_visibility.allocation);
+
+	for(Slot& slot : m_slots)
+	{
+		vmaUnmapMemory(m_allocator, slot.readback.allocation);
+		vmaDestroyBuffer(m_allocator, slot.readback.buffer, slot.readback.allocation);
+		vmaDestroyBuffer(m_allocator, slot.draws.buffer, slot.draws.allocation);
+		vmaUnmapMemory(m_allocator, slot.objects.allocation);
+		vmaDestroyBuffer(m_allocator, slot.objects.buffer, slot.objects.allocation);
+	}
+}
@@ -0,0 +1,179 @@
+#pragma once
+
+#include "vk_defines.h"
+#include "vk_resources.h"
+#include "vk_commands.h"
+#include "vk_pipeline.h"
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <atomic>
+#include <vector>
+
+// matches struct Object in hiz_cull.comp
+struct GPUOcclusionObject
+{
+	// world space AABB, w unused
+	glm::vec4 center;
+
+	glm::vec4 extent;
+
+	uint32_t first_vertex;
+
+	uint32_t vertex_count;
+
+	// scene handle index, selects the visibility history entry; unlike the dense index it
+	// does not move to another object when one is destroyed
+	uint32_t object;
+
+	uint32_t padding;
+};
+
+enum OcclusionPhase : uint32_t
+{
+	OCCLUSION_PHASE_EARLY = 0,
+	OCCLUSION_PHASE_LATE
+};
+
+struct OcclusionCullerDescription
+{
+	// objects culled per frame, and the size of the visibility history
+	uint32_t capacity = 0;
+
+	// the depth attachment the pyramid is built from, single-sampled and created with SAMPLED usage
+	AllocatedImage depth {};
+
+	// creates and owns the pipeline and set layouts
+	PipelineLayoutCache* layouts = nullptr;
+};
+
+// Objects of the last completed frame that each phase drew, readable from any thread
+struct OcclusionStats
+{
+	uint32_t objects = 0;
+
+	uint32_t early = 0;
+
+	uint32_t late = 0;
+};
+
+/**
+ * Two-phase occlusion culling against a hierarchical depth (Hi-Z) pyramid.
+ * The early phase draws what was visible last frame; its depth is reduced
+ * to a min-depth mip chain in one compute dispatch; the late phase tests the
+ * bounds of every object against the pyramid, draws the ones that became
+ * visible and records the visibility for the next frame. Both phases emit
+ * indirect draws with a GPU-side count, so occluded objects cost a compute
+ * thread instead of a draw.
+ */
+class OcclusionCuller
+{
+public:
+
+	void init(VkDevice device, VmaAllocator allocator, const OcclusionCullerDescription& description);
+
+	inline bool is_enabled() const { return m_capacity > 0; }
+
+	inline uint32_t get_capacity() const { return m_capacity; }
+
+	// before the first pass of the frame: uploads the objects and emits the early draws
+	void record_early_cull(VkCommandBuffer cmd, uint32_t slot, const std::vector<GPUOcclusionObject>& objects, const glm::mat4& view_projection);
+
+	// between the passes; depth is in DEPTH_STENCIL_ATTACHMENT_OPTIMAL before and after
+	void record_late_cull(VkCommandBuffer cmd, uint32_t slot);
+
+	// inside a pass, with the mesh pipeline, vertex buffer and push constants bound
+	void record_draws(CommandRecorder& recorder, uint32_t slot, OcclusionPhase phase);
+
+	OcclusionStats get_stats() const;
+
+	void destroy();
+
+private:
+
+	static constexpr uint32_t SLOT_COUNT = 2;
+
+	// matches MAX_LEVELS in hiz_build.comp
+	static constexpr uint32_t MAX_LEVELS = 16;
+
+	// the draw counts of both phases precede the commands
+	static constexpr VkDeviceSize COUNTS_SIZE = 4 * sizeof(uint32_t);
+
+	struct Slot
+	{
+		// written by the render thread
+		AllocatedBuffer objects {};
+
+		GPUOcclusionObject* mapped = nullptr;
+
+		uint32_t object_count = 0;
+
+		AllocatedBuffer draws {};
+
+		// draw counts copied back once the slot's frame completes
+		AllocatedBuffer readback {};
+
+		uint32_t* readback_mapped = nullptr;
+
+		VkDescriptorSet cull_set = VK_NULL_HANDLE;
+	};
+
+	void record_depth_pyramid(VkCommandBuffer cmd);
+
+	VkDevice m_device = VK_NULL_HANDLE;
+
+	VmaAllocator m_allocator = VK_NULL_HANDLE;
+
+	uint32_t m_capacity = 0;
+
+	AllocatedImage m_depth {};
+
+	std::array<Slot, SLOT_COUNT> m_slots {};
+
+	// visible bit per object, written by the late phase and read by the next early phase
+	AllocatedBuffer m_visibility {};
+
+	// finished workgroups of the pyramid build, reset by its last workgroup
+	AllocatedBuffer m_build_counter {};
+
+	bool m_cleared = false;
+
+	glm::mat4 m_view_projection {1.0f};
+
+	// --- depth pyramid ---
+
+	AllocatedImage m_pyramid {};
+
+	VkExtent2D m_pyramid_extent {};
+
+	uint32_t m_level_count = 0;
+
+	std::array<VkImageView, MAX_LEVELS> m_level_views {};
+
+	VkSampler m_sampler = VK_NULL_HANDLE;
+
+	VkDescriptorPool m_descriptor_pool = VK_NULL_HANDLE;
+
+	// owned by the layout cache, as are the pipeline layouts
+	VkDescriptorSetLayout m_build_set_layout = VK_NULL_HANDLE;
+
+	VkDescriptorSetLayout m_cull_set_layout = VK_NULL_HANDLE;
+
+	VkDescriptorSet m_build_set = VK_NULL_HANDLE;
+
+	VkPipelineLayout m_build_layout = VK_NULL_HANDLE;
+
+	VkPipelineLayout m_cull_layout = VK_NULL_HANDLE;
+
+	VkPipeline m_build_pipeline = VK_NULL_HANDLE;
+
+	// early, late
+	std::array<VkPipeline, 2> m_cull_pipelines {};
+
+	std::atomic<uint32_t> m_stats_objects {0};
+
+	std::atomic<uint32_t> m_stats_early {0};
+
+	std::atomic<uint32_t> m_stats_late {0};
+};
@@ -0,0 +1,127 @@
+#include "pre-compiled-header.h"
+#include "options.h"
+#include "views.h"
+
+/**
+ * @brief Parse the engine command line
+ * @param argc Argument count, as given to main
+ * @param argv Arguments, as given to main
+ */
+EngineOptions parse_options(int argc, char** argv)
+{
+	EngineOptions options;
+
+	for(int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+
+		auto next_value = [&]() -> std::string
+		{
+			if(i + 1 >= argc)
+				throw std::runtime_error("Missing value for option " + arg);
+			return argv[++i];
+		};
+
+		if(arg == "--workers")
+			options.worker_count = static_cast<uint32_t>(std::stoul(next_value()));
+		else if(arg == "--bench-jobs")
+			options.bench_jobs = true;
+		else if(arg == "--alloc-check")
+			options.alloc_check_warmup = static_cast<uint32_t>(std::stoul(next_value()));
+		else if(arg == "--alloc-check-frames")
+			options.alloc_check_frames = static_cast<uint32_t>(std::stoul(next_value()));
+		else if(arg == "--gpu")
+			options.gpu = next_value();
+		else if(arg == "--device-group")
+			options.device_group = true;
+		else if(arg == "--views")
+			options.view_count = static_cast<uint32_t>(std::stoul(next_value()));
+		else if(arg == "--depth-prepass")
+			options.depth_prepass = true;
+		else if(arg == "--msaa")
+			options.msaa_samples = static_cast<uint32_t>(std::stoul(next_value()));
+		else if(arg == "--render-scale")
+			options.render_scale = std::stof(next_value());
+		else if(arg == "--frame-budget")
+			options.frame_budget_ms = std::stof(next_value());
+		else if(arg == "--min-render-scale")
+			options.min_render_scale = std::stof(next_value());
+		else if(arg == "--occlusion-culling")
+			options.occlusion_culling = true;
+		else if(arg == "--lod-threshold")
+			options.lod_threshold = std::stof(next_value());
+		else if(arg == "--no-async-compute")
+			options.async_compute = false;
+		else if(arg == "--particles")
+			options.particle_count = static_cast<uint32_t>(std::stoul(next_value()));
+		else if(arg == "--no-idle-wait")
+			options.idle_wait = false;
+		else if(arg == "--low-latency")
+			options.low_latency = true;
+		else if(arg == "--texture")
+			options.textures.push_back(next_value());
+		else if(arg == "--texture-budget")
+			options.texture_budget_mb = static_cast<uint32_t>(std::stoul(next_value()));
+		else if(arg == "--capture")
+			options.capture_dir = next_value();
+		else if(arg == "--golden")
+			options.golden_dir = next_value();
+		else if(arg == "--capture-start")
+			options.capture_start = static_cast<uint32_t>(std::stoul(next_value()));
+		else if(arg == "--capture-count")
+			options.capture_count = static_cast<uint32_t>(std::stoul(next_value()));
+		else if(arg == "--tolerance")
+			options.capture_tolerance = static_cast<uint32_t>(std::stoul(next_value()));
+		else if(arg == "--max-mismatch")
+			options.capture_max_mismatch = std::stof(next_value());
+		else if(arg == "--export")
+			options.export_socket = next_value();
+		else if(arg == "--export-slots")
+			options.export_slots = static_cast<uint32_t>(std::stoul(next_value()));
+		else
+			throw std::runtime_error("Unknown option " + arg);
+	}
+
+	if(options.msaa_samples != 1 && options.msaa_samples != 2 && options.msaa_samples != 4 && options.msaa_samples != 8)
+		throw std::runtime_error("--msaa must be 1, 2, 4 or 8");
+
+	if(!(options.render_scale >= 0.25f && options.render_scale <= 1.0f))
+		throw std::runtime_error("--render-scale must be between 0.25 and 1");
+
+	if(!(options.frame_budget_ms >= 0.0f))
+		throw std::runtime_error("--frame-budget must not be negative");
+
+	if(options.frame_budget_ms > 0.0f && !(options.min_render_scale >= 0.25f && options.min_render_scale <= options.render_scale))
+		throw std::runtime_error("--min-render-scale must be between 0.25 and the render scale");
+
+	// the depth pyramid covers the whole depth image, the goldens one resolution, and the timestamps one GPU
+	if(options.frame_budget_ms > 0.0f && (options.occlusion_culling || !options.capture_dir.empty() || options.device_group))
+		throw std::runtime_error("--frame-budget cannot be combined with --occlusion-culling, --capture or --device-group");
+
+	if(options.occlusion_culling && (options.msaa_samples != 1 || options.depth_prepass))
+		throw std::runtime_error("--occlusion-culling cannot be combined with --msaa or --depth-prepass");
+
+	// the GPU of a frame only sees what it rendered, state carried between frames would alternate between GPUs
+	if(options.device_group && (options.occlusion_culling || options.particle_count > 0))
+		throw std::runtime_error("--device-group cannot be combined with --occlusion-culling or --particles");
+
+	// capture reads back and encodes frames on purpose, every captured frame allocates
+	if(options.alloc_check_warmup > 0 && !options.capture_dir.empty())
+		throw std::runtime_error("--alloc-check cannot be combined with --capture");
+
+	if(options.view_count < 1 || options.view_count > MAX_VIEWS)
+		throw std::runtime_error("--views must be between 1 and " + std::to_string(MAX_VIEWS));
+
+	// the views present from the GPU that rendered them and draw the main window's draw list, which lacks the objects occlusion culling draws
+	if(options.view_count > 1 && (options.device_group || options.occlusion_culling))
+		throw std::runtime_error("--views cannot be combined with --device-group or --occlusion-culling");
+
+	if(options.export_slots < 2 || options.export_slots > 8)
+		throw std::runtime_error("--export-slots must be between 2 and 8");
+
+	// the exported slots live on one GPU, frames rendered by the others would never reach them
+	if(!options.export_socket.empty() && options.device_group)
+		throw std::runtime_error("--export cannot be combined with --device-group");
+
+	return options;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Command line settings of the engine, every field has a usable default
+struct EngineOptions
+{
+	// job system workers including the main thread, 0 uses every hardware thread
+	uint32_t worker_count = 0;
+
+	// run the job system micro-benchmark instead of the engine
+	bool bench_jobs = false;
+
+	// frames to warm up before every heap allocation counts as a failure, the allocation check is off when 0 (debug builds)
+	uint32_t alloc_check_warmup = 0;
+
+	// frames checked after the warm-up, then the engine exits
+	uint32_t alloc_check_frames = 600;
+
+	// --- device ---
+
+	// GPU to run on, by index in the device list or part of its name; empty picks the best scoring one
+	std::string gpu;
+
+	// span the GPUs linked to the selected one and alternate frames between them
+	bool device_group = false;
+
+	// windows showing the scene, the main window included (up to MAX_VIEWS); only the main window has the UI
+	uint32_t view_count = 1;
+
+	// --- rendering ---
+
+	// lay down depth first so the color pass shades each pixel once
+	bool depth_prepass = false;
+
+	// samples per pixel of the scene pass (1, 2, 4 or 8), resolved when the pass stores
+	uint32_t msaa_samples = 1;
+
+	// scene resolution relative to the window, the scene is upscaled before the UI pass; the largest scale with a frame budget
+	float render_scale = 1.0f;
+
+	// GPU milliseconds per frame the governor holds by lowering the render scale, then shedding work; off when 0
+	float frame_budget_ms = 0.0f;
+
+	// lowest render scale the governor goes to before it sheds work
+	float min_render_scale = 0.5f;
+
+	// draw what was visible last frame, then only what a depth pyramid of it does not occlude; needs MSAA off and no depth prepass
+	bool occlusion_culling = false;
+
+	// largest screen space error, in pixels, a mesh level of detail may show
+	float lod_threshold = 1.0f;
+
+	// run compute passes on a dedicated compute family when the device has one
+	bool async_compute = true;
+
+	// GPU particle capacity, the particle system is off when 0
+	uint32_t particle_count = 0;
+
+	// sleep while the window is idle instead of rendering unchanged frames
+	bool idle_wait = true;
+
+	// delay frame starts so input is sampled just in time and at most one frame queues for the display
+	bool low_latency = false;
+
+	// --- textures ---
+
+	// KTX2 files streamed by the texture streamer and shown in the Textures window
+	std::vector<std::string> textures;
+
+	// device memory the resident texture mips may use, in MiB
+	uint32_t texture_budget_mb = 256;
+
+	// --- frame capture ---
+
+	// directory captured frames are written to, capture is off when empty
+	std::string capture_dir;
+
+	// directory with golden .raw frames to compare captures against
+	std::string golden_dir;
+
+	// first captured frame, earlier frames warm up pipelines and caches
+	uint32_t capture_start = 3;
+
+	uint32_t capture_count = 1;
+
+	// largest per-channel difference that still counts as a matching pixel
+	uint32_t capture_tolerance = 2;
+
+	// fraction of pixels allowed to exceed the tolerance
+	float capture_max_mismatch = 0.0f;
+
+	// --- frame export ---
+
+	// Unix domain socket another process connects to for the rendered frames, export is off when empty
+	std::string export_socket;
+
+	// frames the consumer may hold before the engine drops frames instead of overwriting them
+	uint32_t export_slots = 3;
+};
+
+EngineOptions parse_options(int argc, char** argv);
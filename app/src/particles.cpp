@@ -0,0 +1,348 @@
+#include "pre-compiled-header.h"
+#include "particles.h"
+
+#include "vk_utils.h"
+#include "vk_pipeline.h"
+
+#include <glm/glm.hpp>
+
+namespace
+{
+	// matches struct Particle in particles.comp
+	struct GPUParticle
+	{
+		glm::vec4 position_life;
+		glm::vec4 velocity_seed;
+	};
+
+	// matches struct Counters in particles.comp
+	struct GPUParticleCounters
+	{
+		VkDrawIndirectCommand draw;
+		VkDispatchIndirectCommand dispatch;
+		uint32_t alive;
+	};
+
+	struct SimulateConstants
+	{
+		uint32_t capacity;
+		uint32_t emit_count;
+		uint32_t frame;
+		float dt;
+	};
+
+	enum SimulatePass : uint32_t
+	{
+		SIMULATE_PASS_SIMULATE = 0,
+		SIMULATE_PASS_EMIT,
+		SIMULATE_PASS_FINALIZE
+	};
+
+	constexpr uint32_t GROUP_SIZE = 256;
+
+	// particles live 1 to 3 seconds, emission replaces the ones that expire
+	constexpr float MEAN_LIFE = 2.0f;
+
+	// half height of a particle quad in clip space
+	constexpr float PARTICLE_SIZE = 0.004f;
+
+	void memory_barrier(VkCommandBuffer cmd, VkPipelineStageFlags2 src_stage, VkAccessFlags2 src_access, VkPipelineStageFlags2 dst_stage, VkAccessFlags2 dst_access)
+	{
+		VkMemoryBarrier2 barrier = {
+			.sType 		   = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+			.srcStageMask  = src_stage,
+			.srcAccessMask = src_access,
+			.dstStageMask  = dst_stage,
+			.dstAccessMask = dst_access
+		};
+
+		VkDependencyInfo dependency_info = {
+			.sType 				= VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+			.memoryBarrierCount = 1,
+			.pMemoryBarriers 	= &barrier
+		};
+
+		vkCmdPipelineBarrier2(cmd, &dependency_info);
+	}
+}
+
+/**
+ * @brief Allocate the particle buffers and create the simulate and render pipelines
+ * @param device The vulkan device
+ * @param allocator The vma allocator
+ * @param description Capacity, sharing queue families, the formats of the main pass and the layout cache
+ */
+void ParticleSystem::init(VkDevice device, VmaAllocator allocator, const ParticleSystemDescription& description)
+{
+	m_device = device;
+	m_allocator = allocator;
+	m_capacity = description.capacity;
+
+	// --- buffers ---
+
+	for(AllocatedBuffer& particles : m_particles)
+	{
+		particles = vkrsc::create_buffer(allocator, sizeof(GPUParticle) * m_capacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+										 VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, 0, description.queue_families);
+	}
+
+	m_counters = vkrsc::create_buffer(allocator, COUNTERS_STRIDE * SLOT_COUNT,
+									  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+									  VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE, 0, description.queue_families);
+
+	// --- layouts, reflected from the shaders ---
+
+	ShaderReflection compute_reflection;
+	ShaderReflection vertex_reflection;
+	ShaderReflection fragment_reflection;
+
+	VkShaderModule compute_shader = vkutil::load_shader_module(device, "assets/shaders/spirv/particles_comp.spv", &compute_reflection);
+	VkShaderModule vertex_shader = vkutil::load_shader_module(device, "assets/shaders/spirv/particles_vert.spv", &vertex_reflection);
+	VkShaderModule fragment_shader = vkutil::load_shader_module(device, "assets/shaders/spirv/particles_frag.spv", &fragment_reflection);
+
+	spirv::validate_push_constants(compute_reflection, sizeof(SimulateConstants), "particles.comp");
+	spirv::validate_push_constants(vertex_reflection, sizeof(glm::vec2), "particles.vert");
+
+	// source particles, destination particles, source counters, destination counters
+	m_simulate_layout = description.layouts->get({ &compute_reflection });
+	m_simulate_set_layout = description.layouts->get_set_layout(m_simulate_layout, 0);
+
+	// particles, read by the vertex shader
+	m_render_layout = description.layouts->get({ &vertex_reflection, &fragment_reflection });
+	m_render_set_layout = description.layouts->get_set_layout(m_render_layout, 0);
+
+	// --- descriptors ---
+
+	VkDescriptorPoolSize pool_size = {
+		.type 			 = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		.descriptorCount = SLOT_COUNT * 5
+	};
+
+	VkDescriptorPoolCreateInfo pool_info = {
+		.sType 		   = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.maxSets 	   = SLOT_COUNT * 2,
+		.poolSizeCount = 1,
+		.pPoolSizes    = &pool_size
+	};
+
+	VK_CHECK(vkCreateDescriptorPool(device, &pool_info, nullptr, &m_descriptor_pool));
+
+	for(uint32_t slot = 0; slot < SLOT_COUNT; slot++)
+	{
+		VkDescriptorSetLayout layouts[2] = { m_simulate_set_layout, m_render_set_layout };
+		VkDescriptorSet sets[2];
+
+		VkDescriptorSetAllocateInfo set_info = {
+			.sType 				= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+			.descriptorPool 	= m_descriptor_pool,
+			.descriptorSetCount = 2,
+			.pSetLayouts 		= layouts
+		};
+
+		VK_CHECK(vkAllocateDescriptorSets(device, &set_info, sets));
+		m_simulate_sets[slot] = sets[0];
+		m_render_sets[slot] = sets[1];
+
+		const uint32_t source = (slot + 1) % SLOT_COUNT;
+		VkDescriptorBufferInfo buffer_infos[4] = {
+			{ m_particles[source].buffer, 0, VK_WHOLE_SIZE },
+			{ m_particles[slot].buffer, 0, VK_WHOLE_SIZE },
+			{ m_counters.buffer, source * COUNTERS_STRIDE, sizeof(GPUParticleCounters) },
+			{ m_counters.buffer, slot * COUNTERS_STRIDE, sizeof(GPUParticleCounters) }
+		};
+
+		VkWriteDescriptorSet writes[5];
+		for(uint32_t binding = 0; binding < 4; binding++)
+		{
+			writes[binding] = {
+				.sType 			 = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				.dstSet 		 = m_simulate_sets[slot],
+				.dstBinding 	 = binding,
+				.descriptorCount = 1,
+				.descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				.pBufferInfo 	 = &buffer_infos[binding]
+			};
+		}
+
+		// the render set of a slot reads what its simulate set wrote
+		writes[4] = {
+			.sType 			 = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet 		 = m_render_sets[slot],
+			.dstBinding 	 = 0,
+			.descriptorCount = 1,
+			.descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.pBufferInfo 	 = &buffer_infos[1]
+		};
+
+		vkUpdateDescriptorSets(device, 5, writes, 0, nullptr);
+	}
+
+	// --- simulate pipelines, one per pass of the same shader ---
+
+	for(uint32_t pass = 0; pass < m_simulate_pipelines.size(); pass++)
+	{
+		VkSpecializationMapEntry pass_entry = {
+			.constantID = 0,
+			.offset 	= 0,
+			.size 		= sizeof(uint32_t)
+		};
+
+		VkSpecializationInfo specialization = {
+			.mapEntryCount = 1,
+			.pMapEntries   = &pass_entry,
+			.dataSize 	   = sizeof(uint32_t),
+			.pData 		   = &pass
+		};
+
+		m_simulate_pipelines[pass] = vkpipe::create_compute_pipeline(device, compute_shader, m_simulate_layout, &specialization);
+	}
+
+	vkDestroyShaderModule(device, compute_shader, nullptr);
+
+	// --- render pipeline: instanced quads expanded in the vertex shader, no vertex input ---
+
+	GraphicsPipelineDescription render_description = {
+		.vertex_shader 	  = vertex_shader,
+		.fragment_shader  = fragment_shader,
+		.layout 		  = m_render_layout,
+		.color_format 	  = description.color_format,
+		.depth_format 	  = description.depth_format,
+		.samples 		  = description.samples,
+		.blend_attachment = {
+			.blendEnable 		 = VK_TRUE,
+			.srcColorBlendFactor = VK_BLEND_FACTOR_ONE,
+			.dstColorBlendFactor = VK_BLEND_FACTOR_ONE,
+			.colorBlendOp 		 = VK_BLEND_OP_ADD,
+			.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+			.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+			.alphaBlendOp 		 = VK_BLEND_OP_ADD,
+			.colorWriteMask 	 = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT
+		},
+		.dynamic_states   = description.dynamic_states
+	};
+
+	m_render_pipeline = vkpipe::create_graphics_pipeline(device, render_description);
+
+	vkDestroyShaderModule(device, render_description.vertex_shader, nullptr);
+	vkDestroyShaderModule(device, render_description.fragment_shader, nullptr);
+
+	std::cout << "particles: capacity " << m_capacity << " (" << (sizeof(GPUParticle) * m_capacity * SLOT_COUNT) / (1024 * 1024) << " MiB)" << '\n';
+}
+
+/**
+ * @brief Record the simulate, emit and finalize passes of a frame slot
+ *
+ * Reads the survivors of the other slot and writes this slot's particles
+ * and counters. The graphics work that last read this slot has completed
+ * (the scheduler waits for it), earlier compute work is ordered by the
+ * barrier at the start, as both run on the compute queue.
+ * @param cmd A command buffer of the compute queue
+ * @param slot The frame slot
+ */
+void ParticleSystem::record_simulation(VkCommandBuffer cmd, uint32_t slot)
+{
+	const uint32_t source = (slot + 1) % SLOT_COUNT;
+
+	auto now = std::chrono::steady_clock::now();
+	float dt = m_frame == 0 ? 1.0f / 60.0f : std::chrono::duration<float>(now - m_last_simulation).count();
+	dt = std::min(dt, 0.05f);
+	m_last_simulation = now;
+
+	if(!m_counters_cleared)
+	{
+		vkCmdFillBuffer(cmd, m_counters.buffer, 0, VK_WHOLE_SIZE, 0);
+		m_counters_cleared = true;
+	}
+
+	// the previous finalize wrote the source counters, the destination ones were written two frames ago
+	memory_barrier(cmd,
+		VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_CLEAR_BIT,
+		VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT,
+		VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_CLEAR_BIT,
+		VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_TRANSFER_WRITE_BIT);
+
+	// the destination count is the append cursor of simulate and emit
+	vkCmdFillBuffer(cmd, m_counters.buffer, slot * COUNTERS_STRIDE + offsetof(VkDrawIndirectCommand, instanceCount), sizeof(uint32_t), 0);
+
+	memory_barrier(cmd,
+		VK_PIPELINE_STAGE_2_CLEAR_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+		VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT);
+
+	SimulateConstants constants = {
+		.capacity 	= m_capacity,
+		.emit_count = std::min(m_capacity, static_cast<uint32_t>(std::ceil(m_capacity * m_emit_fraction * dt / MEAN_LIFE))),
+		.frame 		= m_frame++,
+		.dt 		= dt
+	};
+
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_simulate_layout, 0, 1, &m_simulate_sets[slot], 0, nullptr);
+	vkCmdPushConstants(cmd, m_simulate_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(SimulateConstants), &constants);
+
+	// one thread per survivor of the previous frame
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_simulate_pipelines[SIMULATE_PASS_SIMULATE]);
+	vkCmdDispatchIndirect(cmd, m_counters.buffer, source * COUNTERS_STRIDE + offsetof(GPUParticleCounters, dispatch));
+
+	memory_barrier(cmd,
+		VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT,
+		VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT);
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_simulate_pipelines[SIMULATE_PASS_EMIT]);
+	vkCmdDispatch(cmd, (constants.emit_count + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+
+	memory_barrier(cmd,
+		VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_WRITE_BIT,
+		VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_READ_BIT | VK_ACCESS_2_SHADER_WRITE_BIT);
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_simulate_pipelines[SIMULATE_PASS_FINALIZE]);
+	vkCmdDispatch(cmd, 1, 1, 1);
+}
+
+/**
+ * @brief Draw the live particles of a frame slot as instanced quads
+ * @param recorder The recorder of the main color pass
+ * @param slot The frame slot whose simulation this frame waited for
+ * @param extent The render area, keeps the quads square
+ */
+void ParticleSystem::record_draw(CommandRecorder& recorder, uint32_t slot, VkExtent2D extent)
+{
+	recorder.bind_pipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, m_render_pipeline);
+
+	// tested against the scene, not written: additive particles are order independent
+	RasterState particle_state = {
+		.depth_test 	= VK_TRUE,
+		.depth_write 	= VK_FALSE,
+		.depth_compare 	= VK_COMPARE_OP_GREATER_OR_EQUAL,
+		.blend_enable 	= VK_TRUE,
+		.blend_equation = {
+			.srcColorBlendFactor = VK_BLEND_FACTOR_ONE,
+			.dstColorBlendFactor = VK_BLEND_FACTOR_ONE,
+			.colorBlendOp 		 = VK_BLEND_OP_ADD,
+			.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+			.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+			.alphaBlendOp 		 = VK_BLEND_OP_ADD
+		}
+	};
+	recorder.set_raster_state(particle_state);
+
+	recorder.bind_descriptor_set(VK_PIPELINE_BIND_POINT_GRAPHICS, m_render_layout, 0, m_render_sets[slot]);
+
+	glm::vec2 half_size = glm::vec2(PARTICLE_SIZE * extent.height / extent.width, PARTICLE_SIZE);
+	recorder.push_constants(m_render_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::vec2), &half_size);
+
+	// instance count is the live count finalize wrote
+	recorder.draw_indirect(m_counters.buffer, slot * COUNTERS_STRIDE, 1, sizeof(VkDrawIndirectCommand));
+}
+
+void ParticleSystem::destroy()
+{
+	vkDestroyPipeline(m_device, m_render_pipeline, nullptr);
+	for(VkPipeline pipeline : m_simulate_pipelines)
+		vkDestroyPipeline(m_device, pipeline, nullptr);
+
+	// the layouts belong to the layout cache
+	vkDestroyDescriptorPool(m_device, m_descriptor_pool, nullptr);
+
+	vmaDestroyBuffer(m_allocator, m_counters.buffer, m_counters.allocation);
+	for(AllocatedBuffer& particles : m_particles)
+		vmaDestroyBuffer(m_allocator, particles.buffer, particles.allocation);
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "vk_defines.h"
+#include "vk_resources.h"
+#include "vk_commands.h"
+#include "vk_pipeline.h"
+
+#include <array>
+#include <chrono>
+#include <vector>
+
+struct ParticleSystemDescription
+{
+	// maximum live particles, memory is allocated for all of them up front
+	uint32_t capacity = 0;
+
+	// queue families sharing the particle buffers
+	std::vector<uint32_t> queue_families;
+
+	VkFormat color_format = VK_FORMAT_UNDEFINED;
+
+	VkFormat depth_format = VK_FORMAT_UNDEFINED;
+
+	VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+
+	std::vector<VkDynamicState> dynamic_states;
+
+	// creates and owns the pipeline and set layouts
+	PipelineLayoutCache* layouts = nullptr;
+};
+
+/**
+ * GPU particle system: emission, simulation and compaction run in compute
+ * passes, the CPU never touches particle data. Each frame slot owns one
+ * particle buffer and one counters block; the compute passes of a slot read
+ * the survivors of the other slot, append the live ones and the new ones to
+ * their own buffer, and write the indirect draw and dispatch arguments, so
+ * drawing millions of instanced quads needs no readback.
+ */
+class ParticleSystem
+{
+public:
+
+	void init(VkDevice device, VmaAllocator allocator, const ParticleSystemDescription& description);
+
+	inline bool is_enabled() const { return m_capacity > 0; }
+
+	// compute pass, registered with the ComputeScheduler
+	void record_simulation(VkCommandBuffer cmd, uint32_t slot);
+
+	// render thread: the live count settles at this fraction of the capacity, for shedding load
+	inline void set_emit_fraction(float fraction) { m_emit_fraction = fraction; }
+
+	// inside the main color pass, viewport and scissor are already set
+	void record_draw(CommandRecorder& recorder, uint32_t slot, VkExtent2D extent);
+
+	void destroy();
+
+private:
+
+	static constexpr uint32_t SLOT_COUNT = 2;
+
+	// counters blocks are storage buffer ranges, aligned for any minStorageBufferOffsetAlignment
+	static constexpr VkDeviceSize COUNTERS_STRIDE = 256;
+
+	VkDevice m_device = VK_NULL_HANDLE;
+
+	VmaAllocator m_allocator = VK_NULL_HANDLE;
+
+	uint32_t m_capacity = 0;
+
+	std::array<AllocatedBuffer, SLOT_COUNT> m_particles {};
+
+	AllocatedBuffer m_counters {};
+
+	VkDescriptorPool m_descriptor_pool = VK_NULL_HANDLE;
+
+	// owned by the layout cache, as are the pipeline layouts
+	VkDescriptorSetLayout m_simulate_set_layout = VK_NULL_HANDLE;
+
+	VkDescriptorSetLayout m_render_set_layout = VK_NULL_HANDLE;
+
+	std::array<VkDescriptorSet, SLOT_COUNT> m_simulate_sets {};
+
+	std::array<VkDescriptorSet, SLOT_COUNT> m_render_sets {};
+
+	VkPipelineLayout m_simulate_layout = VK_NULL_HANDLE;
+
+	VkPipelineLayout m_render_layout = VK_NULL_HANDLE;
+
+	// simulate, emit, finalize
+	std::array<VkPipeline, 3> m_simulate_pipelines {};
+
+	VkPipeline m_render_pipeline = VK_NULL_HANDLE;
+
+	// --- simulation clock, advanced on the render thread ---
+
+	bool m_counters_cleared = false;
+
+	uint32_t m_frame = 0;
+
+	float m_emit_fraction = 1.0f;
+
+	std::chrono::steady_clock::time_point m_last_simulation;
+};
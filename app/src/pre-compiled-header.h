@@ -5,9 +5,12 @@
 #include <algorithm>
 #include <functional>
 #include <string>
+#include <cstring>
 #include <optional>
 #include <fstream>
 #include <chrono>
+#include <filesystem>
+#include <cmath>
 
 // Containers
 #include <unordered_map>
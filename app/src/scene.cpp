@@ -0,0 +1,249 @@
+#include "pre-compiled-header.h"
+#include "scene.h"
+
+#include "jobs.h"
+
+namespace
+{
+	// objects per parallel task, a multiple of every SIMD width
+	constexpr size_t SCENE_CHUNK_SIZE = 16384;
+
+	template<typename T>
+	void swap_remove(std::vector<T>& values, size_t index)
+	{
+		values[index] = values.back();
+		values.pop_back();
+	}
+
+	FrustumPlanes extract_frustum(const glm::mat4& m)
+	{
+		// rows of the (column-major) view-projection matrix
+		glm::vec4 r0 = glm::vec4(m[0][0], m[1][0], m[2][0], m[3][0]);
+		glm::vec4 r1 = glm::vec4(m[0][1], m[1][1], m[2][1], m[3][1]);
+		glm::vec4 r2 = glm::vec4(m[0][2], m[1][2], m[2][2], m[3][2]);
+		glm::vec4 r3 = glm::vec4(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+		// vulkan clip volume: -w <= x, y <= w and 0 <= z <= w
+		const glm::vec4 planes[6] = { r3 + r0, r3 - r0, r3 + r1, r3 - r1, r2, r3 - r2 };
+
+		FrustumPlanes frustum;
+		for(int i = 0; i < 6; i++)
+		{
+			// an infinite reverse-Z projection yields a plane without normal, keep it as "always inside"
+			float length = glm::length(glm::vec3(planes[i]));
+			glm::vec4 plane = length > 0.0f ? planes[i] / length : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+
+			frustum.planes[i][0] = plane.x;
+			frustum.planes[i][1] = plane.y;
+			frustum.planes[i][2] = plane.z;
+			frustum.planes[i][3] = plane.w;
+		}
+
+		return frustum;
+	}
+
+	LodView make_lod_view(const glm::mat4& m, const LodSettings& settings)
+	{
+		LodView view;
+		for(int column = 0; column < 4; column++)
+			view.w_row[column] = m[column][3];
+
+		// NDC spans 2 units over the viewport height; the y row scales world units into clip space
+		glm::vec3 y_row = glm::vec3(m[0][1], m[1][1], m[2][1]);
+		view.pixels_per_unit = glm::length(y_row) * settings.viewport_height * 0.5f;
+
+		view.threshold = settings.threshold;
+		view.coarsen_threshold = settings.threshold * (1.0f - settings.hysteresis);
+		return view;
+	}
+}
+
+void SceneArrays::resize(size_t count)
+{
+	for(auto* values : {
+		&position_x, &position_y, &position_z,
+		&rotation_x, &rotation_y, &rotation_z, &rotation_w, &scale,
+		&bounds_center_x, &bounds_center_y, &bounds_center_z,
+		&bounds_extent_x, &bounds_extent_y, &bounds_extent_z,
+		&world_center_x, &world_center_y, &world_center_z,
+		&world_extent_x, &world_extent_y, &world_extent_z })
+	{
+		values->resize(count);
+	}
+
+	for(auto& values : world)
+		values.resize(count);
+
+	mesh.resize(count);
+	pipeline.resize(count);
+	lod.resize(count);
+}
+
+/**
+ * @brief Add an object, it is appended to the dense arrays
+ * @param description Transform, bounds and render handles of the object
+ */
+SceneHandle Scene::create(const SceneObjectDescription& description)
+{
+	uint32_t handle_index;
+	if(!m_free_handles.empty())
+	{
+		handle_index = m_free_handles.back();
+		m_free_handles.pop_back();
+	}
+	else
+	{
+		handle_index = static_cast<uint32_t>(m_handle_to_dense.size());
+		m_handle_to_dense.push_back(0);
+		m_generations.push_back(0);
+	}
+
+	uint32_t dense = static_cast<uint32_t>(m_dense_to_handle.size());
+	m_handle_to_dense[handle_index] = dense;
+	m_dense_to_handle.push_back(handle_index);
+
+	m_arrays.resize(dense + 1);
+	m_arrays.position_x[dense] = description.position.x;
+	m_arrays.position_y[dense] = description.position.y;
+	m_arrays.position_z[dense] = description.position.z;
+	m_arrays.rotation_x[dense] = description.rotation.x;
+	m_arrays.rotation_y[dense] = description.rotation.y;
+	m_arrays.rotation_z[dense] = description.rotation.z;
+	m_arrays.rotation_w[dense] = description.rotation.w;
+	m_arrays.scale[dense] = description.scale;
+	m_arrays.bounds_center_x[dense] = description.bounds_center.x;
+	m_arrays.bounds_center_y[dense] = description.bounds_center.y;
+	m_arrays.bounds_center_z[dense] = description.bounds_center.z;
+	m_arrays.bounds_extent_x[dense] = description.bounds_extent.x;
+	m_arrays.bounds_extent_y[dense] = description.bounds_extent.y;
+	m_arrays.bounds_extent_z[dense] = description.bounds_extent.z;
+	m_arrays.mesh[dense] = description.mesh;
+	m_arrays.pipeline[dense] = description.pipeline;
+	m_arrays.lod[dense] = 0;
+
+	return { handle_index, m_generations[handle_index] };
+}
+
+/**
+ * @brief Remove an object, the last object is moved into its slot to keep the arrays dense
+ * @param handle The object to remove
+ */
+void Scene::destroy(SceneHandle handle)
+{
+	uint32_t dense = dense_index(handle);
+	uint32_t last = static_cast<uint32_t>(m_dense_to_handle.size() - 1);
+
+	SceneArrays& a = m_arrays;
+	for(auto* values : {
+		&a.position_x, &a.position_y, &a.position_z,
+		&a.rotation_x, &a.rotation_y, &a.rotation_z, &a.rotation_w, &a.scale,
+		&a.bounds_center_x, &a.bounds_center_y, &a.bounds_center_z,
+		&a.bounds_extent_x, &a.bounds_extent_y, &a.bounds_extent_z,
+		&a.world_center_x, &a.world_center_y, &a.world_center_z,
+		&a.world_extent_x, &a.world_extent_y, &a.world_extent_z })
+	{
+		swap_remove(*values, dense);
+	}
+	for(auto& values : a.world)
+		swap_remove(values, dense);
+	swap_remove(a.mesh, dense);
+	swap_remove(a.pipeline, dense);
+	swap_remove(a.lod, dense);
+
+	uint32_t moved_handle = m_dense_to_handle[last];
+	m_dense_to_handle[dense] = moved_handle;
+	m_handle_to_dense[moved_handle] = dense;
+	m_dense_to_handle.pop_back();
+
+	m_generations[handle.index]++;
+	m_free_handles.push_back(handle.index);
+}
+
+bool Scene::is_valid(SceneHandle handle) const
+{
+	return handle.index < m_generations.size() && m_generations[handle.index] == handle.generation;
+}
+
+void Scene::set_position(SceneHandle handle, const glm::vec3& position)
+{
+	uint32_t dense = dense_index(handle);
+	m_arrays.position_x[dense] = position.x;
+	m_arrays.position_y[dense] = position.y;
+	m_arrays.position_z[dense] = position.z;
+}
+
+void Scene::set_rotation(SceneHandle handle, const glm::quat& rotation)
+{
+	uint32_t dense = dense_index(handle);
+	m_arrays.rotation_x[dense] = rotation.x;
+	m_arrays.rotation_y[dense] = rotation.y;
+	m_arrays.rotation_z[dense] = rotation.z;
+	m_arrays.rotation_w[dense] = rotation.w;
+}
+
+/**
+ * @brief Register the LOD chain of a mesh
+ * @param mesh Mesh id, as used in SceneObjectDescription
+ * @param errors Object space error of each level, finest first
+ */
+void Scene::set_mesh_lods(uint16_t mesh, const std::vector<float>& errors)
+{
+	if(m_mesh_lod_errors.size() <= mesh)
+		m_mesh_lod_errors.resize(mesh + 1);
+
+	m_mesh_lod_errors[mesh] = errors;
+}
+
+/**
+ * @brief Run the transform and cull kernels over all objects in parallel chunks
+ * @param view_projection Camera matrix the frustum is extracted from
+ * @param jobs The job system the chunks run on
+ */
+void Scene::update(const glm::mat4& view_projection, JobSystem& jobs)
+{
+	const size_t count = size();
+	const FrustumPlanes frustum = extract_frustum(view_projection);
+	const LodView lod_view = make_lod_view(view_projection, m_lod_settings);
+	const bool select_lod = m_lod_settings.viewport_height > 0.0f && !m_mesh_lod_errors.empty();
+
+	// sized for every object up front, so a camera move that shows more of the scene does not allocate
+	size_t chunk_count = (count + SCENE_CHUNK_SIZE - 1) / SCENE_CHUNK_SIZE;
+	if(m_chunk_visible.size() != chunk_count)
+	{
+		m_chunk_visible.resize(chunk_count);
+		for(auto& chunk_visible : m_chunk_visible)
+			chunk_visible.reserve(SCENE_CHUNK_SIZE);
+	}
+	m_visible.reserve(count);
+
+	jobs.parallel_for(static_cast<uint32_t>(chunk_count), 1, [this, &frustum, &lod_view, select_lod, count](uint32_t first_chunk, uint32_t last_chunk)
+	{
+		for(uint32_t chunk = first_chunk; chunk < last_chunk; chunk++)
+		{
+			size_t begin = chunk * SCENE_CHUNK_SIZE;
+			size_t end = std::min(begin + SCENE_CHUNK_SIZE, count);
+
+			scenekernels::update_world(m_arrays, begin, end);
+
+			m_chunk_visible[chunk].clear();
+			scenekernels::cull(m_arrays, frustum, begin, end, m_chunk_visible[chunk]);
+
+			// only visible objects change level, hidden ones keep theirs until they show up again
+			if(select_lod)
+				scenekernels::select_lod(m_arrays, lod_view, m_mesh_lod_errors, m_chunk_visible[chunk]);
+		}
+	});
+
+	// compact the per-chunk results, chunks are in order so the list stays sorted
+	m_visible.clear();
+	for(const auto& chunk_visible : m_chunk_visible)
+		m_visible.insert(m_visible.end(), chunk_visible.begin(), chunk_visible.end());
+}
+
+uint32_t Scene::dense_index(SceneHandle handle) const
+{
+	if(!is_valid(handle))
+		throw std::runtime_error("Invalid scene handle");
+
+	return m_handle_to_dense[handle.index];
+}
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstdint>
+#include <vector>
+#include <array>
+
+class JobSystem;
+
+// Stable reference to a scene object; stays valid while objects are
+// added and removed, the generation detects use after destroy.
+struct SceneHandle
+{
+	uint32_t index = UINT32_MAX;
+
+	uint32_t generation = 0;
+};
+
+struct SceneObjectDescription
+{
+	glm::vec3 position = glm::vec3(0.0f);
+
+	glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+
+	float scale = 1.0f;
+
+	// local space AABB
+	glm::vec3 bounds_center = glm::vec3(0.0f);
+
+	glm::vec3 bounds_extent = glm::vec3(0.0f);
+
+	uint16_t mesh = 0;
+
+	uint16_t pipeline = 0;
+};
+
+// Structure-of-arrays storage, every array is indexed by the dense object index
+struct SceneArrays
+{
+	// --- local transform ---
+	std::vector<float> position_x, position_y, position_z;
+	std::vector<float> rotation_x, rotation_y, rotation_z, rotation_w;
+	std::vector<float> scale;
+
+	// --- local bounds ---
+	std::vector<float> bounds_center_x, bounds_center_y, bounds_center_z;
+	std::vector<float> bounds_extent_x, bounds_extent_y, bounds_extent_z;
+
+	// --- outputs of the transform kernel ---
+	// world matrix as 3x4 rows: m00 m01 m02 m03 m10 ... m23
+	std::array<std::vector<float>, 12> world;
+	std::vector<float> world_center_x, world_center_y, world_center_z;
+	std::vector<float> world_extent_x, world_extent_y, world_extent_z;
+
+	// --- render handles ---
+	std::vector<uint16_t> mesh;
+	std::vector<uint16_t> pipeline;
+
+	// level of detail picked by the last update, kept for hysteresis
+	std::vector<uint8_t> lod;
+
+	void resize(size_t count);
+};
+
+// Frustum as six inward-facing planes (nx, ny, nz, d): inside when n.p + d >= 0
+struct FrustumPlanes
+{
+	float planes[6][4];
+};
+
+// Screen space error budget of the LOD selection
+struct LodSettings
+{
+	// height of the viewport the scene is rendered to, in pixels
+	float viewport_height = 0.0f;
+
+	// largest projected error a level may have, in pixels
+	float threshold = 1.0f;
+
+	// a coarser level must be this fraction below the threshold before it is picked, avoids popping back and forth
+	float hysteresis = 0.25f;
+};
+
+// Camera terms the LOD kernel projects errors with, derived from the view-projection matrix
+struct LodView
+{
+	// clip space w of a point: dot(w_row, (p, 1))
+	float w_row[4];
+
+	// pixels covered by one world unit at w = 1
+	float pixels_per_unit;
+
+	float threshold;
+
+	float coarsen_threshold;
+};
+
+namespace scenekernels
+{
+
+	void update_world(SceneArrays& arrays, size_t begin, size_t end);
+
+	void cull(const SceneArrays& arrays, const FrustumPlanes& frustum, size_t begin, size_t end, std::vector<uint32_t>& visible);
+
+	// mesh_errors[mesh] holds the object space error of each level of the mesh, finest first
+	void select_lod(SceneArrays& arrays, const LodView& view, const std::vector<std::vector<float>>& mesh_errors, const std::vector<uint32_t>& visible);
+
+	const char* isa_name();
+
+};
+
+class Scene
+{
+public:
+
+	SceneHandle create(const SceneObjectDescription& description);
+
+	void destroy(SceneHandle handle);
+
+	bool is_valid(SceneHandle handle) const;
+
+	void set_position(SceneHandle handle, const glm::vec3& position);
+
+	void set_rotation(SceneHandle handle, const glm::quat& rotation);
+
+	// errors of the LOD chain of a mesh, finest first; meshes without a chain always draw level 0
+	void set_mesh_lods(uint16_t mesh, const std::vector<float>& errors);
+
+	inline void set_lod_settings(const LodSettings& settings) { m_lod_settings = settings; }
+
+	// transform and cull every object on the job system, the visible list is rebuilt
+	void update(const glm::mat4& view_projection, JobSystem& jobs);
+
+	inline size_t size() const { return m_dense_to_handle.size(); }
+
+	inline const SceneArrays& get_arrays() const { return m_arrays; }
+
+	// dense indices of the objects that passed culling in the last update
+	inline const std::vector<uint32_t>& get_visible() const { return m_visible; }
+
+	// index of the handle of a dense object, it stays with the object while others are destroyed
+	inline uint32_t get_handle_index(uint32_t dense) const { return m_dense_to_handle[dense]; }
+
+private:
+
+	uint32_t dense_index(SceneHandle handle) const;
+
+	SceneArrays m_arrays;
+
+	// handle index -> dense index and generation
+	std::vector<uint32_t> m_handle_to_dense;
+	std::vector<uint32_t> m_generations;
+	std::vector<uint32_t> m_free_handles;
+
+	// dense index -> handle index
+	std::vector<uint32_t> m_dense_to_handle;
+
+	std::vector<uint32_t> m_visible;
+
+	std::vector<std::vector<uint32_t>> m_chunk_visible;
+
+	std::vector<std::vector<float>> m_mesh_lod_errors;
+
+	LodSettings m_lod_settings;
+};
@@ -0,0 +1,177 @@
+#include "pre-compiled-header.h"
+#include "scene.h"
+
+#include "simd.h"
+
+namespace
+{
+	template<typename V>
+	inline void world_batch(SceneArrays& a, size_t i)
+	{
+		const V x = V::load(&a.rotation_x[i]);
+		const V y = V::load(&a.rotation_y[i]);
+		const V z = V::load(&a.rotation_z[i]);
+		const V w = V::load(&a.rotation_w[i]);
+		const V s = V::load(&a.scale[i]);
+
+		const V one = V::broadcast(1.0f);
+		const V two = V::broadcast(2.0f);
+
+		const V xx = x * x, yy = y * y, zz = z * z;
+		const V xy = x * y, xz = x * z, yz = y * z;
+		const V wx = w * x, wy = w * y, wz = w * z;
+
+		// scaled rotation matrix from the unit quaternion
+		const V m[3][3] = {
+			{ s * (one - two * (yy + zz)), s * (two * (xy - wz)), 		 s * (two * (xz + wy)) },
+			{ s * (two * (xy + wz)), 		s * (one - two * (xx + zz)), s * (two * (yz - wx)) },
+			{ s * (two * (xz - wy)), 		s * (two * (yz + wx)), 		 s * (one - two * (xx + yy)) }
+		};
+		const V t[3] = { V::load(&a.position_x[i]), V::load(&a.position_y[i]), V::load(&a.position_z[i]) };
+
+		for(int row = 0; row < 3; row++)
+		{
+			m[row][0].store(&a.world[row * 4 + 0][i]);
+			m[row][1].store(&a.world[row * 4 + 1][i]);
+			m[row][2].store(&a.world[row * 4 + 2][i]);
+			t[row].store(&a.world[row * 4 + 3][i]);
+		}
+
+		// world AABB: transformed center, extent through |M|
+		const V cx = V::load(&a.bounds_center_x[i]), cy = V::load(&a.bounds_center_y[i]), cz = V::load(&a.bounds_center_z[i]);
+		const V ex = V::load(&a.bounds_extent_x[i]), ey = V::load(&a.bounds_extent_y[i]), ez = V::load(&a.bounds_extent_z[i]);
+
+		float* world_center[3] = { &a.world_center_x[i], &a.world_center_y[i], &a.world_center_z[i] };
+		float* world_extent[3] = { &a.world_extent_x[i], &a.world_extent_y[i], &a.world_extent_z[i] };
+
+		for(int row = 0; row < 3; row++)
+		{
+			(m[row][0] * cx + m[row][1] * cy + m[row][2] * cz + t[row]).store(world_center[row]);
+			(abs(m[row][0]) * ex + abs(m[row][1]) * ey + abs(m[row][2]) * ez).store(world_extent[row]);
+		}
+	}
+
+	// bit i set when object i + lane intersects the frustum
+	template<typename V>
+	inline uint32_t cull_batch(const SceneArrays& a, const FrustumPlanes& frustum, size_t i)
+	{
+		const V cx = V::load(&a.world_center_x[i]), cy = V::load(&a.world_center_y[i]), cz = V::load(&a.world_center_z[i]);
+		const V ex = V::load(&a.world_extent_x[i]), ey = V::load(&a.world_extent_y[i]), ez = V::load(&a.world_extent_z[i]);
+
+		uint32_t mask = (1u << V::width) - 1u;
+		for(const auto& plane : frustum.planes)
+		{
+			const V distance = V::broadcast(plane[0]) * cx + V::broadcast(plane[1]) * cy + V::broadcast(plane[2]) * cz + V::broadcast(plane[3]);
+			const V radius 	 = V::broadcast(std::fabs(plane[0])) * ex + V::broadcast(std::fabs(plane[1])) * ey + V::broadcast(std::fabs(plane[2])) * ez;
+
+			mask &= (distance + radius).non_negative_mask();
+		}
+
+		return mask;
+	}
+}
+
+/**
+ * @brief Compute world matrices and world bounds of objects [begin, end)
+ * @param arrays The scene arrays
+ * @param begin First dense index
+ * @param end One past the last dense index
+ */
+void scenekernels::update_world(SceneArrays& arrays, size_t begin, size_t end)
+{
+	using V = simd::FloatN;
+
+	size_t i = begin;
+	for(; i + V::width <= end; i += V::width)
+		world_batch<V>(arrays, i);
+	for(; i < end; i++)
+		world_batch<simd::Float1>(arrays, i);
+}
+
+/**
+ * @brief Test the world bounds of objects [begin, end) against a frustum
+ * @param arrays The scene arrays, world bounds must be up to date
+ * @param frustum The camera frustum
+ * @param begin First dense index
+ * @param end One past the last dense index
+ * @param visible Dense indices of the visible objects are appended, in order
+ */
+void scenekernels::cull(const SceneArrays& arrays, const FrustumPlanes& frustum, size_t begin, size_t end, std::vector<uint32_t>& visible)
+{
+	using V = simd::FloatN;
+
+	size_t i = begin;
+	for(; i + V::width <= end; i += V::width)
+	{
+		uint32_t mask = cull_batch<V>(arrays, frustum, i);
+		while(mask)
+		{
+			uint32_t lane = 0;
+			while(!(mask & (1u << lane)))
+				lane++;
+			mask &= mask - 1;
+			visible.push_back(static_cast<uint32_t>(i + lane));
+		}
+	}
+	for(; i < end; i++)
+		if(cull_batch<simd::Float1>(arrays, frustum, i))
+			visible.push_back(static_cast<uint32_t>(i));
+}
+
+/**
+ * @brief Pick the level of detail of visible objects from their projected error
+ *
+ * The error of a level is projected at the nearest w of the object's world
+ * bounds. An object moves to a finer level as soon as its level exceeds
+ * the threshold, but to a coarser one only when that level stays below
+ * the lower hysteresis threshold, so objects near the boundary do not
+ * alternate between levels every frame.
+ * @param arrays The scene arrays, world bounds must be up to date
+ * @param view Projection terms and thresholds
+ * @param mesh_errors Per mesh, the error of each level, finest first
+ * @param visible Dense indices of the objects to update
+ */
+void scenekernels::select_lod(SceneArrays& arrays, const LodView& view, const std::vector<std::vector<float>>& mesh_errors, const std::vector<uint32_t>& visible)
+{
+	// below this the camera is inside or at the bounds and the finest level is used
+	constexpr float MIN_W = 1e-4f;
+
+	for(uint32_t i : visible)
+	{
+		uint16_t mesh = arrays.mesh[i];
+		if(mesh >= mesh_errors.size() || mesh_errors[mesh].size() < 2)
+		{
+			arrays.lod[i] = 0;
+			continue;
+		}
+		const std::vector<float>& errors = mesh_errors[mesh];
+
+		float w = view.w_row[0] * arrays.world_center_x[i] + view.w_row[1] * arrays.world_center_y[i] + view.w_row[2] * arrays.world_center_z[i] + view.w_row[3];
+		float radius = std::fabs(view.w_row[0]) * arrays.world_extent_x[i] + std::fabs(view.w_row[1]) * arrays.world_extent_y[i] + std::fabs(view.w_row[2]) * arrays.world_extent_z[i];
+
+		float nearest_w = w - radius;
+		if(nearest_w < MIN_W)
+		{
+			arrays.lod[i] = 0;
+			continue;
+		}
+
+		// object space error -> pixels
+		float scale = view.pixels_per_unit * arrays.scale[i] / nearest_w;
+
+		const uint32_t last = static_cast<uint32_t>(std::min<size_t>(errors.size(), UINT8_MAX + 1) - 1);
+		uint32_t level = std::min<uint32_t>(arrays.lod[i], last);
+
+		while(level > 0 && errors[level] * scale > view.threshold)
+			level--;
+		while(level < last && errors[level + 1] * scale < view.coarsen_threshold)
+			level++;
+
+		arrays.lod[i] = static_cast<uint8_t>(level);
+	}
+}
+
+const char* scenekernels::isa_name()
+{
+	return simd::isa_name();
+}
@@ -0,0 +1,492 @@
+#include "pre-compiled-header.h"
+#include "shader_reflection.h"
+
+namespace
+{
+	constexpr uint32_t MAGIC = 0x07230203;
+
+	constexpr uint32_t HEADER_WORDS = 5;
+
+	enum Op : uint32_t
+	{
+		OP_ENTRY_POINT 					= 15,
+		OP_TYPE_BOOL 					= 20,
+		OP_TYPE_INT 					= 21,
+		OP_TYPE_FLOAT 					= 22,
+		OP_TYPE_VECTOR 					= 23,
+		OP_TYPE_MATRIX 					= 24,
+		OP_TYPE_IMAGE 					= 25,
+		OP_TYPE_SAMPLER 				= 26,
+		OP_TYPE_SAMPLED_IMAGE 			= 27,
+		OP_TYPE_ARRAY 					= 28,
+		OP_TYPE_RUNTIME_ARRAY 			= 29,
+		OP_TYPE_STRUCT 					= 30,
+		OP_TYPE_POINTER 				= 32,
+		OP_CONSTANT 					= 43,
+		OP_SPEC_CONSTANT 				= 50,
+		OP_VARIABLE 					= 59,
+		OP_DECORATE 					= 71,
+		OP_MEMBER_DECORATE 				= 72,
+		OP_TYPE_ACCELERATION_STRUCTURE 	= 5341
+	};
+
+	enum Decoration : uint32_t
+	{
+		DECORATION_BLOCK 		  = 2,
+		DECORATION_BUFFER_BLOCK   = 3,
+		DECORATION_ARRAY_STRIDE   = 6,
+		DECORATION_MATRIX_STRIDE  = 7,
+		DECORATION_BUILT_IN 	  = 11,
+		DECORATION_LOCATION 	  = 30,
+		DECORATION_BINDING 		  = 33,
+		DECORATION_DESCRIPTOR_SET = 34,
+		DECORATION_OFFSET 		  = 35
+	};
+
+	enum StorageClass : uint32_t
+	{
+		STORAGE_CLASS_UNIFORM_CONSTANT = 0,
+		STORAGE_CLASS_INPUT 		   = 1,
+		STORAGE_CLASS_UNIFORM 		   = 2,
+		STORAGE_CLASS_PUSH_CONSTANT    = 9,
+		STORAGE_CLASS_STORAGE_BUFFER   = 12
+	};
+
+	constexpr uint32_t DIM_BUFFER = 5;
+
+	constexpr uint32_t DIM_SUBPASS_DATA = 6;
+
+	// OpTypeImage "sampled" operand: known to be used with a sampler, or as a storage image
+	constexpr uint32_t IMAGE_SAMPLED = 1;
+
+	constexpr uint32_t IMAGE_STORAGE = 2;
+
+	// what the reflection needs of one result id
+	struct Id
+	{
+		uint32_t opcode = 0;
+
+		// operands of the defining instruction, the result id included
+		std::vector<uint32_t> words;
+
+		uint32_t set = UINT32_MAX;
+
+		uint32_t binding = UINT32_MAX;
+
+		uint32_t location = UINT32_MAX;
+
+		uint32_t array_stride = 0;
+
+		bool built_in = false;
+
+		bool buffer_block = false;
+
+		std::vector<uint32_t> member_offsets;
+
+		std::vector<uint32_t> member_matrix_strides;
+	};
+
+	VkShaderStageFlagBits to_stage(uint32_t execution_model)
+	{
+		switch(execution_model)
+		{
+		case 0: return VK_SHADER_STAGE_VERTEX_BIT;
+		case 1: return VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT;
+		case 2: return VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT;
+		case 3: return VK_SHADER_STAGE_GEOMETRY_BIT;
+		case 4: return VK_SHADER_STAGE_FRAGMENT_BIT;
+		case 5: return VK_SHADER_STAGE_COMPUTE_BIT;
+		default:
+			throw std::runtime_error("SPIR-V: unsupported execution model " + std::to_string(execution_model));
+		}
+	}
+
+	class Module
+	{
+	public:
+
+		Module(const uint32_t* code, size_t word_count)
+		{
+			if(word_count < HEADER_WORDS || code[0] != MAGIC)
+				throw std::runtime_error("SPIR-V: bad magic number");
+
+			m_ids.resize(code[3]);
+
+			for(size_t offset = HEADER_WORDS; offset < word_count;)
+			{
+				uint32_t opcode = code[offset] & 0xffff;
+				uint32_t length = code[offset] >> 16;
+				if(length == 0 || offset + length > word_count)
+					throw std::runtime_error("SPIR-V: truncated instruction");
+
+				parse(opcode, code + offset + 1, length - 1);
+				offset += length;
+			}
+
+			if(!m_has_entry_point)
+				throw std::runtime_error("SPIR-V: no entry point");
+		}
+
+		ShaderReflection reflect() const
+		{
+			ShaderReflection reflection = { .stage = m_stage };
+
+			for(uint32_t variable : m_variables)
+			{
+				const Id& id = m_ids[variable];
+				uint32_t storage_class = id.words[2];
+				const Id& pointer = get(id.words[0]);
+				uint32_t pointee = pointer.words[2];
+
+				switch(storage_class)
+				{
+				case STORAGE_CLASS_UNIFORM_CONSTANT:
+				case STORAGE_CLASS_UNIFORM:
+				case STORAGE_CLASS_STORAGE_BUFFER:
+					reflection.bindings.push_back(reflect_binding(id, storage_class, pointee));
+					break;
+				case STORAGE_CLASS_PUSH_CONSTANT:
+					reflection.push_constant_size = std::max(reflection.push_constant_size, get_size(pointee, 0));
+					break;
+				case STORAGE_CLASS_INPUT:
+					if(m_stage == VK_SHADER_STAGE_VERTEX_BIT && !id.built_in && !get(pointee).built_in)
+						reflection.inputs.push_back({ .location = id.location, .format = get_input_format(id, pointee) });
+					break;
+				default:
+					break;
+				}
+			}
+
+			std::sort(reflection.bindings.begin(), reflection.bindings.end(), [](const ShaderBinding& a, const ShaderBinding& b)
+			{
+				return a.set != b.set ? a.set < b.set : a.binding < b.binding;
+			});
+
+			std::sort(reflection.inputs.begin(), reflection.inputs.end(), [](const ShaderInput& a, const ShaderInput& b)
+			{
+				return a.location < b.location;
+			});
+
+			return reflection;
+		}
+
+	private:
+
+		const Id& get(uint32_t id) const
+		{
+			if(id >= m_ids.size() || m_ids[id].opcode == 0)
+				throw std::runtime_error("SPIR-V: reference to undefined id " + std::to_string(id));
+			return m_ids[id];
+		}
+
+		Id& define(uint32_t id, uint32_t opcode, const uint32_t* operands, uint32_t count)
+		{
+			if(id >= m_ids.size())
+				throw std::runtime_error("SPIR-V: id out of bound");
+
+			Id& result = m_ids[id];
+			result.opcode = opcode;
+			result.words.assign(operands, operands + count);
+			return result;
+		}
+
+		void parse(uint32_t opcode, const uint32_t* operands, uint32_t count)
+		{
+			switch(opcode)
+			{
+			case OP_ENTRY_POINT:
+				// one entry point per module, the engine never packs several
+				m_stage = to_stage(operands[0]);
+				m_has_entry_point = true;
+				break;
+			case OP_TYPE_BOOL:
+			case OP_TYPE_INT:
+			case OP_TYPE_FLOAT:
+			case OP_TYPE_VECTOR:
+			case OP_TYPE_MATRIX:
+			case OP_TYPE_IMAGE:
+			case OP_TYPE_SAMPLER:
+			case OP_TYPE_SAMPLED_IMAGE:
+			case OP_TYPE_ARRAY:
+			case OP_TYPE_RUNTIME_ARRAY:
+			case OP_TYPE_STRUCT:
+			case OP_TYPE_POINTER:
+			case OP_TYPE_ACCELERATION_STRUCTURE:
+				define(operands[0], opcode, operands, count);
+				break;
+			case OP_CONSTANT:
+			case OP_SPEC_CONSTANT:
+				// array lengths, a specialization constant counts with its default value
+				define(operands[1], opcode, operands, count);
+				break;
+			case OP_VARIABLE:
+				define(operands[1], opcode, operands, count);
+				m_variables.push_back(operands[1]);
+				break;
+			case OP_DECORATE:
+				decorate(operands[0], operands[1], count > 2 ? operands[2] : 0);
+				break;
+			case OP_MEMBER_DECORATE:
+				decorate_member(operands[0], operands[1], operands[2], count > 3 ? operands[3] : 0);
+				break;
+			default:
+				break;
+			}
+		}
+
+		void decorate(uint32_t target, uint32_t decoration, uint32_t value)
+		{
+			if(target >= m_ids.size())
+				throw std::runtime_error("SPIR-V: decoration of an id out of bound");
+
+			// decorations precede the definitions, so they are stored before the id is defined
+			Id& id = m_ids[target];
+			switch(decoration)
+			{
+			case DECORATION_DESCRIPTOR_SET: id.set = value; break;
+			case DECORATION_BINDING: 		id.binding = value; break;
+			case DECORATION_LOCATION: 		id.location = value; break;
+			case DECORATION_ARRAY_STRIDE: 	id.array_stride = value; break;
+			case DECORATION_BUILT_IN: 		id.built_in = true; break;
+			case DECORATION_BUFFER_BLOCK: 	id.buffer_block = true; break;
+			default: break;
+			}
+		}
+
+		void decorate_member(uint32_t target, uint32_t member, uint32_t decoration, uint32_t value)
+		{
+			if(target >= m_ids.size())
+				throw std::runtime_error("SPIR-V: decoration of an id out of bound");
+
+			Id& id = m_ids[target];
+			if(id.member_offsets.size() <= member)
+			{
+				id.member_offsets.resize(member + 1, 0);
+				id.member_matrix_strides.resize(member + 1, 0);
+			}
+
+			if(decoration == DECORATION_OFFSET)
+				id.member_offsets[member] = value;
+			else if(decoration == DECORATION_MATRIX_STRIDE)
+				id.member_matrix_strides[member] = value;
+			else if(decoration == DECORATION_BUILT_IN)
+				id.built_in = true;
+		}
+
+		uint32_t get_array_length(const Id& array) const
+		{
+			const Id& length = get(array.words[2]);
+			if(length.opcode != OP_CONSTANT && length.opcode != OP_SPEC_CONSTANT)
+				throw std::runtime_error("SPIR-V: array length is not a constant");
+			return length.words[2];
+		}
+
+		// bytes of a block member as laid out by its offset and stride decorations
+		uint32_t get_size(uint32_t type, uint32_t matrix_stride) const
+		{
+			const Id& id = get(type);
+			switch(id.opcode)
+			{
+			case OP_TYPE_BOOL:
+				return 4;
+			case OP_TYPE_INT:
+			case OP_TYPE_FLOAT:
+				return id.words[1] / 8;
+			case OP_TYPE_VECTOR:
+				return id.words[2] * get_size(id.words[1], 0);
+			case OP_TYPE_MATRIX:
+				return id.words[2] * (matrix_stride > 0 ? matrix_stride : get_size(id.words[1], 0));
+			case OP_TYPE_ARRAY:
+				return get_array_length(id) * (id.array_stride > 0 ? id.array_stride : get_size(id.words[1], matrix_stride));
+			case OP_TYPE_RUNTIME_ARRAY:
+				return 0;
+			case OP_TYPE_POINTER:
+				return 8;
+			case OP_TYPE_STRUCT:
+			{
+				uint32_t size = 0;
+				for(uint32_t member = 0; member + 1 < id.words.size(); member++)
+				{
+					uint32_t offset = member < id.member_offsets.size() ? id.member_offsets[member] : 0;
+					uint32_t stride = member < id.member_matrix_strides.size() ? id.member_matrix_strides[member] : 0;
+					size = std::max(size, offset + get_size(id.words[member + 1], stride));
+				}
+				return size;
+			}
+			default:
+				throw std::runtime_error("SPIR-V: block member of unsupported type");
+			}
+		}
+
+		ShaderBinding reflect_binding(const Id& variable, uint32_t storage_class, uint32_t type) const
+		{
+			if(variable.set == UINT32_MAX || variable.binding == UINT32_MAX)
+				throw std::runtime_error("SPIR-V: resource without set or binding decoration");
+
+			ShaderBinding binding = {
+				.set 	 = variable.set,
+				.binding = variable.binding
+			};
+
+			// arrays of descriptors
+			const Id* id = &get(type);
+			while(id->opcode == OP_TYPE_ARRAY || id->opcode == OP_TYPE_RUNTIME_ARRAY)
+			{
+				if(id->opcode == OP_TYPE_RUNTIME_ARRAY)
+					throw std::runtime_error("SPIR-V: unbounded descriptor arrays are not supported");
+
+				binding.count *= get_array_length(*id);
+				id = &get(id->words[1]);
+			}
+
+			if(storage_class == STORAGE_CLASS_STORAGE_BUFFER)
+			{
+				binding.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+				return binding;
+			}
+
+			if(storage_class == STORAGE_CLASS_UNIFORM)
+			{
+				// std430 buffers of SPIR-V before 1.3 are BufferBlock uniforms
+				binding.type = id->buffer_block ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+				return binding;
+			}
+
+			switch(id->opcode)
+			{
+			case OP_TYPE_SAMPLER:
+				binding.type = VK_DESCRIPTOR_TYPE_SAMPLER;
+				break;
+			case OP_TYPE_SAMPLED_IMAGE:
+			{
+				const Id& image = get(id->words[1]);
+				binding.type = image.words[2] == DIM_BUFFER ? VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+				break;
+			}
+			case OP_TYPE_IMAGE:
+			{
+				uint32_t dim = id->words[2];
+				uint32_t sampled = id->words[6];
+				if(dim == DIM_SUBPASS_DATA)
+					binding.type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+				else if(sampled == IMAGE_STORAGE)
+					binding.type = dim == DIM_BUFFER ? VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+				else if(sampled == IMAGE_SAMPLED)
+					binding.type = dim == DIM_BUFFER ? VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+				else
+					throw std::runtime_error("SPIR-V: image of unknown usage");
+				break;
+			}
+			case OP_TYPE_ACCELERATION_STRUCTURE:
+				binding.type = VK_DESCRIPTOR_TYPE_ACCELERATION_STRUCTURE_KHR;
+				break;
+			default:
+				throw std::runtime_error("SPIR-V: uniform constant of unsupported type");
+			}
+
+			return binding;
+		}
+
+		VkFormat get_input_format(const Id& variable, uint32_t type) const
+		{
+			if(variable.location == UINT32_MAX)
+				throw std::runtime_error("SPIR-V: vertex input without location");
+
+			const Id* id = &get(type);
+			uint32_t components = 1;
+			if(id->opcode == OP_TYPE_VECTOR)
+			{
+				components = id->words[2];
+				id = &get(id->words[1]);
+			}
+
+			static constexpr VkFormat FLOAT_FORMATS[4] = { VK_FORMAT_R32_SFLOAT, VK_FORMAT_R32G32_SFLOAT, VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT };
+			static constexpr VkFormat SINT_FORMATS[4] = { VK_FORMAT_R32_SINT, VK_FORMAT_R32G32_SINT, VK_FORMAT_R32G32B32_SINT, VK_FORMAT_R32G32B32A32_SINT };
+			static constexpr VkFormat UINT_FORMATS[4] = { VK_FORMAT_R32_UINT, VK_FORMAT_R32G32_UINT, VK_FORMAT_R32G32B32_UINT, VK_FORMAT_R32G32B32A32_UINT };
+
+			// 32-bit scalars and vectors; matrices, arrays and 16/64-bit inputs span other formats or locations
+			if(components < 1 || components > 4 || (id->opcode != OP_TYPE_FLOAT && id->opcode != OP_TYPE_INT) || id->words[1] != 32)
+				throw std::runtime_error("SPIR-V: vertex input at location " + std::to_string(variable.location) + " has an unsupported type");
+
+			if(id->opcode == OP_TYPE_FLOAT)
+				return FLOAT_FORMATS[components - 1];
+			return id->words[2] ? SINT_FORMATS[components - 1] : UINT_FORMATS[components - 1];
+		}
+
+		std::vector<Id> m_ids;
+
+		std::vector<uint32_t> m_variables;
+
+		VkShaderStageFlagBits m_stage = VK_SHADER_STAGE_VERTEX_BIT;
+
+		bool m_has_entry_point = false;
+	};
+}
+
+/**
+ * @brief Read the descriptor bindings, push constant block and vertex inputs of a SPIR-V module
+ *
+ * Only the declarations are read, so a resource the entry point never
+ * uses is still part of the interface; the pipeline layout then covers it,
+ * which keeps pipelines built from the same shaders compatible.
+ * @param code The module, in words
+ * @param word_count Length of code
+ */
+ShaderReflection spirv::reflect(const uint32_t* code, size_t word_count)
+{
+	return Module(code, word_count).reflect();
+}
+
+/**
+ * @brief Check that the vertex attributes of a pipeline feed every input of its vertex shader
+ * @param vertex_shader Reflection of the vertex shader
+ * @param description The vertex input state the pipeline is created with
+ * @param name Shown in the error message
+ */
+void spirv::validate_vertex_input(const ShaderReflection& vertex_shader, const VertexInputDescription& description, const char* name)
+{
+	for(const ShaderInput& input : vertex_shader.inputs)
+	{
+		auto attribute = std::find_if(description.attributes.begin(), description.attributes.end(), [&input](const VkVertexInputAttributeDescription& attribute)
+		{
+			return attribute.location == input.location;
+		});
+
+		if(attribute == description.attributes.end())
+			throw std::runtime_error(std::string(name) + ": input location " + std::to_string(input.location) + " has no vertex attribute");
+
+		if(attribute->format != input.format)
+			throw std::runtime_error(std::string(name) + ": input location " + std::to_string(input.location) + " is format " + std::to_string(input.format)
+									 + ", the vertex attribute is format " + std::to_string(attribute->format));
+	}
+}
+
+void spirv::validate_push_constants(const ShaderReflection& shader, uint32_t size, const char* name)
+{
+	if(shader.push_constant_size != size)
+		throw std::runtime_error(std::string(name) + ": push constant block is " + std::to_string(shader.push_constant_size) + " bytes, "
+								 + std::to_string(size) + " are pushed; if the source matches, the SPIR-V is out of date, regenerate it with compile.bat");
+}
+
+/**
+ * @brief Check that a shader declares a descriptor the engine binds
+ *
+ * The SPIR-V is checked in next to its GLSL, a module compiled before the
+ * source changed still loads and would only fail deep inside layout creation.
+ * @param shader Reflection of the shader
+ * @param set Descriptor set the engine binds
+ * @param binding Binding in the set
+ * @param type Descriptor type the engine writes
+ * @param name Shown in the error message
+ */
+void spirv::validate_binding(const ShaderReflection& shader, uint32_t set, uint32_t binding, VkDescriptorType type, const char* name)
+{
+	auto declared = std::find_if(shader.bindings.begin(), shader.bindings.end(), [set, binding](const ShaderBinding& declared)
+	{
+		return declared.set == set && declared.binding == binding;
+	});
+
+	if(declared == shader.bindings.end() || declared->type != type)
+		throw std::runtime_error(std::string(name) + ": SPIR-V out of date, no descriptor of type " + std::to_string(type) + " at set " + std::to_string(set)
+								 + " binding " + std::to_string(binding) + "; regenerate it with compile.bat");
+}
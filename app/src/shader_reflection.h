@@ -0,0 +1,58 @@
+#pragma once
+
+#include "vk_defines.h"
+#include "vk_mesh.h"
+
+#include <cstdint>
+#include <vector>
+
+// One descriptor binding a shader declares
+struct ShaderBinding
+{
+	uint32_t set = 0;
+
+	uint32_t binding = 0;
+
+	VkDescriptorType type = VK_DESCRIPTOR_TYPE_MAX_ENUM;
+
+	// array length, 1 for a single descriptor
+	uint32_t count = 1;
+};
+
+// One user-defined input of a vertex shader, builtins are not listed
+struct ShaderInput
+{
+	uint32_t location = 0;
+
+	VkFormat format = VK_FORMAT_UNDEFINED;
+};
+
+// The interface of a SPIR-V module, read when the module is loaded
+struct ShaderReflection
+{
+	VkShaderStageFlagBits stage = VK_SHADER_STAGE_VERTEX_BIT;
+
+	// sorted by set, then binding
+	std::vector<ShaderBinding> bindings;
+
+	// bytes of the push constant block, 0 without one
+	uint32_t push_constant_size = 0;
+
+	// vertex shaders only, sorted by location
+	std::vector<ShaderInput> inputs;
+};
+
+namespace spirv
+{
+	// throws std::runtime_error when the code is not SPIR-V or uses a resource the engine cannot describe
+	ShaderReflection reflect(const uint32_t* code, size_t word_count);
+
+	// throws std::runtime_error when an input of the vertex shader has no attribute of the same location and format
+	void validate_vertex_input(const ShaderReflection& vertex_shader, const VertexInputDescription& description, const char* name);
+
+	// throws std::runtime_error when the push constant block of the shader is not size bytes, the size of the C++ struct pushed to it
+	void validate_push_constants(const ShaderReflection& shader, uint32_t size, const char* name);
+
+	// throws std::runtime_error when the shader declares no descriptor of type at set and binding, the checked-in SPIR-V is older than its source
+	void validate_binding(const ShaderReflection& shader, uint32_t set, uint32_t binding, VkDescriptorType type, const char* name);
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+// Minimal float vector types used by the batch kernels. Kernels are written
+// once as templates over one of these; the widest type the compiler targets
+// is picked at compile time (AVX2 with the PSEUDO3D_AVX2 CMake option, SSE2 otherwise).
+// Define SIMD_FORCE_SCALAR to test the scalar fallback.
+
+#include <cmath>
+#include <cstdint>
+
+#if !defined(SIMD_FORCE_SCALAR) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+	#define SIMD_SSE 1
+	#include <immintrin.h>
+#endif
+
+#if defined(SIMD_SSE) && defined(__AVX2__)
+	#define SIMD_AVX2 1
+#endif
+
+namespace simd
+{
+
+	struct Float1
+	{
+		static constexpr int width = 1;
+
+		float v;
+
+		static inline Float1 load(const float* p) { return { *p }; }
+		static inline Float1 broadcast(float x) { return { x }; }
+		inline void store(float* p) const { *p = v; }
+
+		// bit i set when lane i is >= 0
+		inline uint32_t non_negative_mask() const { return v >= 0.0f ? 1u : 0u; }
+
+		friend inline Float1 operator+(Float1 a, Float1 b) { return { a.v + b.v }; }
+		friend inline Float1 operator-(Float1 a, Float1 b) { return { a.v - b.v }; }
+		friend inline Float1 operator*(Float1 a, Float1 b) { return { a.v * b.v }; }
+		friend inline Float1 abs(Float1 a) { return { std::fabs(a.v) }; }
+		friend inline Float1 min(Float1 a, Float1 b) { return { a.v < b.v ? a.v : b.v }; }
+	};
+
+#if defined(SIMD_SSE)
+	struct Float4
+	{
+		static constexpr int width = 4;
+
+		__m128 v;
+
+		static inline Float4 load(const float* p) { return { _mm_loadu_ps(p) }; }
+		static inline Float4 broadcast(float x) { return { _mm_set1_ps(x) }; }
+		inline void store(float* p) const { _mm_storeu_ps(p, v); }
+
+		inline uint32_t non_negative_mask() const { return static_cast<uint32_t>(_mm_movemask_ps(_mm_cmpge_ps(v, _mm_setzero_ps()))); }
+
+		friend inline Float4 operator+(Float4 a, Float4 b) { return { _mm_add_ps(a.v, b.v) }; }
+		friend inline Float4 operator-(Float4 a, Float4 b) { return { _mm_sub_ps(a.v, b.v) }; }
+		friend inline Float4 operator*(Float4 a, Float4 b) { return { _mm_mul_ps(a.v, b.v) }; }
+		friend inline Float4 abs(Float4 a) { return { _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v) }; }
+		friend inline Float4 min(Float4 a, Float4 b) { return { _mm_min_ps(a.v, b.v) }; }
+	};
+#endif
+
+#if defined(SIMD_AVX2)
+	struct Float8
+	{
+		static constexpr int width = 8;
+
+		__m256 v;
+
+		static inline Float8 load(const float* p) { return { _mm256_loadu_ps(p) }; }
+		static inline Float8 broadcast(float x) { return { _mm256_set1_ps(x) }; }
+		inline void store(float* p) const { _mm256_storeu_ps(p, v); }
+
+		inline uint32_t non_negative_mask() const { return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(v, _mm256_setzero_ps(), _CMP_GE_OQ))); }
+
+		friend inline Float8 operator+(Float8 a, Float8 b) { return { _mm256_add_ps(a.v, b.v) }; }
+		friend inline Float8 operator-(Float8 a, Float8 b) { return { _mm256_sub_ps(a.v, b.v) }; }
+		friend inline Float8 operator*(Float8 a, Float8 b) { return { _mm256_mul_ps(a.v, b.v) }; }
+		friend inline Float8 abs(Float8 a) { return { _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v) }; }
+		friend inline Float8 min(Float8 a, Float8 b) { return { _mm256_min_ps(a.v, b.v) }; }
+	};
+#endif
+
+#if defined(SIMD_AVX2)
+	using FloatN = Float8;
+	inline const char* isa_name() { return "AVX2"; }
+#elif defined(SIMD_SSE)
+	using FloatN = Float4;
+	inline const char* isa_name() { return "SSE2"; }
+#else
+	using FloatN = Float1;
+	inline const char* isa_name() { return "scalar"; }
+#endif
+
+};
@@ -0,0 +1,90 @@
+#include "pre-compiled-header.h"
+#include "static_pass.h"
+
+/**
+ * @brief Allocate the secondary command buffers
+ * @param device The vulkan device
+ * @param pool A pool of the graphics family, used only by the render thread
+ * @param slot_count Frames in flight
+ * @param pass_count Render passes with static content per frame
+ */
+void StaticPassCache::init(VkDevice device, VkCommandPool pool, uint32_t slot_count, uint32_t pass_count)
+{
+	m_device = device;
+	m_pool = pool;
+	m_pass_count = pass_count;
+
+	std::vector<VkCommandBuffer> command_buffers(slot_count * pass_count);
+
+	VkCommandBufferAllocateInfo cmd_buffer_info = {
+		.sType 				= VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+		.commandPool 		= pool,
+		.level 				= VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+		.commandBufferCount = static_cast<uint32_t>(command_buffers.size()),
+	};
+
+	VK_CHECK(vkAllocateCommandBuffers(device, &cmd_buffer_info, command_buffers.data()));
+
+	m_entries.resize(command_buffers.size());
+	for(size_t i = 0; i < command_buffers.size(); i++)
+		m_entries[i].cmd = command_buffers[i];
+}
+
+/**
+ * @brief Get the secondary to execute in a pass of this frame
+ *
+ * The slot's previous frame must have completed, its secondary may be reset.
+ * @param slot Frame slot being recorded
+ * @param pass Index of the pass
+ * @param key Sums up everything the recording depends on besides the per-frame buffers
+ * @param rendering Attachment formats and samples of the pass
+ * @param record Records the pass content into the secondary, called only on a key change
+ */
+VkCommandBuffer StaticPassCache::get(uint32_t slot, uint32_t pass, uint64_t key, const VkCommandBufferInheritanceRenderingInfo& rendering, FunctionRef<void(VkCommandBuffer)> record)
+{
+	Entry& entry = m_entries[slot * m_pass_count + pass];
+	if(entry.valid && entry.key == key)
+	{
+		m_reused++;
+		return entry.cmd;
+	}
+
+	VkCommandBufferInheritanceInfo inheritance_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+		.pNext = &rendering
+	};
+
+	// executed by one frame at a time, no SIMULTANEOUS_USE
+	VkCommandBufferBeginInfo begin_info = {
+		.sType 			  = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.flags 			  = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+		.pInheritanceInfo = &inheritance_info
+	};
+
+	VK_CHECK(vkResetCommandBuffer(entry.cmd, 0));
+	VK_CHECK(vkBeginCommandBuffer(entry.cmd, &begin_info));
+	record(entry.cmd);
+	VK_CHECK(vkEndCommandBuffer(entry.cmd));
+
+	entry.valid = true;
+	entry.key = key;
+	m_recorded++;
+
+	return entry.cmd;
+}
+
+void StaticPassCache::invalidate()
+{
+	for(Entry& entry : m_entries)
+		entry.valid = false;
+}
+
+void StaticPassCache::destroy()
+{
+	std::vector<VkCommandBuffer> command_buffers;
+	for(const Entry& entry : m_entries)
+		command_buffers.push_back(entry.cmd);
+
+	vkFreeCommandBuffers(m_device, m_pool, static_cast<uint32_t>(command_buffers.size()), command_buffers.data());
+	m_entries.clear();
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "vk_defines.h"
+#include "fixed_containers.h"
+
+#include <vector>
+
+/**
+ * Secondary command buffers holding the static content of render passes,
+ * recorded once and executed again every frame. What changes per frame is
+ * read by the recorded commands from per-frame buffers, so a secondary
+ * stays valid until the structure it was recorded from changes; the caller
+ * sums that structure up in a key and the secondary is re-recorded only
+ * when the key differs. One secondary per pass and frame in flight: the
+ * per-frame buffers are bound by slot, and a re-recording never resets a
+ * buffer a pending frame still executes.
+ */
+class StaticPassCache
+{
+public:
+
+	void init(VkDevice device, VkCommandPool pool, uint32_t slot_count, uint32_t pass_count);
+
+	// secondary of pass in slot, re-recorded through record when key differs from the key it was recorded with
+	VkCommandBuffer get(uint32_t slot, uint32_t pass, uint64_t key, const VkCommandBufferInheritanceRenderingInfo& rendering, FunctionRef<void(VkCommandBuffer)> record);
+
+	// every secondary is recorded again on next use, after the swapchain or attachments changed
+	void invalidate();
+
+	void destroy();
+
+	inline uint64_t get_recorded_count() const { return m_recorded; }
+
+	inline uint64_t get_reused_count() const { return m_reused; }
+
+private:
+
+	struct Entry
+	{
+		VkCommandBuffer cmd = VK_NULL_HANDLE;
+
+		bool valid = false;
+
+		uint64_t key = 0;
+	};
+
+	VkDevice m_device = VK_NULL_HANDLE;
+
+	VkCommandPool m_pool = VK_NULL_HANDLE;
+
+	uint32_t m_pass_count = 0;
+
+	// slot major
+	std::vector<Entry> m_entries;
+
+	uint64_t m_recorded = 0;
+
+	uint64_t m_reused = 0;
+};
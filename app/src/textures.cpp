@@ -0,0 +1,541 @@
+#include "pre-compiled-header.h"
+#include "textures.h"
+#include "vk_utils.h"
+#include "fixed_containers.h"
+
+#include <imgui_impl_vulkan.h>
+
+#include <bit>
+
+namespace
+{
+	// satisfies the bufferOffset alignment of every format the streamer uploads (texel or block size, and 4)
+	constexpr VkDeviceSize STAGING_ALIGNMENT = 16;
+
+	constexpr size_t PAGE_SIZE = 4096;
+
+	inline VkExtent3D get_level_extent(const Ktx2Header& header, uint32_t level)
+	{
+		return { std::max(header.width >> level, 1u), std::max(header.height >> level, 1u), 1 };
+	}
+
+	inline VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+}
+
+/**
+ * @brief Create the sampler and the staging ring
+ * @param description Device, budget and staging sizes
+ */
+void TextureStreamer::init(const TextureStreamerDescription& description)
+{
+	m_description = description;
+
+	VkSamplerCreateInfo sampler_info = {
+		.sType 		  = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+		.magFilter 	  = VK_FILTER_LINEAR,
+		.minFilter 	  = VK_FILTER_LINEAR,
+		.mipmapMode   = VK_SAMPLER_MIPMAP_MODE_LINEAR,
+		.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+		.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+		.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+		.minLod 	  = 0.0f,
+		.maxLod 	  = VK_LOD_CLAMP_NONE
+	};
+
+	VK_CHECK(vkCreateSampler(description.device, &sampler_info, nullptr, &m_sampler));
+
+	m_staging.resize(description.slot_count);
+	for(StagingBuffer& staging : m_staging)
+	{
+		staging.buffer = vkrsc::create_buffer(description.allocator, description.staging_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_AUTO_PREFER_HOST, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+
+		void* mapped;
+		VK_CHECK(vmaMapMemory(description.allocator, staging.buffer.allocation, &mapped));
+		staging.mapped = static_cast<uint8_t*>(mapped);
+	}
+}
+
+/**
+ * @brief Start loading a texture
+ * @param path A KTX2 file
+ * @param jobs The job system, called from one of its workers
+ * @param counter Signaled when the file is mapped and validated
+ */
+TextureHandle TextureStreamer::request(const std::string& path, JobSystem& jobs, JobCounter& counter)
+{
+	TextureHandle handle = static_cast<TextureHandle>(m_textures.size());
+
+	m_textures.push_back(std::make_unique<Texture>());
+	Texture* texture = m_textures.back().get();
+	texture->owner = this;
+	texture->path = path;
+
+	jobs.run(counter, &TextureStreamer::load, texture);
+
+	return handle;
+}
+
+/**
+ * @brief Map, validate and prefetch a texture file, runs on a worker
+ *
+ * Failures only mark the texture, the rest of the engine keeps running.
+ */
+void TextureStreamer::load(void* data, uint32_t, uint32_t)
+{
+	Texture& texture = *static_cast<Texture*>(data);
+
+	try
+	{
+		texture.file.open(texture.path);
+
+		const uint8_t* bytes = texture.file.get_data();
+		Ktx2Header& header = texture.header;
+		header = ktx2::parse(bytes, texture.file.get_size());
+
+		// Basis Universal payloads (BasisLZ or UASTC) are stored with an undefined format and need a transcoder
+		if(header.format == VK_FORMAT_UNDEFINED || header.supercompression == ktx2::SUPERCOMPRESSION_BASIS_LZ)
+			throw std::runtime_error("Basis Universal textures need a transcoder, which this build does not include");
+
+		if(header.supercompression != ktx2::SUPERCOMPRESSION_NONE)
+			throw std::runtime_error("Supercompression scheme " + std::to_string(header.supercompression) + " is not supported");
+
+		uint32_t block_width, block_height;
+		uint32_t block_size = ktx2::get_block_size(header.format, block_width, block_height);
+		if(block_size == 0)
+			throw std::runtime_error(std::string("Unsupported format ") + string_VkFormat(header.format));
+
+		VkFormatProperties properties;
+		vkGetPhysicalDeviceFormatProperties(texture.owner->m_description.gpu, header.format, &properties);
+
+		const VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT | VK_FORMAT_FEATURE_TRANSFER_SRC_BIT;
+		if((properties.optimalTilingFeatures & required) != required)
+			throw std::runtime_error(std::string("The device cannot sample ") + string_VkFormat(header.format));
+
+		// levels below the stored ones are blitted, which needs a blittable format
+		const VkFormatFeatureFlags blit = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+		const bool can_generate = block_width == 1 && (properties.optimalTilingFeatures & blit) == blit;
+
+		uint32_t full_chain = static_cast<uint32_t>(std::bit_width(std::max(header.width, header.height)));
+		texture.level_count = can_generate ? full_chain : header.level_count;
+
+		texture.level_bytes.resize(texture.level_count);
+		for(uint32_t level = 0; level < texture.level_count; level++)
+		{
+			VkExtent3D extent = get_level_extent(header, level);
+			VkDeviceSize blocks = static_cast<VkDeviceSize>((extent.width + block_width - 1) / block_width) * ((extent.height + block_height - 1) / block_height);
+			texture.level_bytes[level] = blocks * block_size;
+
+			if(level < header.level_count && header.levels[level].length < texture.level_bytes[level])
+				throw std::runtime_error("KTX2 level " + std::to_string(level) + " is smaller than its extent");
+		}
+
+		// fault the stored levels in here, so the staging copy on the render thread does not wait for the disk
+		volatile uint8_t sink = 0;
+		for(const Ktx2Level& level : header.levels)
+			for(size_t offset = 0; offset < level.length; offset += PAGE_SIZE)
+				sink = sink + bytes[level.offset + offset];
+
+		texture.resident_level.store(texture.level_count, std::memory_order_relaxed);
+		texture.state.store(TextureState::READY, std::memory_order_release);
+
+		std::cout << "texture " << texture.path << ": " << header.width << "x" << header.height << " " << string_VkFormat(header.format) << ", " << header.level_count << "/" << texture.level_count << " levels stored" << '\n';
+	}
+	catch(const std::exception& e)
+	{
+		texture.file.close();
+		texture.error = e.what();
+		texture.state.store(TextureState::FAILED, std::memory_order_release);
+
+		std::cout << "texture " << texture.path << " failed: " << texture.error << '\n';
+	}
+}
+
+void TextureStreamer::set_demand(TextureHandle texture, float pixels)
+{
+	m_textures[texture]->demand.store(pixels, std::memory_order_relaxed);
+}
+
+TextureStatus TextureStreamer::get_status(TextureHandle handle) const
+{
+	const Texture& texture = *m_textures[handle];
+
+	TextureStatus status;
+	status.state = texture.state.load(std::memory_order_acquire);
+	if(status.state != TextureState::READY)
+		return status;
+
+	status.width 		  = texture.header.width;
+	status.height 		  = texture.header.height;
+	status.level_count 	  = texture.level_count;
+	status.resident_level = texture.resident_level.load(std::memory_order_relaxed);
+	status.resident_bytes = texture.resident_bytes.load(std::memory_order_relaxed);
+	status.descriptor 	  = texture.descriptor.load(std::memory_order_acquire);
+	return status;
+}
+
+/**
+ * @brief Size of a texture whose largest resident mip is level
+ */
+VkDeviceSize TextureStreamer::get_bytes(const Texture& texture, uint32_t level) const
+{
+	VkDeviceSize bytes = 0;
+	for(uint32_t i = level; i < texture.level_count; i++)
+		bytes += texture.level_bytes[i];
+	return bytes;
+}
+
+/**
+ * @brief Pick the largest mip of every loaded texture for this frame
+ *
+ * A texture wants the mip whose size matches its on-screen size. While the
+ * wanted mips exceed the budget, the texture with the lowest demand drops
+ * its largest wanted mip; the smallest mip of every texture always stays.
+ */
+void TextureStreamer::choose_levels()
+{
+	VkDeviceSize total = 0;
+
+	for(const std::unique_ptr<Texture>& pointer : m_textures)
+	{
+		Texture& texture = *pointer;
+		if(texture.state.load(std::memory_order_acquire) != TextureState::READY)
+			continue;
+
+		const uint32_t smallest = texture.level_count - 1;
+		float demand = texture.demand.load(std::memory_order_relaxed);
+
+		uint32_t level = smallest;
+		if(demand > 0.0f)
+		{
+			float size = static_cast<float>(std::max(texture.header.width, texture.header.height));
+			level = static_cast<uint32_t>(std::clamp(std::floor(std::log2(size / demand)), 0.0f, static_cast<float>(smallest)));
+		}
+
+		// a mip that does not fit in one frame's staging can never be uploaded
+		while(level < smallest && level < texture.header.level_count && texture.level_bytes[level] > m_description.staging_size)
+			level++;
+
+		texture.target_level = level;
+		total += get_bytes(texture, level);
+	}
+
+	while(total > m_description.budget)
+	{
+		Texture* victim = nullptr;
+		float victim_demand = 0.0f;
+
+		for(const std::unique_ptr<Texture>& pointer : m_textures)
+		{
+			Texture& texture = *pointer;
+			if(texture.state.load(std::memory_order_acquire) != TextureState::READY || texture.target_level + 1 >= texture.level_count)
+				continue;
+
+			float demand = texture.demand.load(std::memory_order_relaxed);
+			if(!victim || demand < victim_demand || (demand == victim_demand && texture.level_bytes[texture.target_level] > victim->level_bytes[victim->target_level]))
+			{
+				victim = &texture;
+				victim_demand = demand;
+			}
+		}
+
+		// only smallest mips are left
+		if(!victim)
+			break;
+
+		total -= victim->level_bytes[victim->target_level];
+		victim->target_level++;
+	}
+}
+
+/**
+ * @brief Move textures towards the mips chosen for this frame
+ *
+ * Runs before the first render pass of the frame, the command buffer of
+ * slot has just been waited for, so its staging buffer is free.
+ * @param cmd The primary command buffer of the frame
+ * @param slot Frame slot, selects the staging buffer
+ */
+void TextureStreamer::update(VkCommandBuffer cmd, uint32_t slot)
+{
+	m_update++;
+
+	// no frame in flight or packet in the pipeline references these anymore
+	while(!m_retired.empty() && m_retired.front().update <= m_update)
+	{
+		Retired& retired = m_retired.front();
+		ImGui_ImplVulkan_RemoveTexture(retired.descriptor);
+		vkrsc::destroy_image(m_description.device, m_description.allocator, retired.image);
+		m_retired.pop_front();
+	}
+
+	choose_levels();
+
+	StagingBuffer& staging = m_staging[slot];
+	VkDeviceSize staging_offset = 0;
+
+	for(const std::unique_ptr<Texture>& pointer : m_textures)
+	{
+		Texture& texture = *pointer;
+		if(texture.state.load(std::memory_order_acquire) != TextureState::READY)
+			continue;
+
+		uint32_t resident = texture.resident_level.load(std::memory_order_relaxed);
+		if(texture.target_level == resident)
+			continue;
+
+		// dropping mips only copies; gaining them goes one level per frame. Generated levels are blitted from the
+		// smallest stored one, so the first image and any gain from a generated level start there.
+		uint32_t level = texture.target_level;
+		if(level < resident)
+			level = resident >= texture.header.level_count ? texture.header.level_count - 1 : resident - 1;
+
+		// uploads of this rebuild, a texture that does not fit waits for the next frame
+		VkDeviceSize upload = 0;
+		for(uint32_t i = level; i < std::min(resident, texture.header.level_count); i++)
+			upload += align_up(texture.level_bytes[i], STAGING_ALIGNMENT);
+
+		if(staging_offset + upload > m_description.staging_size)
+			continue;
+
+		rebuild(texture, level, cmd, staging, staging_offset);
+	}
+}
+
+/**
+ * @brief Replace the image of a texture with one whose largest mip is level
+ * @param texture A loaded texture
+ * @param level The new largest resident mip
+ * @param cmd The primary command buffer of the frame
+ * @param staging Staging buffer of the frame
+ * @param staging_offset First free byte of staging, advanced past the uploads
+ */
+void TextureStreamer::rebuild(Texture& texture, uint32_t level, VkCommandBuffer cmd, StagingBuffer& staging, VkDeviceSize& staging_offset)
+{
+	const Ktx2Header& header = texture.header;
+	const uint32_t resident = texture.resident_level.load(std::memory_order_relaxed);
+	const uint32_t level_count = texture.level_count - level;
+	const uint32_t stored_end = std::min(resident, header.level_count);
+
+	// the levels the file does not store are generated, each from the one above, when the new image gains its
+	// first stored level: the old image (if any) holds only generated ones, none worth copying
+	const bool generate = level < header.level_count && resident >= header.level_count && texture.level_count > header.level_count;
+
+	AllocatedImage image = vkrsc::create_image(
+		m_description.device,
+		m_description.allocator,
+		get_level_extent(header, level),
+		header.format,
+		VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+		VK_IMAGE_ASPECT_COLOR_BIT,
+		level_count
+	);
+
+	vkutil::transition_image_layout(
+		cmd,
+		image.image,
+		VK_IMAGE_LAYOUT_UNDEFINED,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		0,
+		VK_ACCESS_2_TRANSFER_WRITE_BIT,
+		VK_PIPELINE_STAGE_2_NONE,
+		VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+		VK_IMAGE_ASPECT_COLOR_BIT,
+		0,
+		level_count
+	);
+
+	// levels both images hold are copied on the GPU
+	if(texture.image.image != VK_NULL_HANDLE && !generate)
+	{
+		const uint32_t old_level_count = texture.level_count - resident;
+
+		vkutil::transition_image_layout(
+			cmd,
+			texture.image.image,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			0,
+			VK_ACCESS_2_TRANSFER_READ_BIT,
+			VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+			VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+			VK_IMAGE_ASPECT_COLOR_BIT,
+			0,
+			old_level_count
+		);
+
+		// a 32-bit extent has at most 32 levels
+		FixedVector<VkImageCopy, 32> regions;
+		for(uint32_t i = std::max(level, resident); i < texture.level_count; i++)
+		{
+			regions.push_back({
+				.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i - resident, 0, 1 },
+				.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i - level, 0, 1 },
+				.extent 		= get_level_extent(header, i)
+			});
+		}
+
+		vkCmdCopyImage(cmd, texture.image.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, regions.size(), regions.data());
+
+		// the UI of this frame may still sample the old image until its packet picks up the new descriptor
+		vkutil::transition_image_layout(
+			cmd,
+			texture.image.image,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			0,
+			VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+			VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+			VK_IMAGE_ASPECT_COLOR_BIT,
+			0,
+			old_level_count
+		);
+	}
+
+	// levels the new image gains are read from the mapped file
+	for(uint32_t i = level; i < stored_end; i++)
+	{
+		std::memcpy(staging.mapped + staging_offset, texture.file.get_data() + header.levels[i].offset, texture.level_bytes[i]);
+
+		VkBufferImageCopy region = {
+			.bufferOffset 	  = staging_offset,
+			.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i - level, 0, 1 },
+			.imageExtent 	  = get_level_extent(header, i)
+		};
+
+		vkCmdCopyBufferToImage(cmd, staging.buffer.buffer, image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+		staging_offset += align_up(texture.level_bytes[i], STAGING_ALIGNMENT);
+	}
+
+	if(generate)
+	{
+		for(uint32_t i = header.level_count; i < texture.level_count; i++)
+		{
+			vkutil::transition_image_layout(
+				cmd,
+				image.image,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				VK_ACCESS_2_TRANSFER_WRITE_BIT,
+				VK_ACCESS_2_TRANSFER_READ_BIT,
+				VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+				VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+				VK_IMAGE_ASPECT_COLOR_BIT,
+				i - 1 - level,
+				1
+			);
+
+			VkExtent3D src = get_level_extent(header, i - 1);
+			VkExtent3D dst = get_level_extent(header, i);
+
+			VkImageBlit blit = {
+				.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i - 1 - level, 0, 1 },
+				.srcOffsets 	= { { 0, 0, 0 }, { static_cast<int32_t>(src.width), static_cast<int32_t>(src.height), 1 } },
+				.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i - level, 0, 1 },
+				.dstOffsets 	= { { 0, 0, 0 }, { static_cast<int32_t>(dst.width), static_cast<int32_t>(dst.height), 1 } }
+			};
+
+			vkCmdBlitImage(cmd, image.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+		}
+
+		// blit sources, every level but the last
+		vkutil::transition_image_layout(
+			cmd,
+			image.image,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			0,
+			VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+			VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+			VK_IMAGE_ASPECT_COLOR_BIT,
+			header.level_count - 1 - level,
+			texture.level_count - header.level_count
+		);
+	}
+
+	// everything still in TRANSFER_DST: the whole image, or everything above the blit sources
+	const uint32_t written_count = generate ? header.level_count - 1 - level : level_count;
+	if(written_count > 0)
+	{
+		vkutil::transition_image_layout(
+			cmd,
+			image.image,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_ACCESS_2_TRANSFER_WRITE_BIT,
+			VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+			VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+			VK_IMAGE_ASPECT_COLOR_BIT,
+			0,
+			written_count
+		);
+	}
+
+	// the last generated level was only ever written
+	if(generate)
+	{
+		vkutil::transition_image_layout(
+			cmd,
+			image.image,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_ACCESS_2_TRANSFER_WRITE_BIT,
+			VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+			VK_PIPELINE_STAGE_2_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+			VK_IMAGE_ASPECT_COLOR_BIT,
+			level_count - 1,
+			1
+		);
+	}
+
+	VkDescriptorSet old_descriptor = texture.descriptor.load(std::memory_order_relaxed);
+	if(texture.image.image != VK_NULL_HANDLE)
+		m_retired.push_back({ texture.image, old_descriptor, m_update + m_description.retire_delay });
+
+	VkDescriptorSet descriptor = ImGui_ImplVulkan_AddTexture(m_sampler, image.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+	VkDeviceSize bytes = get_bytes(texture, level);
+	m_resident_bytes.fetch_add(bytes, std::memory_order_relaxed);
+	m_resident_bytes.fetch_sub(texture.resident_bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+	texture.image = image;
+	texture.resident_bytes.store(bytes, std::memory_order_relaxed);
+	texture.resident_level.store(level, std::memory_order_relaxed);
+	texture.descriptor.store(descriptor, std::memory_order_release);
+}
+
+void TextureStreamer::destroy()
+{
+	for(const Retired& retired : m_retired)
+	{
+		ImGui_ImplVulkan_RemoveTexture(retired.descriptor);
+		vkrsc::destroy_image(m_description.device, m_description.allocator, retired.image);
+	}
+	m_retired.clear();
+
+	for(const std::unique_ptr<Texture>& texture : m_textures)
+	{
+		if(texture->image.image == VK_NULL_HANDLE)
+			continue;
+
+		ImGui_ImplVulkan_RemoveTexture(texture->descriptor.load(std::memory_order_relaxed));
+		vkrsc::destroy_image(m_description.device, m_description.allocator, texture->image);
+	}
+	m_textures.clear();
+
+	for(StagingBuffer& staging : m_staging)
+	{
+		vmaUnmapMemory(m_description.allocator, staging.buffer.allocation);
+		vmaDestroyBuffer(m_description.allocator, staging.buffer.buffer, staging.buffer.allocation);
+	}
+	m_staging.clear();
+
+	vkDestroySampler(m_description.device, m_sampler, nullptr);
+}
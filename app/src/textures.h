@@ -0,0 +1,181 @@
+#pragma once
+
+#include "vk_defines.h"
+#include "vk_resources.h"
+#include "mapped_file.h"
+#include "ktx2.h"
+#include "jobs.h"
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+using TextureHandle = uint32_t;
+
+enum class TextureState : uint32_t
+{
+	LOADING,
+	READY,
+	FAILED
+};
+
+struct TextureStreamerDescription
+{
+	VkPhysicalDevice gpu = VK_NULL_HANDLE;
+
+	VkDevice device = VK_NULL_HANDLE;
+
+	VmaAllocator allocator = VK_NULL_HANDLE;
+
+	// device memory all resident mips together may use
+	VkDeviceSize budget = 0;
+
+	// upload capacity of one frame, a mip larger than this is never made resident
+	VkDeviceSize staging_size = 0;
+
+	// frames in flight, one staging buffer each
+	uint32_t slot_count = 0;
+
+	// updates a replaced image is kept alive: frames in flight plus packets queued ahead of them
+	uint32_t retire_delay = 0;
+};
+
+// What the UI shows of a texture, readable from any thread
+struct TextureStatus
+{
+	TextureState state = TextureState::LOADING;
+
+	uint32_t width = 0;
+
+	uint32_t height = 0;
+
+	uint32_t level_count = 0;
+
+	// largest resident mip, level_count while nothing is resident
+	uint32_t resident_level = 0;
+
+	VkDeviceSize resident_bytes = 0;
+
+	// ImGui texture id of the resident mips, VK_NULL_HANDLE while nothing is resident
+	VkDescriptorSet descriptor = VK_NULL_HANDLE;
+};
+
+/**
+ * Streams the mips of KTX2 textures by demand. Files are memory mapped and
+ * validated on the job system; residency is decided on the render thread
+ * once per frame: each texture wants the mip that matches its on-screen size
+ * (set_demand), and while the sum exceeds the budget the least demanded
+ * textures give up their largest mip. A residency change rebuilds the image
+ * with the new mip range, copies the levels both ranges share on the GPU and
+ * uploads only the new ones through a per-frame staging ring, at most one
+ * level finer per frame. Levels the file does not store are generated with
+ * blits when the image is first created.
+ */
+class TextureStreamer
+{
+public:
+
+	void init(const TextureStreamerDescription& description);
+
+	// main thread, before the render thread starts; loading runs as a job on counter
+	TextureHandle request(const std::string& path, JobSystem& jobs, JobCounter& counter);
+
+	// largest on-screen side of the texture in pixels, 0 when it is not visible
+	void set_demand(TextureHandle texture, float pixels);
+
+	TextureStatus get_status(TextureHandle texture) const;
+
+	inline const std::string& get_path(TextureHandle texture) const { return m_textures[texture]->path; }
+
+	// valid once the state is FAILED
+	inline const std::string& get_error(TextureHandle texture) const { return m_textures[texture]->error; }
+
+	inline uint32_t get_count() const { return static_cast<uint32_t>(m_textures.size()); }
+
+	inline VkDeviceSize get_resident_bytes() const { return m_resident_bytes.load(std::memory_order_relaxed); }
+
+	inline VkDeviceSize get_budget() const { return m_description.budget; }
+
+	// render thread, records uploads and copies before the frame's first render pass
+	void update(VkCommandBuffer cmd, uint32_t slot);
+
+	// the loading jobs must be done
+	void destroy();
+
+private:
+
+	struct Texture
+	{
+		TextureStreamer* owner = nullptr;
+
+		std::string path;
+
+		std::string error;
+
+		MappedFile file;
+
+		Ktx2Header header;
+
+		std::atomic<TextureState> state {TextureState::LOADING};
+
+		// full chain: the levels of the file plus the generated ones
+		uint32_t level_count = 0;
+
+		std::vector<VkDeviceSize> level_bytes;
+
+		std::atomic<float> demand {0.0f};
+
+		// --- render thread ---
+
+		AllocatedImage image {};
+
+		// the mip the budget pass settled on this frame
+		uint32_t target_level = 0;
+
+		std::atomic<uint32_t> resident_level {0};
+
+		std::atomic<VkDeviceSize> resident_bytes {0};
+
+		std::atomic<VkDescriptorSet> descriptor {VK_NULL_HANDLE};
+	};
+
+	struct Retired
+	{
+		AllocatedImage image;
+
+		VkDescriptorSet descriptor;
+
+		uint64_t update;
+	};
+
+	struct StagingBuffer
+	{
+		AllocatedBuffer buffer;
+
+		uint8_t* mapped = nullptr;
+	};
+
+	static void load(void* data, uint32_t begin, uint32_t end);
+
+	void choose_levels();
+
+	void rebuild(Texture& texture, uint32_t level, VkCommandBuffer cmd, StagingBuffer& staging, VkDeviceSize& staging_offset);
+
+	VkDeviceSize get_bytes(const Texture& texture, uint32_t level) const;
+
+	TextureStreamerDescription m_description;
+
+	VkSampler m_sampler = VK_NULL_HANDLE;
+
+	std::vector<StagingBuffer> m_staging;
+
+	std::vector<std::unique_ptr<Texture>> m_textures;
+
+	std::deque<Retired> m_retired;
+
+	uint64_t m_update = 0;
+
+	std::atomic<VkDeviceSize> m_resident_bytes {0};
+};
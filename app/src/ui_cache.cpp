@@ -0,0 +1,87 @@
+#include "pre-compiled-header.h"
+#include "ui_cache.h"
+
+#include <imgui_impl_vulkan.h>
+
+/**
+ * @brief Allocate the secondary command buffers
+ * @param device The vulkan device
+ * @param pool A pool of the graphics family, used only by the render thread
+ * @param color_format Format of the UI pass color attachment
+ * @param slot_count Frames in flight
+ */
+void UiCache::init(VkDevice device, VkCommandPool pool, VkFormat color_format, uint32_t slot_count)
+{
+	m_device = device;
+	m_pool = pool;
+	m_color_format = color_format;
+
+	m_command_buffers.resize(slot_count);
+
+	VkCommandBufferAllocateInfo cmd_buffer_info = {
+		.sType 				= VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+		.commandPool 		= pool,
+		.level 				= VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+		.commandBufferCount = slot_count,
+	};
+
+	VK_CHECK(vkAllocateCommandBuffers(device, &cmd_buffer_info, m_command_buffers.data()));
+}
+
+/**
+ * @brief Get the secondary to execute in the UI pass of this frame
+ *
+ * ImGui rotates its vertex/index buffers per RenderDrawData call, so while
+ * it is not called the buffers of the last recording stay untouched.
+ * @param snapshot The UI of the frame being recorded
+ */
+VkCommandBuffer UiCache::get(UiSnapshot& snapshot)
+{
+	if(m_valid && snapshot.get_hash() == m_hash)
+	{
+		m_reused++;
+		return m_command_buffers[m_current];
+	}
+
+	// the other buffers are not referenced by any frame in flight
+	m_current = (m_current + 1) % m_command_buffers.size();
+	VkCommandBuffer cmd = m_command_buffers[m_current];
+
+	VkCommandBufferInheritanceRenderingInfo inheritance_rendering_info = {
+		.sType 					 = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO,
+		.colorAttachmentCount 	 = 1,
+		.pColorAttachmentFormats = &m_color_format,
+		.rasterizationSamples 	 = VK_SAMPLE_COUNT_1_BIT
+	};
+
+	VkCommandBufferInheritanceInfo inheritance_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+		.pNext = &inheritance_rendering_info
+	};
+
+	// replayed by consecutive frames, which may be in flight together
+	VkCommandBufferBeginInfo begin_info = {
+		.sType 			  = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.flags 			  = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT,
+		.pInheritanceInfo = &inheritance_info
+	};
+
+	VK_CHECK(vkResetCommandBuffer(cmd, 0));
+	VK_CHECK(vkBeginCommandBuffer(cmd, &begin_info));
+	// ImGui binds its own pipeline, descriptor set and buffers; the secondary is its alone, so no
+	// CommandRecorder shadows it. Recording more into it through one would need invalidate() here.
+	ImGui_ImplVulkan_RenderDrawData(snapshot.get(), cmd);
+	VK_CHECK(vkEndCommandBuffer(cmd));
+
+	m_valid = true;
+	m_hash = snapshot.get_hash();
+	m_recorded++;
+
+	return cmd;
+}
+
+void UiCache::destroy()
+{
+	vkFreeCommandBuffers(m_device, m_pool, static_cast<uint32_t>(m_command_buffers.size()), m_command_buffers.data());
+	m_command_buffers.clear();
+}
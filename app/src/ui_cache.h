@@ -0,0 +1,49 @@
+#pragma once
+
+#include "vk_defines.h"
+#include "frame_packet.h"
+
+#include <vector>
+
+/**
+ * Records the ImGui draws into secondary command buffers and replays the
+ * last one while the UI is unchanged, so an idle UI costs neither the
+ * vertex/index upload of ImGui_ImplVulkan_RenderDrawData nor re-recording.
+ * One secondary per frame in flight: a new recording never resets a
+ * buffer a pending frame still executes.
+ */
+class UiCache
+{
+public:
+
+	void init(VkDevice device, VkCommandPool pool, VkFormat color_format, uint32_t slot_count);
+
+	// secondary with the draws of the snapshot, recorded only when its hash changed
+	VkCommandBuffer get(UiSnapshot& snapshot);
+
+	void destroy();
+
+	inline uint64_t get_recorded_count() const { return m_recorded; }
+
+	inline uint64_t get_reused_count() const { return m_reused; }
+
+private:
+
+	VkDevice m_device = VK_NULL_HANDLE;
+
+	VkCommandPool m_pool = VK_NULL_HANDLE;
+
+	VkFormat m_color_format = VK_FORMAT_UNDEFINED;
+
+	std::vector<VkCommandBuffer> m_command_buffers;
+
+	uint32_t m_current = 0;
+
+	bool m_valid = false;
+
+	uint64_t m_hash = 0;
+
+	uint64_t m_recorded = 0;
+
+	uint64_t m_reused = 0;
+};
@@ -0,0 +1,315 @@
+#include "pre-compiled-header.h"
+#include "views.h"
+
+#include "configurations.h"
+#include "vk_utils.h"
+
+/**
+ * @brief Open the view windows and create their swapchains and attachments
+ *
+ * Each view opens on the monitor after the one of the previous view when
+ * there is one, so a machine with a monitor per view fills them in order.
+ * @param description Device, formats and view count; the formats must be the main window's
+ */
+void ViewSet::init(const ViewSetDescription& description)
+{
+	m_description = description;
+
+	// sized once, the render thread and the jobs keep pointers into it
+	m_views.resize(description.count);
+	for(uint32_t i = 0; i < description.count; i++)
+	{
+		init_window(m_views[i], i);
+		init_swapchain(m_views[i]);
+		init_frames(m_views[i]);
+	}
+}
+
+void ViewSet::init_window(View& view, uint32_t index)
+{
+	std::string title = std::string(APP_NAME) + " - view " + std::to_string(index + 1);
+
+	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+	view.window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, title.c_str(), nullptr, nullptr);
+	if(view.window == nullptr)
+		throw std::runtime_error("Failed to create the window of view " + std::to_string(index + 1));
+
+	// the main window is on the first monitor
+	int monitor_count = 0;
+	GLFWmonitor** monitors = glfwGetMonitors(&monitor_count);
+	if(static_cast<int>(index) + 1 < monitor_count)
+	{
+		int x, y, width, height;
+		glfwGetMonitorWorkarea(monitors[index + 1], &x, &y, &width, &height);
+		glfwSetWindowPos(view.window, x, y);
+	}
+
+	VK_CHECK(glfwCreateWindowSurface(m_description.instance, view.window, nullptr, &view.surface));
+
+	VkBool32 supported = VK_FALSE;
+	VK_CHECK(vkGetPhysicalDeviceSurfaceSupportKHR(m_description.gpu, m_description.queue_family, view.surface, &supported));
+	if(!supported)
+		throw std::runtime_error("The graphics queue cannot present to the window of view " + std::to_string(index + 1));
+}
+
+void ViewSet::init_swapchain(View& view)
+{
+	VkSurfaceCapabilitiesKHR surface_properties;
+	VK_CHECK(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(m_description.gpu, view.surface, &surface_properties));
+
+	if(surface_properties.currentExtent.width == 0xFFFFFFFF)
+		view.extent = { WINDOW_WIDTH, WINDOW_HEIGHT };
+	else
+		view.extent = surface_properties.currentExtent;
+
+	// the pipelines are created for the main window's format
+	uint32_t format_count;
+	VK_CHECK(vkGetPhysicalDeviceSurfaceFormatsKHR(m_description.gpu, view.surface, &format_count, nullptr));
+	std::vector<VkSurfaceFormatKHR> formats(format_count);
+	VK_CHECK(vkGetPhysicalDeviceSurfaceFormatsKHR(m_description.gpu, view.surface, &format_count, formats.data()));
+
+	bool format_supported = false;
+	for(const VkSurfaceFormatKHR& format : formats)
+		format_supported |= format.format == m_description.surface_format.format && format.colorSpace == m_description.surface_format.colorSpace;
+	if(!format_supported)
+		throw std::runtime_error("A view window does not support the surface format of the main window");
+
+	uint32_t image_count = surface_properties.minImageCount + 1;
+	if(surface_properties.maxImageCount > 0 && image_count > surface_properties.maxImageCount)
+		image_count = surface_properties.maxImageCount;
+
+	VkCompositeAlphaFlagBitsKHR composite = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+	if(!(surface_properties.supportedCompositeAlpha & VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR))
+		composite = VK_COMPOSITE_ALPHA_INHERIT_BIT_KHR;
+
+	VkSwapchainCreateInfoKHR swapchain_info = {
+		.sType 			  = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
+		.surface 		  = view.surface,
+		.minImageCount 	  = image_count,
+		.imageFormat 	  = m_description.surface_format.format,
+		.imageColorSpace  = m_description.surface_format.colorSpace,
+		.imageExtent 	  = view.extent,
+		.imageArrayLayers = 1,
+		.imageUsage 	  = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+		.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
+		.preTransform 	  = (surface_properties.supportedTransforms & VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR) ? VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR : surface_properties.currentTransform,
+		.compositeAlpha   = composite,
+		.presentMode 	  = VK_PRESENT_MODE_FIFO_KHR,
+		.clipped 		  = true
+	};
+
+	VK_CHECK(vkCreateSwapchainKHR(m_description.device, &swapchain_info, nullptr, &view.swapchain));
+
+	VK_CHECK(vkGetSwapchainImagesKHR(m_description.device, view.swapchain, &image_count, nullptr));
+	view.images.resize(image_count);
+	VK_CHECK(vkGetSwapchainImagesKHR(m_description.device, view.swapchain, &image_count, view.images.data()));
+
+	for(VkImage image : view.images)
+	{
+		VkImageViewCreateInfo view_info = {
+			.sType 			  = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+			.image 			  = image,
+			.viewType 		  = VK_IMAGE_VIEW_TYPE_2D,
+			.format 		  = m_description.surface_format.format,
+			.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
+		};
+
+		VkImageView image_view;
+		VK_CHECK(vkCreateImageView(m_description.device, &view_info, nullptr, &image_view));
+		view.image_views.push_back(image_view);
+	}
+
+	// like the main window's, cleared by and dropped after the frame
+	VkExtent3D extent = { view.extent.width, view.extent.height, 1 };
+	view.depth_image = vkrsc::create_attachment(m_description.device, m_description.allocator, extent, m_description.depth_format,
+												VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT, m_description.samples);
+
+	if(m_description.samples != VK_SAMPLE_COUNT_1_BIT)
+		view.msaa_color_image = vkrsc::create_attachment(m_description.device, m_description.allocator, extent, m_description.surface_format.format,
+														 VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT, m_description.samples);
+}
+
+void ViewSet::init_frames(View& view)
+{
+	VkCommandPoolCreateInfo pool_info = {
+		.sType 			  = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+		.flags 			  = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+		.queueFamilyIndex = m_description.queue_family
+	};
+	VK_CHECK(vkCreateCommandPool(m_description.device, &pool_info, nullptr, &view.command_pool));
+
+	view.command_buffers.resize(m_description.slot_count);
+	VkCommandBufferAllocateInfo cmd_buffer_info = {
+		.sType 				= VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+		.commandPool 		= view.command_pool,
+		.level 				= VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+		.commandBufferCount = m_description.slot_count
+	};
+	VK_CHECK(vkAllocateCommandBuffers(m_description.device, &cmd_buffer_info, view.command_buffers.data()));
+
+	VkSemaphoreCreateInfo semaphore_info = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO
+	};
+
+	view.acquire_semaphores.resize(m_description.slot_count);
+	for(VkSemaphore& semaphore : view.acquire_semaphores)
+		VK_CHECK(vkCreateSemaphore(m_description.device, &semaphore_info, nullptr, &semaphore));
+}
+
+bool ViewSet::should_close() const
+{
+	for(const View& view : m_views)
+		if(glfwWindowShouldClose(view.window))
+			return true;
+	return false;
+}
+
+/**
+ * @brief Acquire the image every view renders this frame into
+ * @param slot Frame slot, its fence was waited for so its semaphores are unsignaled
+ */
+void ViewSet::acquire(uint32_t slot)
+{
+	for(View& view : m_views)
+		VK_CHECK(vkAcquireNextImageKHR(m_description.device, view.swapchain, UINT64_MAX, view.acquire_semaphores[slot], VK_NULL_HANDLE, &view.image));
+}
+
+/**
+ * @brief Record the scene pass of a view into its command buffer of the slot
+ *
+ * Transitions the acquired image for rendering and back for presenting, the
+ * command buffer runs in the frame's submit after the acquire semaphore.
+ * @param view_index Index of the view
+ * @param slot Frame slot, its fence was waited for
+ * @param draw Records the scene with the view's recorder, inside the pass
+ */
+void ViewSet::record(uint32_t view_index, uint32_t slot, FunctionRef<void(CommandRecorder& recorder, VkExtent2D extent)> draw)
+{
+	View& view = m_views[view_index];
+	VkCommandBuffer cmd = view.command_buffers[slot];
+	VkImage image = view.images[view.image];
+
+	VK_CHECK(vkResetCommandBuffer(cmd, 0));
+
+	VkCommandBufferBeginInfo begin_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+	};
+	VK_CHECK(vkBeginCommandBuffer(cmd, &begin_info));
+
+	vkutil::transition_image_layout(
+		cmd,
+		image,
+		VK_IMAGE_LAYOUT_UNDEFINED,
+		VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+		0,
+		VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+		VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+		VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT
+	);
+
+	// the previous frame of this view may still be testing against it
+	vkutil::transition_image_layout(
+		cmd,
+		view.depth_image.image,
+		VK_IMAGE_LAYOUT_UNDEFINED,
+		VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+		VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+		VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+		VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+		VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+		VK_IMAGE_ASPECT_DEPTH_BIT
+	);
+
+	if(m_description.samples != VK_SAMPLE_COUNT_1_BIT)
+	{
+		vkutil::transition_image_layout(
+			cmd,
+			view.msaa_color_image.image,
+			VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+			VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+			VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+			VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT
+		);
+	}
+
+	VkRenderingAttachmentInfo color_attachment = {
+		.sType 		 = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+		.imageView 	 = view.image_views[view.image],
+		.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+		.loadOp 	 = VK_ATTACHMENT_LOAD_OP_CLEAR,
+		.storeOp 	 = VK_ATTACHMENT_STORE_OP_STORE,
+		.clearValue  = { .color = m_description.clear_color }
+	};
+
+	if(m_description.samples != VK_SAMPLE_COUNT_1_BIT)
+	{
+		color_attachment.imageView 			= view.msaa_color_image.view;
+		color_attachment.resolveMode 		= VK_RESOLVE_MODE_AVERAGE_BIT;
+		color_attachment.resolveImageView 	= view.image_views[view.image];
+		color_attachment.resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		color_attachment.storeOp 			= VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	}
+
+	// reverse-Z, as in the main window
+	VkRenderingAttachmentInfo depth_attachment = {
+		.sType 		 = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+		.imageView 	 = view.depth_image.view,
+		.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+		.loadOp 	 = VK_ATTACHMENT_LOAD_OP_CLEAR,
+		.storeOp 	 = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+		.clearValue  = { .depthStencil = { 0.0f, 0 } }
+	};
+
+	VkRenderingInfo rendering_info = {
+		.sType 				  = VK_STRUCTURE_TYPE_RENDERING_INFO,
+		.renderArea 		  = { { 0, 0 }, view.extent },
+		.layerCount 		  = 1,
+		.colorAttachmentCount = 1,
+		.pColorAttachments 	  = &color_attachment,
+		.pDepthAttachment 	  = &depth_attachment
+	};
+
+	vkCmdBeginRendering(cmd, &rendering_info);
+	view.recorder.begin(cmd, m_description.extended_dynamic_state3);
+	draw(view.recorder, view.extent);
+	vkCmdEndRendering(cmd);
+
+	vkutil::transition_image_layout(
+		cmd,
+		image,
+		VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+		VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+		VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+		0,
+		VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+		VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT
+	);
+
+	VK_CHECK(vkEndCommandBuffer(cmd));
+}
+
+void ViewSet::destroy()
+{
+	for(View& view : m_views)
+	{
+		for(VkSemaphore semaphore : view.acquire_semaphores)
+			vkDestroySemaphore(m_description.device, semaphore, nullptr);
+		vkDestroyCommandPool(m_description.device, view.command_pool, nullptr);
+
+		if(view.msaa_color_image.image != VK_NULL_HANDLE)
+			vkrsc::destroy_image(m_description.device, m_description.allocator, view.msaa_color_image);
+		vkrsc::destroy_image(m_description.device, m_description.allocator, view.depth_image);
+
+		for(VkImageView image_view : view.image_views)
+			vkDestroyImageView(m_description.device, image_view, nullptr);
+		vkDestroySwapchainKHR(m_description.device, view.swapchain, nullptr);
+
+		vkDestroySurfaceKHR(m_description.instance, view.surface, nullptr);
+		glfwDestroyWindow(view.window);
+	}
+	m_views.clear();
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include "vk_defines.h"
+#include "vk_resources.h"
+#include "vk_commands.h"
+#include "fixed_containers.h"
+
+#include <vector>
+
+// windows one engine renders to, the main window included; the limit of --views
+const uint32_t MAX_VIEWS = 8;
+
+struct ViewSetDescription
+{
+	VkInstance instance = VK_NULL_HANDLE;
+
+	VkPhysicalDevice gpu = VK_NULL_HANDLE;
+
+	VkDevice device = VK_NULL_HANDLE;
+
+	VmaAllocator allocator = VK_NULL_HANDLE;
+
+	// the family that renders and presents every view
+	uint32_t queue_family = 0;
+
+	// views besides the main window
+	uint32_t count = 0;
+
+	// formats and samples of the main window's scene pass, the views share its pipelines
+	VkSurfaceFormatKHR surface_format {};
+
+	VkFormat depth_format = VK_FORMAT_UNDEFINED;
+
+	VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+
+	VkClearColorValue clear_color {};
+
+	// frames in flight, one command buffer and acquire semaphore each
+	uint32_t slot_count = 0;
+
+	bool extended_dynamic_state3 = false;
+};
+
+/**
+ * Additional output windows of one engine. Each view owns its window,
+ * surface, swapchain and scene attachments, everything else (device,
+ * queues, pipelines, meshes, uploads) is the main window's. A view renders
+ * the scene pass of the frame into its own primary command buffer, so the
+ * views of a frame can be recorded in parallel; the engine submits them
+ * with the main window's command buffer in one vkQueueSubmit2 and presents
+ * every swapchain in one vkQueuePresentKHR. Views show no UI.
+ */
+class ViewSet
+{
+public:
+
+	void init(const ViewSetDescription& description);
+
+	inline uint32_t get_count() const { return static_cast<uint32_t>(m_views.size()); }
+
+	// --- main thread ---
+
+	// closing any view closes the engine
+	bool should_close() const;
+
+	// --- render thread ---
+
+	// the next image of every view, the view's semaphore of slot is signaled when it is ready
+	void acquire(uint32_t slot);
+
+	inline VkCommandBuffer get_command_buffer(uint32_t view, uint32_t slot) const { return m_views[view].command_buffers[slot]; }
+
+	inline VkSemaphore get_acquire_semaphore(uint32_t view, uint32_t slot) const { return m_views[view].acquire_semaphores[slot]; }
+
+	inline VkSwapchainKHR get_swapchain(uint32_t view) const { return m_views[view].swapchain; }
+
+	inline uint32_t get_image(uint32_t view) const { return m_views[view].image; }
+
+	// --- render thread or a job worker, one thread per view at a time ---
+
+	// the scene pass of view into its acquired image, left in PRESENT_SRC; draw records the content, viewport and scissor unset
+	void record(uint32_t view_index, uint32_t slot, FunctionRef<void(CommandRecorder& recorder, VkExtent2D extent)> draw);
+
+	void destroy();
+
+private:
+
+	struct View
+	{
+		GLFWwindow* window = nullptr;
+
+		VkSurfaceKHR surface = VK_NULL_HANDLE;
+
+		VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+
+		VkExtent2D extent {};
+
+		std::vector<VkImage> images;
+
+		std::vector<VkImageView> image_views;
+
+		AllocatedImage depth_image {};
+
+		// only with MSAA
+		AllocatedImage msaa_color_image {};
+
+		// the views are recorded on different threads, each one allocates from its own pool
+		VkCommandPool command_pool = VK_NULL_HANDLE;
+
+		std::vector<VkCommandBuffer> command_buffers;
+
+		std::vector<VkSemaphore> acquire_semaphores;
+
+		// acquired this frame
+		uint32_t image = 0;
+
+		CommandRecorder recorder;
+	};
+
+	void init_window(View& view, uint32_t index);
+
+	void init_swapchain(View& view);
+
+	void init_frames(View& view);
+
+	ViewSetDescription m_description;
+
+	std::vector<View> m_views;
+};
@@ -0,0 +1,402 @@
+#include "pre-compiled-header.h"
+#include "vk_capture.h"
+
+#include "vk_utils.h"
+
+namespace
+{
+	const char RAW_MAGIC[4] = { 'V', 'K', 'C', 'P' };
+
+	uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0)
+	{
+		static const std::array<uint32_t, 256> table = []()
+		{
+			std::array<uint32_t, 256> t;
+			for(uint32_t n = 0; n < 256; n++)
+			{
+				uint32_t c = n;
+				for(int k = 0; k < 8; k++)
+					c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+				t[n] = c;
+			}
+			return t;
+		}();
+
+		crc = ~crc;
+		for(size_t i = 0; i < size; i++)
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		return ~crc;
+	}
+
+	void put_u32_be(std::vector<uint8_t>& out, uint32_t value)
+	{
+		out.push_back(static_cast<uint8_t>(value >> 24));
+		out.push_back(static_cast<uint8_t>(value >> 16));
+		out.push_back(static_cast<uint8_t>(value >> 8));
+		out.push_back(static_cast<uint8_t>(value));
+	}
+
+	void put_chunk(std::vector<uint8_t>& out, const char* type, const std::vector<uint8_t>& data)
+	{
+		put_u32_be(out, static_cast<uint32_t>(data.size()));
+		size_t crc_start = out.size();
+		out.insert(out.end(), type, type + 4);
+		out.insert(out.end(), data.begin(), data.end());
+		put_u32_be(out, crc32(out.data() + crc_start, out.size() - crc_start));
+	}
+
+	/**
+	 * @brief Encode RGBA8 pixels as PNG using stored (uncompressed) deflate blocks
+	 *
+	 * Captures are diffed, not archived, so encoding speed matters more than size.
+	 */
+	std::vector<uint8_t> encode_png(const uint8_t* rgba, uint32_t width, uint32_t height)
+	{
+		// scanlines, each prefixed with filter type 0
+		std::vector<uint8_t> scanlines;
+		scanlines.reserve(static_cast<size_t>(width * 4 + 1) * height);
+		for(uint32_t y = 0; y < height; y++)
+		{
+			scanlines.push_back(0);
+			const uint8_t* row = rgba + static_cast<size_t>(y) * width * 4;
+			scanlines.insert(scanlines.end(), row, row + width * 4);
+		}
+
+		// zlib stream
+		std::vector<uint8_t> zlib = { 0x78, 0x01 };
+		uint32_t adler_a = 1, adler_b = 0;
+		for(size_t offset = 0; offset < scanlines.size() || offset == 0; )
+		{
+			size_t block = std::min<size_t>(scanlines.size() - offset, 0xFFFF);
+			bool last = offset + block == scanlines.size();
+
+			zlib.push_back(last ? 1 : 0);
+			zlib.push_back(static_cast<uint8_t>(block));
+			zlib.push_back(static_cast<uint8_t>(block >> 8));
+			zlib.push_back(static_cast<uint8_t>(~block));
+			zlib.push_back(static_cast<uint8_t>(~block >> 8));
+
+			for(size_t i = offset; i < offset + block; i++)
+			{
+				adler_a = (adler_a + scanlines[i]) % 65521;
+				adler_b = (adler_b + adler_a) % 65521;
+			}
+			zlib.insert(zlib.end(), scanlines.begin() + offset, scanlines.begin() + offset + block);
+
+			offset += block;
+			if(last)
+				break;
+		}
+		put_u32_be(zlib, (adler_b << 16) | adler_a);
+
+		std::vector<uint8_t> header;
+		put_u32_be(header, width);
+		put_u32_be(header, height);
+		header.insert(header.end(), { 8, 6, 0, 0, 0 }); // 8 bit, RGBA, deflate, no filter, no interlace
+
+		std::vector<uint8_t> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+		put_chunk(png, "IHDR", header);
+		put_chunk(png, "IDAT", zlib);
+		put_chunk(png, "IEND", {});
+
+		return png;
+	}
+
+	std::string frame_file_name(const std::string& dir, uint32_t frame, const char* extension)
+	{
+		return fmt::format("{}/frame_{:05}.{}", dir, frame, extension);
+	}
+}
+
+/**
+ * @brief Create the readback ring and start the writer thread
+ * @param allocator The VMA allocator
+ * @param extent Size of the captured swapchain images
+ * @param format Format of the captured swapchain images, 8 bit RGBA or BGRA
+ * @param slot_count Number of frames in flight
+ * @param options Capture directory, golden directory and tolerances
+ */
+void FrameCapture::init(VmaAllocator allocator, VkExtent2D extent, VkFormat format, uint32_t slot_count, const EngineOptions& options)
+{
+	m_options = options;
+	if(!is_enabled())
+		return;
+
+	m_allocator = allocator;
+	m_extent = extent;
+	m_swizzle = format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_B8G8R8A8_UNORM;
+
+	size_t frame_size = static_cast<size_t>(extent.width) * extent.height * 4;
+
+	m_slots.resize(slot_count);
+	for(auto& slot : m_slots)
+	{
+		slot.buffer = vkrsc::create_buffer(allocator, frame_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_AUTO_PREFER_HOST, VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT);
+		VK_CHECK(vmaMapMemory(allocator, slot.buffer.allocation, &slot.mapped));
+	}
+
+	std::filesystem::create_directories(m_options.capture_dir);
+
+	m_writer = std::thread(&FrameCapture::writer_loop, this);
+}
+
+/**
+ * @brief Hand a finished readback to the writer thread
+ * @param slot The frame-in-flight index, its fence must already be waited for
+ */
+void FrameCapture::collect(uint32_t slot)
+{
+	if(!is_enabled() || !m_slots[slot].pending)
+		return;
+
+	ReadbackSlot& readback = m_slots[slot];
+	readback.pending = false;
+
+	VK_CHECK(vmaInvalidateAllocation(m_allocator, readback.buffer.allocation, 0, VK_WHOLE_SIZE));
+
+	CapturedFrame captured = { .frame = readback.frame };
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if(!m_free_pixels.empty())
+		{
+			captured.pixels = std::move(m_free_pixels.back());
+			m_free_pixels.pop_back();
+		}
+	}
+
+	const uint8_t* pixels = static_cast<const uint8_t*>(readback.mapped);
+	captured.pixels.assign(pixels, pixels + static_cast<size_t>(m_extent.width) * m_extent.height * 4);
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_queue.push_back(std::move(captured));
+	}
+	m_condition.notify_one();
+}
+
+/**
+ * @brief Record the copy of a rendered frame if this frame is captured
+ * @param cmd The frame command buffer, after the scene passes and before the UI pass
+ * @param image The window-sized image the frame is rendered to
+ * @param layout COLOR_ATTACHMENT_OPTIMAL after rendering, TRANSFER_DST_OPTIMAL after an upscale blit; the image is left in it
+ * @param slot The frame-in-flight index
+ * @param frame The frame number
+ */
+void FrameCapture::record(VkCommandBuffer cmd, VkImage image, VkImageLayout layout, uint32_t slot, uint32_t frame)
+{
+	if(!is_enabled() || frame < m_options.capture_start || frame >= m_options.capture_start + m_options.capture_count)
+		return;
+
+	const bool blitted = layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	const VkAccessFlags2 write_access = blitted ? VK_ACCESS_2_TRANSFER_WRITE_BIT : VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
+	const VkPipelineStageFlags2 write_stage = blitted ? VK_PIPELINE_STAGE_2_BLIT_BIT : VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+
+	vkutil::transition_image_layout(
+		cmd,
+		image,
+		layout,
+		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		write_access,
+		VK_ACCESS_2_TRANSFER_READ_BIT,
+		write_stage,
+		VK_PIPELINE_STAGE_2_COPY_BIT
+	);
+
+	VkBufferImageCopy region = {
+		.bufferOffset 	   = 0,
+		.bufferRowLength   = 0,
+		.bufferImageHeight = 0,
+		.imageSubresource  = {
+			.aspectMask 	= VK_IMAGE_ASPECT_COLOR_BIT,
+			.mipLevel 		= 0,
+			.baseArrayLayer = 0,
+			.layerCount 	= 1
+		},
+		.imageOffset = { 0, 0, 0 },
+		.imageExtent = { m_extent.width, m_extent.height, 1 }
+	};
+
+	vkCmdCopyImageToBuffer(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, m_slots[slot].buffer.buffer, 1, &region);
+
+	// make the copy visible to the host once the frame fence signals
+	VkMemoryBarrier2 host_barrier = {
+		.sType 		   = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+		.srcStageMask  = VK_PIPELINE_STAGE_2_COPY_BIT,
+		.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+		.dstStageMask  = VK_PIPELINE_STAGE_2_HOST_BIT,
+		.dstAccessMask = VK_ACCESS_2_HOST_READ_BIT
+	};
+
+	VkDependencyInfo dependency_info = {
+		.sType 				= VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+		.memoryBarrierCount = 1,
+		.pMemoryBarriers 	= &host_barrier
+	};
+
+	vkCmdPipelineBarrier2(cmd, &dependency_info);
+
+	vkutil::transition_image_layout(
+		cmd,
+		image,
+		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		layout,
+		0,
+		write_access,
+		VK_PIPELINE_STAGE_2_COPY_BIT,
+		write_stage
+	);
+
+	m_slots[slot].pending = true;
+	m_slots[slot].frame = frame;
+}
+
+/**
+ * @brief True once every requested frame was written (and compared)
+ */
+bool FrameCapture::is_finished() const
+{
+	return is_enabled() && m_written >= m_options.capture_count;
+}
+
+/**
+ * @brief Drain pending readbacks, stop the writer and free the ring
+ *
+ * Must be called after the queue is idle.
+ */
+void FrameCapture::destroy()
+{
+	if(!is_enabled())
+		return;
+
+	for(uint32_t i = 0; i < m_slots.size(); i++)
+		collect(i);
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_condition.notify_one();
+	m_writer.join();
+
+	for(auto& slot : m_slots)
+	{
+		vmaUnmapMemory(m_allocator, slot.buffer.allocation);
+		vmaDestroyBuffer(m_allocator, slot.buffer.buffer, slot.buffer.allocation);
+	}
+	m_slots.clear();
+}
+
+void FrameCapture::writer_loop()
+{
+	while(true)
+	{
+		CapturedFrame frame;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_condition.wait(lock, [this]() { return m_stop || !m_queue.empty(); });
+
+			if(m_queue.empty())
+				return;
+
+			frame = std::move(m_queue.front());
+			m_queue.pop_front();
+		}
+
+		write_frame(frame);
+		m_written++;
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_free_pixels.push_back(std::move(frame.pixels));
+	}
+}
+
+void FrameCapture::write_frame(CapturedFrame& frame)
+{
+	std::vector<uint8_t>& rgba = frame.pixels;
+	if(m_swizzle)
+		for(size_t i = 0; i < rgba.size(); i += 4)
+			std::swap(rgba[i], rgba[i + 2]);
+
+	// raw: magic, width, height, RGBA8 pixels
+	std::string raw_path = frame_file_name(m_options.capture_dir, frame.frame, "raw");
+	std::ofstream raw(raw_path, std::ios::binary);
+	raw.write(RAW_MAGIC, sizeof(RAW_MAGIC));
+	raw.write(reinterpret_cast<const char*>(&m_extent.width), sizeof(uint32_t));
+	raw.write(reinterpret_cast<const char*>(&m_extent.height), sizeof(uint32_t));
+	raw.write(reinterpret_cast<const char*>(rgba.data()), rgba.size());
+	raw.close();
+
+	std::vector<uint8_t> png = encode_png(rgba.data(), m_extent.width, m_extent.height);
+	std::string png_path = frame_file_name(m_options.capture_dir, frame.frame, "png");
+	std::ofstream png_file(png_path, std::ios::binary);
+	png_file.write(reinterpret_cast<const char*>(png.data()), png.size());
+	png_file.close();
+
+	// a missing capture must fail the run, a CI job would otherwise pass on nothing
+	if(!raw || !png_file)
+	{
+		std::cout << "capture: could not write " << (!raw ? raw_path : png_path) << '\n';
+		m_write_error = true;
+	}
+
+	if(m_options.golden_dir.empty())
+		return;
+
+	// compare against the golden frame
+	std::string golden_path = frame_file_name(m_options.golden_dir, frame.frame, "raw");
+	std::ifstream golden(golden_path, std::ios::binary);
+
+	char magic[4];
+	uint32_t width = 0, height = 0;
+	golden.read(magic, sizeof(magic));
+	golden.read(reinterpret_cast<char*>(&width), sizeof(uint32_t));
+	golden.read(reinterpret_cast<char*>(&height), sizeof(uint32_t));
+
+	if(!golden || memcmp(magic, RAW_MAGIC, sizeof(RAW_MAGIC)) != 0 || width != m_extent.width || height != m_extent.height)
+	{
+		std::cout << "capture: golden frame " << golden_path << " is missing or has a different size" << '\n';
+		m_mismatch = true;
+		return;
+	}
+
+	std::vector<uint8_t>& expected = m_expected;
+	expected.resize(rgba.size());
+	golden.read(reinterpret_cast<char*>(expected.data()), expected.size());
+
+	// a truncated file would otherwise be compared against the previous frame's pixels
+	if(static_cast<size_t>(golden.gcount()) != expected.size())
+	{
+		std::cout << "capture: golden frame " << golden_path << " is truncated" << '\n';
+		m_mismatch = true;
+		return;
+	}
+
+	size_t mismatched_pixels = 0;
+	uint32_t max_difference = 0;
+	double squared_error = 0.0;
+	for(size_t i = 0; i < rgba.size(); i += 4)
+	{
+		uint32_t pixel_difference = 0;
+		for(size_t c = 0; c < 4; c++)
+		{
+			int difference = std::abs(static_cast<int>(rgba[i + c]) - static_cast<int>(expected[i + c]));
+			pixel_difference = std::max(pixel_difference, static_cast<uint32_t>(difference));
+			squared_error += static_cast<double>(difference) * difference;
+		}
+
+		max_difference = std::max(max_difference, pixel_difference);
+		if(pixel_difference > m_options.capture_tolerance)
+			mismatched_pixels++;
+	}
+
+	size_t pixel_count = rgba.size() / 4;
+	double mismatch_ratio = static_cast<double>(mismatched_pixels) / pixel_count;
+	double rmse = std::sqrt(squared_error / rgba.size());
+	bool passed = mismatch_ratio <= m_options.capture_max_mismatch;
+
+	fmt::print("capture: frame {} {} (max diff {}, rmse {:.3f}, {} of {} pixels over tolerance)\n",
+		frame.frame, passed ? "matches golden" : "DIFFERS from golden", max_difference, rmse, mismatched_pixels, pixel_count);
+
+	if(!passed)
+		m_mismatch = true;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "vk_defines.h"
+#include "vk_resources.h"
+#include "options.h"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+/**
+ * Copies rendered frames, without the UI, into host-visible readback
+ * buffers, one per frame in flight, so a capture never waits on the GPU:
+ * the copy is collected once the frame fence has been waited for by the
+ * frame loop. Encoding and golden comparison run on a writer thread.
+ */
+class FrameCapture
+{
+	struct ReadbackSlot
+	{
+		AllocatedBuffer buffer;
+
+		void* mapped = nullptr;
+
+		bool pending = false;
+
+		uint32_t frame = 0;
+	};
+
+	struct CapturedFrame
+	{
+		uint32_t frame;
+
+		std::vector<uint8_t> pixels;
+	};
+
+public:
+
+	void init(VmaAllocator allocator, VkExtent2D extent, VkFormat format, uint32_t slot_count, const EngineOptions& options);
+
+	inline bool is_enabled() const { return !m_options.capture_dir.empty(); }
+
+	void collect(uint32_t slot);
+
+	void record(VkCommandBuffer cmd, VkImage image, VkImageLayout layout, uint32_t slot, uint32_t frame);
+
+	bool is_finished() const;
+
+	inline bool has_mismatch() const { return m_mismatch; }
+
+	// a captured frame could not be written to the capture directory
+	inline bool has_write_error() const { return m_write_error; }
+
+	void destroy();
+
+private:
+
+	void writer_loop();
+
+	// swizzles the pixels in place
+	void write_frame(CapturedFrame& frame);
+
+	EngineOptions m_options;
+
+	VmaAllocator m_allocator = VK_NULL_HANDLE;
+
+	VkExtent2D m_extent {};
+
+	// swapchain images are BGRA on most platforms, files are always RGBA
+	bool m_swizzle = false;
+
+	std::vector<ReadbackSlot> m_slots;
+
+	// --- writer thread ---
+
+	std::thread m_writer;
+
+	std::mutex m_mutex;
+
+	std::condition_variable m_condition;
+
+	std::deque<CapturedFrame> m_queue;
+
+	// pixel buffers the writer is done with, reused by the next collected frames
+	std::vector<std::vector<uint8_t>> m_free_pixels;
+
+	// the golden frame being compared, only touched by the writer
+	std::vector<uint8_t> m_expected;
+
+	bool m_stop = false;
+
+	std::atomic<uint32_t> m_written {};
+
+	std::atomic<bool> m_mismatch {};
+
+	std::atomic<bool> m_write_error {};
+};
@@ -0,0 +1,329 @@
+#include "pre-compiled-header.h"
+#include "vk_commands.h"
+
+#include <bit>
+#include <cassert>
+
+namespace
+{
+	PFN_vkCmdSetPolygonModeEXT 		  cmd_set_polygon_mode 		  = nullptr;
+	PFN_vkCmdSetColorBlendEnableEXT   cmd_set_color_blend_enable   = nullptr;
+	PFN_vkCmdSetColorBlendEquationEXT cmd_set_color_blend_equation = nullptr;
+	PFN_vkCmdSetColorWriteMaskEXT 	  cmd_set_color_write_mask 	  = nullptr;
+
+	bool operator==(const VkColorBlendEquationEXT& a, const VkColorBlendEquationEXT& b)
+	{
+		return a.srcColorBlendFactor == b.srcColorBlendFactor && a.dstColorBlendFactor == b.dstColorBlendFactor && a.colorBlendOp == b.colorBlendOp
+			&& a.srcAlphaBlendFactor == b.srcAlphaBlendFactor && a.dstAlphaBlendFactor == b.dstAlphaBlendFactor && a.alphaBlendOp == b.alphaBlendOp;
+	}
+}
+
+/**
+ * @brief Dynamic states of the mesh pipelines
+ * @param extended_dynamic_state3 Whether VK_EXT_extended_dynamic_state3 blend/polygon state is enabled
+ */
+std::vector<VkDynamicState> vkcmd::get_dynamic_states(bool extended_dynamic_state3)
+{
+	std::vector<VkDynamicState> dynamic_states = {
+		VK_DYNAMIC_STATE_VIEWPORT,
+		VK_DYNAMIC_STATE_SCISSOR,
+		VK_DYNAMIC_STATE_CULL_MODE,
+		VK_DYNAMIC_STATE_FRONT_FACE,
+		VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY,
+		VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE,
+		VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE,
+		VK_DYNAMIC_STATE_DEPTH_COMPARE_OP,
+		VK_DYNAMIC_STATE_VERTEX_INPUT_BINDING_STRIDE
+	};
+
+	if(extended_dynamic_state3)
+	{
+		dynamic_states.push_back(VK_DYNAMIC_STATE_POLYGON_MODE_EXT);
+		dynamic_states.push_back(VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT);
+		dynamic_states.push_back(VK_DYNAMIC_STATE_COLOR_BLEND_EQUATION_EXT);
+		dynamic_states.push_back(VK_DYNAMIC_STATE_COLOR_WRITE_MASK_EXT);
+	}
+
+	return dynamic_states;
+}
+
+/**
+ * @brief Load the VK_EXT_extended_dynamic_state3 commands
+ * @param device The vulkan device, created with the extension enabled
+ */
+void vkcmd::load_extended_dynamic_state3(VkDevice device)
+{
+	cmd_set_polygon_mode 		 = reinterpret_cast<PFN_vkCmdSetPolygonModeEXT>(vkGetDeviceProcAddr(device, "vkCmdSetPolygonModeEXT"));
+	cmd_set_color_blend_enable 	 = reinterpret_cast<PFN_vkCmdSetColorBlendEnableEXT>(vkGetDeviceProcAddr(device, "vkCmdSetColorBlendEnableEXT"));
+	cmd_set_color_blend_equation = reinterpret_cast<PFN_vkCmdSetColorBlendEquationEXT>(vkGetDeviceProcAddr(device, "vkCmdSetColorBlendEquationEXT"));
+	cmd_set_color_write_mask 	 = reinterpret_cast<PFN_vkCmdSetColorWriteMaskEXT>(vkGetDeviceProcAddr(device, "vkCmdSetColorWriteMaskEXT"));
+
+	if(!cmd_set_polygon_mode || !cmd_set_color_blend_enable || !cmd_set_color_blend_equation || !cmd_set_color_write_mask)
+		throw std::runtime_error("Failed to load VK_EXT_extended_dynamic_state3 commands");
+}
+
+/**
+ * @brief Start recording through the wrapper, forgetting any shadowed state
+ * @param cmd The command buffer, already in the recording state
+ * @param extended_dynamic_state3 Whether blend/polygon state is dynamic in the bound pipelines
+ */
+void CommandRecorder::begin(VkCommandBuffer cmd, bool extended_dynamic_state3)
+{
+	m_cmd = cmd;
+	m_extended_dynamic_state3 = extended_dynamic_state3;
+	m_stats = {};
+
+	for(VertexBinding& binding : m_vertex_bindings)
+		binding = {};
+
+	invalidate();
+}
+
+/**
+ * @brief Forget the shadowed state, the next command of each kind is recorded again
+ *
+ * The requested vertex buffers are kept but marked dirty, whoever recorded
+ * into the command buffer in between may have bound its own.
+ */
+void CommandRecorder::invalidate()
+{
+	for(VkPipeline& pipeline : m_pipelines)
+		pipeline = VK_NULL_HANDLE;
+	for(auto& sets : m_descriptor_sets)
+		for(BoundDescriptorSet& set : sets)
+			set = {};
+
+	m_push_layout = VK_NULL_HANDLE;
+	m_viewport_valid = false;
+	m_scissor_valid = false;
+	m_raster_state_valid = false;
+
+	m_dirty_vertex_bindings = 0;
+	for(uint32_t i = 0; i < MAX_VERTEX_BINDINGS; i++)
+	{
+		if(m_vertex_bindings[i].buffer != VK_NULL_HANDLE)
+			m_dirty_vertex_bindings |= 1u << i;
+	}
+}
+
+void CommandRecorder::bind_pipeline(VkPipelineBindPoint bind_point, VkPipeline pipeline)
+{
+	VkPipeline& bound = m_pipelines[bind_point_index(bind_point)];
+	if(bound == pipeline)
+	{
+		m_stats.eliminated++;
+		return;
+	}
+
+	vkCmdBindPipeline(m_cmd, bind_point, pipeline);
+	bound = pipeline;
+	m_stats.recorded++;
+}
+
+/**
+ * @brief Bind one descriptor set, skipped when the same set is bound with the same layout. Forgets the other
+ * sets the new layout may have disturbed.
+ * @param bind_point Graphics or compute
+ * @param layout The pipeline layout the set is bound for
+ * @param index The set number, below MAX_DESCRIPTOR_SETS
+ * @param set The descriptor set
+ */
+void CommandRecorder::bind_descriptor_set(VkPipelineBindPoint bind_point, VkPipelineLayout layout, uint32_t index, VkDescriptorSet set)
+{
+	assert(index < MAX_DESCRIPTOR_SETS);
+
+	BoundDescriptorSet* bound = m_descriptor_sets[bind_point_index(bind_point)];
+	if(bound[index].layout == layout && bound[index].set == set)
+	{
+		m_stats.eliminated++;
+		return;
+	}
+
+	vkCmdBindDescriptorSets(m_cmd, bind_point, layout, index, 1, &set, 0, nullptr);
+	m_stats.recorded++;
+
+	// a set bound with another layout is disturbed unless the two layouts are compatible for it, below this
+	// index as well; compatibility is not tracked, so any other layout counts as incompatible. Replacing the
+	// layout at this index also disturbs every set after it.
+	const bool layout_changed = bound[index].layout != layout;
+	for(uint32_t i = 0; i < MAX_DESCRIPTOR_SETS; i++)
+	{
+		if(bound[i].layout != layout || (layout_changed && i > index))
+			bound[i] = {};
+	}
+	bound[index] = { layout, set };
+}
+
+/**
+ * @brief Write push constants, skipped when they repeat the previous write byte for byte
+ * @param layout The pipeline layout
+ * @param stages The stages of the push constant range
+ * @param offset Offset in bytes
+ * @param size Size in bytes, at most 128
+ * @param data The values
+ */
+void CommandRecorder::push_constants(VkPipelineLayout layout, VkShaderStageFlags stages, uint32_t offset, uint32_t size, const void* data)
+{
+	if(size <= MAX_PUSH_CONSTANT_SIZE && layout == m_push_layout && stages == m_push_stages && offset == m_push_offset
+		&& size == m_push_size && memcmp(m_push_data, data, size) == 0)
+	{
+		m_stats.eliminated++;
+		return;
+	}
+
+	vkCmdPushConstants(m_cmd, layout, stages, offset, size, data);
+	m_stats.recorded++;
+
+	m_push_layout = layout;
+	m_push_stages = stages;
+	m_push_offset = offset;
+	m_push_size = std::min(size, MAX_PUSH_CONSTANT_SIZE);
+	memcpy(m_push_data, data, m_push_size);
+}
+
+void CommandRecorder::set_viewport(const VkViewport& viewport)
+{
+	if(m_viewport_valid && memcmp(&viewport, &m_viewport, sizeof(VkViewport)) == 0)
+	{
+		m_stats.eliminated++;
+		return;
+	}
+
+	vkCmdSetViewport(m_cmd, 0, 1, &viewport);
+	m_viewport = viewport;
+	m_viewport_valid = true;
+	m_stats.recorded++;
+}
+
+void CommandRecorder::set_scissor(const VkRect2D& scissor)
+{
+	if(m_scissor_valid && memcmp(&scissor, &m_scissor, sizeof(VkRect2D)) == 0)
+	{
+		m_stats.eliminated++;
+		return;
+	}
+
+	vkCmdSetScissor(m_cmd, 0, 1, &scissor);
+	m_scissor = scissor;
+	m_scissor_valid = true;
+	m_stats.recorded++;
+}
+
+/**
+ * @brief Record the dynamic states of a draw, skipping the ones already set
+ * @param state The state the next draw expects
+ */
+void CommandRecorder::set_raster_state(const RasterState& state)
+{
+	const bool force = !m_raster_state_valid;
+
+	// every state below is one command, either recorded or eliminated
+	auto set = [this, force](bool changed, auto&& record)
+	{
+		if(force || changed)
+		{
+			record();
+			m_stats.recorded++;
+		}
+		else
+		{
+			m_stats.eliminated++;
+		}
+	};
+
+	set(state.cull_mode != m_raster_state.cull_mode, [&]() { vkCmdSetCullMode(m_cmd, state.cull_mode); });
+	set(state.front_face != m_raster_state.front_face, [&]() { vkCmdSetFrontFace(m_cmd, state.front_face); });
+	set(state.topology != m_raster_state.topology, [&]() { vkCmdSetPrimitiveTopology(m_cmd, state.topology); });
+	set(state.depth_test != m_raster_state.depth_test, [&]() { vkCmdSetDepthTestEnable(m_cmd, state.depth_test); });
+	set(state.depth_write != m_raster_state.depth_write, [&]() { vkCmdSetDepthWriteEnable(m_cmd, state.depth_write); });
+	set(state.depth_compare != m_raster_state.depth_compare, [&]() { vkCmdSetDepthCompareOp(m_cmd, state.depth_compare); });
+
+	if(m_extended_dynamic_state3)
+	{
+		set(state.polygon_mode != m_raster_state.polygon_mode, [&]() { cmd_set_polygon_mode(m_cmd, state.polygon_mode); });
+		set(state.blend_enable != m_raster_state.blend_enable, [&]() { cmd_set_color_blend_enable(m_cmd, 0, 1, &state.blend_enable); });
+		set(!(state.blend_equation == m_raster_state.blend_equation), [&]() { cmd_set_color_blend_equation(m_cmd, 0, 1, &state.blend_equation); });
+		set(state.color_write_mask != m_raster_state.color_write_mask, [&]() { cmd_set_color_write_mask(m_cmd, 0, 1, &state.color_write_mask); });
+	}
+
+	m_raster_state = state;
+	m_raster_state_valid = true;
+}
+
+/**
+ * @brief Bind a vertex buffer with a dynamic stride, recorded by the next draw
+ * @param binding The vertex input binding, below MAX_VERTEX_BINDINGS
+ * @param buffer The vertex buffer
+ * @param offset Offset in bytes into the buffer
+ * @param stride Vertex stride in bytes
+ */
+void CommandRecorder::bind_vertex_buffer(uint32_t binding, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize stride)
+{
+	assert(binding < MAX_VERTEX_BINDINGS);
+
+	VertexBinding& bound = m_vertex_bindings[binding];
+	const uint32_t bit = 1u << binding;
+
+	if(bound.buffer == buffer && bound.offset == offset && bound.stride == stride)
+	{
+		m_stats.eliminated++;
+		return;
+	}
+
+	// a pending bind that is replaced before any draw never reaches the command buffer
+	if(m_dirty_vertex_bindings & bit)
+		m_stats.eliminated++;
+
+	bound = { buffer, offset, stride };
+	m_dirty_vertex_bindings |= bit;
+}
+
+void CommandRecorder::draw(uint32_t vertex_count, uint32_t instance_count, uint32_t first_vertex, uint32_t first_instance)
+{
+	flush_vertex_buffers();
+
+	vkCmdDraw(m_cmd, vertex_count, instance_count, first_vertex, first_instance);
+	m_stats.recorded++;
+}
+
+void CommandRecorder::draw_indirect(VkBuffer buffer, VkDeviceSize offset, uint32_t draw_count, uint32_t stride)
+{
+	flush_vertex_buffers();
+
+	vkCmdDrawIndirect(m_cmd, buffer, offset, draw_count, stride);
+	m_stats.recorded++;
+}
+
+void CommandRecorder::draw_indirect_count(VkBuffer buffer, VkDeviceSize offset, VkBuffer count_buffer, VkDeviceSize count_offset, uint32_t max_draw_count, uint32_t stride)
+{
+	flush_vertex_buffers();
+
+	vkCmdDrawIndirectCount(m_cmd, buffer, offset, count_buffer, count_offset, max_draw_count, stride);
+	m_stats.recorded++;
+}
+
+void CommandRecorder::flush_vertex_buffers()
+{
+	while(m_dirty_vertex_bindings != 0)
+	{
+		// one command per run of consecutive dirty bindings
+		uint32_t first = std::countr_zero(m_dirty_vertex_bindings);
+		uint32_t count = std::countr_one(m_dirty_vertex_bindings >> first);
+
+		VkBuffer buffers[MAX_VERTEX_BINDINGS];
+		VkDeviceSize offsets[MAX_VERTEX_BINDINGS];
+		VkDeviceSize strides[MAX_VERTEX_BINDINGS];
+		for(uint32_t i = 0; i < count; i++)
+		{
+			buffers[i] = m_vertex_bindings[first + i].buffer;
+			offsets[i] = m_vertex_bindings[first + i].offset;
+			strides[i] = m_vertex_bindings[first + i].stride;
+		}
+
+		vkCmdBindVertexBuffers2(m_cmd, first, count, buffers, offsets, nullptr, strides);
+		m_stats.recorded++;
+		m_stats.eliminated += count - 1;
+
+		m_dirty_vertex_bindings &= ~(((1u << count) - 1) << first);
+	}
+}
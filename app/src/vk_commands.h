@@ -0,0 +1,167 @@
+#pragma once
+
+#include "vk_defines.h"
+
+// Fixed-function state recorded per draw instead of baked into pipelines
+struct RasterState
+{
+	VkCullModeFlags cull_mode = VK_CULL_MODE_NONE;
+
+	VkFrontFace front_face = VK_FRONT_FACE_CLOCKWISE;
+
+	VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+	VkBool32 depth_test = VK_FALSE;
+
+	VkBool32 depth_write = VK_FALSE;
+
+	VkCompareOp depth_compare = VK_COMPARE_OP_ALWAYS;
+
+	// VK_EXT_extended_dynamic_state3, ignored when unsupported
+	VkPolygonMode polygon_mode = VK_POLYGON_MODE_FILL;
+
+	VkBool32 blend_enable = VK_FALSE;
+
+	VkColorBlendEquationEXT blend_equation = {
+		.srcColorBlendFactor = VK_BLEND_FACTOR_ONE,
+		.dstColorBlendFactor = VK_BLEND_FACTOR_ZERO,
+		.colorBlendOp 		 = VK_BLEND_OP_ADD,
+		.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+		.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
+		.alphaBlendOp 		 = VK_BLEND_OP_ADD
+	};
+
+	VkColorComponentFlags color_write_mask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+};
+
+namespace vkcmd
+{
+
+	// dynamic states every mesh pipeline is created with
+	std::vector<VkDynamicState> get_dynamic_states(bool extended_dynamic_state3);
+
+	void load_extended_dynamic_state3(VkDevice device);
+
+};
+
+// Commands the recorder issued and the redundant ones it dropped since begin()
+struct CommandStats
+{
+	uint32_t recorded = 0;
+
+	uint32_t eliminated = 0;
+};
+
+/**
+ * Thin wrapper over a command buffer that shadows the state already
+ * recorded (pipelines, descriptor sets, push constants, viewport, scissor,
+ * vertex buffers and dynamic raster state) and drops commands that would
+ * not change it. Vertex buffer binds are deferred to the next draw so
+ * contiguous bindings go out as one vkCmdBindVertexBuffers2.
+ * Every pipeline bound through it is expected to use vkcmd::get_dynamic_states.
+ * Commands recorded into the same buffer behind its back leave the shadow
+ * stale until invalidate().
+ */
+class CommandRecorder
+{
+public:
+
+	void begin(VkCommandBuffer cmd, bool extended_dynamic_state3);
+
+	// call after anything recorded into the command buffer without the recorder, e.g. ImGui's renderer
+	void invalidate();
+
+	void bind_pipeline(VkPipelineBindPoint bind_point, VkPipeline pipeline);
+
+	void bind_descriptor_set(VkPipelineBindPoint bind_point, VkPipelineLayout layout, uint32_t index, VkDescriptorSet set);
+
+	void push_constants(VkPipelineLayout layout, VkShaderStageFlags stages, uint32_t offset, uint32_t size, const void* data);
+
+	void set_viewport(const VkViewport& viewport);
+
+	void set_scissor(const VkRect2D& scissor);
+
+	void set_raster_state(const RasterState& state);
+
+	void bind_vertex_buffer(uint32_t binding, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize stride);
+
+	void draw(uint32_t vertex_count, uint32_t instance_count = 1, uint32_t first_vertex = 0, uint32_t first_instance = 0);
+
+	void draw_indirect(VkBuffer buffer, VkDeviceSize offset, uint32_t draw_count, uint32_t stride);
+
+	// the draw count is read from count_buffer on the GPU, at most max_draw_count
+	void draw_indirect_count(VkBuffer buffer, VkDeviceSize offset, VkBuffer count_buffer, VkDeviceSize count_offset, uint32_t max_draw_count, uint32_t stride);
+
+	inline VkCommandBuffer get() const { return m_cmd; }
+
+	inline const CommandStats& get_stats() const { return m_stats; }
+
+private:
+
+	static constexpr uint32_t MAX_VERTEX_BINDINGS = 8;
+
+	static constexpr uint32_t MAX_DESCRIPTOR_SETS = 4;
+
+	// the minimum maxPushConstantsSize every device supports
+	static constexpr uint32_t MAX_PUSH_CONSTANT_SIZE = 128;
+
+	struct VertexBinding
+	{
+		VkBuffer buffer = VK_NULL_HANDLE;
+
+		VkDeviceSize offset = 0;
+
+		VkDeviceSize stride = 0;
+	};
+
+	struct BoundDescriptorSet
+	{
+		VkPipelineLayout layout = VK_NULL_HANDLE;
+
+		VkDescriptorSet set = VK_NULL_HANDLE;
+	};
+
+	void flush_vertex_buffers();
+
+	// graphics 0, compute 1
+	static inline uint32_t bind_point_index(VkPipelineBindPoint bind_point) { return bind_point == VK_PIPELINE_BIND_POINT_COMPUTE ? 1 : 0; }
+
+	VkCommandBuffer m_cmd = VK_NULL_HANDLE;
+
+	bool m_extended_dynamic_state3 = false;
+
+	CommandStats m_stats;
+
+	VkPipeline m_pipelines[2] {};
+
+	BoundDescriptorSet m_descriptor_sets[2][MAX_DESCRIPTOR_SETS] {};
+
+	// last push constant write, compared byte for byte
+	VkPipelineLayout m_push_layout = VK_NULL_HANDLE;
+
+	VkShaderStageFlags m_push_stages = 0;
+
+	uint32_t m_push_offset = 0;
+
+	uint32_t m_push_size = 0;
+
+	uint8_t m_push_data[MAX_PUSH_CONSTANT_SIZE] {};
+
+	// nothing is known about the command buffer state until it is first set
+	bool m_viewport_valid = false;
+
+	VkViewport m_viewport {};
+
+	bool m_scissor_valid = false;
+
+	VkRect2D m_scissor {};
+
+	bool m_raster_state_valid = false;
+
+	RasterState m_raster_state;
+
+	// requested bindings, the dirty ones are recorded by the next draw
+	VertexBinding m_vertex_bindings[MAX_VERTEX_BINDINGS] {};
+
+	uint32_t m_dirty_vertex_bindings = 0;
+};
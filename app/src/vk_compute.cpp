@@ -0,0 +1,173 @@
+#include "pre-compiled-header.h"
+#include "vk_compute.h"
+
+namespace
+{
+	VkSemaphore create_timeline_semaphore(VkDevice device)
+	{
+		VkSemaphoreTypeCreateInfo type_info = {
+			.sType 		   = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+			.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+			.initialValue  = 0
+		};
+
+		VkSemaphoreCreateInfo semaphore_info = {
+			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+			.pNext = &type_info
+		};
+
+		VkSemaphore semaphore;
+		VK_CHECK(vkCreateSemaphore(device, &semaphore_info, nullptr, &semaphore));
+		return semaphore;
+	}
+}
+
+/**
+ * @brief Create the command buffers and timelines of the scheduler
+ * @param device The vulkan device
+ * @param families Queue families found at device creation
+ * @param queue A queue of families.compute
+ * @param slot_count Frames in flight, one command buffer each
+ */
+void ComputeScheduler::init(VkDevice device, const QueueFamilies& families, VkQueue queue, uint32_t slot_count)
+{
+	m_device = device;
+	m_families = families;
+	m_queue = queue;
+
+	VkCommandPoolCreateInfo cmd_pool_info = {
+		.sType 			  = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+		.flags 			  = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+		.queueFamilyIndex = families.compute
+	};
+
+	VK_CHECK(vkCreateCommandPool(device, &cmd_pool_info, nullptr, &m_command_pool));
+
+	m_slots.resize(slot_count);
+	for(Slot& slot : m_slots)
+	{
+		VkCommandBufferAllocateInfo cmd_buffer_info = {
+			.sType 				= VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+			.commandPool 		= m_command_pool,
+			.level 				= VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+			.commandBufferCount = 1,
+		};
+
+		VK_CHECK(vkAllocateCommandBuffers(device, &cmd_buffer_info, &slot.cmd));
+	}
+
+	m_compute_timeline = create_timeline_semaphore(device);
+	m_graphics_timeline = create_timeline_semaphore(device);
+}
+
+/**
+ * @brief Register a pass, passes are recorded every frame in registration order
+ * @param name Name for logs and debugging
+ * @param consumer_stages Graphics stages that read what the pass writes
+ * @param record Records the pass into the compute command buffer
+ */
+void ComputeScheduler::add_pass(const char* name, VkPipelineStageFlags2 consumer_stages, RecordFunction record)
+{
+	m_passes.push_back({ name, consumer_stages, std::move(record) });
+
+	std::cout << "compute pass '" << name << "' on " << (is_async() ? "async compute queue" : "graphics queue") << '\n';
+}
+
+/**
+ * @brief Record and submit the passes of a frame
+ *
+ * Must run before the graphics submit of the same frame; its result is the
+ * wait the graphics submit adds. The command buffer of the slot is reused
+ * once its previous submit has completed, which the frame fence already
+ * implies, so the host wait normally returns immediately.
+ * @param frame The frame number the graphics submit will use
+ */
+ComputeScheduler::Submission ComputeScheduler::submit(uint64_t frame)
+{
+	if(m_passes.empty())
+		return {};
+
+	const uint64_t slot_count = m_slots.size();
+	uint32_t slot_index = static_cast<uint32_t>(frame % slot_count);
+	Slot& slot = m_slots[slot_index];
+
+	VkSemaphoreWaitInfo host_wait = {
+		.sType 			= VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+		.semaphoreCount = 1,
+		.pSemaphores 	= &m_compute_timeline,
+		.pValues 		= &slot.value
+	};
+	VK_CHECK(vkWaitSemaphores(m_device, &host_wait, UINT64_MAX));
+
+	VK_CHECK(vkResetCommandBuffer(slot.cmd, 0));
+
+	VkCommandBufferBeginInfo begin_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+	};
+	VK_CHECK(vkBeginCommandBuffer(slot.cmd, &begin_info));
+
+	Submission submission;
+	for(const Pass& pass : m_passes)
+	{
+		pass.record(slot.cmd, slot_index);
+		submission.wait_stages |= pass.consumer_stages;
+	}
+
+	VK_CHECK(vkEndCommandBuffer(slot.cmd));
+
+	submission.wait_value = frame + 1;
+	slot.value = submission.wait_value;
+
+	// graphics of the previous frame keeps running, only the one that used this slot must be done
+	VkSemaphoreSubmitInfo wait_info = {
+		.sType 	   = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+		.semaphore = m_graphics_timeline,
+		.value 	   = frame >= slot_count ? get_graphics_value(frame - slot_count) : 0,
+		.stageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT
+	};
+
+	VkSemaphoreSubmitInfo signal_info = {
+		.sType 	   = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+		.semaphore = m_compute_timeline,
+		.value 	   = submission.wait_value,
+		.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT
+	};
+
+	VkCommandBufferSubmitInfo cmd_info = {
+		.sType 		   = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+		.commandBuffer = slot.cmd
+	};
+
+	VkSubmitInfo2 submit_info = {
+		.sType 					  = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+		.waitSemaphoreInfoCount   = 1,
+		.pWaitSemaphoreInfos 	  = &wait_info,
+		.commandBufferInfoCount   = 1,
+		.pCommandBufferInfos 	  = &cmd_info,
+		.signalSemaphoreInfoCount = 1,
+		.pSignalSemaphoreInfos 	  = &signal_info
+	};
+
+	VK_CHECK(vkQueueSubmit2(m_queue, 1, &submit_info, VK_NULL_HANDLE));
+
+	return submission;
+}
+
+std::vector<uint32_t> ComputeScheduler::get_sharing_families() const
+{
+	if(is_async())
+		return { m_families.graphics, m_families.compute };
+
+	return { m_families.graphics };
+}
+
+void ComputeScheduler::destroy()
+{
+	vkDestroySemaphore(m_device, m_compute_timeline, nullptr);
+	vkDestroySemaphore(m_device, m_graphics_timeline, nullptr);
+	vkDestroyCommandPool(m_device, m_command_pool, nullptr);
+
+	m_slots.clear();
+	m_passes.clear();
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "vk_defines.h"
+#include "vk_utils.h"
+
+#include <functional>
+#include <vector>
+
+/**
+ * Schedules compute passes on the compute queue, a dedicated family when
+ * the device has one, so they overlap the graphics work of the previous
+ * frame. Ordering uses two timeline semaphores instead of fences:
+ * compute of frame N waits for graphics of frame N - slot_count, the last
+ * user of the slot's resources, and graphics of frame N waits for compute
+ * of frame N only at the stages that consume its results.
+ */
+class ComputeScheduler
+{
+public:
+
+	// records one pass, slot is the frame slot whose resources may be written
+	using RecordFunction = std::function<void(VkCommandBuffer cmd, uint32_t slot)>;
+
+	struct Submission
+	{
+		// compute timeline value the graphics submit waits for, 0 when nothing was submitted
+		uint64_t wait_value = 0;
+
+		// graphics stages that read compute results
+		VkPipelineStageFlags2 wait_stages = VK_PIPELINE_STAGE_2_NONE;
+	};
+
+	void init(VkDevice device, const QueueFamilies& families, VkQueue queue, uint32_t slot_count);
+
+	void add_pass(const char* name, VkPipelineStageFlags2 consumer_stages, RecordFunction record);
+
+	Submission submit(uint64_t frame);
+
+	// the value the graphics submit of `frame` signals on the graphics timeline
+	inline uint64_t get_graphics_value(uint64_t frame) const { return frame + 1; }
+
+	inline VkSemaphore get_graphics_timeline() const { return m_graphics_timeline; }
+
+	inline VkSemaphore get_compute_timeline() const { return m_compute_timeline; }
+
+	inline bool is_async() const { return m_families.has_async_compute(); }
+
+	// queue families of buffers shared by both queues (VK_SHARING_MODE_CONCURRENT when more than one)
+	std::vector<uint32_t> get_sharing_families() const;
+
+	void destroy();
+
+private:
+
+	struct Pass
+	{
+		const char* name;
+
+		VkPipelineStageFlags2 consumer_stages;
+
+		RecordFunction record;
+	};
+
+	struct Slot
+	{
+		VkCommandBuffer cmd = VK_NULL_HANDLE;
+
+		// compute timeline value of the last submit that used this command buffer
+		uint64_t value = 0;
+	};
+
+	VkDevice m_device = VK_NULL_HANDLE;
+
+	QueueFamilies m_families;
+
+	VkQueue m_queue = VK_NULL_HANDLE;
+
+	VkCommandPool m_command_pool = VK_NULL_HANDLE;
+
+	std::vector<Slot> m_slots;
+
+	std::vector<Pass> m_passes;
+
+	VkSemaphore m_compute_timeline = VK_NULL_HANDLE;
+
+	VkSemaphore m_graphics_timeline = VK_NULL_HANDLE;
+};
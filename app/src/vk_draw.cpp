@@ -0,0 +1,56 @@
+#include "pre-compiled-header.h"
+#include "vk_draw.h"
+
+/**
+ * @brief Build the sort key of an opaque draw
+ * @param view_depth Distance from the camera, negative values are clamped to 0
+ * @param pipeline Index of the pipeline the draw binds
+ * @param mesh Index of the mesh the draw reads
+ */
+uint64_t vkdraw::make_opaque_sort_key(float view_depth, uint16_t pipeline, uint16_t mesh)
+{
+	// the bit pattern of a positive float grows with its value
+	float depth = std::max(view_depth, 0.0f);
+	uint32_t depth_bits;
+	memcpy(&depth_bits, &depth, sizeof(depth_bits));
+
+	uint64_t key = 0;
+	key |= static_cast<uint64_t>(depth_bits >> 1) << 32;
+	key |= static_cast<uint64_t>(pipeline) << 16;
+	key |= static_cast<uint64_t>(mesh);
+
+	return key;
+}
+
+/**
+ * @brief Order draws by key, front-to-back for opaque geometry to maximize early-Z rejection
+ * @param draws The frame draw list
+ */
+void vkdraw::sort_draws(std::vector<DrawCommand>& draws)
+{
+	std::sort(draws.begin(), draws.end(), [](const DrawCommand& a, const DrawCommand& b)
+	{
+		return a.sort_key < b.sort_key;
+	});
+}
+
+/**
+ * @brief Hash a draw list, equal hashes record equal commands
+ * @param draws The sorted frame draw list
+ * @param seed Hash of the state the draws are recorded with (pipeline, extent)
+ */
+uint64_t vkdraw::hash_draws(const std::vector<DrawCommand>& draws, uint64_t seed)
+{
+	constexpr uint64_t FNV_PRIME = 0x100000001b3ull;
+
+	uint64_t hash = (0xcbf29ce484222325ull ^ seed) * FNV_PRIME;
+	hash = (hash ^ draws.size()) * FNV_PRIME;
+
+	for(const DrawCommand& draw : draws)
+	{
+		hash = (hash ^ reinterpret_cast<uint64_t>(draw.vertex_buffer)) * FNV_PRIME;
+		hash = (hash ^ (static_cast<uint64_t>(draw.first_vertex) << 32 | draw.vertex_count)) * FNV_PRIME;
+	}
+
+	return hash;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "vk_defines.h"
+
+// One recorded draw; draws are sorted by key before recording
+struct DrawCommand
+{
+	uint64_t sort_key = 0;
+
+	VkBuffer vertex_buffer = VK_NULL_HANDLE;
+
+	uint32_t first_vertex = 0;
+
+	uint32_t vertex_count = 0;
+};
+
+namespace vkdraw
+{
+
+	/**
+	 * Opaque key layout, ascending order is front-to-back:
+	 *   [63:62] bucket        (0 = opaque)
+	 *   [61:32] view depth    (top 30 bits of the positive float)
+	 *   [31:16] pipeline id
+	 *   [15: 0] mesh id
+	 */
+	uint64_t make_opaque_sort_key(float view_depth, uint16_t pipeline, uint16_t mesh);
+
+	void sort_draws(std::vector<DrawCommand>& draws);
+
+	// what recording the draws depends on: buffers, ranges and order, not the sort keys
+	uint64_t hash_draws(const std::vector<DrawCommand>& draws, uint64_t seed);
+
+};
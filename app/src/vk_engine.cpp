@@ -3,6 +3,11 @@
 
 #include "configurations.h"
 #include "vk_utils.h"
+#include "vk_pipeline.h"
+#include "vk_commands.h"
+#include "vk_draw.h"
+#include "device_select.h"
+#include "alloc_tracker.h"
 
 #include <imgui.h>
 #include <imgui_impl_glfw.h>
@@ -10,26 +15,111 @@
 
 #include <glm/gtc/type_ptr.hpp>
 
-void Engine::init()
+void Engine::init(const EngineOptions& options)
 {
+	m_options = options;
+
+	if(m_options.alloc_check_warmup > 0 && !alloctrack::is_available())
+		throw std::runtime_error("--alloc-check needs a debug build, operator new is only replaced with DEBUG defined");
+
+	init_jobs();
+
 	init_vulkan();
 
 	init_swapchain();
 
+	init_render_targets();
+
 	init_per_frame();
 
+	init_views();
+
+	init_compute();
+
 	init_pipeline();
 
+	init_frame_uniforms();
+
 	init_scene();
 
+	init_particles();
+
+	init_occlusion();
+
 	init_imgui();
+
+	init_textures();
+
+	init_capture();
+
+	init_export();
+
+	init_latency();
+
+	init_governor();
 }
 
 void Engine::run()
 {
-	while (!glfwWindowShouldClose(m_window))
+	// the scene of the first frame, later updates are kicked off while building packets
+	kick_scene_update();
+
+	// packets keep their capacity from frame to frame, sized for every object the loop never grows them
+	for(uint32_t i = 0; i < TripleBuffer<FramePacket>::SLOT_COUNT; i++)
+	{
+		m_frame_packets.get_slot(i).draws.reserve(m_scene.size());
+		m_frame_packets.get_slot(i).occlusion_objects.reserve(m_scene.size());
+	}
+
+	m_render_running = true;
+	m_render_thread = std::thread(&Engine::render_loop, this);
+
+	// with nothing animating on its own, an unchanged UI means an unchanged frame; an export consumer expects
+	// a steady stream, and the allocation check counts frames
+	const bool idle_wait = m_options.idle_wait && !m_particles.is_enabled() && !m_capture.is_enabled() && !m_export.is_enabled()
+						&& m_options.alloc_check_warmup == 0;
+	const uint32_t alloc_check_end = m_options.alloc_check_warmup + m_options.alloc_check_frames;
+	bool idle = false;
+	uint64_t published_ui_hash = 0;
+
+	while (!glfwWindowShouldClose(m_window) && !m_views.should_close() && !m_capture.is_finished())
 	{
-		glfwPollEvents();
+		AllocationScope scope("main loop");
+
+		// idle: sleep until input arrives, the timeout keeps time-based widgets (text cursor) going
+		if(idle)
+			glfwWaitEventsTimeout(IDLE_WAIT_TIMEOUT);
+		else
+			glfwPollEvents();
+
+		// the render thread has not picked up the last packet yet, keep polling input meanwhile
+		if(m_frame_packets.is_pending())
+		{
+			std::this_thread::sleep_for(std::chrono::microseconds(500));
+			continue;
+		}
+
+		// pacing: start the frame late, with input polled right before it
+		if(m_latency.wait_for_frame_start())
+			glfwPollEvents();
+
+		const auto input_time = LatencyMonitor::Clock::now();
+
+		// refreshed every frame, the stats would make each rendered frame change the UI of the next one and the loop
+		// would never go idle; while idle the last values stay, a UI change brings them up to date again
+		if(!idle && std::chrono::duration<double>(input_time - m_live_stats.time).count() >= LIVE_STATS_INTERVAL)
+		{
+			m_live_stats.time = input_time;
+			m_live_stats.commands_recorded = m_commands_recorded.load(std::memory_order_relaxed);
+			m_live_stats.commands_eliminated = m_commands_eliminated.load(std::memory_order_relaxed);
+			m_live_stats.latency = m_latency.get_stats();
+			if(m_occlusion.is_enabled())
+				m_live_stats.occlusion = m_occlusion.get_stats();
+			if(m_governor.is_enabled())
+				m_live_stats.governor = m_governor.get_stats();
+			if(m_export.is_enabled())
+				m_live_stats.exported = m_export.get_stats();
+		}
 
 		ImGui_ImplVulkan_NewFrame();
 		ImGui_ImplGlfw_NewFrame();
@@ -39,115 +129,616 @@ void Engine::run()
 		ImGui::ColorEdit3("Top", glm::value_ptr(m_colors.colors[0]));
 		ImGui::ColorEdit3("Right", glm::value_ptr(m_colors.colors[1]));
 		ImGui::ColorEdit3("Left", glm::value_ptr(m_colors.colors[2]));
+		ImGui::Text("commands: %u recorded, %u eliminated", m_live_stats.commands_recorded, m_live_stats.commands_eliminated);
+		if(m_occlusion.is_enabled())
+		{
+			const OcclusionStats& occlusion = m_live_stats.occlusion;
+			ImGui::Text("occlusion: %u objects, %u early + %u late draws", occlusion.objects, occlusion.early, occlusion.late);
+		}
+		const LatencyStats& latency = m_live_stats.latency;
+		ImGui::Text("latency: %.2f ms (avg %.2f, max %.2f), pacing delay %.2f ms", latency.last_ms, latency.average_ms, latency.max_ms, latency.pacing_delay_ms);
+		if(m_governor.is_enabled())
+		{
+			const FrameGovernorStats& governor = m_live_stats.governor;
+			ImGui::Text("frame budget: gpu %.2f ms (avg %.2f, budget %.2f), scale %.2f, shed level %u", governor.gpu_ms, governor.average_ms, m_options.frame_budget_ms, governor.scale, governor.shed_level);
+		}
+		if(m_export.is_enabled())
+		{
+			const FrameExportStats& exported = m_live_stats.exported;
+			ImGui::Text("export (%s): %s, %llu exported, %llu dropped", exported.memory_kind == frame_export::MEMORY_DMA_BUF ? "dma-buf" : "host memory",
+						exported.connected ? "connected" : "waiting", static_cast<unsigned long long>(exported.exported), static_cast<unsigned long long>(exported.dropped));
+		}
 		ImGui::End();
 
+		if(m_textures.get_count() > 0)
+		{
+			bool visible = ImGui::Begin("Textures");
+			if(visible)
+				ImGui::Text("resident: %.1f / %.1f MiB", m_textures.get_resident_bytes() / 1048576.0, m_textures.get_budget() / 1048576.0);
+
+			for(TextureHandle texture = 0; texture < m_textures.get_count(); texture++)
+			{
+				TextureStatus status = m_textures.get_status(texture);
+
+				// a collapsed window shows nothing, its textures keep only their smallest mip
+				m_textures.set_demand(texture, visible ? m_texture_sizes[texture] : 0.0f);
+				if(!visible)
+					continue;
+
+				ImGui::PushID(static_cast<int>(texture));
+				ImGui::SeparatorText(m_textures.get_path(texture).c_str());
+
+				if(status.state == TextureState::LOADING)
+					ImGui::TextUnformatted("loading");
+				else if(status.state == TextureState::FAILED)
+					ImGui::TextWrapped("failed: %s", m_textures.get_error(texture).c_str());
+				else
+				{
+					ImGui::Text("%ux%u, mip %u of %u resident, %.2f MiB", status.width, status.height, status.resident_level, status.level_count, status.resident_bytes / 1048576.0);
+					ImGui::SliderFloat("size", &m_texture_sizes[texture], 16.0f, 1024.0f, "%.0f px");
+
+					if(status.descriptor)
+					{
+						float aspect = static_cast<float>(status.height) / status.width;
+						ImGui::Image((ImTextureID)status.descriptor, ImVec2(m_texture_sizes[texture], m_texture_sizes[texture] * aspect));
+					}
+				}
+
+				ImGui::PopID();
+			}
+			ImGui::End();
+		}
+
 		ImGui::Render();
 
-		draw();
+		FramePacket& packet = m_frame_packets.get_write();
+		packet.ui.capture(ImGui::GetDrawData());
+
+		// the last published frame already shows this UI: skip it, CPU and GPU stay idle
+		idle = idle_wait && m_simulation_frame > 0 && packet.ui.get_hash() == published_ui_hash;
+		if(idle)
+			continue;
+		published_ui_hash = packet.ui.get_hash();
+
+		m_jobs.wait(m_scene_update);
+
+		build_frame_packet(packet);
+		packet.input_time = input_time;
+
+		// levels of detail for the resolution the governor renders at, coarser while it sheds work
+		if(m_governor.is_enabled())
+		{
+			m_scene.set_lod_settings({
+				.viewport_height = context.swapchain_dimensions.height * m_governor.get_published_scale(),
+				.threshold 		 = m_options.lod_threshold * m_governor.get_lod_bias()
+			});
+		}
+
+		// the packet no longer needs the scene: simulate the next frame while this one is rendered
+		kick_scene_update();
+
+		packet.publish_time = LatencyMonitor::Clock::now();
+		m_frame_packets.publish();
+
+		// from here on every frame must run on the memory it already has
+		if(m_options.alloc_check_warmup > 0)
+		{
+			if(m_simulation_frame == m_options.alloc_check_warmup)
+				alloctrack::arm();
+			else if(m_simulation_frame == alloc_check_end)
+				glfwSetWindowShouldClose(m_window, GLFW_TRUE);
+		}
+	}
+
+	m_render_running = false;
+	m_frame_packets.wake();
+	m_render_thread.join();
+
+	if(m_options.alloc_check_warmup > 0)
+	{
+		alloctrack::disarm();
+		m_steady_state_allocations = alloctrack::report("after warm-up");
 	}
 
+	m_latency.print_summary();
+
 	cleanup();
 }
 
+void Engine::render_loop()
+{
+	AllocationScope scope("render thread");
+
+	// kicks the recording of the views
+	m_jobs.attach(0);
+
+	while (m_render_running)
+	{
+		uint32_t seen = m_frame_packets.get_published();
+		if(!m_frame_packets.acquire())
+		{
+			m_frame_packets.wait(seen);
+			continue;
+		}
+
+		draw(m_frame_packets.get_read());
+	}
+}
+
+void Engine::build_frame_packet(FramePacket& packet)
+{
+	packet.frame = m_simulation_frame++;
+
+	// snapshot of the values the UI may change while this packet is rendered
+	packet.constants = m_colors;
+
+	packet.view_projection = m_view_projection;
+
+	// draw list from the objects that passed culling, opaque draws front-to-back
+	const SceneArrays& scene = m_scene.get_arrays();
+	packet.draws.clear();
+	packet.occlusion_objects.clear();
+	for(uint32_t object : m_scene.get_visible())
+	{
+		const MeshLod& lod = m_mesh_lods[std::min<size_t>(scene.lod[object], m_mesh_lods.size() - 1)];
+
+		// the visibility history is keyed by handle: Scene::destroy moves the last object into the freed dense
+		// slot, which would hand it the history of the destroyed one. A reused handle inherits a stale entry,
+		// that costs at most one extra early draw or one late test.
+		const uint32_t handle_index = m_scene.get_handle_index(object);
+
+		// the GPU decides whether these are drawn, and in which order
+		if(m_occlusion.is_enabled() && handle_index < m_occlusion.get_capacity())
+		{
+			packet.occlusion_objects.push_back({
+				.center 	  = glm::vec4(scene.world_center_x[object], scene.world_center_y[object], scene.world_center_z[object], 0.0f),
+				.extent 	  = glm::vec4(scene.world_extent_x[object], scene.world_extent_y[object], scene.world_extent_z[object], 0.0f),
+				.first_vertex = lod.first_vertex,
+				.vertex_count = lod.vertex_count,
+				.object 	  = handle_index
+			});
+			continue;
+		}
+
+		// reverse-Z: depth 1 is the near plane, so 1 - depth grows with the distance from the camera
+		const glm::vec4 clip = packet.view_projection * glm::vec4(scene.world_center_x[object], scene.world_center_y[object], scene.world_center_z[object], 1.0f);
+		const float view_depth = clip.w > 0.0f ? 1.0f - clip.z / clip.w : 0.0f;
+
+		packet.draws.push_back({
+			.sort_key 	   = vkdraw::make_opaque_sort_key(view_depth, scene.pipeline[object], scene.mesh[object]),
+			.vertex_buffer = m_mesh.buffer,
+			.first_vertex  = lod.first_vertex,
+			.vertex_count  = lod.vertex_count
+		});
+	}
+	vkdraw::sort_draws(packet.draws);
+}
+
 void Engine::cleanup()
 {
-	vkQueueWaitIdle(context.queue);
+	m_jobs.wait(m_scene_update);
+
+	// the compute queue may still run work the last graphics submit did not wait for
+	vkDeviceWaitIdle(context.device);
 
 	m_deletion_queue.flush();
 }
 
-void Engine::draw()
+void Engine::draw(FramePacket& packet)
 {
 	VK_CHECK(vkWaitForFences(context.device, 1, &get_current_frame().queue_submit_fence, true, UINT64_MAX));
 	VK_CHECK(vkResetFences(context.device, 1, &get_current_frame().queue_submit_fence));
+
+	// the previous use of this frame slot is done, hand its readback (if any) to the writer
+	m_capture.collect(frame_number % FRAME_OVERLAP);
+
+	// times the frames that ended; when pacing, waits until at most one frame is queued for the display
+	m_latency.begin_frame(frame_number % FRAME_OVERLAP, packet.publish_time);
+
+	// the GPU time of the slot's last frame picks the resolution of this one, and what it sheds
+	if(m_governor.is_enabled())
+	{
+		m_governor.begin_frame(frame_number % FRAME_OVERLAP);
+
+		const float scale = m_governor.get_scale();
+		context.render_extent = {
+			std::clamp(static_cast<uint32_t>(context.swapchain_dimensions.width * scale), 1u, context.render_target_extent.width),
+			std::clamp(static_cast<uint32_t>(context.swapchain_dimensions.height * scale), 1u, context.render_target_extent.height)
+		};
+		m_particles.set_emit_fraction(m_governor.get_particle_fraction());
+	}
+
+	// takes an export slot when a consumer is connected and has released one
+	const bool exported = m_export.begin_frame();
 	
-	// acquire next image
+	// alternate frame rendering: the GPU this frame renders on, 0 without a device group
+	const uint32_t frame_device = frame_number % context.device_count;
+	const uint32_t frame_device_mask = 1u << frame_device;
+	const uint32_t all_devices_mask = (1u << context.device_count) - 1;
+
+	// acquire next image, ready for the frame's GPU
+	VkAcquireNextImageInfoKHR acquire_info = {
+		.sType 		= VK_STRUCTURE_TYPE_ACQUIRE_NEXT_IMAGE_INFO_KHR,
+		.swapchain 	= context.swapchain,
+		.timeout 	= UINT64_MAX,
+		.semaphore 	= get_current_frame().swapchain_acquire_semaphore,
+		.deviceMask = frame_device_mask
+	};
+
 	uint32_t image;
-	VK_CHECK(vkAcquireNextImageKHR(context.device, context.swapchain, UINT64_MAX,
-											get_current_frame().swapchain_acquire_semaphore, VK_NULL_HANDLE, 
-											&image));
+	VK_CHECK(vkAcquireNextImage2KHR(context.device, &acquire_info, &image));
+	m_views.acquire(frame_number % FRAME_OVERLAP);
 	
 	
+	// compute of this frame overlaps the graphics work of the previous one still in flight
+	ComputeScheduler::Submission compute = m_compute.submit(frame_number);
+
 	// render triangle
 	VkCommandBuffer cmd = get_current_frame().primary_command_buffer;
 
 	vkResetCommandBuffer(cmd, 0);
 
+	// every GPU of a device group runs the frame's uploads, so their copies of the resources stay alike
+	VkDeviceGroupCommandBufferBeginInfo device_group_begin_info = {
+		.sType 		= VK_STRUCTURE_TYPE_DEVICE_GROUP_COMMAND_BUFFER_BEGIN_INFO,
+		.deviceMask = all_devices_mask
+	};
+
 	VkCommandBufferBeginInfo begin_info = { 
 		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.pNext = context.device_count > 1 ? &device_group_begin_info : nullptr,
 		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
 	};
 
 	VK_CHECK(vkBeginCommandBuffer(get_current_frame().primary_command_buffer, &begin_info));
 
-	// transition swapchain image to COLOR_ATTACHMENT_OPTIMAL
+	// mip uploads and copies, the UI pass samples the textures
+	m_textures.update(cmd, frame_number % FRAME_OVERLAP);
+
+	// the rest of the frame runs on its GPU only
+	if(context.device_count > 1)
+		vkCmdSetDeviceMask(cmd, frame_device_mask);
+
+	// the draws of the objects visible last frame, for the first half of the scene pass
+	if(m_occlusion.is_enabled())
+		m_occlusion.record_early_cull(cmd, frame_number % FRAME_OVERLAP, packet.occlusion_objects, packet.view_projection);
+
+	// a render scale below 1 renders the scene into its own image and upscales it into the swapchain image
+	const bool scaled = context.scene_image.image != VK_NULL_HANDLE;
+
+	// exporting through dma-buf, the frame is rendered into the slot's image and copied into the swapchain image at the end
+	const VkImage output_image = m_export.get_image() != VK_NULL_HANDLE ? m_export.get_image() : context.swapchain_images[image];
+	const VkImageView output_view = m_export.get_view() != VK_NULL_HANDLE ? m_export.get_view() : context.swapchain_image_views[image];
+
+	// transition the output image to COLOR_ATTACHMENT_OPTIMAL, or TRANSFER_DST_OPTIMAL for the upscale
 	vkutil::transition_image_layout(
 		cmd,
-		context.swapchain_images[image],
+		output_image,
 		VK_IMAGE_LAYOUT_UNDEFINED,
-		VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+		scaled ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
 		0,
-		VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
-		VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT,
-		VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT
+		scaled ? VK_ACCESS_2_TRANSFER_WRITE_BIT : VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+		VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+		scaled ? VK_PIPELINE_STAGE_2_BLIT_BIT : VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT
+	);
+
+	// transition depth attachment, the previous frame may still be testing against it
+	vkutil::transition_image_layout(
+		cmd,
+		context.depth_image.image,
+		VK_IMAGE_LAYOUT_UNDEFINED,
+		VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+		VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+		VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+		VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+		VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+		VK_IMAGE_ASPECT_DEPTH_BIT
 	);
 
+	if(context.samples != VK_SAMPLE_COUNT_1_BIT)
+	{
+		// like depth, shared by the frames in flight
+		vkutil::transition_image_layout(
+			cmd,
+			context.msaa_color_image.image,
+			VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+			VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+			VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+			VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT
+		);
+	}
+
+	if(scaled)
+	{
+		// the previous frame may still upscale from it
+		vkutil::transition_image_layout(
+			cmd,
+			context.scene_image.image,
+			VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			0,
+			VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+			VK_PIPELINE_STAGE_2_BLIT_BIT,
+			VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT
+		);
+	}
+
+	if(m_governor.is_enabled())
+		m_governor.record_begin(cmd, frame_number % FRAME_OVERLAP);
+
+	// the recorded draws read the UI-driven values from here, the slot's previous frame is done with it
+	*get_current_frame().uniforms_mapped = packet.constants;
+	VK_CHECK(vmaFlushAllocation(context.allocator, get_current_frame().uniforms.allocation, 0, VK_WHOLE_SIZE));
+
+	// the scene passes execute secondaries, re-recorded only when what they draw changed
+	VkPipeline pipeline = context.graphics_pipeline_library ? m_pipeline_library.get() : context.pipeline;
+	uint64_t extent_key = static_cast<uint64_t>(context.render_extent.width) << 32 | context.render_extent.height;
+	uint64_t draws_key = vkdraw::hash_draws(packet.draws, reinterpret_cast<uint64_t>(pipeline) ^ extent_key);
+	CommandStats command_stats;
+
+	// the views record their scene passes on the workers meanwhile, each into its own command buffer
+	m_view_frame = {
+		.packet   = &packet,
+		.pipeline = pipeline
+	};
+	for(uint32_t view = 0; view < m_views.get_count(); view++)
+	{
+		m_jobs.run(m_view_recording, [](void* data, uint32_t begin, uint32_t)
+		{
+			static_cast<Engine*>(data)->record_view(begin);
+		}, this, view, view + 1);
+	}
+
+	VkCommandBufferInheritanceRenderingInfo scene_inheritance = {
+		.sType 					 = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO,
+		.colorAttachmentCount 	 = 1,
+		.pColorAttachmentFormats = &context.swapchain_dimensions.format,
+		.depthAttachmentFormat 	 = context.depth_image.format,
+		.rasterizationSamples 	 = context.samples
+	};
+
+	VkRect2D render_area = {
+		.offset = {0, 0},
+		.extent = context.render_extent
+	};
+
+	// a render pass instance defaults to the initial device mask, every GPU of the group
+	VkDeviceGroupRenderPassBeginInfo device_group_pass = {
+		.sType 		= VK_STRUCTURE_TYPE_DEVICE_GROUP_RENDER_PASS_BEGIN_INFO,
+		.deviceMask = frame_device_mask
+	};
+	const void* rendering_next = context.device_count > 1 ? &device_group_pass : nullptr;
+
+	// reverse-Z: cleared to 0 (infinitely far), nearer fragments have greater depth
+	VkClearValue depth_clear_value = { .depthStencil = { 0.0f, 0 } };
+	VkRenderingAttachmentInfo depth_attachment = {
+		.sType       = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+	    .imageView   = context.depth_image.view,
+	    .imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+	    .loadOp      = VK_ATTACHMENT_LOAD_OP_CLEAR,
+	    .storeOp     = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+	    .clearValue  = depth_clear_value
+	};
+
+	RasterState mesh_state = {
+		.depth_test    = VK_TRUE,
+		.depth_write   = VK_TRUE,
+		.depth_compare = VK_COMPARE_OP_GREATER_OR_EQUAL
+	};
+
+	if(m_options.depth_prepass)
+	{
+		depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+
+		VkRenderingInfo prepass_info = {
+			.sType 			  = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR,
+			.pNext 			  = rendering_next,
+			.flags 			  = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT,
+			.renderArea 	  = render_area,
+			.layerCount 	  = 1,
+			.pDepthAttachment = &depth_attachment
+		};
+
+		VkCommandBufferInheritanceRenderingInfo prepass_inheritance = scene_inheritance;
+		prepass_inheritance.colorAttachmentCount = 0;
+		prepass_inheritance.pColorAttachmentFormats = nullptr;
+
+		VkCommandBuffer prepass_cmd = get_scene_pass(SCENE_PASS_DEPTH_PREPASS, draws_key, prepass_inheritance, [&]()
+		{
+			record_draws(m_recorder, context.render_extent, context.depth_prepass_pipeline, mesh_state, packet.draws);
+		}, command_stats);
+
+		vkCmdBeginRendering(cmd, &prepass_info);
+		vkCmdExecuteCommands(cmd, 1, &prepass_cmd);
+		vkCmdEndRendering(cmd);
+
+		// the color pass only shades the fragments that won the prepass
+		vkutil::transition_image_layout(
+			cmd,
+			context.depth_image.image,
+			VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+			VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+			VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+			VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+			VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+			VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+			VK_IMAGE_ASPECT_DEPTH_BIT
+		);
+
+		depth_attachment.loadOp  = VK_ATTACHMENT_LOAD_OP_LOAD;
+		depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		mesh_state.depth_write   = VK_FALSE;
+		mesh_state.depth_compare = VK_COMPARE_OP_EQUAL;
+	}
+
+	VkImage scene_image = scaled ? context.scene_image.image : output_image;
+	VkImageView scene_view = scaled ? context.scene_image.view : output_view;
+
 	VkClearValue clear_value = {{{0.01f, 0.01f, 0.033f, 1.0f}}};
 	VkRenderingAttachmentInfo color_attachment = {
 		.sType       = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
-	    .imageView   = context.swapchain_image_views[image],
+	    .imageView   = scene_view,
 	    .imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
 	    .loadOp      = VK_ATTACHMENT_LOAD_OP_CLEAR,
 	    .storeOp     = VK_ATTACHMENT_STORE_OP_STORE,
 	    .clearValue  = clear_value
 	};
 
+	// MSAA: the samples stay in the transient image, only the resolve at the end of the pass is stored
+	if(context.samples != VK_SAMPLE_COUNT_1_BIT)
+	{
+		color_attachment.imageView 			= context.msaa_color_image.view;
+		color_attachment.resolveMode 		= VK_RESOLVE_MODE_AVERAGE_BIT;
+		color_attachment.resolveImageView 	= scene_view;
+		color_attachment.resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		color_attachment.storeOp 			= VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	}
+
 	// begin rendering
 	VkRenderingInfo rendering_info = {
 		.sType                = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR,
-	    .renderArea           = {                         													
-			.offset 		  = {0, 0},        																
-			.extent 		  = { context.swapchain_dimensions.width, context.swapchain_dimensions.height } 
-		},
+		.pNext 				  = rendering_next,
+		.flags 				  = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT,
+	    .renderArea           = render_area,
 		.layerCount 		  = 1,
 	    .colorAttachmentCount = 1,
-	    .pColorAttachments    = &color_attachment
+	    .pColorAttachments    = &color_attachment,
+	    .pDepthAttachment     = &depth_attachment
 	};
 
+	// occlusion culling: the early half keeps its depth, the pyramid is built from it
+	if(m_occlusion.is_enabled())
+		depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+
+	// the indirect draws of occlusion culling and particles read per-slot buffers, they are static too
+	VkCommandBuffer main_cmd = get_scene_pass(SCENE_PASS_MAIN, draws_key, scene_inheritance, [&]()
+	{
+		record_draws(m_recorder, context.render_extent, pipeline, mesh_state, packet.draws);
+
+		if(m_occlusion.is_enabled())
+			record_occlusion_draws(pipeline, mesh_state, OCCLUSION_PHASE_EARLY);
+		else if(m_particles.is_enabled())
+			m_particles.record_draw(m_recorder, frame_number % FRAME_OVERLAP, context.render_extent);
+	}, command_stats);
+
 	vkCmdBeginRendering(cmd, &rendering_info);
+	vkCmdExecuteCommands(cmd, 1, &main_cmd);
 
-	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, context.pipeline);
+	if(m_occlusion.is_enabled())
+	{
+		vkCmdEndRendering(cmd);
+
+		// test every object against what the early half drew, the second half adds the ones that became visible
+		m_occlusion.record_late_cull(cmd, frame_number % FRAME_OVERLAP);
+
+		vkutil::transition_image_layout(
+			cmd,
+			scene_image,
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+			VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+			VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+			VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT
+		);
+
+		color_attachment.loadOp  = VK_ATTACHMENT_LOAD_OP_LOAD;
+		depth_attachment.loadOp  = VK_ATTACHMENT_LOAD_OP_LOAD;
+		depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+		VkCommandBuffer late_cmd = get_scene_pass(SCENE_PASS_LATE, reinterpret_cast<uint64_t>(pipeline) ^ extent_key, scene_inheritance, [&]()
+		{
+			record_occlusion_draws(pipeline, mesh_state, OCCLUSION_PHASE_LATE);
 
-	// Set dynamic states
+			if(m_particles.is_enabled())
+				m_particles.record_draw(m_recorder, frame_number % FRAME_OVERLAP, context.render_extent);
+		}, command_stats);
 
-	// Set viewport dynamically
-	VkViewport vp{
-	    .width    = static_cast<float>(context.swapchain_dimensions.width),
-	    .height   = static_cast<float>(context.swapchain_dimensions.height),
-	    .minDepth = 0.0f,
-	    .maxDepth = 1.0f};
+		vkCmdBeginRendering(cmd, &rendering_info);
+		vkCmdExecuteCommands(cmd, 1, &late_cmd);
+	}
 
-	vkCmdSetViewport(cmd, 0, 1, &vp);
+	vkCmdEndRendering(cmd);
 
-	// Set scissor dynamically
-	VkRect2D scissor{
-	    .extent = {
-	        .width  = context.swapchain_dimensions.width,
-	        .height = context.swapchain_dimensions.height}};
+	// for the UI thread, which shows them next to the frame; a replayed pass records nothing
+	m_commands_recorded.store(command_stats.recorded, std::memory_order_relaxed);
+	m_commands_eliminated.store(command_stats.eliminated, std::memory_order_relaxed);
 
-	vkCmdSetScissor(cmd, 0, 1, &scissor);
+	VkRect2D output_area = {
+		.offset = {0, 0},
+		.extent = { context.swapchain_dimensions.width, context.swapchain_dimensions.height }
+	};
 
-	VkDeviceSize offSets = { 0 };
+	if(scaled)
+	{
+		vkutil::transition_image_layout(
+			cmd,
+			context.scene_image.image,
+			VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+			VK_ACCESS_2_TRANSFER_READ_BIT,
+			VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+			VK_PIPELINE_STAGE_2_BLIT_BIT
+		);
+
+		// bilinear upscale to the window resolution, the UI is drawn on top at full resolution
+		VkImageBlit upscale = {
+			.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+			.srcOffsets 	= { { 0, 0, 0 }, { static_cast<int32_t>(context.render_extent.width), static_cast<int32_t>(context.render_extent.height), 1 } },
+			.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+			.dstOffsets 	= { { 0, 0, 0 }, { static_cast<int32_t>(output_area.extent.width), static_cast<int32_t>(output_area.extent.height), 1 } }
+		};
 
-	vkCmdBindVertexBuffers(cmd, 0, 1, &m_mesh.buffer, &offSets);
-	vkCmdPushConstants(cmd, context.pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(GPUMeshConstant), &m_colors);
+		vkCmdBlitImage(cmd, context.scene_image.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, output_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &upscale, VK_FILTER_LINEAR);
+	}
 
-	vkCmdDraw(cmd, 3, 1, 0, 0);
+	// captured without the UI, whose live stats differ from run to run
+	m_capture.record(cmd, output_image, scaled ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, frame_number % FRAME_OVERLAP, frame_number);
 
-	ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmd);
+	// UI in its own pass: a render pass instance either records inline or executes secondaries
+	vkutil::transition_image_layout(
+		cmd,
+		output_image,
+		scaled ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+		VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+		scaled ? VK_ACCESS_2_TRANSFER_WRITE_BIT : VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+		VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+		scaled ? VK_PIPELINE_STAGE_2_BLIT_BIT : VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+		VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT
+	);
+
+	// single-sampled at window resolution, whatever the scene pass used
+	VkRenderingAttachmentInfo ui_color_attachment = {
+		.sType       = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+	    .imageView   = output_view,
+	    .imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+	    .loadOp      = VK_ATTACHMENT_LOAD_OP_LOAD,
+	    .storeOp     = VK_ATTACHMENT_STORE_OP_STORE
+	};
 
+	VkRenderingInfo ui_rendering_info = {
+		.sType                = VK_STRUCTURE_TYPE_RENDERING_INFO_KHR,
+		.pNext 				  = rendering_next,
+		.flags 				  = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT,
+	    .renderArea           = output_area,
+		.layerCount 		  = 1,
+	    .colorAttachmentCount = 1,
+	    .pColorAttachments    = &ui_color_attachment
+	};
+
+	VkCommandBuffer ui_cmd = m_ui_cache.get(packet.ui);
+
+	vkCmdBeginRendering(cmd, &ui_rendering_info);
+	vkCmdExecuteCommands(cmd, 1, &ui_cmd);
 	vkCmdEndRendering(cmd);
 
+	// the consumer gets the frame with the UI, as the window shows it
+	if(exported)
+		m_export.record_export(cmd, context.swapchain_images[image]);
+
 	// transition the swapchain image to PRESENT_SRC
 	vkutil::transition_image_layout(
 	    cmd,
@@ -159,38 +750,232 @@ void Engine::draw()
 	    VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,        // srcStage
 	    VK_PIPELINE_STAGE_2_BOTTOM_OF_PIPE_BIT                  // dstStage
 	);
+
+	// without present wait, the frame ends where the GPU finished it
+	m_latency.record_end_of_frame(cmd, frame_number % FRAME_OVERLAP);
+
+	if(m_governor.is_enabled())
+		m_governor.record_end(cmd, frame_number % FRAME_OVERLAP);
 	
 	VK_CHECK(vkEndCommandBuffer(cmd));
 
-	// submit
-	VkPipelineStageFlags wait_stage = { VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT };
-	VkSubmitInfo submit_info = {
-		.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-	    .waitSemaphoreCount   = 1,
-	    .pWaitSemaphores      = &get_current_frame().swapchain_acquire_semaphore,
-	    .pWaitDstStageMask    = &wait_stage,
-	    .commandBufferCount   = 1,
-	    .pCommandBuffers      = &cmd,
-	    .signalSemaphoreCount = 1,
-	    .pSignalSemaphores    = &get_current_frame().swapchain_release_semaphore
+	// submit, waiting for the compute passes of this frame only where their results are read
+	FixedVector<VkSemaphoreSubmitInfo, MAX_VIEWS + 1> wait_infos;
+	wait_infos.push_back({
+		.sType 		 = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+		.semaphore 	 = get_current_frame().swapchain_acquire_semaphore,
+		.stageMask 	 = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+		.deviceIndex = frame_device
+	});
+
+	if(compute.wait_value > 0)
+	{
+		wait_infos.push_back({
+			.sType 	   = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+			.semaphore = m_compute.get_compute_timeline(),
+			.value 	   = compute.wait_value,
+			.stageMask = compute.wait_stages
+		});
+	}
+
+	VkSemaphoreSubmitInfo signal_infos[3] = {
+		{
+			.sType 		 = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+			.semaphore 	 = get_current_frame().swapchain_release_semaphore,
+			.stageMask 	 = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+			.deviceIndex = frame_device
+		},
+		{
+			.sType 	   = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+			.semaphore = m_compute.get_graphics_timeline(),
+			.value 	   = m_compute.get_graphics_value(frame_number),
+			.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT
+		}
 	};
 
-	VK_CHECK(vkQueueSubmit(context.queue, 1, &submit_info, get_current_frame().queue_submit_fence));
+	// the consumer waits for this one
+	if(exported)
+		signal_infos[2] = m_export.get_ready_signal();
+
+	FixedVector<VkCommandBufferSubmitInfo, MAX_VIEWS> cmd_infos;
+	cmd_infos.push_back({
+		.sType 		   = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+		.commandBuffer = cmd,
+		.deviceMask    = all_devices_mask
+	});
+
+	// one batch for every window; the release semaphore signals when all of them are rendered
+	m_jobs.wait(m_view_recording);
+	for(uint32_t view = 0; view < m_views.get_count(); view++)
+	{
+		wait_infos.push_back({
+			.sType 	   = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+			.semaphore = m_views.get_acquire_semaphore(view, frame_number % FRAME_OVERLAP),
+			.stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT
+		});
+
+		cmd_infos.push_back({
+			.sType 		   = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+			.commandBuffer = m_views.get_command_buffer(view, frame_number % FRAME_OVERLAP),
+			.deviceMask    = all_devices_mask
+		});
+	}
+
+	VkSubmitInfo2 submit_info = {
+		.sType 					  = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+		.waitSemaphoreInfoCount   = wait_infos.size(),
+		.pWaitSemaphoreInfos 	  = wait_infos.data(),
+		.commandBufferInfoCount   = cmd_infos.size(),
+		.pCommandBufferInfos 	  = cmd_infos.data(),
+		.signalSemaphoreInfoCount = exported ? 3u : 2u,
+		.pSignalSemaphoreInfos 	  = signal_infos
+	};
+
+	VK_CHECK(vkQueueSubmit2(context.queue, 1, &submit_info, get_current_frame().queue_submit_fence));
+
+	// present every window at once, the main window first
+	FixedVector<VkSwapchainKHR, MAX_VIEWS> swapchains;
+	FixedVector<uint32_t, MAX_VIEWS> images;
+	swapchains.push_back(context.swapchain);
+	images.push_back(image);
+	for(uint32_t view = 0; view < m_views.get_count(); view++)
+	{
+		swapchains.push_back(m_views.get_swapchain(view));
+		images.push_back(m_views.get_image(view));
+	}
 
-	// present
 	VkPresentInfoKHR present_info = {
 		.sType              = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
 	    .waitSemaphoreCount = 1,
 	    .pWaitSemaphores    = &get_current_frame().swapchain_release_semaphore,
-	    .swapchainCount     = 1,
-	    .pSwapchains        = &context.swapchain,
-	    .pImageIndices      = &image
+	    .swapchainCount     = swapchains.size(),
+	    .pSwapchains        = swapchains.data(),
+	    .pImageIndices      = images.data()
+	};
+
+	// the frame's GPU presents its image, or hands it to one that can
+	VkDeviceGroupPresentInfoKHR device_group_present = {
+		.sType 			= VK_STRUCTURE_TYPE_DEVICE_GROUP_PRESENT_INFO_KHR,
+		.swapchainCount = 1,
+		.pDeviceMasks 	= &frame_device_mask,
+		.mode 			= context.device_present_modes[frame_device]
 	};
+
+	if(context.device_count > 1)
+		present_info.pNext = &device_group_present;
+
+	VkPresentIdKHR present_id;
+	m_latency.prepare_present(present_info, present_id);
+
 	VK_CHECK(vkQueuePresentKHR(context.queue, &present_info));
+	m_latency.end_frame(frame_number % FRAME_OVERLAP, packet.input_time);
 
 	frame_number++;
 }
 
+void Engine::kick_scene_update()
+{
+	m_jobs.run(m_scene_update, [](void* data, uint32_t, uint32_t)
+	{
+		Engine* engine = static_cast<Engine*>(data);
+		engine->m_scene.update(engine->m_view_projection, engine->m_jobs);
+	}, this);
+}
+
+void Engine::set_mesh_state(CommandRecorder& recorder, VkExtent2D extent, VkPipeline pipeline, const RasterState& state)
+{
+	// binds and dynamic states repeated by consecutive draws (or passes) are filtered by the recorder
+	recorder.bind_pipeline(VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+
+	VkViewport viewport = {
+	    .width    = static_cast<float>(extent.width),
+	    .height   = static_cast<float>(extent.height),
+	    .minDepth = 0.0f,
+	    .maxDepth = 1.0f
+	};
+	recorder.set_viewport(viewport);
+
+	VkRect2D scissor = {
+	    .extent = extent
+	};
+	recorder.set_scissor(scissor);
+
+	recorder.set_raster_state(state);
+
+	recorder.bind_descriptor_set(VK_PIPELINE_BIND_POINT_GRAPHICS, context.pipeline_layout, 0, get_current_frame().frame_set);
+}
+
+void Engine::record_draws(CommandRecorder& recorder, VkExtent2D extent, VkPipeline pipeline, const RasterState& state, const std::vector<DrawCommand>& draws)
+{
+	set_mesh_state(recorder, extent, pipeline, state);
+
+	for(const DrawCommand& draw : draws)
+	{
+		recorder.bind_vertex_buffer(0, draw.vertex_buffer, 0, sizeof(Vertex));
+
+		recorder.draw(draw.vertex_count, 1, draw.first_vertex);
+	}
+}
+
+void Engine::record_occlusion_draws(VkPipeline pipeline, const RasterState& state, OcclusionPhase phase)
+{
+	set_mesh_state(m_recorder, context.render_extent, pipeline, state);
+
+	m_recorder.bind_vertex_buffer(0, m_mesh.buffer, 0, sizeof(Vertex));
+
+	m_occlusion.record_draws(m_recorder, frame_number % FRAME_OVERLAP, phase);
+}
+
+VkCommandBuffer Engine::get_scene_pass(ScenePass pass, uint64_t key, const VkCommandBufferInheritanceRenderingInfo& rendering, FunctionRef<void()> record, CommandStats& stats)
+{
+	return m_static_passes.get(frame_number % FRAME_OVERLAP, pass, key, rendering, [&](VkCommandBuffer secondary)
+	{
+		// nothing is bound in a new secondary, the recorder starts from scratch
+		m_recorder.begin(secondary, context.extended_dynamic_state3);
+		record();
+
+		stats.recorded 	 += m_recorder.get_stats().recorded;
+		stats.eliminated += m_recorder.get_stats().eliminated;
+	});
+}
+
+/**
+ * @brief Record the scene pass of a view, on a job worker while the render thread records the main window
+ *
+ * The view draws the main window's draw list and particles without a
+ * prepass; the uniforms of the slot were written before the job was kicked.
+ * @param view Index in m_views
+ */
+void Engine::record_view(uint32_t view)
+{
+	const uint32_t slot = frame_number % FRAME_OVERLAP;
+
+	m_views.record(view, slot, [this, slot](CommandRecorder& recorder, VkExtent2D extent)
+	{
+		RasterState mesh_state = {
+			.depth_test    = VK_TRUE,
+			.depth_write   = VK_TRUE,
+			.depth_compare = VK_COMPARE_OP_GREATER_OR_EQUAL
+		};
+		record_draws(recorder, extent, m_view_frame.pipeline, mesh_state, m_view_frame.packet->draws);
+
+		if(m_particles.is_enabled())
+			m_particles.record_draw(recorder, slot, extent);
+	});
+}
+
+void Engine::init_jobs()
+{
+	// the render thread submits the recording of the views
+	m_jobs.init(m_options.worker_count, 1);
+	m_deletion_queue.deletors.push_back([this]()
+	{
+		std::cout << "stopping job system" << '\n';
+		m_jobs.shutdown();
+	});
+
+	std::cout << "job system workers: " << m_jobs.get_worker_count() << '\n';
+}
 
 void Engine::init_vulkan()
 {
@@ -204,6 +989,9 @@ void Engine::init_vulkan()
 	
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
 	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+
+	// a capture run is not watched, it renders into a hidden window (on CI, one of a virtual display)
+	glfwWindowHint(GLFW_VISIBLE, m_options.capture_dir.empty() ? GLFW_TRUE : GLFW_FALSE);
 	m_window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, APP_NAME, nullptr, nullptr);
 	if(m_window == nullptr)
 		throw std::runtime_error("Failed to create window");
@@ -256,76 +1044,218 @@ void Engine::init_vulkan()
 		vkDestroySurfaceKHR(context.instance, context.surface, nullptr);
 	});
 
-	// select physical device
-	uint32_t gpu_count;
-	VK_CHECK(vkEnumeratePhysicalDevices(context.instance, &gpu_count, nullptr));
-	if(gpu_count < 1)
-		throw std::runtime_error("No physical device found.");
-	std::vector<VkPhysicalDevice> gpus(gpu_count);
-	VK_CHECK(vkEnumeratePhysicalDevices(context.instance, &gpu_count, gpus.data()));
+	// select physical device: the best scoring one, or the one --gpu names
+	std::vector<DeviceCandidate> candidates = vkdevice::rank_devices(context.instance, context.surface, m_options.device_group);
+	const DeviceCandidate& selected = vkdevice::choose_device(candidates, m_options.gpu);
+
+	context.gpu = selected.gpu;
+	context.graphics_queue_index = selected.families.graphics;
+	context.compute_queue_index = m_options.async_compute ? selected.families.compute : selected.families.graphics;
+	std::cout << "selected gpu [" << selected.index << "] " << selected.properties.deviceName << '\n';
+
+	// query available device extensions
+	uint32_t device_extension_count;
+	VK_CHECK(vkEnumerateDeviceExtensionProperties(context.gpu, nullptr, &device_extension_count, nullptr));
+	std::vector<VkExtensionProperties> available_device_extensions(device_extension_count);
+	VK_CHECK(vkEnumerateDeviceExtensionProperties(context.gpu, nullptr, &device_extension_count, available_device_extensions.data()));
+
+	auto is_extension_available = [&available_device_extensions](const char* name)
+	{
+		for(const auto& extension : available_device_extensions)
+			if(strcmp(extension.extensionName, name) == 0)
+				return true;
+		return false;
+	};
+
+	// query vulkan 1.3 features, optional extension features are appended to the chain when available
+	std::vector<const char*> required_device_extensions {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+	VkPhysicalDeviceFeatures2 query_device_features2{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
+	VkPhysicalDeviceVulkan12Features query_vulkan12_features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+	VkPhysicalDeviceVulkan13Features query_vulkan13_features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES};
+	VkPhysicalDeviceExtendedDynamicStateFeaturesEXT query_extended_dynamic_state_features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT};
+	VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT query_graphics_pipeline_library_features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT};
+	VkPhysicalDeviceExtendedDynamicState3FeaturesEXT query_extended_dynamic_state3_features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT};
+	query_device_features2.pNext = &query_vulkan12_features;
+	query_vulkan12_features.pNext = &query_vulkan13_features;
+	query_vulkan13_features.pNext = &query_extended_dynamic_state_features;
+	void** query_chain = &query_extended_dynamic_state_features.pNext;
+
+	bool graphics_pipeline_library_available = is_extension_available(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME)
+											&& is_extension_available(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+	if(graphics_pipeline_library_available)
+	{
+		*query_chain = &query_graphics_pipeline_library_features;
+		query_chain = &query_graphics_pipeline_library_features.pNext;
+	}
+
+	bool extended_dynamic_state3_available = is_extension_available(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME);
+	if(extended_dynamic_state3_available)
+	{
+		*query_chain = &query_extended_dynamic_state3_features;
+		query_chain = &query_extended_dynamic_state3_features.pNext;
+	}
+
+	VkPhysicalDevicePresentIdFeaturesKHR query_present_id_features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR};
+	VkPhysicalDevicePresentWaitFeaturesKHR query_present_wait_features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR};
+	bool present_wait_available = is_extension_available(VK_KHR_PRESENT_ID_EXTENSION_NAME)
+							   && is_extension_available(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+	if(present_wait_available)
+	{
+		*query_chain = &query_present_id_features;
+		query_present_id_features.pNext = &query_present_wait_features;
+		query_chain = &query_present_wait_features.pNext;
+	}
+
+	vkGetPhysicalDeviceFeatures2(context.gpu, &query_device_features2);
+
+	if(!query_vulkan13_features.dynamicRendering)
+		throw std::runtime_error("Dynamic Rendering feature is missing");
+	if(!query_vulkan13_features.synchronization2)
+		throw std::runtime_error("Synchronization2 feature is missing");
+	if(!query_vulkan12_features.timelineSemaphore)
+		throw std::runtime_error("Timeline Semaphore feature is missing");
+	if(!query_extended_dynamic_state_features.extendedDynamicState)
+		throw std::runtime_error("Extended Dynamic State feature is missing");
+
+	VkPhysicalDeviceExtendedDynamicStateFeaturesEXT enable_extended_dynamic_state_features = {
+	    .sType 				  = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT,
+	    .extendedDynamicState = VK_TRUE
+	};
+	void** enable_chain = &enable_extended_dynamic_state_features.pNext;
+
+	// optional: fast-linked pipelines from pre-compiled parts
+	VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT enable_graphics_pipeline_library_features = {
+		.sType 					 = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT,
+		.graphicsPipelineLibrary = VK_TRUE
+	};
+
+	if(graphics_pipeline_library_available && query_graphics_pipeline_library_features.graphicsPipelineLibrary)
+	{
+		required_device_extensions.push_back(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME);
+		required_device_extensions.push_back(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+		*enable_chain = &enable_graphics_pipeline_library_features;
+		enable_chain = &enable_graphics_pipeline_library_features.pNext;
+		context.graphics_pipeline_library = true;
+	}
+
+	// optional: polygon mode and blend state recorded per draw
+	VkPhysicalDeviceExtendedDynamicState3FeaturesEXT enable_extended_dynamic_state3_features = {
+		.sType 									 = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT,
+		.extendedDynamicState3PolygonMode 		 = VK_TRUE,
+		.extendedDynamicState3ColorBlendEnable 	 = VK_TRUE,
+		.extendedDynamicState3ColorBlendEquation = VK_TRUE,
+		.extendedDynamicState3ColorWriteMask 	 = VK_TRUE
+	};
+
+	if(extended_dynamic_state3_available
+		&& query_extended_dynamic_state3_features.extendedDynamicState3PolygonMode
+		&& query_extended_dynamic_state3_features.extendedDynamicState3ColorBlendEnable
+		&& query_extended_dynamic_state3_features.extendedDynamicState3ColorBlendEquation
+		&& query_extended_dynamic_state3_features.extendedDynamicState3ColorWriteMask)
+	{
+		required_device_extensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME);
+		*enable_chain = &enable_extended_dynamic_state3_features;
+		enable_chain = &enable_extended_dynamic_state3_features.pNext;
+		context.extended_dynamic_state3 = true;
+	}
+
+	// optional: present ids the render thread can wait on, to time presents and pace frames
+	VkPhysicalDevicePresentWaitFeaturesKHR enable_present_wait_features = {
+		.sType 		 = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR,
+		.presentWait = VK_TRUE
+	};
+
+	VkPhysicalDevicePresentIdFeaturesKHR enable_present_id_features = {
+		.sType 	   = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR,
+		.pNext 	   = &enable_present_wait_features,
+		.presentId = VK_TRUE
+	};
+
+	if(present_wait_available && query_present_id_features.presentId && query_present_wait_features.presentWait)
+	{
+		required_device_extensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+		required_device_extensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+		*enable_chain = &enable_present_id_features;
+		enable_chain = &enable_present_wait_features.pNext;
+		context.present_wait = true;
+	}
+
+	// optional: GPU timestamps mapped to the CPU clock, the latency fallback without present wait; a device group
+	// writes each frame's timestamp on a different GPU, so the fence is used there instead
+	if(!context.present_wait && !m_options.device_group && is_extension_available(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME)
+		&& LatencyMonitor::get_host_time_domain() != VK_TIME_DOMAIN_DEVICE_EXT)
+	{
+		auto get_time_domains = reinterpret_cast<PFN_vkGetPhysicalDeviceCalibrateableTimeDomainsEXT>(
+			vkGetInstanceProcAddr(context.instance, "vkGetPhysicalDeviceCalibrateableTimeDomainsEXT"));
+
+		uint32_t time_domain_count = 0;
+		if(get_time_domains)
+			VK_CHECK(get_time_domains(context.gpu, &time_domain_count, nullptr));
+		std::vector<VkTimeDomainEXT> time_domains(time_domain_count);
+		if(time_domain_count > 0)
+			VK_CHECK(get_time_domains(context.gpu, &time_domain_count, time_domains.data()));
+
+		uint32_t queue_family_count = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(context.gpu, &queue_family_count, nullptr);
+		std::vector<VkQueueFamilyProperties> queue_families(queue_family_count);
+		vkGetPhysicalDeviceQueueFamilyProperties(context.gpu, &queue_family_count, queue_families.data());
+
+		bool host_domain = std::find(time_domains.begin(), time_domains.end(), LatencyMonitor::get_host_time_domain()) != time_domains.end();
+		bool device_domain = std::find(time_domains.begin(), time_domains.end(), VK_TIME_DOMAIN_DEVICE_EXT) != time_domains.end();
+
+		if(host_domain && device_domain && queue_families[context.graphics_queue_index].timestampValidBits > 0)
+		{
+			required_device_extensions.push_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+			context.calibrated_timestamps = true;
+		}
+	}
+
+	// optional: one logical device over every GPU linked to the selected one, frames alternate between them
+	VkPhysicalDeviceGroupProperties device_group = vkdevice::find_device_group(context.instance, context.gpu);
+	VkDeviceGroupDeviceCreateInfo device_group_info = {
+		.sType 				 = VK_STRUCTURE_TYPE_DEVICE_GROUP_DEVICE_CREATE_INFO,
+		.physicalDeviceCount = device_group.physicalDeviceCount,
+		.pPhysicalDevices 	 = device_group.physicalDevices
+	};
+
+	if(m_options.device_group && device_group.physicalDeviceCount > 1)
+	{
+		*enable_chain = &device_group_info;
+		enable_chain = &device_group_info.pNext;
+		context.device_count = device_group.physicalDeviceCount;
+	}
 
-	for(const auto &physical_device : gpus)
+	// frame export: fds for the semaphores and the memory, then dma-buf images or imported host memory, whichever the device has
+	if(!m_options.export_socket.empty())
 	{
-		VkPhysicalDeviceProperties device_properties;
-		vkGetPhysicalDeviceProperties(physical_device, &device_properties);
+		if(!is_extension_available(VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME) || !is_extension_available(VK_KHR_EXTERNAL_SEMAPHORE_FD_EXTENSION_NAME))
+			throw std::runtime_error("Frame export requires VK_KHR_external_memory_fd and VK_KHR_external_semaphore_fd");
 
-		std::cout << "maxPerStageDescriptorUniformBuffers: " << device_properties.limits.maxPerStageDescriptorUniformBuffers << '\n';
+		required_device_extensions.push_back(VK_KHR_EXTERNAL_MEMORY_FD_EXTENSION_NAME);
+		required_device_extensions.push_back(VK_KHR_EXTERNAL_SEMAPHORE_FD_EXTENSION_NAME);
 
-		if(device_properties.apiVersion < VK_API_VERSION_1_3)
+		if(is_extension_available(VK_EXT_EXTERNAL_MEMORY_DMA_BUF_EXTENSION_NAME))
 		{
-			std::cout << "Physical device " << device_properties.deviceName << " does not support Vulkan 1.3, skipping." << std::endl;
-			continue;
+			required_device_extensions.push_back(VK_EXT_EXTERNAL_MEMORY_DMA_BUF_EXTENSION_NAME);
+			context.export_dma_buf = true;
 		}
 
-		uint32_t queue_family_count = 0;
-		vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count, nullptr);
-
-		std::vector<VkQueueFamilyProperties> queue_family_properties(queue_family_count);
-		vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count, queue_family_properties.data());
-
-		for(uint32_t i = 0; i < queue_family_count; i++)
+		if(is_extension_available(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME))
 		{
-			VkBool32 supports_present = VK_FALSE;
-			vkGetPhysicalDeviceSurfaceSupportKHR(physical_device, i, context.surface, &supports_present);
-
-			if((queue_family_properties[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) && supports_present)
-			{
-				context.graphics_queue_index = i;
-				break;
-			}
+			required_device_extensions.push_back(VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME);
+			context.export_host_memory = true;
 		}
 
-		if(context.graphics_queue_index >= 0)
-		{
-			context.gpu = physical_device;
-			break;
-		}
+		if(!context.export_dma_buf && !context.export_host_memory)
+			throw std::runtime_error("Frame export requires VK_EXT_external_memory_dma_buf or VK_EXT_external_memory_host");
 	}
 
-	if(context.graphics_queue_index < 0)
-		throw std::runtime_error("Failed to find a suitable GPU with Vulkan 1.3 support.");
-
-	// query vulkan 1.3 features
-	std::vector<const char*> required_device_extensions {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
-	VkPhysicalDeviceFeatures2 query_device_features2{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2};
-	VkPhysicalDeviceVulkan13Features query_vulkan13_features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES};
-	VkPhysicalDeviceExtendedDynamicStateFeaturesEXT query_extended_dynamic_state_features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT};
-	query_device_features2.pNext = &query_vulkan13_features;
-	query_vulkan13_features.pNext = &query_extended_dynamic_state_features;
-
-	vkGetPhysicalDeviceFeatures2(context.gpu, &query_device_features2);
-
-	if(!query_vulkan13_features.dynamicRendering)
-		throw std::runtime_error("Dynamic Rendering feature is missing");
-	if(!query_vulkan13_features.synchronization2)
-		throw std::runtime_error("Synchronization2 feature is missing");
-	if(!query_extended_dynamic_state_features.extendedDynamicState)
-		throw std::runtime_error("Extended Dynamic State feature is missing");
-
-	VkPhysicalDeviceExtendedDynamicStateFeaturesEXT enable_extended_dynamic_state_features = {
-	    .sType 				  = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT,
-	    .extendedDynamicState = VK_TRUE
-	};
+	std::cout << "graphics pipeline library: " << (context.graphics_pipeline_library ? "enabled" : "unavailable") << '\n';
+	std::cout << "extended dynamic state 3: " << (context.extended_dynamic_state3 ? "enabled" : "unavailable") << '\n';
+	std::cout << "present wait: " << (context.present_wait ? "enabled" : (context.calibrated_timestamps ? "unavailable, calibrated timestamps enabled" : "unavailable")) << '\n';
+	std::cout << "async compute: " << (context.compute_queue_index != context.graphics_queue_index ? "dedicated queue family" : "graphics queue") << '\n';
+	if(m_options.device_group)
+		std::cout << "device group: " << (context.device_count > 1 ? std::to_string(context.device_count) + " GPUs" : "unavailable, the GPU is not linked to another") << '\n';
 
 	VkPhysicalDeviceVulkan13Features enable_vulkan13_features = {
 	    .sType 			  = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
@@ -334,26 +1264,54 @@ void Engine::init_vulkan()
 	    .dynamicRendering = VK_TRUE,
 	};
 
+	VkPhysicalDeviceVulkan12Features enable_vulkan12_features = {
+	    .sType 			   = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+	    .pNext 			   = &enable_vulkan13_features,
+	    .drawIndirectCount = m_options.occlusion_culling ? VK_TRUE : VK_FALSE,
+	    .timelineSemaphore = VK_TRUE
+	};
+
 	VkPhysicalDeviceFeatures2 enable_device_features2{
 	    .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
-	    .pNext = &enable_vulkan13_features
+	    .pNext = &enable_vulkan12_features
 	};
 
-	// create logical device
+	// occlusion culling: GPU-side draw counts, and the pyramid build writes its levels through an indexed image array
+	if(m_options.occlusion_culling)
+	{
+		if(!query_vulkan12_features.drawIndirectCount)
+			throw std::runtime_error("Occlusion culling requires the Draw Indirect Count feature");
+		if(!query_device_features2.features.shaderStorageImageArrayDynamicIndexing)
+			throw std::runtime_error("Occlusion culling requires the Shader Storage Image Array Dynamic Indexing feature");
+
+		enable_device_features2.features.shaderStorageImageArrayDynamicIndexing = VK_TRUE;
+	}
+
+	// create logical device, with a second queue when compute has its own family
 	float queue_priority = 1.0f;
 
-	VkDeviceQueueCreateInfo queue_info = {
+	std::vector<VkDeviceQueueCreateInfo> queue_infos = {{
 		.sType            = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-	    .queueFamilyIndex = static_cast<uint32_t>(context.graphics_queue_index),
+	    .queueFamilyIndex = context.graphics_queue_index,
 	    .queueCount       = 1,
 	    .pQueuePriorities = &queue_priority
-	};
+	}};
+
+	if(context.compute_queue_index != context.graphics_queue_index)
+	{
+		queue_infos.push_back({
+			.sType            = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+		    .queueFamilyIndex = context.compute_queue_index,
+		    .queueCount       = 1,
+		    .pQueuePriorities = &queue_priority
+		});
+	}
 
 	VkDeviceCreateInfo device_info{
 	    .sType                   = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
 	    .pNext                   = &enable_device_features2,
-	    .queueCreateInfoCount    = 1,
-	    .pQueueCreateInfos       = &queue_info,
+	    .queueCreateInfoCount    = static_cast<uint32_t>(queue_infos.size()),
+	    .pQueueCreateInfos       = queue_infos.data(),
 	    .enabledExtensionCount   = static_cast<uint32_t>(required_device_extensions.size()),
 	    .ppEnabledExtensionNames = required_device_extensions.data()
 	};
@@ -365,6 +1323,10 @@ void Engine::init_vulkan()
 		vkDestroyDevice(context.device, nullptr);
 	});
 	vkGetDeviceQueue(context.device, context.graphics_queue_index, 0, &context.queue);
+	vkGetDeviceQueue(context.device, context.compute_queue_index, 0, &context.compute_queue);
+
+	if(context.extended_dynamic_state3)
+		vkcmd::load_extended_dynamic_state3(context.device);
 
 	// init vma allocator
 	VmaAllocatorCreateInfo allocator_info = {
@@ -373,6 +1335,13 @@ void Engine::init_vulkan()
 		.instance = context.instance
 	};
 
+	// the allocation check sees VMA's own allocations and every new block of device memory
+	if(m_options.alloc_check_warmup > 0)
+	{
+		allocator_info.pAllocationCallbacks = alloctrack::get_vulkan_callbacks();
+		allocator_info.pDeviceMemoryCallbacks = alloctrack::get_device_memory_callbacks();
+	}
+
 	VK_CHECK(vmaCreateAllocator(&allocator_info, &context.allocator));
 	m_deletion_queue.deletors.push_back([this]()
 	{
@@ -442,6 +1411,32 @@ void Engine::init_swapchain()
 	else if (surface_properties.supportedCompositeAlpha & VK_COMPOSITE_ALPHA_POST_MULTIPLIED_BIT_KHR)
 		composite = VK_COMPOSITE_ALPHA_POST_MULTIPLIED_BIT_KHR;
 
+	// frame capture copies out of the swapchain images
+	VkImageUsageFlags image_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+
+	// a scaled scene is blitted into them, with a frame budget the scale may drop at any time
+	if(m_options.render_scale < 1.0f || m_options.frame_budget_ms > 0.0f)
+	{
+		if(!(surface_properties.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT))
+			throw std::runtime_error("A render scale requires swapchain images usable as transfer destination");
+		image_usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	}
+	if(!m_options.capture_dir.empty())
+	{
+		if(!(surface_properties.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT))
+			throw std::runtime_error("Frame capture requires swapchain images usable as transfer source");
+		image_usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	}
+
+	// frame export copies the frame out of them, or into them from a dma-buf image
+	if(!m_options.export_socket.empty())
+	{
+		const VkImageUsageFlags transfer = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		if((surface_properties.supportedUsageFlags & transfer) != transfer)
+			throw std::runtime_error("Frame export requires swapchain images usable as transfer source and destination");
+		image_usage |= transfer;
+	}
+
 	VkSwapchainCreateInfoKHR swapchain_info{
 	    .sType            = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
 	    .surface          = context.surface,                            // The surface onto which images will be presented
@@ -450,7 +1445,7 @@ void Engine::init_swapchain()
 		.imageColorSpace  = selected_format.colorSpace,                 // Color space of the images (e.g., VK_COLOR_SPACE_SRGB_NONLINEAR_KHR)
 	    .imageExtent      = swapchain_size,                             // Resolution of the swapchain images (width and height)
 	    .imageArrayLayers = 1,                                          // Number of layers in each image (usually 1 unless stereoscopic)
-	    .imageUsage       = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,        // How the images will be used (as color attachments)
+	    .imageUsage       = image_usage,                                // How the images will be used (as color attachments)
 	    .imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,                  // Access mode of the images (exclusive to one queue family)
 	    .preTransform     = pre_transform,                              // Transform to apply to images (e.g., rotation)
 	    .compositeAlpha   = composite,                                  // Alpha blending to apply (e.g., opaque, pre-multiplied)
@@ -459,6 +1454,47 @@ void Engine::init_swapchain()
 	    .oldSwapchain     = old_swapchain                               // Handle to the old swapchain, if replacing an existing one
 	};
 
+	// device group: each GPU presents the images it rendered, or hands them to a GPU that can
+	VkDeviceGroupSwapchainCreateInfoKHR device_group_info = {
+		.sType = VK_STRUCTURE_TYPE_DEVICE_GROUP_SWAPCHAIN_CREATE_INFO_KHR
+	};
+
+	if(context.device_count > 1)
+	{
+		VkDeviceGroupPresentCapabilitiesKHR group_capabilities = {
+			.sType = VK_STRUCTURE_TYPE_DEVICE_GROUP_PRESENT_CAPABILITIES_KHR
+		};
+		VK_CHECK(vkGetDeviceGroupPresentCapabilitiesKHR(context.device, &group_capabilities));
+
+		VkDeviceGroupPresentModeFlagsKHR surface_modes = 0;
+		VK_CHECK(vkGetDeviceGroupSurfacePresentModesKHR(context.device, context.surface, &surface_modes));
+		VkDeviceGroupPresentModeFlagsKHR modes = group_capabilities.modes & surface_modes;
+
+		for(uint32_t device = 0; device < context.device_count; device++)
+		{
+			bool remote = false;
+			for(uint32_t presenter = 0; presenter < context.device_count; presenter++)
+				remote |= (group_capabilities.presentMask[presenter] & (1u << device)) != 0;
+
+			if((modes & VK_DEVICE_GROUP_PRESENT_MODE_LOCAL_BIT_KHR) && group_capabilities.presentMask[device] != 0)
+				context.device_present_modes[device] = VK_DEVICE_GROUP_PRESENT_MODE_LOCAL_BIT_KHR;
+			else if((modes & VK_DEVICE_GROUP_PRESENT_MODE_REMOTE_BIT_KHR) && remote)
+				context.device_present_modes[device] = VK_DEVICE_GROUP_PRESENT_MODE_REMOTE_BIT_KHR;
+			else
+			{
+				// frames only alternate between the GPUs before the first one that cannot present, the selected GPU presents
+				std::cout << "device group: GPU " << device << " cannot present, alternating between " << std::max(1u, device) << " GPUs" << '\n';
+				context.device_count = std::max(1u, device);
+				break;
+			}
+
+			device_group_info.modes |= context.device_present_modes[device];
+		}
+
+		if(context.device_count > 1)
+			swapchain_info.pNext = &device_group_info;
+	}
+
 	VK_CHECK(vkCreateSwapchainKHR(context.device, &swapchain_info, nullptr, &context.swapchain));
 	m_deletion_queue.deletors.push_back([this]()
 	{
@@ -471,7 +1507,7 @@ void Engine::init_swapchain()
 		// TODO: destroy old swapchain 
 	}
 
-	context.swapchain_dimensions = { swapchain_size.width, swapchain_size.height, selected_format.format };
+	context.swapchain_dimensions = { swapchain_size.width, swapchain_size.height, selected_format.format, selected_format.colorSpace };
 
 	uint32_t image_count;
 	vkGetSwapchainImagesKHR(context.device, context.swapchain, &image_count, nullptr);
@@ -508,6 +1544,83 @@ void Engine::init_swapchain()
 	}
 }
 
+void Engine::init_render_targets()
+{
+	const SwapchainDimensions& swapchain = context.swapchain_dimensions;
+	context.render_extent = {
+		std::max(1u, static_cast<uint32_t>(swapchain.width * m_options.render_scale)),
+		std::max(1u, static_cast<uint32_t>(swapchain.height * m_options.render_scale))
+	};
+
+	// a frame governor renders into part of the attachments when it lowers the scale
+	context.render_target_extent = context.render_extent;
+	VkExtent3D extent = { context.render_extent.width, context.render_extent.height, 1 };
+
+	// the highest supported count not above the requested one
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(context.gpu, &properties);
+	VkSampleCountFlags supported_samples = properties.limits.framebufferColorSampleCounts & properties.limits.framebufferDepthSampleCounts;
+
+	for(uint32_t samples = m_options.msaa_samples; samples > 1; samples /= 2)
+	{
+		if(supported_samples & samples)
+		{
+			context.samples = static_cast<VkSampleCountFlagBits>(samples);
+			break;
+		}
+	}
+
+	if(context.samples != m_options.msaa_samples)
+		std::cout << "msaa: " << m_options.msaa_samples << "x is not supported, using " << context.samples << "x" << '\n';
+
+	std::cout << "scene: " << extent.width << "x" << extent.height << ", " << context.samples << "x msaa" << '\n';
+
+	// depth is cleared by and dropped after the frame, it never needs memory outside the tile;
+	// occlusion culling stores it and builds its depth pyramid from it
+	VkFormat depth_format = vkutil::find_depth_format(context.gpu);
+	if(m_options.occlusion_culling)
+	{
+		VkFormatProperties format_properties;
+		vkGetPhysicalDeviceFormatProperties(context.gpu, depth_format, &format_properties);
+		if(!(format_properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT))
+			throw std::runtime_error("Occlusion culling requires a depth format that can be sampled");
+
+		context.depth_image = vkrsc::create_image(context.device, context.allocator, extent, depth_format, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_DEPTH_BIT);
+	}
+	else
+		context.depth_image = vkrsc::create_attachment(context.device, context.allocator, extent, depth_format, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT, context.samples);
+	m_deletion_queue.deletors.push_back([this]()
+	{
+		std::cout << "destroying depth image" << '\n';
+		vkrsc::destroy_image(context.device, context.allocator, context.depth_image);
+	});
+
+	if(context.samples != VK_SAMPLE_COUNT_1_BIT)
+	{
+		context.msaa_color_image = vkrsc::create_attachment(context.device, context.allocator, extent, swapchain.format, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, VK_IMAGE_ASPECT_COLOR_BIT, context.samples);
+		m_deletion_queue.deletors.push_back([this]()
+		{
+			std::cout << "destroying msaa color image" << '\n';
+			vkrsc::destroy_image(context.device, context.allocator, context.msaa_color_image);
+		});
+	}
+
+	if(m_options.render_scale < 1.0f || m_options.frame_budget_ms > 0.0f)
+	{
+		VkFormatProperties format_properties;
+		vkGetPhysicalDeviceFormatProperties(context.gpu, swapchain.format, &format_properties);
+		if((format_properties.optimalTilingFeatures & (VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT)) != (VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT))
+			throw std::runtime_error("A render scale requires a swapchain format that supports blits");
+
+		context.scene_image = vkrsc::create_image(context.device, context.allocator, extent, swapchain.format, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+		m_deletion_queue.deletors.push_back([this]()
+		{
+			std::cout << "destroying scene image" << '\n';
+			vkrsc::destroy_image(context.device, context.allocator, context.scene_image);
+		});
+	}
+}
+
 void Engine::init_per_frame()
 {
 
@@ -563,138 +1676,201 @@ void Engine::init_per_frame()
 
 		vkAllocateCommandBuffers(context.device, &cmd_buffer_info, &context.per_frame[i].primary_command_buffer);
 	}
+
+	// the static content of the scene passes, replayed while the draw list is unchanged
+	m_static_passes.init(context.device, context.primary_command_pool, FRAME_OVERLAP, SCENE_PASS_COUNT);
+	m_deletion_queue.deletors.push_back([this]()
+	{
+		std::cout << "scene passes recorded: " << m_static_passes.get_recorded_count() << ", replayed: " << m_static_passes.get_reused_count() << '\n';
+		m_static_passes.destroy();
+	});
 }
 
-void Engine::init_pipeline()
+void Engine::init_views()
 {
-	std::array<VkPipelineShaderStageCreateInfo, 2> shader_stages = {{
-	{
-		.sType 	= VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-		.stage 	= VK_SHADER_STAGE_VERTEX_BIT,
-		.module = vkutil::load_shader_module(context.device, "assets/shaders/spirv/default_mesh_vert.spv"),
-		.pName 	= "main"
-	},
+	if(m_options.view_count <= 1)
+		return;
+
+	ViewSetDescription description = {
+		.instance 				 = context.instance,
+		.gpu 					 = context.gpu,
+		.device 				 = context.device,
+		.allocator 				 = context.allocator,
+		.queue_family 			 = context.graphics_queue_index,
+		.count 					 = m_options.view_count - 1,
+		.surface_format 		 = { context.swapchain_dimensions.format, context.swapchain_dimensions.color_space },
+		.depth_format 			 = context.depth_image.format,
+		.samples 				 = context.samples,
+		.clear_color 			 = {{ 0.01f, 0.01f, 0.033f, 1.0f }},
+		.slot_count 			 = FRAME_OVERLAP,
+		.extended_dynamic_state3 = context.extended_dynamic_state3
+	};
+
+	m_views.init(description);
+	m_deletion_queue.deletors.push_back([this]()
 	{
-		.sType 	= VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-		.stage 	= VK_SHADER_STAGE_FRAGMENT_BIT,
-		.module = vkutil::load_shader_module(context.device, "assets/shaders/spirv/default_mesh_frag.spv"),
-		.pName 	= "main"
-	}
-	}};
+		std::cout << "destroying views" << '\n';
+		m_views.destroy();
+	});
 
-	VertexInputDescription vertexDescription = Vertex::get_vertex_description();
+	std::cout << "views: " << m_options.view_count << " windows" << '\n';
+}
 
-	// vertex input state
-	VkPipelineVertexInputStateCreateInfo vertex_input = {
-		.sType 							 = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-		.vertexBindingDescriptionCount   = static_cast<uint32_t>(vertexDescription.bindings.size()),
-		.pVertexBindingDescriptions 	 = vertexDescription.bindings.data(),
-		.vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexDescription.attributes.size()),
-		.pVertexAttributeDescriptions 	 = vertexDescription.attributes.data()
+void Engine::init_compute()
+{
+	QueueFamilies families = {
+		.graphics = context.graphics_queue_index,
+		.compute  = context.compute_queue_index
 	};
 
-	VkPipelineInputAssemblyStateCreateInfo input_assembly = {
-		.sType 					= VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
-		.topology 				= VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
-		.primitiveRestartEnable = VK_FALSE
-	};
+	m_compute.init(context.device, families, context.compute_queue, FRAME_OVERLAP);
+	m_deletion_queue.deletors.push_back([this]()
+	{
+		std::cout << "destroying compute scheduler" << '\n';
+		m_compute.destroy();
+	});
+}
 
-	VkPipelineViewportStateCreateInfo viewport = {
-		.sType 		   = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
-		.viewportCount = 1,
-		.scissorCount  = 1
-	};
+void Engine::init_pipeline()
+{
+	// every pipeline layout, created from shader reflection and shared between pipelines with the same interface
+	m_layouts.init(context.device);
+	m_deletion_queue.deletors.push_back([this]()
+	{
+		std::cout << "destroying " << m_layouts.get_layout_count() << " pipeline layouts, " << m_layouts.get_set_layout_count() << " set layouts" << '\n';
+		m_layouts.destroy();
+	});
 
-	VkPipelineRasterizationStateCreateInfo raster = {
-		.sType 					 = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
-		.depthClampEnable 		 = VK_FALSE,
-		.rasterizerDiscardEnable = VK_FALSE,
-		.polygonMode 			 = VK_POLYGON_MODE_FILL,
-		.depthBiasEnable 		 = VK_FALSE,
-		.lineWidth 				 = 1.0f
+	ShaderReflection vertex_reflection;
+	ShaderReflection fragment_reflection;
+
+	GraphicsPipelineDescription description = {
+		.vertex_shader 	 = vkutil::load_shader_module(context.device, "assets/shaders/spirv/default_mesh_vert.spv", &vertex_reflection),
+		.fragment_shader = vkutil::load_shader_module(context.device, "assets/shaders/spirv/default_mesh_frag.spv", &fragment_reflection),
+		.vertex_input 	 = Vertex::get_vertex_description(),
+		.color_format 	 = context.swapchain_dimensions.format,
+		.depth_format 	 = context.depth_image.format,
+		.samples 		 = context.samples,
+		.dynamic_states  = vkcmd::get_dynamic_states(context.extended_dynamic_state3)
 	};
 
-	VkPipelineMultisampleStateCreateInfo multisample = {
-		.sType 				  = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
-		.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT
-	};
+	spirv::validate_vertex_input(vertex_reflection, description.vertex_input, "default_mesh.vert");
 
-	VkPipelineDepthStencilStateCreateInfo depth_stencil = {
-		.sType 			= VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
-		.depthCompareOp = VK_COMPARE_OP_ALWAYS
-	};
+	// a module compiled before the colors moved out of push constants has no set 0
+	spirv::validate_binding(vertex_reflection, 0, 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, "default_mesh.vert");
+	spirv::validate_push_constants(vertex_reflection, 0, "default_mesh.vert");
 
-	VkPipelineColorBlendAttachmentState blend_attachment = {
-		.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT
-	};
+	// set 0 is the frame's uniform buffer, the colors are not push constants so recorded draws can be replayed
+	context.pipeline_layout = m_layouts.get({ &vertex_reflection, &fragment_reflection });
+	context.frame_set_layout = m_layouts.get_set_layout(context.pipeline_layout, 0);
 
-	VkPipelineColorBlendStateCreateInfo blend = {
-		.sType 			 = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
-		.attachmentCount = 1,
-		.pAttachments 	 = &blend_attachment
-	};
+	description.layout = context.pipeline_layout;
 
-	std::vector<VkDynamicState> dynamic_states = {
-		VK_DYNAMIC_STATE_VIEWPORT,
-		VK_DYNAMIC_STATE_SCISSOR
-	};
+	if(context.graphics_pipeline_library)
+	{
+		// parts are compiled now, linked on first draw
+		m_pipeline_library.init(context.device, description);
+		m_deletion_queue.deletors.push_back([this]()
+		{
+			m_pipeline_library.destroy();
+		});
+	}
+	else
+	{
+		context.pipeline = vkpipe::create_graphics_pipeline(context.device, description);
+		m_deletion_queue.deletors.push_back([this]()
+		{
+			vkDestroyPipeline(context.device, context.pipeline, nullptr);
+		});
+	}
 
-	VkPipelineDynamicStateCreateInfo dynamic_state_info = {
-		.sType 			   = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
-		.dynamicStateCount = static_cast<uint32_t>(dynamic_states.size()),
-		.pDynamicStates    = dynamic_states.data()
-	};
+	if(m_options.depth_prepass)
+	{
+		// same vertex shader, so prepass depth matches the color pass bit for bit
+		GraphicsPipelineDescription prepass_description = description;
+		prepass_description.fragment_shader = VK_NULL_HANDLE;
+		prepass_description.color_format = VK_FORMAT_UNDEFINED;
+
+		// the fragment shader declares no resources, so this is the color pipeline's layout and the frame set stays bound
+		prepass_description.layout = m_layouts.get({ &vertex_reflection });
+
+		context.depth_prepass_pipeline = vkpipe::create_graphics_pipeline(context.device, prepass_description);
+		m_deletion_queue.deletors.push_back([this]()
+		{
+			vkDestroyPipeline(context.device, context.depth_prepass_pipeline, nullptr);
+		});
+	}
 
-	VkPushConstantRange push_constant = {
-		.stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
-		.offset = offsetof(GPUMeshConstant, colors),
-		.size = sizeof(GPUMeshConstant)
+	vkDestroyShaderModule(context.device, description.vertex_shader, nullptr);
+	vkDestroyShaderModule(context.device, description.fragment_shader, nullptr);
+}
+
+void Engine::init_frame_uniforms()
+{
+	// one buffer and set per frame in flight, the set layout is the one reflected from default_mesh.vert
+	VkDescriptorPoolSize pool_size = {
+		.type 			 = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+		.descriptorCount = FRAME_OVERLAP
 	};
 
-	VkPipelineLayoutCreateInfo layout_info = {
-		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-		.pushConstantRangeCount = 1,
-		.pPushConstantRanges = &push_constant
+	VkDescriptorPoolCreateInfo pool_info = {
+		.sType 		   = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.maxSets 	   = FRAME_OVERLAP,
+		.poolSizeCount = 1,
+		.pPoolSizes    = &pool_size
 	};
 
-	VK_CHECK(vkCreatePipelineLayout(context.device, &layout_info, nullptr, &context.pipeline_layout));
+	VK_CHECK(vkCreateDescriptorPool(context.device, &pool_info, nullptr, &context.descriptor_pool));
 	m_deletion_queue.deletors.push_back([this]()
 	{
-		vkDestroyPipelineLayout(context.device, context.pipeline_layout, nullptr);
+		std::cout << "destroying frame descriptor pool" << '\n';
+		vkDestroyDescriptorPool(context.device, context.descriptor_pool, nullptr);
 	});
 
-	// required for dynamic rendering
-	VkPipelineRenderingCreateInfo pipeline_rendering_info = {
-		.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
-		.colorAttachmentCount 	 = 1,
-		.pColorAttachmentFormats = &context.swapchain_dimensions.format
-	};
-
-	VkGraphicsPipelineCreateInfo pipeline_graphics_info = {
-		.sType 				 = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-		.pNext 				 = &pipeline_rendering_info,
-		.stageCount 		 = static_cast<uint32_t>(shader_stages.size()),
-		.pStages 			 = shader_stages.data(),
-		.pVertexInputState 	 = &vertex_input,
-		.pInputAssemblyState = &input_assembly,
-		.pViewportState 	 = &viewport,
-		.pRasterizationState = &raster,
-		.pMultisampleState 	 = &multisample,
-		.pColorBlendState 	 = &blend,
-		.pDynamicState 		 = &dynamic_state_info,
-		.layout 			 = context.pipeline_layout,
-		.renderPass 		 = VK_NULL_HANDLE,
-		.subpass			 = 0
-	};
-
-	VK_CHECK(vkCreateGraphicsPipelines(context.device, VK_NULL_HANDLE, 1, &pipeline_graphics_info, nullptr, &context.pipeline));
-	m_deletion_queue.deletors.push_back([this]()
+	for(int i = 0; i < FRAME_OVERLAP; i++)
 	{
-		vkDestroyPipeline(context.device, context.pipeline, nullptr);
-	});
+		PerFrame& frame = context.per_frame[i];
+
+		frame.uniforms = vkrsc::create_buffer(context.allocator, sizeof(GPUMeshConstant), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+											  VMA_MEMORY_USAGE_AUTO_PREFER_HOST, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+
+		void* mapped;
+		VK_CHECK(vmaMapMemory(context.allocator, frame.uniforms.allocation, &mapped));
+		frame.uniforms_mapped = static_cast<GPUMeshConstant*>(mapped);
+
+		m_deletion_queue.deletors.push_back([this, i]()
+		{
+			std::cout << "destroying frame uniforms [" << i << ']' << '\n';
+			vmaUnmapMemory(context.allocator, context.per_frame[i].uniforms.allocation);
+			vmaDestroyBuffer(context.allocator, context.per_frame[i].uniforms.buffer, context.per_frame[i].uniforms.allocation);
+		});
+
+		VkDescriptorSetAllocateInfo set_info = {
+			.sType 				= VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+			.descriptorPool 	= context.descriptor_pool,
+			.descriptorSetCount = 1,
+			.pSetLayouts 		= &context.frame_set_layout
+		};
+
+		VK_CHECK(vkAllocateDescriptorSets(context.device, &set_info, &frame.frame_set));
+
+		VkDescriptorBufferInfo buffer_info = {
+			.buffer = frame.uniforms.buffer,
+			.offset = 0,
+			.range 	= sizeof(GPUMeshConstant)
+		};
+
+		VkWriteDescriptorSet write = {
+			.sType 			 = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+			.dstSet 		 = frame.frame_set,
+			.dstBinding 	 = 0,
+			.descriptorCount = 1,
+			.descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+			.pBufferInfo 	 = &buffer_info
+		};
 
-	vkDestroyShaderModule(context.device, shader_stages[0].module, nullptr);
-	vkDestroyShaderModule(context.device, shader_stages[1].module, nullptr);
+		vkUpdateDescriptorSets(context.device, 1, &write, 0, nullptr);
+	}
 }
 
 void Engine::init_scene()
@@ -706,8 +1882,25 @@ void Engine::init_scene()
 	VkFence copy_fence;
 	VK_CHECK(vkCreateFence(context.device, &fence_info, nullptr, &copy_fence));
 
+	// import: the LOD chain is appended to the vertices, every level is a vertex range of the same buffer
+	Mesh mesh = { .vertices = vertices };
+	meshlod::build_lod_chain(mesh);
+	m_mesh_lods = mesh.lods;
+
+	std::vector<float> lod_errors;
+	for(const MeshLod& lod : mesh.lods)
+		lod_errors.push_back(lod.error);
+	m_scene.set_mesh_lods(0, lod_errors);
+
+	m_scene.set_lod_settings({
+		.viewport_height = static_cast<float>(context.render_extent.height),
+		.threshold 		 = m_options.lod_threshold
+	});
+
+	std::cout << "mesh 0: " << mesh.lods.size() << " levels of detail" << '\n';
+
 	// staging buffer
-	VkDeviceSize buffer_size = sizeof(vertices[0]) * vertices.size();
+	VkDeviceSize buffer_size = sizeof(mesh.vertices[0]) * mesh.vertices.size();
 
 	AllocatedBuffer staging = vkrsc::create_buffer(context.allocator, buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_AUTO_PREFER_HOST, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
 
@@ -720,7 +1913,7 @@ void Engine::init_scene()
 	// map staging buffer <- mesh
 	void* data;
 	vmaMapMemory(context.allocator, staging.allocation, &data);
-		memcpy(data, vertices.data(), (size_t)buffer_size);
+		memcpy(data, mesh.vertices.data(), (size_t)buffer_size);
 	vmaUnmapMemory(context.allocator, staging.allocation);
 
 	// copy staging buffer to mesh buffer
@@ -763,18 +1956,144 @@ void Engine::init_scene()
 	std::cout << "Destroying staging buffer" << '\n';
 	vmaDestroyBuffer(context.allocator, staging.buffer, staging.allocation);
 
+	// the triangle is the only scene object, its vertices are already in clip space
+	m_triangle = m_scene.create({
+		.bounds_center = glm::vec3(0.0f),
+		.bounds_extent = glm::vec3(0.5f, 0.5f, 0.0f),
+		.mesh 		   = 0,
+		.pipeline 	   = 0
+	});
+
+	std::cout << "scene kernels: " << scenekernels::isa_name() << '\n';
+
 	m_colors.colors[0] = glm::vec4(1.0f);
 	m_colors.colors[1] = glm::vec4(1.0f);
 	m_colors.colors[2] = glm::vec4(1.0f);
 }
 
+void Engine::init_particles()
+{
+	if(m_options.particle_count == 0)
+		return;
+
+	ParticleSystemDescription description = {
+		.capacity 		= m_options.particle_count,
+		.queue_families = m_compute.get_sharing_families(),
+		.color_format 	= context.swapchain_dimensions.format,
+		.depth_format 	= context.depth_image.format,
+		.samples 		= context.samples,
+		.dynamic_states = vkcmd::get_dynamic_states(context.extended_dynamic_state3),
+		.layouts 		= &m_layouts
+	};
+
+	m_particles.init(context.device, context.allocator, description);
+	m_deletion_queue.deletors.push_back([this]()
+	{
+		std::cout << "destroying particle system" << '\n';
+		m_particles.destroy();
+	});
+
+	// the vertex shader reads the particles, the indirect draw reads the counters
+	m_compute.add_pass("particles", VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT, [this](VkCommandBuffer cmd, uint32_t slot)
+	{
+		m_particles.record_simulation(cmd, slot);
+	});
+}
+
+void Engine::init_occlusion()
+{
+	if(!m_options.occlusion_culling)
+		return;
+
+	OcclusionCullerDescription description = {
+		.capacity = OCCLUSION_CAPACITY,
+		.depth 	  = context.depth_image,
+		.layouts  = &m_layouts
+	};
+
+	m_occlusion.init(context.device, context.allocator, description);
+	m_deletion_queue.deletors.push_back([this]()
+	{
+		std::cout << "destroying occlusion culler" << '\n';
+		m_occlusion.destroy();
+	});
+}
+
+void Engine::init_latency()
+{
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(context.gpu, &properties);
+
+	uint32_t queue_family_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(context.gpu, &queue_family_count, nullptr);
+	std::vector<VkQueueFamilyProperties> queue_families(queue_family_count);
+	vkGetPhysicalDeviceQueueFamilyProperties(context.gpu, &queue_family_count, queue_families.data());
+
+	LatencyMonitorDescription description = {
+		.gpu 				   = context.gpu,
+		.device 			   = context.device,
+		.swapchain 			   = context.swapchain,
+		.present_wait 		   = context.present_wait,
+		.calibrated_timestamps = context.calibrated_timestamps,
+		.timestamp_period 	   = properties.limits.timestampPeriod,
+		.timestamp_valid_bits  = queue_families[context.graphics_queue_index].timestampValidBits,
+		.slot_count 		   = FRAME_OVERLAP,
+		.pacing 			   = m_options.low_latency
+	};
+
+	m_latency.init(description);
+	m_deletion_queue.deletors.push_back([this]()
+	{
+		std::cout << "destroying latency monitor" << '\n';
+		m_latency.destroy();
+	});
+}
+
+void Engine::init_governor()
+{
+	if(m_options.frame_budget_ms <= 0.0f)
+		return;
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(context.gpu, &properties);
+
+	uint32_t queue_family_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(context.gpu, &queue_family_count, nullptr);
+	std::vector<VkQueueFamilyProperties> queue_families(queue_family_count);
+	vkGetPhysicalDeviceQueueFamilyProperties(context.gpu, &queue_family_count, queue_families.data());
+
+	FrameGovernorDescription description = {
+		.device 			  = context.device,
+		.timestamp_period 	  = properties.limits.timestampPeriod,
+		.timestamp_valid_bits = queue_families[context.graphics_queue_index].timestampValidBits,
+		.slot_count 		  = FRAME_OVERLAP,
+		.target_ms 			  = m_options.frame_budget_ms,
+		.min_scale 			  = m_options.min_render_scale,
+		.max_scale 			  = m_options.render_scale
+	};
+
+	m_governor.init(description);
+	m_deletion_queue.deletors.push_back([this]()
+	{
+		std::cout << "destroying frame governor" << '\n';
+		m_governor.destroy();
+	});
+
+	std::cout << "frame budget: " << m_options.frame_budget_ms << " ms, render scale " << m_options.min_render_scale << " to " << m_options.render_scale << '\n';
+}
+
 void Engine::init_imgui()
 {
 	IMGUI_CHECKVERSION();
+
+	// ImGui allocates with malloc, which operator new does not see
+	if(m_options.alloc_check_warmup > 0)
+		ImGui::SetAllocatorFunctions(alloctrack::imgui_alloc, alloctrack::imgui_free);
+
 	ImGui::CreateContext();
 	ImGui::StyleColorsDark();
 
-	// required for dynamic rendering
+	// required for dynamic rendering, the UI pass has no depth attachment
 	VkPipelineRenderingCreateInfo pipeline_rendering_info = {
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
 		.colorAttachmentCount 	 = 1,
@@ -797,18 +2116,90 @@ void Engine::init_imgui()
 		.MinImageCount = context.surface_properties.minImageCount,
 		.ImageCount = static_cast<uint32_t>(context.swapchain_images.size()),
 		.MSAASamples = VK_SAMPLE_COUNT_1_BIT,
-		.DescriptorPoolSize = 2,
+		.DescriptorPoolSize = 64,
 		.UseDynamicRendering = true,
 		.PipelineRenderingCreateInfo = pipeline_rendering_info,
 	};
 
 	ImGui_ImplVulkan_Init(&init_info);
 
+	// upload now: ImGui_ImplVulkan_NewFrame would otherwise submit it from the UI thread while the render thread owns the queue
+	ImGui_ImplVulkan_CreateFontsTexture();
+
 	m_deletion_queue.deletors.push_back([]()
 	{
 		ImGui_ImplVulkan_Shutdown();
 		ImGui_ImplGlfw_Shutdown();
 		ImGui::DestroyContext();
 	});
-	
+
+	m_ui_cache.init(context.device, context.primary_command_pool, context.swapchain_dimensions.format, FRAME_OVERLAP);
+	m_deletion_queue.deletors.push_back([this]()
+	{
+		std::cout << "ui frames recorded: " << m_ui_cache.get_recorded_count() << ", replayed: " << m_ui_cache.get_reused_count() << '\n';
+		m_ui_cache.destroy();
+	});
+}
+
+void Engine::init_textures()
+{
+	TextureStreamerDescription description = {
+		.gpu 		  = context.gpu,
+		.device 	  = context.device,
+		.allocator 	  = context.allocator,
+		.budget 	  = static_cast<VkDeviceSize>(m_options.texture_budget_mb) << 20,
+		.staging_size = TEXTURE_STAGING_SIZE,
+		.slot_count   = FRAME_OVERLAP,
+		// frames in flight, plus the packets queued in the triple buffer with the old descriptor
+		.retire_delay = FRAME_OVERLAP + 3
+	};
+
+	m_textures.init(description);
+
+	for(const std::string& path : m_options.textures)
+		m_textures.request(path, m_jobs, m_texture_loads);
+
+	m_texture_sizes.assign(m_options.textures.size(), 256.0f);
+
+	m_deletion_queue.deletors.push_back([this]()
+	{
+		std::cout << "destroying texture streamer" << '\n';
+		m_jobs.wait(m_texture_loads);
+		m_textures.destroy();
+	});
+}
+
+void Engine::init_capture()
+{
+	VkExtent2D extent = { context.swapchain_dimensions.width, context.swapchain_dimensions.height };
+	m_capture.init(context.allocator, extent, context.swapchain_dimensions.format, FRAME_OVERLAP, m_options);
+	m_deletion_queue.deletors.push_back([this]()
+	{
+		m_capture.destroy();
+	});
+}
+
+void Engine::init_export()
+{
+	if(m_options.export_socket.empty())
+		return;
+
+	FrameExporterDescription description = {
+		.gpu 		  = context.gpu,
+		.device 	  = context.device,
+		.queue_family = context.graphics_queue_index,
+		.extent 	  = { context.swapchain_dimensions.width, context.swapchain_dimensions.height },
+		.format 	  = context.swapchain_dimensions.format,
+		.slot_count   = m_options.export_slots,
+		.socket_path  = m_options.export_socket,
+		.dma_buf 	  = context.export_dma_buf,
+		.host_memory  = context.export_host_memory
+	};
+
+	m_export.init(description);
+	m_deletion_queue.deletors.push_back([this]()
+	{
+		std::cout << "destroying frame exporter" << '\n';
+		m_export.destroy();
+	});
 }
@@ -2,16 +2,55 @@
 
 #include "vk_defines.h"
 #include "vk_mesh.h"
+#include "mesh_lod.h"
+#include "vk_pipeline.h"
+#include "vk_commands.h"
+#include "vk_draw.h"
+#include "scene.h"
+#include "jobs.h"
+#include "vk_capture.h"
+#include "frame_export.h"
+#include "vk_compute.h"
+#include "particles.h"
+#include "occlusion.h"
+#include "latency.h"
+#include "ui_cache.h"
+#include "static_pass.h"
+#include "textures.h"
+#include "options.h"
+#include "frame_packet.h"
+#include "views.h"
+#include "governor.h"
 
 
 
 const int FRAME_OVERLAP = 2;
 
-struct GPUMeshConstant
+// upload capacity of the texture streamer per frame
+const VkDeviceSize TEXTURE_STAGING_SIZE = 32ull << 20;
+
+// objects the occlusion culler handles per frame, the rest is drawn without occlusion culling
+const uint32_t OCCLUSION_CAPACITY = 1u << 16;
+
+// render passes whose content is recorded once into secondaries and replayed
+enum ScenePass : uint32_t
 {
-	glm::vec4 colors[3];
+	SCENE_PASS_DEPTH_PREPASS = 0,
+
+	// the whole scene pass, or its first half with occlusion culling
+	SCENE_PASS_MAIN,
+
+	// second half of the scene pass with occlusion culling
+	SCENE_PASS_LATE,
+
+	SCENE_PASS_COUNT
 };
 
+// seconds an idle interactive window sleeps between checks of the UI
+const double IDLE_WAIT_TIMEOUT = 0.5;
+
+// seconds between refreshes of the frame stats the Triangle window shows
+const double LIVE_STATS_INTERVAL = 0.5;
 
 class Engine
 {
@@ -33,6 +72,8 @@ class Engine
 		uint32_t height = 0;
 
 		VkFormat format = VK_FORMAT_UNDEFINED;
+
+		VkColorSpaceKHR color_space = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
 	};
 
 	struct PerFrame 
@@ -41,6 +82,12 @@ class Engine
 		VkCommandBuffer primary_command_buffer  = VK_NULL_HANDLE;
 		VkSemaphore swapchain_acquire_semaphore = VK_NULL_HANDLE;
 		VkSemaphore swapchain_release_semaphore = VK_NULL_HANDLE;
+
+
+		// per-frame data of the mesh shader, written before the recorded draws replay
+		AllocatedBuffer uniforms 				= {};
+		GPUMeshConstant* uniforms_mapped 		= nullptr;
+		VkDescriptorSet frame_set 				= VK_NULL_HANDLE;
 	};
 
 	struct Context
@@ -55,10 +102,15 @@ class Engine
 
 		uint32_t graphics_queue_index = -1;
 
+		// equal to graphics_queue_index when there is no dedicated compute family
+		uint32_t compute_queue_index = -1;
+
 		VkDevice device = VK_NULL_HANDLE;
 
 		VkQueue queue;
 
+		VkQueue compute_queue;
+
 		VmaAllocator allocator;
 
 		VkSwapchainKHR swapchain = VK_NULL_HANDLE;
@@ -73,36 +125,129 @@ class Engine
 
 		PerFrame per_frame[FRAME_OVERLAP];
 
+		VkDescriptorPool descriptor_pool = VK_NULL_HANDLE;
+
+		// set 0 of the mesh pipeline layout: the frame's uniform buffer, owned by the layout cache
+		VkDescriptorSetLayout frame_set_layout = VK_NULL_HANDLE;
+
 		VkPipeline pipeline;
 
 		VkPipelineLayout pipeline_layout;
 
+		VkPipeline depth_prepass_pipeline = VK_NULL_HANDLE;
+
+		AllocatedImage depth_image;
+
+		// multisampled color of the scene pass, only with MSAA
+		AllocatedImage msaa_color_image {};
+
+		// the scene at render resolution, only with a render scale below 1; upscaled into the swapchain image
+		AllocatedImage scene_image {};
+
+		// resolution of the scene pass this frame, the frame governor changes it on the render thread
+		VkExtent2D render_extent {};
+
+		// size of the scene attachments, the largest render extent
+		VkExtent2D render_target_extent {};
+
+		VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+
+		bool graphics_pipeline_library = false;
+
+		bool extended_dynamic_state3 = false;
+
+		// VK_KHR_present_id and VK_KHR_present_wait
+		bool present_wait = false;
+
+		// VK_EXT_calibrated_timestamps, in a host time domain steady_clock counts in
+		bool calibrated_timestamps = false;
+
+		// GPUs frames alternate between, more than 1 when the device spans a device group
+		uint32_t device_count = 1;
+
+		// how the images each GPU renders reach the display, LOCAL or REMOTE
+		std::array<VkDeviceGroupPresentModeFlagBitsKHR, VK_MAX_DEVICE_GROUP_SIZE> device_present_modes {};
+
+		// VK_EXT_external_memory_dma_buf and VK_EXT_external_memory_host, enabled for frame export only
+		bool export_dma_buf = false;
+
+		bool export_host_memory = false;
+
 	};
 
 public:
 	
-	void init();
+	void init(const EngineOptions& options = {});
 
 	void run();
 
+	// a captured frame differed from its golden frame or could not be written
+	inline bool has_capture_failed() const { return m_capture.has_mismatch() || m_capture.has_write_error(); }
+
+	// --alloc-check found heap allocations after the warm-up
+	inline bool has_steady_state_allocations() const { return m_steady_state_allocations > 0; }
+
 private:
 
-	void draw();
+	void render_loop();
+
+	void build_frame_packet(FramePacket& packet);
+
+	void draw(FramePacket& packet);
+
+	void kick_scene_update();
+
+	void set_mesh_state(CommandRecorder& recorder, VkExtent2D extent, VkPipeline pipeline, const RasterState& state);
+
+	void record_draws(CommandRecorder& recorder, VkExtent2D extent, VkPipeline pipeline, const RasterState& state, const std::vector<DrawCommand>& draws);
+
+	// the draws one occlusion culling phase emitted, all of them use the scene mesh
+	void record_occlusion_draws(VkPipeline pipeline, const RasterState& state, OcclusionPhase phase);
+
+	// the secondary of a scene pass for this frame, recorded through record only when key changed
+	VkCommandBuffer get_scene_pass(ScenePass pass, uint64_t key, const VkCommandBufferInheritanceRenderingInfo& rendering, FunctionRef<void()> record, CommandStats& stats);
+
+	// job body: the scene pass of one of m_views for the frame in m_view_frame
+	void record_view(uint32_t view);
 
 	void cleanup();
 
+	void init_jobs();
+
 	void init_vulkan();
 
 	void init_swapchain();
 
+	void init_render_targets();
+
 	void init_per_frame();
 
+	void init_views();
+
+	void init_compute();
+
 	void init_pipeline();
 
+	void init_frame_uniforms();
+
 	void init_scene();
 
+	void init_particles();
+
+	void init_occlusion();
+
+	void init_latency();
+
+	void init_governor();
+
 	void init_imgui();
 
+	void init_textures();
+
+	void init_capture();
+
+	void init_export();
+
 	inline PerFrame& get_current_frame() { return context.per_frame[frame_number % FRAME_OVERLAP]; }
 
 	// --- window ---
@@ -112,14 +257,116 @@ private:
 
 	Context context;
 
+	EngineOptions m_options;
+
 	DeletionQueue m_deletion_queue;
 
+	PipelineLibrary m_pipeline_library;
+
+	PipelineLayoutCache m_layouts;
+
+	CommandRecorder m_recorder;
+
+	// recorder stats of the last recorded frame, written by the render thread
+	std::atomic<uint32_t> m_commands_recorded {};
+
+	std::atomic<uint32_t> m_commands_eliminated {};
+
+	FrameCapture m_capture;
+
+	uint64_t m_steady_state_allocations = 0;
+
+	FrameExporter m_export;
+
+	ComputeScheduler m_compute;
+
+	ParticleSystem m_particles;
+
+	OcclusionCuller m_occlusion;
+
+	LatencyMonitor m_latency;
+
+	FrameGovernor m_governor;
+
+	UiCache m_ui_cache;
+
+	// what the Triangle window shows of the last frames; every rendered frame changes it, so it is
+	// refreshed at LIVE_STATS_INTERVAL and left alone while idle instead of every frame
+	struct LiveStats
+	{
+		LatencyMonitor::Clock::time_point time;
+
+		uint32_t commands_recorded = 0;
+
+		uint32_t commands_eliminated = 0;
+
+		OcclusionStats occlusion;
+
+		LatencyStats latency;
+
+		FrameGovernorStats governor;
+
+		FrameExportStats exported;
+	};
+
+	LiveStats m_live_stats;
+
+	StaticPassCache m_static_passes;
+
+	// windows besides m_window, sharing everything but their swapchains and attachments
+	ViewSet m_views;
+
+	// what the view jobs of the frame being drawn record, set by the render thread before it kicks them
+	struct ViewFrame
+	{
+		const FramePacket* packet = nullptr;
+
+		VkPipeline pipeline = VK_NULL_HANDLE;
+	};
+
+	ViewFrame m_view_frame;
+
+	JobCounter m_view_recording;
+
+	TextureStreamer m_textures;
+
+	// pending texture loads, waited for before the streamer is destroyed
+	JobCounter m_texture_loads;
+
+	// on-screen size of each texture in the Textures window, drives its demand
+	std::vector<float> m_texture_sizes;
+
 	// --- temp ---
 
 	AllocatedBuffer m_mesh;
 
+	// vertex ranges of the LOD chain in m_mesh
+	std::vector<MeshLod> m_mesh_lods;
+
 	GPUMeshConstant m_colors;
 
+	// --- render thread ---
+
+	TripleBuffer<FramePacket> m_frame_packets;
+
+	std::thread m_render_thread;
+
+	std::atomic<bool> m_render_running {false};
+
+	uint64_t m_simulation_frame {};
+
+	JobSystem m_jobs;
+
+	Scene m_scene;
+
+	// pending update of m_scene, wait on it before reading the visible list
+	JobCounter m_scene_update;
+
+	SceneHandle m_triangle;
+
+	// the mesh shader takes clip space positions, so the camera is identity for now
+	glm::mat4 m_view_projection = glm::mat4(1.0f);
+
 	const std::vector<Vertex> vertices = {
 		{{ 0.0f,-0.5f, 0.0f }, { 0.0f, 0.0f, 0.0f }, { 1.0f, 0.0f, 0.0f }},
 		{{ 0.5f, 0.5f, 0.0f }, { 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }},
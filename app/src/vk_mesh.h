@@ -6,6 +6,10 @@
 
 #include "vk_resources.h"
 
+#include <array>
+#include <cstddef>
+#include <type_traits>
+
 struct VertexInputDescription
 {
 
@@ -15,6 +19,97 @@ struct VertexInputDescription
     VkPipelineVertexInputStateCreateFlags flags = 0;
 };
 
+// Vertex attribute format of a C++ member type; a type without a specialization does not compile as an attribute
+template<typename T>
+struct VertexFormat;
+
+template<> struct VertexFormat<float> 	 	{ static constexpr VkFormat value = VK_FORMAT_R32_SFLOAT; };
+template<> struct VertexFormat<glm::vec2> 	{ static constexpr VkFormat value = VK_FORMAT_R32G32_SFLOAT; };
+template<> struct VertexFormat<glm::vec3> 	{ static constexpr VkFormat value = VK_FORMAT_R32G32B32_SFLOAT; };
+template<> struct VertexFormat<glm::vec4> 	{ static constexpr VkFormat value = VK_FORMAT_R32G32B32A32_SFLOAT; };
+template<> struct VertexFormat<int32_t> 	{ static constexpr VkFormat value = VK_FORMAT_R32_SINT; };
+template<> struct VertexFormat<glm::ivec2> 	{ static constexpr VkFormat value = VK_FORMAT_R32G32_SINT; };
+template<> struct VertexFormat<glm::ivec3> 	{ static constexpr VkFormat value = VK_FORMAT_R32G32B32_SINT; };
+template<> struct VertexFormat<glm::ivec4> 	{ static constexpr VkFormat value = VK_FORMAT_R32G32B32A32_SINT; };
+template<> struct VertexFormat<uint32_t> 	{ static constexpr VkFormat value = VK_FORMAT_R32_UINT; };
+template<> struct VertexFormat<glm::uvec2> 	{ static constexpr VkFormat value = VK_FORMAT_R32G32_UINT; };
+template<> struct VertexFormat<glm::uvec3> 	{ static constexpr VkFormat value = VK_FORMAT_R32G32B32_UINT; };
+template<> struct VertexFormat<glm::uvec4> 	{ static constexpr VkFormat value = VK_FORMAT_R32G32B32A32_UINT; };
+
+template<typename T>
+struct MemberTraits;
+
+template<typename V, typename M>
+struct MemberTraits<M V::*>
+{
+    using vertex = V;
+    using type = M;
+};
+
+// The member of a vertex struct that feeds a shader input location
+template<uint32_t Location, auto Member>
+struct VertexAttribute
+{
+    using vertex = typename MemberTraits<decltype(Member)>::vertex;
+    using type = typename MemberTraits<decltype(Member)>::type;
+
+    static constexpr uint32_t location = Location;
+
+    static constexpr VkFormat format = VertexFormat<type>::value;
+
+    static uint32_t get_offset()
+    {
+        static const vertex object {};
+        return static_cast<uint32_t>(reinterpret_cast<const std::byte*>(&(object.*Member)) - reinterpret_cast<const std::byte*>(&object));
+    }
+};
+
+template<uint32_t... Locations>
+constexpr bool has_increasing_locations()
+{
+    constexpr std::array<uint32_t, sizeof...(Locations)> locations = { Locations... };
+    for(size_t i = 1; i < locations.size(); i++)
+        if(locations[i] <= locations[i - 1])
+            return false;
+    return true;
+}
+
+/**
+ * Vertex input of one interleaved binding, checked when it is compiled:
+ * every attribute is a member of V with a known format, and the locations
+ * increase. The shader side is checked against the reflection of the
+ * vertex shader when the pipeline is created (spirv::validate_vertex_input).
+ */
+template<typename V, typename... Attributes>
+struct VertexLayout
+{
+    static_assert(std::is_standard_layout_v<V>, "vertex types are copied to the GPU byte for byte");
+    static_assert((std::is_same_v<typename Attributes::vertex, V> && ...), "an attribute refers to a member of another vertex type");
+    static_assert((sizeof(typename Attributes::type) + ... + 0) <= sizeof(V), "attributes overlap");
+
+    static_assert(has_increasing_locations<Attributes::location...>(), "attribute locations must be unique and increasing");
+
+    static VertexInputDescription describe()
+    {
+        VertexInputDescription description;
+
+        description.bindings.push_back({
+            .binding   = 0,
+            .stride    = sizeof(V),
+            .inputRate = VK_VERTEX_INPUT_RATE_VERTEX
+        });
+
+        (description.attributes.push_back({
+            .location = Attributes::location,
+            .binding  = 0,
+            .format   = Attributes::format,
+            .offset   = Attributes::get_offset()
+        }), ...);
+
+        return description;
+    }
+};
+
 struct Vertex
 {
     glm::vec3 position;
@@ -24,8 +119,34 @@ struct Vertex
     static VertexInputDescription get_vertex_description();
 };
 
+// the inputs of default_mesh.vert
+using MeshVertexLayout = VertexLayout<Vertex,
+    VertexAttribute<0, &Vertex::position>,
+    VertexAttribute<1, &Vertex::normal>,
+    VertexAttribute<2, &Vertex::color>>;
+
+struct GPUMeshConstant
+{
+    glm::vec4 colors[3];
+};
+
+// One level of detail: a range of Mesh::vertices, drawn non-indexed
+struct MeshLod
+{
+    uint32_t first_vertex = 0;
+
+    uint32_t vertex_count = 0;
+
+    // largest object space distance between this level and the full-detail surface
+    float error = 0.0f;
+};
+
 struct Mesh
 {
     std::vector<Vertex> vertices;
+
+    // lods[0] is the full-detail mesh, empty until a LOD chain is built
+    std::vector<MeshLod> lods;
+
     AllocatedBuffer vertexBuffer;
 };
@@ -0,0 +1,439 @@
+#include "pre-compiled-header.h"
+#include "vk_pipeline.h"
+
+namespace
+{
+	// All create infos of a graphics pipeline, filled in place so the
+	// internal pointers stay valid while the pipeline (or a part) is created.
+	struct PipelineStates
+	{
+		std::array<VkPipelineShaderStageCreateInfo, 2> shader_stages;
+		uint32_t stage_count;
+		VkPipelineVertexInputStateCreateInfo vertex_input;
+		VkPipelineInputAssemblyStateCreateInfo input_assembly;
+		VkPipelineViewportStateCreateInfo viewport;
+		VkPipelineRasterizationStateCreateInfo raster;
+		VkPipelineMultisampleStateCreateInfo multisample;
+		VkPipelineDepthStencilStateCreateInfo depth_stencil;
+		VkPipelineColorBlendAttachmentState blend_attachment;
+		VkPipelineColorBlendStateCreateInfo blend;
+		VkPipelineDynamicStateCreateInfo dynamic_state;
+		VkPipelineRenderingCreateInfo rendering;
+	};
+
+	void fill_pipeline_states(const GraphicsPipelineDescription& description, PipelineStates& states)
+	{
+		states.shader_stages = {{
+		{
+			.sType 	= VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.stage 	= VK_SHADER_STAGE_VERTEX_BIT,
+			.module = description.vertex_shader,
+			.pName 	= "main"
+		},
+		{
+			.sType 	= VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.stage 	= VK_SHADER_STAGE_FRAGMENT_BIT,
+			.module = description.fragment_shader,
+			.pName 	= "main"
+		}
+		}};
+		states.stage_count = description.fragment_shader != VK_NULL_HANDLE ? 2 : 1;
+
+		states.vertex_input = {
+			.sType 							 = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+			.vertexBindingDescriptionCount   = static_cast<uint32_t>(description.vertex_input.bindings.size()),
+			.pVertexBindingDescriptions 	 = description.vertex_input.bindings.data(),
+			.vertexAttributeDescriptionCount = static_cast<uint32_t>(description.vertex_input.attributes.size()),
+			.pVertexAttributeDescriptions 	 = description.vertex_input.attributes.data()
+		};
+
+		states.input_assembly = {
+			.sType 					= VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+			.topology 				= VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+			.primitiveRestartEnable = VK_FALSE
+		};
+
+		states.viewport = {
+			.sType 		   = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+			.viewportCount = 1,
+			.scissorCount  = 1
+		};
+
+		states.raster = {
+			.sType 					 = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+			.depthClampEnable 		 = VK_FALSE,
+			.rasterizerDiscardEnable = VK_FALSE,
+			.polygonMode 			 = VK_POLYGON_MODE_FILL,
+			.depthBiasEnable 		 = VK_FALSE,
+			.lineWidth 				 = 1.0f
+		};
+
+		states.multisample = {
+			.sType 				  = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+			.rasterizationSamples = description.samples
+		};
+
+		states.depth_stencil = {
+			.sType 			= VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+			.depthCompareOp = VK_COMPARE_OP_ALWAYS
+		};
+
+		states.blend_attachment = description.blend_attachment;
+
+		const uint32_t color_attachment_count = description.color_format != VK_FORMAT_UNDEFINED ? 1 : 0;
+
+		states.blend = {
+			.sType 			 = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+			.attachmentCount = color_attachment_count,
+			.pAttachments 	 = &states.blend_attachment
+		};
+
+		states.dynamic_state = {
+			.sType 			   = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+			.dynamicStateCount = static_cast<uint32_t>(description.dynamic_states.size()),
+			.pDynamicStates    = description.dynamic_states.data()
+		};
+
+		// required for dynamic rendering
+		states.rendering = {
+			.sType 					 = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
+			.colorAttachmentCount 	 = color_attachment_count,
+			.pColorAttachmentFormats = &description.color_format,
+			.depthAttachmentFormat 	 = description.depth_format
+		};
+	}
+}
+
+/**
+ * @brief Create a complete (monolithic) graphics pipeline
+ * @param device The vulkan device
+ * @param description Shaders, vertex input, layout and attachment formats of the pipeline
+ */
+VkPipeline vkpipe::create_graphics_pipeline(VkDevice device, const GraphicsPipelineDescription& description)
+{
+	PipelineStates states;
+	fill_pipeline_states(description, states);
+
+	VkGraphicsPipelineCreateInfo pipeline_graphics_info = {
+		.sType 				 = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+		.pNext 				 = &states.rendering,
+		.stageCount 		 = states.stage_count,
+		.pStages 			 = states.shader_stages.data(),
+		.pVertexInputState 	 = &states.vertex_input,
+		.pInputAssemblyState = &states.input_assembly,
+		.pViewportState 	 = &states.viewport,
+		.pRasterizationState = &states.raster,
+		.pMultisampleState 	 = &states.multisample,
+		.pDepthStencilState  = &states.depth_stencil,
+		.pColorBlendState 	 = &states.blend,
+		.pDynamicState 		 = &states.dynamic_state,
+		.layout 			 = description.layout,
+		.renderPass 		 = VK_NULL_HANDLE,
+		.subpass			 = 0
+	};
+
+	VkPipeline pipeline;
+	VK_CHECK(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_graphics_info, nullptr, &pipeline));
+
+	return pipeline;
+}
+
+/**
+ * @brief Create a compute pipeline
+ * @param device The vulkan device
+ * @param shader The compute shader, entry point "main"
+ * @param layout The pipeline layout
+ * @param specialization Specialization constants, one shader can back several pipelines
+ */
+VkPipeline vkpipe::create_compute_pipeline(VkDevice device, VkShaderModule shader, VkPipelineLayout layout, const VkSpecializationInfo* specialization)
+{
+	VkComputePipelineCreateInfo pipeline_compute_info = {
+		.sType  = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+		.stage  = {
+			.sType 				 = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+			.stage 				 = VK_SHADER_STAGE_COMPUTE_BIT,
+			.module 			 = shader,
+			.pName 				 = "main",
+			.pSpecializationInfo = specialization
+		},
+		.layout = layout
+	};
+
+	VkPipeline pipeline;
+	VK_CHECK(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipeline_compute_info, nullptr, &pipeline));
+
+	return pipeline;
+}
+
+/**
+ * @brief Compile the four pipeline library parts
+ * @param device The vulkan device, created with VK_EXT_graphics_pipeline_library enabled
+ * @param description Shaders, vertex input, layout and attachment formats of the pipeline
+ */
+void PipelineLibrary::init(VkDevice device, const GraphicsPipelineDescription& description)
+{
+	m_device = device;
+	m_layout = description.layout;
+
+	PipelineStates states;
+	fill_pipeline_states(description, states);
+
+	const VkGraphicsPipelineLibraryFlagsEXT part_flags[] = {
+		VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT,
+		VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT,
+		VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT,
+		VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT
+	};
+
+	for(size_t i = 0; i < m_parts.size(); i++)
+	{
+		VkGraphicsPipelineLibraryCreateInfoEXT library_info = {
+			.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT,
+			.pNext = &states.rendering,
+			.flags = part_flags[i]
+		};
+
+		VkGraphicsPipelineCreateInfo part_info = {
+			.sType 			= VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+			.pNext 			= &library_info,
+			.flags 			= VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT,
+			.pDynamicState 	= &states.dynamic_state,
+			.renderPass 	= VK_NULL_HANDLE,
+			.subpass		= 0
+		};
+
+		switch(part_flags[i])
+		{
+		case VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT:
+			part_info.pVertexInputState   = &states.vertex_input;
+			part_info.pInputAssemblyState = &states.input_assembly;
+			break;
+		case VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT:
+			part_info.stageCount 		  = 1;
+			part_info.pStages 			  = &states.shader_stages[0];
+			part_info.pViewportState 	  = &states.viewport;
+			part_info.pRasterizationState = &states.raster;
+			part_info.layout 			  = description.layout;
+			break;
+		case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT:
+			part_info.stageCount 		 = states.stage_count - 1;
+			part_info.pStages 			 = &states.shader_stages[1];
+			part_info.pMultisampleState  = &states.multisample;
+			part_info.pDepthStencilState = &states.depth_stencil;
+			part_info.layout 			 = description.layout;
+			break;
+		case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT:
+			part_info.pMultisampleState = &states.multisample;
+			part_info.pColorBlendState  = &states.blend;
+			break;
+		}
+
+		VK_CHECK(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &part_info, nullptr, &m_parts[i]));
+	}
+}
+
+/**
+ * @brief Get the pipeline to bind, fast-linking the parts on first use
+ *
+ * The optimized link is started together with the fast link and replaces
+ * it as soon as the background compile is done.
+ */
+VkPipeline PipelineLibrary::get()
+{
+	if(m_optimized != VK_NULL_HANDLE)
+		return m_optimized;
+
+	if(m_fast_linked == VK_NULL_HANDLE)
+	{
+		m_fast_linked = link(false);
+		m_optimized_link = std::async(std::launch::async, [this]() { return link(true); });
+	}
+
+	if(m_optimized_link.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+	{
+		m_optimized = m_optimized_link.get();
+		return m_optimized;
+	}
+
+	return m_fast_linked;
+}
+
+void PipelineLibrary::destroy()
+{
+	if(m_optimized_link.valid())
+		m_optimized = m_optimized_link.get();
+
+	if(m_optimized != VK_NULL_HANDLE)
+		vkDestroyPipeline(m_device, m_optimized, nullptr);
+	if(m_fast_linked != VK_NULL_HANDLE)
+		vkDestroyPipeline(m_device, m_fast_linked, nullptr);
+
+	for(VkPipeline part : m_parts)
+		vkDestroyPipeline(m_device, part, nullptr);
+}
+
+VkPipeline PipelineLibrary::link(bool optimized) const
+{
+	VkPipelineLibraryCreateInfoKHR library_info = {
+		.sType 		  = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR,
+		.libraryCount = static_cast<uint32_t>(m_parts.size()),
+		.pLibraries   = m_parts.data()
+	};
+
+	VkGraphicsPipelineCreateInfo link_info = {
+		.sType  = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+		.pNext  = &library_info,
+		.flags  = optimized ? VkPipelineCreateFlags(VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT) : VkPipelineCreateFlags(0),
+		.layout = m_layout
+	};
+
+	VkPipeline pipeline;
+	VK_CHECK(vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 1, &link_info, nullptr, &pipeline));
+
+	return pipeline;
+}
+
+void PipelineLayoutCache::init(VkDevice device)
+{
+	m_device = device;
+}
+
+/**
+ * @brief Get the pipeline layout of a set of shader stages, created on first request
+ *
+ * Bindings declared by several stages are visible to all of them and must
+ * agree on type and count. Sets no stage declares between used ones get an
+ * empty layout. The push constant blocks of the stages become one range
+ * covering the largest block.
+ * @param stages Reflections of the pipeline's shaders
+ */
+VkPipelineLayout PipelineLayoutCache::get(const std::vector<const ShaderReflection*>& stages)
+{
+	std::vector<std::vector<VkDescriptorSetLayoutBinding>> sets;
+	VkPushConstantRange push_constants = {};
+
+	for(const ShaderReflection* stage : stages)
+	{
+		for(const ShaderBinding& binding : stage->bindings)
+		{
+			if(sets.size() <= binding.set)
+				sets.resize(binding.set + 1);
+
+			auto existing = std::find_if(sets[binding.set].begin(), sets[binding.set].end(), [&binding](const VkDescriptorSetLayoutBinding& other)
+			{
+				return other.binding == binding.binding;
+			});
+
+			if(existing == sets[binding.set].end())
+			{
+				sets[binding.set].push_back({
+					.binding 		 = binding.binding,
+					.descriptorType  = binding.type,
+					.descriptorCount = binding.count,
+					.stageFlags 	 = static_cast<VkShaderStageFlags>(stage->stage)
+				});
+			}
+			else if(existing->descriptorType != binding.type || existing->descriptorCount != binding.count)
+				throw std::runtime_error("Shader stages disagree on set " + std::to_string(binding.set) + " binding " + std::to_string(binding.binding));
+			else
+				existing->stageFlags |= stage->stage;
+		}
+
+		if(stage->push_constant_size > 0)
+		{
+			push_constants.stageFlags |= stage->stage;
+			push_constants.size = std::max(push_constants.size, stage->push_constant_size);
+		}
+	}
+
+	// the key of the layout: binding count and bindings of every set, then the push constant range
+	std::vector<uint32_t> key;
+	for(std::vector<VkDescriptorSetLayoutBinding>& bindings : sets)
+	{
+		std::sort(bindings.begin(), bindings.end(), [](const VkDescriptorSetLayoutBinding& a, const VkDescriptorSetLayoutBinding& b)
+		{
+			return a.binding < b.binding;
+		});
+
+		key.push_back(static_cast<uint32_t>(bindings.size()));
+		for(const VkDescriptorSetLayoutBinding& binding : bindings)
+			key.insert(key.end(), { binding.binding, static_cast<uint32_t>(binding.descriptorType), binding.descriptorCount, binding.stageFlags });
+	}
+	key.insert(key.end(), { push_constants.stageFlags, push_constants.size });
+
+	auto cached = m_layouts.find(key);
+	if(cached != m_layouts.end())
+		return cached->second.layout;
+
+	Layout layout;
+	for(const std::vector<VkDescriptorSetLayoutBinding>& bindings : sets)
+		layout.set_layouts.push_back(get_set_layout(bindings));
+
+	VkPipelineLayoutCreateInfo layout_info = {
+		.sType 					= VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.setLayoutCount 		= static_cast<uint32_t>(layout.set_layouts.size()),
+		.pSetLayouts 			= layout.set_layouts.data(),
+		.pushConstantRangeCount = push_constants.size > 0 ? 1u : 0u,
+		.pPushConstantRanges 	= &push_constants
+	};
+
+	VK_CHECK(vkCreatePipelineLayout(m_device, &layout_info, nullptr, &layout.layout));
+	m_layouts.emplace(std::move(key), layout);
+
+	return layout.layout;
+}
+
+VkDescriptorSetLayout PipelineLayoutCache::get_set_layout(VkPipelineLayout layout, uint32_t set) const
+{
+	for(const auto& [key, cached] : m_layouts)
+		if(cached.layout == layout)
+		{
+			if(set >= cached.set_layouts.size())
+				throw std::runtime_error("Pipeline layout has no set " + std::to_string(set));
+			return cached.set_layouts[set];
+		}
+
+	throw std::runtime_error("Pipeline layout was not created by the cache");
+}
+
+void PipelineLayoutCache::destroy()
+{
+	for(const auto& [key, layout] : m_layouts)
+		vkDestroyPipelineLayout(m_device, layout.layout, nullptr);
+	for(const auto& [key, set_layout] : m_set_layouts)
+		vkDestroyDescriptorSetLayout(m_device, set_layout, nullptr);
+
+	m_layouts.clear();
+	m_set_layouts.clear();
+}
+
+size_t PipelineLayoutCache::KeyHash::operator()(const std::vector<uint32_t>& key) const
+{
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for(uint32_t word : key)
+		hash = (hash ^ word) * 0x100000001b3ull;
+	return static_cast<size_t>(hash);
+}
+
+VkDescriptorSetLayout PipelineLayoutCache::get_set_layout(const std::vector<VkDescriptorSetLayoutBinding>& bindings)
+{
+	std::vector<uint32_t> key;
+	for(const VkDescriptorSetLayoutBinding& binding : bindings)
+		key.insert(key.end(), { binding.binding, static_cast<uint32_t>(binding.descriptorType), binding.descriptorCount, binding.stageFlags });
+
+	auto cached = m_set_layouts.find(key);
+	if(cached != m_set_layouts.end())
+		return cached->second;
+
+	VkDescriptorSetLayoutCreateInfo layout_info = {
+		.sType 		  = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.bindingCount = static_cast<uint32_t>(bindings.size()),
+		.pBindings 	  = bindings.data()
+	};
+
+	VkDescriptorSetLayout set_layout;
+	VK_CHECK(vkCreateDescriptorSetLayout(m_device, &layout_info, nullptr, &set_layout));
+	m_set_layouts.emplace(std::move(key), set_layout);
+
+	return set_layout;
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include "vk_defines.h"
+#include "vk_mesh.h"
+#include "shader_reflection.h"
+
+#include <future>
+#include <unordered_map>
+
+struct GraphicsPipelineDescription
+{
+	VkShaderModule vertex_shader = VK_NULL_HANDLE;
+
+	VkShaderModule fragment_shader = VK_NULL_HANDLE;
+
+	VertexInputDescription vertex_input;
+
+	VkPipelineLayout layout = VK_NULL_HANDLE;
+
+	// VK_FORMAT_UNDEFINED for depth-only pipelines, which also have no fragment shader
+	VkFormat color_format = VK_FORMAT_UNDEFINED;
+
+	VkFormat depth_format = VK_FORMAT_UNDEFINED;
+
+	// sample count of the attachments the pipeline renders to
+	VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+
+	// used when blend state is not dynamic (no VK_EXT_extended_dynamic_state3)
+	VkPipelineColorBlendAttachmentState blend_attachment = {
+		.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT
+	};
+
+	std::vector<VkDynamicState> dynamic_states = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+};
+
+namespace vkpipe
+{
+
+	VkPipeline create_graphics_pipeline(VkDevice device, const GraphicsPipelineDescription& description);
+
+	VkPipeline create_compute_pipeline(VkDevice device, VkShaderModule shader, VkPipelineLayout layout, const VkSpecializationInfo* specialization = nullptr);
+
+};
+
+/**
+ * Graphics pipeline built from VK_EXT_graphics_pipeline_library parts.
+ * The four parts are compiled up front, fast-linked on first use and
+ * replaced by a link-time optimized pipeline built on a background thread.
+ */
+class PipelineLibrary
+{
+public:
+
+	void init(VkDevice device, const GraphicsPipelineDescription& description);
+
+	VkPipeline get();
+
+	void destroy();
+
+private:
+
+	VkPipeline link(bool optimized) const;
+
+	VkDevice m_device = VK_NULL_HANDLE;
+
+	VkPipelineLayout m_layout = VK_NULL_HANDLE;
+
+	// vertex input, pre-rasterization, fragment shader, fragment output
+	std::array<VkPipeline, 4> m_parts {};
+
+	VkPipeline m_fast_linked = VK_NULL_HANDLE;
+
+	VkPipeline m_optimized = VK_NULL_HANDLE;
+
+	std::future<VkPipeline> m_optimized_link;
+};
+
+/**
+ * Pipeline layouts derived from the reflection of their shaders. Layouts
+ * and descriptor set layouts are deduplicated by content: shaders with the
+ * same interface get the same handles, so their pipelines are layout
+ * compatible and descriptor sets stay bound when switching between them.
+ * Layouts live until destroy(); the cache is filled at init time and is not
+ * thread safe.
+ */
+class PipelineLayoutCache
+{
+public:
+
+	void init(VkDevice device);
+
+	// layout of the union of the stages' interfaces; a push constant write must name every stage declaring the block
+	VkPipelineLayout get(const std::vector<const ShaderReflection*>& stages);
+
+	// a set layout of a layout returned by get(), to allocate descriptor sets from
+	VkDescriptorSetLayout get_set_layout(VkPipelineLayout layout, uint32_t set) const;
+
+	void destroy();
+
+	inline size_t get_layout_count() const { return m_layouts.size(); }
+
+	inline size_t get_set_layout_count() const { return m_set_layouts.size(); }
+
+private:
+
+	// FNV-1a over the words of a key
+	struct KeyHash
+	{
+		size_t operator()(const std::vector<uint32_t>& key) const;
+	};
+
+	struct Layout
+	{
+		VkPipelineLayout layout = VK_NULL_HANDLE;
+
+		std::vector<VkDescriptorSetLayout> set_layouts;
+	};
+
+	VkDescriptorSetLayout get_set_layout(const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+
+	VkDevice m_device = VK_NULL_HANDLE;
+
+	// keyed by the serialized bindings, so equal hashes of different contents never alias
+	std::unordered_map<std::vector<uint32_t>, VkDescriptorSetLayout, KeyHash> m_set_layouts;
+
+	std::unordered_map<std::vector<uint32_t>, Layout, KeyHash> m_layouts;
+};
@@ -1,7 +1,7 @@
 #include "pre-compiled-header.h"
 #include "vk_resources.h"
 
-AllocatedBuffer vkrsc::create_buffer(VmaAllocator allocator, size_t buffer_size, VkBufferUsageFlags buffer_usage, VmaMemoryUsage memory_usage, VmaAllocationCreateFlags memory_flags)
+AllocatedBuffer vkrsc::create_buffer(VmaAllocator allocator, size_t buffer_size, VkBufferUsageFlags buffer_usage, VmaMemoryUsage memory_usage, VmaAllocationCreateFlags memory_flags, const std::vector<uint32_t>& queue_families)
 {
     AllocatedBuffer new_buffer;
 
@@ -11,6 +11,13 @@ AllocatedBuffer vkrsc::create_buffer(VmaAllocator allocator, size_t buffer_size,
 		.usage = buffer_usage
 	};
 
+	if(queue_families.size() > 1)
+	{
+		buffer_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		buffer_info.queueFamilyIndexCount = static_cast<uint32_t>(queue_families.size());
+		buffer_info.pQueueFamilyIndices = queue_families.data();
+	}
+
 	VmaAllocationCreateInfo alloc_info = {
 		.flags = memory_flags,
 		.usage = memory_usage
@@ -20,3 +27,111 @@ AllocatedBuffer vkrsc::create_buffer(VmaAllocator allocator, size_t buffer_size,
 	
 	return new_buffer;
 }
+
+AllocatedImage vkrsc::create_image(VkDevice device, VmaAllocator allocator, VkExtent3D extent, VkFormat format, VkImageUsageFlags image_usage, VkImageAspectFlags aspect, uint32_t mip_levels)
+{
+	AllocatedImage new_image;
+	new_image.format = format;
+	new_image.extent = extent;
+
+	VkImageCreateInfo image_info = {
+		.sType 		   = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+		.imageType 	   = VK_IMAGE_TYPE_2D,
+		.format 	   = format,
+		.extent 	   = extent,
+		.mipLevels 	   = mip_levels,
+		.arrayLayers   = 1,
+		.samples 	   = VK_SAMPLE_COUNT_1_BIT,
+		.tiling 	   = VK_IMAGE_TILING_OPTIMAL,
+		.usage 		   = image_usage,
+		.sharingMode   = VK_SHARING_MODE_EXCLUSIVE,
+		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+	};
+
+	VmaAllocationCreateInfo alloc_info = {
+		.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT,
+		.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE
+	};
+
+	VK_CHECK(vmaCreateImage(allocator, &image_info, &alloc_info, &new_image.image, &new_image.allocation, nullptr));
+
+	VkImageViewCreateInfo view_info = {
+		.sType    		  = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+		.image    		  = new_image.image,
+		.viewType 		  = VK_IMAGE_VIEW_TYPE_2D,
+		.format   		  = format,
+		.subresourceRange = {
+			.aspectMask 	= aspect,
+			.baseMipLevel 	= 0,
+			.levelCount 	= mip_levels,
+			.baseArrayLayer = 0,
+			.layerCount 	= 1
+		}
+	};
+
+	VK_CHECK(vkCreateImageView(device, &view_info, nullptr, &new_image.view));
+
+	return new_image;
+}
+
+AllocatedImage vkrsc::create_attachment(VkDevice device, VmaAllocator allocator, VkExtent3D extent, VkFormat format, VkImageUsageFlags image_usage, VkImageAspectFlags aspect, VkSampleCountFlagBits samples)
+{
+	AllocatedImage new_image;
+	new_image.format = format;
+	new_image.extent = extent;
+
+	VkImageCreateInfo image_info = {
+		.sType 		   = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+		.imageType 	   = VK_IMAGE_TYPE_2D,
+		.format 	   = format,
+		.extent 	   = extent,
+		.mipLevels 	   = 1,
+		.arrayLayers   = 1,
+		.samples 	   = samples,
+		.tiling 	   = VK_IMAGE_TILING_OPTIMAL,
+		.usage 		   = image_usage | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT,
+		.sharingMode   = VK_SHARING_MODE_EXCLUSIVE,
+		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+	};
+
+	// contents never leave the tile memory, so on tilers the image needs no backing memory at all
+	VmaAllocationCreateInfo alloc_info = {
+		.usage = VMA_MEMORY_USAGE_GPU_LAZILY_ALLOCATED
+	};
+
+	VkResult result = vmaCreateImage(allocator, &image_info, &alloc_info, &new_image.image, &new_image.allocation, nullptr);
+	if(result == VK_ERROR_FEATURE_NOT_PRESENT)
+	{
+		// desktop GPUs have no lazily allocated memory type
+		alloc_info = {
+			.flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT,
+			.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE
+		};
+		result = vmaCreateImage(allocator, &image_info, &alloc_info, &new_image.image, &new_image.allocation, nullptr);
+	}
+	VK_CHECK(result);
+
+	VkImageViewCreateInfo view_info = {
+		.sType    		  = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+		.image    		  = new_image.image,
+		.viewType 		  = VK_IMAGE_VIEW_TYPE_2D,
+		.format   		  = format,
+		.subresourceRange = {
+			.aspectMask 	= aspect,
+			.baseMipLevel 	= 0,
+			.levelCount 	= 1,
+			.baseArrayLayer = 0,
+			.layerCount 	= 1
+		}
+	};
+
+	VK_CHECK(vkCreateImageView(device, &view_info, nullptr, &new_image.view));
+
+	return new_image;
+}
+
+void vkrsc::destroy_image(VkDevice device, VmaAllocator allocator, const AllocatedImage& image)
+{
+	vkDestroyImageView(device, image.view, nullptr);
+	vmaDestroyImage(allocator, image.image, image.allocation);
+}
@@ -8,8 +8,25 @@ struct AllocatedBuffer
     VmaAllocation allocation;
 };
 
+struct AllocatedImage
+{
+    VkImage image;
+    VkImageView view;
+    VmaAllocation allocation;
+    VkFormat format;
+    VkExtent3D extent;
+};
+
 
 namespace vkrsc 
 {
-    AllocatedBuffer create_buffer(VmaAllocator allocator, size_t buffer_size, VkBufferUsageFlags buffer_usage, VmaMemoryUsage memory_usage, VmaAllocationCreateFlags memory_flags);
+    // buffers used by more than one queue family are created with concurrent sharing
+    AllocatedBuffer create_buffer(VmaAllocator allocator, size_t buffer_size, VkBufferUsageFlags buffer_usage, VmaMemoryUsage memory_usage, VmaAllocationCreateFlags memory_flags, const std::vector<uint32_t>& queue_families = {});
+
+    AllocatedImage create_image(VkDevice device, VmaAllocator allocator, VkExtent3D extent, VkFormat format, VkImageUsageFlags image_usage, VkImageAspectFlags aspect, uint32_t mip_levels = 1);
+
+    // render pass attachments, transient and lazily allocated where the device has such memory (tilers)
+    AllocatedImage create_attachment(VkDevice device, VmaAllocator allocator, VkExtent3D extent, VkFormat format, VkImageUsageFlags image_usage, VkImageAspectFlags aspect, VkSampleCountFlagBits samples);
+
+    void destroy_image(VkDevice device, VmaAllocator allocator, const AllocatedImage& image);
 }
\ No newline at end of file
@@ -6,7 +6,7 @@
  * @param device The vulkan device
  * @param file_path The shader file path
  */
-VkShaderModule vkutil::load_shader_module(VkDevice device, const char *file_path)
+VkShaderModule vkutil::load_shader_module(VkDevice device, const char *file_path, ShaderReflection* reflection)
 {
     std::ifstream file(file_path, std::ios::ate | std::ios::binary);
     if(!file.is_open())
@@ -20,6 +20,9 @@ VkShaderModule vkutil::load_shader_module(VkDevice device, const char *file_path
     file.read((char*)buffer.data(), file_size);
     file.close();
 
+    if(reflection)
+        *reflection = spirv::reflect(buffer.data(), buffer.size());
+
     VkShaderModuleCreateInfo module_info = {
         .sType 	  = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
         .codeSize = file_size,
@@ -42,6 +45,7 @@ VkShaderModule vkutil::load_shader_module(VkDevice device, const char *file_path
  * @param dstAccessMask The destination access mask, specifying which access types are being transitioned to.
  * @param srcStage The pipeline stage that must happen before the transition.
  * @param dstStage The pipeline stage that must happen after the transition.
+ * @param aspectMask The aspect of the image affected, color unless it is a depth image.
  */
 void vkutil::transition_image_layout(
     VkCommandBuffer cmd,
@@ -51,7 +55,10 @@ void vkutil::transition_image_layout(
     VkAccessFlags2 srcAccessMask,
     VkAccessFlags2 dstAccessMask,
     VkPipelineStageFlags2 srcStage,
-    VkPipelineStageFlags2 dstStage)
+    VkPipelineStageFlags2 dstStage,
+    VkImageAspectFlags aspectMask,
+    uint32_t baseMipLevel,
+    uint32_t levelCount)
 {
     // Initialize the VkImageMemoryBarrier2 structure
 	VkImageMemoryBarrier2 image_barrier{
@@ -76,9 +83,9 @@ void vkutil::transition_image_layout(
 
 	    // Define the subresource range (which parts of the image are affected)
 	    .subresourceRange = {
-	        .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,        // Affects the color aspect of the image
-	        .baseMipLevel   = 0,                                // Start at mip level 0
-	        .levelCount     = 1,                                // Number of mip levels affected
+	        .aspectMask     = aspectMask,                       // Affects the color (or depth) aspect of the image
+	        .baseMipLevel   = baseMipLevel,                     // First affected mip level
+	        .levelCount     = levelCount,                       // Number of mip levels affected
 	        .baseArrayLayer = 0,                                // Start at array layer 0
 	        .layerCount     = 1                                 // Number of array layers affected
 	    }};
@@ -94,3 +101,57 @@ void vkutil::transition_image_layout(
 	// Record the pipeline barrier into the command buffer
 	vkCmdPipelineBarrier2(cmd, &dependency_info);
 }
+
+/**
+ * @brief Pick a float depth format for reverse-Z rendering
+ * @param gpu The physical device
+ */
+VkFormat vkutil::find_depth_format(VkPhysicalDevice gpu)
+{
+	VkFormatProperties properties;
+	vkGetPhysicalDeviceFormatProperties(gpu, VK_FORMAT_D32_SFLOAT, &properties);
+
+	if(!(properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT))
+		throw std::runtime_error("D32_SFLOAT depth attachments are not supported");
+
+	return VK_FORMAT_D32_SFLOAT;
+}
+
+/**
+ * @brief Find the graphics+present family and a dedicated async compute family
+ *
+ * A family with compute but without graphics runs on hardware queues that
+ * execute alongside rasterization; when there is none, compute shares the
+ * graphics family. graphics is UINT32_MAX when the device cannot present.
+ * @param gpu The physical device
+ * @param surface The surface images are presented to
+ */
+QueueFamilies vkutil::find_queue_families(VkPhysicalDevice gpu, VkSurfaceKHR surface)
+{
+	uint32_t queue_family_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(gpu, &queue_family_count, nullptr);
+
+	std::vector<VkQueueFamilyProperties> queue_family_properties(queue_family_count);
+	vkGetPhysicalDeviceQueueFamilyProperties(gpu, &queue_family_count, queue_family_properties.data());
+
+	QueueFamilies families;
+	for(uint32_t i = 0; i < queue_family_count; i++)
+	{
+		VkQueueFlags flags = queue_family_properties[i].queueFlags;
+
+		VkBool32 supports_present = VK_FALSE;
+		vkGetPhysicalDeviceSurfaceSupportKHR(gpu, i, surface, &supports_present);
+
+		if(families.graphics == UINT32_MAX && (flags & VK_QUEUE_GRAPHICS_BIT) && supports_present)
+			families.graphics = i;
+
+		if(families.compute == UINT32_MAX && (flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT))
+			families.compute = i;
+	}
+
+	// every graphics family supports compute as well
+	if(families.compute == UINT32_MAX)
+		families.compute = families.graphics;
+
+	return families;
+}
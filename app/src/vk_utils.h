@@ -1,12 +1,30 @@
 #pragma once
 
 #include "vk_defines.h"
+#include "shader_reflection.h"
+
+// Queue families the engine submits to
+struct QueueFamilies
+{
+	// graphics and present
+	uint32_t graphics = UINT32_MAX;
+
+	// a compute-only family when the device has one, the graphics family otherwise
+	uint32_t compute = UINT32_MAX;
+
+	inline bool has_async_compute() const { return compute != graphics; }
+};
 
 namespace vkutil
 {
 
-    VkShaderModule load_shader_module(VkDevice device, const char *file_path);
+    // reflection, when given, receives the interface of the module
+    VkShaderModule load_shader_module(VkDevice device, const char *file_path, ShaderReflection* reflection = nullptr);
+
+    void transition_image_layout(VkCommandBuffer cmd, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags2 srcAccessMask, VkAccessFlags2 dstAccessMask, VkPipelineStageFlags2 srcStage, VkPipelineStageFlags2 dstStage, VkImageAspectFlags aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, uint32_t baseMipLevel = 0, uint32_t levelCount = 1);
+
+    VkFormat find_depth_format(VkPhysicalDevice gpu);
 
-    void transition_image_layout(VkCommandBuffer cmd, VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout, VkAccessFlags2 srcAccessMask, VkAccessFlags2 dstAccessMask, VkPipelineStageFlags2 srcStage, VkPipelineStageFlags2 dstStage);
+    QueueFamilies find_queue_families(VkPhysicalDevice gpu, VkSurfaceKHR surface);
 
 };
\ No newline at end of file